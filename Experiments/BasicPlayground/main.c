@@ -27,11 +27,12 @@ static void init(void)
     ib_initCore((ib_CoreDesc)
                 {
                     .Win32MainWindowHandle = sapp_win32_get_hwnd(),
-                    .Win32MainInstanceHandle = GetModuleHandle(NULL)
+                    .Win32MainInstanceHandle = GetModuleHandle(NULL),
+                    .PipelineCachePath = "BasicPlayground.pipelinecache"
                 },
                 &Core);
 
-    GraphPool = ibr_allocRenderGraphPool(&Core);
+    GraphPool = ibr_allocRenderGraphPool(&Core, (ibr_RenderGraphPoolDesc) { .RecordingThreadCount = 1 });
     Surface = ib_allocWin32Surface(&Core, (ib_SurfaceDesc)
                                    {
                                        .Win32WindowHandle = sapp_win32_get_hwnd(),
@@ -107,7 +108,7 @@ static void update(void)
         ibr_endFrame(&GraphPool, graph);
     }
 
-    ActiveFrame = (ActiveFrame + 1) % ib_FramebufferCount;
+    ActiveFrame = (ActiveFrame + 1) % GraphPool.FramesInFlight;
 }
 
 void events(sapp_event const* event)
@@ -153,7 +153,7 @@ static void init(void)
                 },
                 &Core);
 
-    GraphPool = ibr_allocRenderGraphPool(&Core);
+    GraphPool = ibr_allocRenderGraphPool(&Core, (ibr_RenderGraphPoolDesc) { .RecordingThreadCount = 1 });
     Surface = ib_allocWin32Surface(&Core, (ib_SurfaceDesc)
                                    {
                                        .Win32WindowHandle = sapp_win32_get_hwnd(),
@@ -310,7 +310,7 @@ static void update(void)
         ibr_endFrame(&GraphPool, graph);
     }
 
-    ActiveFrame = (ActiveFrame + 1) % ib_FramebufferCount;
+    ActiveFrame = (ActiveFrame + 1) % GraphPool.FramesInFlight;
 
     imgui_endFrame();
 }
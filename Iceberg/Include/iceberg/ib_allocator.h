@@ -79,6 +79,8 @@ typedef struct
     VkDevice LogicalDevice;
     uint32_t RootMemorySize;
     iba_GpuMemoryPool* MemoryPools;
+    VkDeviceSize AllocatedSize;
+    uint32_t AllocationCount;
 } iba_GpuAllocator;
 
 typedef struct
@@ -115,6 +117,17 @@ void iba_killGpuAllocator(iba_GpuAllocator *allocator);
 iba_GpuAllocation iba_gpuAlloc(iba_GpuAllocator *allocator, iba_GpuAllocationRequest request);
 void iba_gpuFree(iba_GpuAllocator *allocator, iba_GpuAllocation* allocation);
 
+typedef struct
+{
+    VkDeviceSize ReservedSize; // Device memory held by the roots
+    VkDeviceSize AllocatedSize; // Handed out of the roots, alignment padding included
+    uint32_t AllocationCount;
+    uint32_t RootCount;
+    uint32_t PoolCount; // One per memory type in use
+} iba_GpuAllocatorStats;
+
+iba_GpuAllocatorStats iba_getGpuAllocatorStats(iba_GpuAllocator const* allocator);
+
 // Stack Allocator
 
 // Pages must match this header
@@ -17,10 +17,14 @@
 
 static VkAllocationCallbacks *const ib_NoVkAllocator = NULL;
 
+// Default frames in flight and swapchain image count, both can be picked at runtime up to their maximums.
 #ifndef ib_FramebufferCount
 #define ib_FramebufferCount 2
 #endif // ib_FramebufferCount
 
+#define ib_MaxFramesInFlight 4
+#define ib_MaxSwapchainImageCount 8 // Drivers can hand back more images than we asked for
+
 typedef struct ib_Core ib_Core;
 
 // Timeline semaphore
@@ -99,16 +103,47 @@ enum
     ib_DefaultTexture_White = 0,
     ib_DefaultTexture_Count
 };
-	
+
+// Window systems
+enum
+{
+    ib_WindowSystem_None = 0,
+    ib_WindowSystem_Win32,
+    ib_WindowSystem_Xlib,
+    ib_WindowSystem_Xcb,
+    ib_WindowSystem_Wayland,
+    ib_WindowSystem_Headless, // VK_EXT_headless_surface, presents go nowhere. Drives the present path without a display.
+    ib_WindowSystem_Count
+};
+typedef uint32_t ib_WindowSystem;
+
+typedef struct
+{
+    ib_WindowSystem System;
+    void const* Display; // HINSTANCE, Display*, xcb_connection_t* or wl_display*. Unused for headless.
+    void const* Window; // HWND, the Window or xcb_window_t cast to a pointer, or wl_surface*. Unused for headless.
+} ib_Window;
+
 typedef struct
 {
     // Win32
     void const* Win32MainWindowHandle;
     void const* Win32MainInstanceHandle;
+    ib_Window MainWindow; // Any window system, picks a device and present queue that can present to it. Ignored if Win32MainWindowHandle is set.
+    char const* DeviceNameFilter; // Optional, only devices whose name contains this are considered. "llvmpipe" picks lavapipe.
+
+    char const* PipelineCachePath; // Optional, the pipeline cache is loaded from here on init and saved back on kill
+    bool CaptureShaderStatistics; // Always on with IB_DEBUG, see ib_getPipelineExecutableReport
+    char const* ComputeTuningPath; // Optional, autotuned compute configurations are loaded from and saved to here
 } ib_CoreDesc;
 
 void ib_initCore(ib_CoreDesc desc, ib_Core* outCore);
 void ib_killCore(ib_Core* core);
+
+// Writes the pipeline cache to ib_CoreDesc::PipelineCachePath through a temporary file, so a crash mid-save keeps the old cache.
+// Does nothing if no pipelines were compiled since the last save. Returns false if the save failed.
+// Can run alongside pipeline creation, but not alongside another save. The render graph pool saves periodically on its own thread.
+bool ib_savePipelineCache(ib_Core* core);
 void ib_flushStaging(ib_Core* core, ib_Staging* staging);
 
 // Command buffer
@@ -117,6 +152,7 @@ typedef struct
     ib_range(VkCommandBuffer) OutCommandBuffers;
     ib_Queue Queue;
     VkCommandPool Pool;
+    VkCommandBufferLevel Level; // Defaults to primary
 } ib_AllocCommandBuffersDesc;
 
 typedef struct
@@ -147,6 +183,7 @@ typedef struct
     VkFormat Format;
     uint32_t MipCount;
     uint32_t LayerCount;
+    uint32_t BindlessIndex; // ib_InvalidBindlessIndex unless the texture is sampled or used as storage
 } ib_Texture;
 
 typedef struct
@@ -210,6 +247,7 @@ typedef struct
     VkDeviceAddress DeviceAddress;
     iba_GpuAllocation Allocation;
     size_t Size;
+    uint32_t BindlessIndex; // ib_InvalidBindlessIndex unless the buffer is a storage buffer
 } ib_Buffer;
 
 typedef struct
@@ -242,32 +280,90 @@ void ib_freeBuffer(ib_Core* core, ib_Buffer* buffer);
 void ib_writeToBuffer(ib_Core* core, ib_WriteToBufferDesc desc);
 
 // Surface
+enum
+{
+    ib_PresentMode_Default = 0, // FIFO with UseVSync, mailbox otherwise if the surface supports it
+    ib_PresentMode_Fifo,
+    ib_PresentMode_FifoRelaxed, // Tears instead of waiting when a frame misses its vblank
+    ib_PresentMode_Mailbox,
+    ib_PresentMode_Immediate,
+    ib_PresentMode_Count
+};
+typedef uint32_t ib_PresentMode;
+
+// Rebuilds hand the old swapchain to the new one and keep it alive until the frames that used it are done.
+#define ib_MaxRetiredSwapchainCount 4
+typedef struct
+{
+    VkSwapchainKHR Swapchain;
+    VkImageView Views[ib_MaxSwapchainImageCount];
+    uint32_t ViewCount;
+    uint64_t RetiredAtPrepare; // ib_Surface::PrepareCount when it was replaced
+} ib_RetiredSwapchain;
+
+// Filled in by ib_prepareSurface and ib_presentSurface, can be reset freely.
+typedef struct
+{
+    uint64_t AcquireCount;
+    double LastAcquireWaitTime; // Milliseconds blocked in vkAcquireNextImageKHR
+    double MaxAcquireWaitTime;
+    double TotalAcquireWaitTime;
+    uint64_t PresentCount;
+    uint32_t RebuildCount;
+
+    // Only with ib_Core::PresentWaitEnabled. Completion is polled once per ib_prepareSurface, times are accurate to a frame.
+    uint64_t CompletedPresentCount;
+    uint64_t MissedVBlankCount; // FIFO modes only, refreshes that went by without a new image
+    double RefreshInterval; // Milliseconds, estimated from completed presents
+} ib_PresentStatistics;
+
 typedef struct
 {
     VkSurfaceKHR VulkanSurface;
     VkSurfaceFormatKHR Format;
-    VkExtent3D Extent;
+    VkExtent3D Extent; // Wayland and headless surfaces leave the size to us, set this before ib_rebuildSurface to resize them
     VkPresentModeKHR PresentMode;
+    uint32_t SupportedPresentModes; // Bit per ib_PresentMode
     VkSwapchainKHR Swapchain;
 
     struct
     {
         VkSemaphore AcquireSemaphore;
-    } Framebuffers[ib_FramebufferCount];
-    ib_Texture SwapchainTextures[ib_FramebufferCount];
+    } Framebuffers[ib_MaxFramesInFlight];
+    ib_Texture SwapchainTextures[ib_MaxSwapchainImageCount];
+    uint32_t SwapchainTextureCount;
+    uint32_t RequestedImageCount;
+
+    ib_RetiredSwapchain RetiredSwapchains[ib_MaxRetiredSwapchainCount];
+    uint32_t RetiredSwapchainCount;
+    uint64_t PrepareCount;
+
+    ib_PresentStatistics Statistics;
+    uint64_t PresentID; // Last VK_KHR_present_id value handed to the swapchain
+    uint64_t CompletedPresentID;
+    uint64_t PresentCompletedTicks; // When CompletedPresentID was seen complete
 } ib_Surface;
 
 typedef struct
 {
     void const* Win32WindowHandle;
     void const* Win32InstanceHandle;
+    ib_Window Window; // For ib_allocSurface
+    VkExtent2D Extent; // Used when the window system doesn't dictate the size, Wayland and headless
     bool UseVSync;
+    ib_PresentMode PresentMode; // Falls back to FIFO if the surface doesn't support it
     bool SRGB;
+    uint32_t ImageCount; // 1 to ib_MaxSwapchainImageCount, 0 uses ib_FramebufferCount. Clamped to what the surface supports.
 } ib_SurfaceDesc;
 
-ib_Surface ib_allocWin32Surface(ib_Core* core, ib_SurfaceDesc desc);
+ib_Surface ib_allocSurface(ib_Core* core, ib_SurfaceDesc desc);
+ib_Surface ib_allocWin32Surface(ib_Core* core, ib_SurfaceDesc desc); // ib_allocSurface with Win32WindowHandle and Win32InstanceHandle
 void ib_freeSurface(ib_Core* core, ib_Surface* surface);
 
+// Both rebuild the swapchain, call them between frames.
+void ib_setSurfaceImageCount(ib_Core* core, ib_Surface* surface, uint32_t imageCount);
+bool ib_setSurfacePresentMode(ib_Core* core, ib_Surface* surface, ib_PresentMode presentMode); // False if unsupported, the mode is left as is
+
 enum
 {
     ib_SurfaceState_Ok = 0,
@@ -298,6 +394,8 @@ typedef struct
 } ib_PresentSurfaceDesc;
 
 ib_SurfaceState ib_presentSurface(ib_Core* core, ib_PresentSurfaceDesc presentDesc);
+
+// Doesn't wait for the device, the old swapchain is destroyed by a later ib_prepareSurface once its frames are done.
 void ib_rebuildSurface(ib_Core* core, ib_Surface* surface);
 
 // Graphics pipeline
@@ -316,11 +414,21 @@ typedef ib_range(ib_ShaderInputDesc const) ib_ShaderInputRange;
 typedef struct
 {
     ib_ShaderInputRange Inputs;
+    bool PushDescriptor; // Inputs are pushed into command buffers with ib_pushShaderInputs instead of allocated, requires ib_Core::PushDescriptorsEnabled
 } ib_ShaderInputLayoutDesc;
 
+#define ib_MaxShaderInputsPerLayout 32
+#define ib_MaxTemplatedDescriptorCount 256 // Layouts with more descriptors than this are written without an update template
+
 typedef struct
 {
     VkDescriptorSetLayout DescriptorSetLayout;
+    bool IsPushDescriptor;
+
+    // Used when a write fills every descriptor of the set, VK_NULL_HANDLE if the layout doesn't fit a template.
+    VkDescriptorUpdateTemplate UpdateTemplate;
+    uint32_t TemplateDescriptorCount;
+    uint16_t TemplateOffsets[ib_MaxShaderInputsPerLayout]; // First template entry of each binding
 } ib_ShaderInputLayout;
 
 ib_ShaderInputLayout ib_allocShaderInputLayout(ib_Core* core, ib_ShaderInputLayoutDesc blockLayoutDesc);
@@ -373,10 +481,33 @@ typedef struct
 {
     ib_ShaderInput* ShaderInput;
     ib_range(ib_ShaderInputWrite const) Inputs;
+    ib_ShaderInputLayout const* Layout; // Optional, lets complete writes go through the layout's update template
 } ib_WriteToShaderInputDesc;
 
 void ib_writeToShaderInput(ib_Core* core, ib_WriteToShaderInputDesc desc);
 
+// Records the writes straight into the command buffer, no descriptor set or pool involved.
+// The set at SetIndex in the pipeline layout has to be a push descriptor layout.
+typedef struct
+{
+    VkPipelineBindPoint BindPoint;
+    VkPipelineLayout PipelineLayout;
+    uint32_t SetIndex;
+    ib_range(ib_ShaderInputWrite const) Inputs;
+} ib_PushShaderInputsDesc;
+
+void ib_pushShaderInputs(ib_Core* core, VkCommandBuffer commandBuffer, ib_PushShaderInputsDesc desc);
+
+// Specialization constants are 32 bits, floats and bools go in as their bit pattern.
+#define ib_MaxSpecializationConstantCount 32
+typedef struct
+{
+    uint32_t Id; // constant_id in the shader, ids the shader doesn't declare are ignored
+    uint32_t Value;
+} ib_SpecializationConstant;
+
+typedef ib_range(ib_SpecializationConstant const) ib_SpecializationConstantRange;
+
 typedef struct
 {
     char const* EntryPoint;
@@ -384,6 +515,7 @@ typedef struct
     size_t CodeSize;
     VkShaderStageFlagBits Stage;
     uint32_t RequiredWaveSize;
+    ib_SpecializationConstantRange Constants;
 } ib_ShaderDesc;
 
 typedef struct
@@ -405,6 +537,10 @@ typedef struct
 } ib_PipelineShaderInputDesc;
 
 #define ib_MaxShaderInputLayoutPerPipeline 4
+#define ib_MaxShaderStagesPerPipeline 8
+#define ib_GraphicsPipelineLibraryPartCount 4 // Vertex input, pre-rasterization, fragment shader and fragment output
+
+typedef struct ib_GraphicsPipeline ib_GraphicsPipeline;
 
 typedef struct
 {
@@ -418,15 +554,25 @@ typedef struct
 
     ib_range(ib_RenderTargetDesc const) RenderTargetDescs;
     ib_DepthRenderTargetDesc DepthDesc;
+
+    // Pipeline libraries, requires ib_Core::GraphicsPipelineLibraryEnabled.
+    // Compile the parts shared between variants once with LibraryParts, then build each variant with Libraries
+    // and only the state of the remaining parts, which is a link rather than a full compile.
+    VkGraphicsPipelineLibraryFlagsEXT LibraryParts; // Non zero builds a library with only these parts
+    ib_range(ib_GraphicsPipeline const* const) Libraries; // Parts to link in instead of compiling
+    bool LinkTimeOptimization; // Slower link that optimizes across the libraries
 } ib_GraphicsPipelineDesc;
 
-typedef struct
+struct ib_GraphicsPipeline
 {
     VkPipelineLayout Layout;
     VkPipeline VulkanPipeline;
     ib_ShaderInputLayout InlineShaderInputLayouts[ib_MaxShaderInputLayoutPerPipeline]; // Owned shader input layouts.
     uint32_t InlineShaderInputLayoutCount;
-} ib_GraphicsPipeline;
+    VkShaderModule ShaderModules[ib_MaxShaderStagesPerPipeline]; // References into ib_Core::ShaderModules
+    uint32_t ShaderModuleCount;
+    VkGraphicsPipelineLibraryFlagsEXT LibraryParts;
+};
 
 ib_GraphicsPipeline ib_allocGraphicsPipeline(ib_Core* core, ib_GraphicsPipelineDesc desc);
 void ib_freeGraphicsPipeline(ib_Core* core, ib_GraphicsPipeline* pipeline);
@@ -451,11 +597,20 @@ inline void ib_reloadGraphicsPipeline(ib_Core* core, ib_GraphicsPipeline* pipeli
     }
 }
 
+// Filled by ib_autotuneComputePipeline, see Compute autotuning below.
+typedef struct
+{
+    uint32_t RequiredWaveSize; // 0 leaves it to the driver
+    VkExtent3D WorkgroupSize; // Zero if the workgroup size isn't tuned
+    uint32_t WorkgroupSizeIds[3]; // constant_id of local_size_x_id, local_size_y_id and local_size_z_id
+} ib_ComputeTuning;
+
 typedef struct
 {
     ib_ShaderDesc ShaderDesc;
     ib_range(VkPushConstantRange const) PushConstants;
     ib_PipelineShaderInputDesc ShaderInputs[ib_MaxShaderInputLayoutPerPipeline];
+    bool ApplyStoredTuning; // Overrides the wave size and workgroup size with the tuning stored for this shader, if any
 } ib_ComputePipelineDesc;
 
 typedef struct
@@ -464,6 +619,9 @@ typedef struct
     VkPipeline VulkanPipeline;
     ib_ShaderInputLayout InlineShaderInputLayouts[ib_MaxShaderInputLayoutPerPipeline]; // Owned shader input layouts.
     uint32_t InlineShaderInputLayoutCount;
+    VkShaderModule ShaderModule; // Reference into ib_Core::ShaderModules
+    ib_ComputeTuning Tuning; // Applied tuning, size dispatches off Tuning.WorkgroupSize when it's non zero
+    bool IsTuned;
 } ib_ComputePipeline;
 
 ib_ComputePipeline ib_allocComputePipeline(ib_Core* core, ib_ComputePipelineDesc desc);
@@ -479,15 +637,205 @@ inline void ib_reloadComputePipeline(ib_Core* core, ib_ComputePipeline* pipeline
     }
 }
 
+// Pipeline variants
+// One pipeline per set of specialization constants, built on first use from a shared base desc.
+// The variant constants replace the constants of every shader in the base desc.
+typedef struct ib_PipelineVariant ib_PipelineVariant;
+struct ib_PipelineVariant
+{
+    ib_PipelineVariant* Next;
+    uint64_t Hash;
+    ib_SpecializationConstant Constants[ib_MaxSpecializationConstantCount];
+    uint32_t ConstantCount;
+    ib_GraphicsPipeline Graphics;
+    ib_ComputePipeline Compute;
+};
+
+typedef struct
+{
+    ib_GraphicsPipelineDesc const* GraphicsDesc; // Set one of the two, it must stay alive with the cache
+    ib_ComputePipelineDesc const* ComputeDesc;
+} ib_PipelineVariantCacheDesc;
+
+typedef struct
+{
+    ib_PipelineVariantCacheDesc Desc;
+    ib_PipelineVariant* Variants;
+    uint32_t VariantCount;
+} ib_PipelineVariantCache;
+
+ib_PipelineVariantCache ib_allocPipelineVariantCache(ib_PipelineVariantCacheDesc desc);
+void ib_freePipelineVariantCache(ib_Core* core, ib_PipelineVariantCache* cache);
+// Returned pipelines live as long as the cache
+ib_GraphicsPipeline const* ib_getGraphicsPipelineVariant(ib_Core* core, ib_PipelineVariantCache* cache, ib_SpecializationConstantRange constants);
+ib_ComputePipeline const* ib_getComputePipelineVariant(ib_Core* core, ib_PipelineVariantCache* cache, ib_SpecializationConstantRange constants);
+
+// Compute autotuning
+// Builds a compute pipeline for every combination of wave size and workgroup size, times representative dispatches
+// and stores the fastest for this device. From then on ib_allocComputePipeline applies the stored tuning to the same
+// shader when ib_ComputePipelineDesc::ApplyStoredTuning is set, the tunings are saved to ib_CoreDesc::ComputeTuningPath
+// for the next launch.
+// The shader has to take its workgroup size from specialization constants for the workgroup size to be tuned.
+#define ib_DefaultAutotuneSampleCount 16
+
+typedef void(*ib_AutotuneDispatchFunc)(VkCommandBuffer commandBuffer, ib_ComputePipeline const* pipeline, ib_ComputeTuning const* tuning, void* userData);
+
+typedef struct
+{
+    ib_ComputePipelineDesc const* Desc;
+    ib_range(uint32_t const) WaveSizes; // Empty tries 32 and 64, sizes the device can't require are skipped
+    ib_range(VkExtent3D const) WorkgroupSizes; // Empty keeps the shader's own workgroup size
+    uint32_t WorkgroupSizeIds[3];
+    ib_AutotuneDispatchFunc Dispatch; // Binds and dispatches, size the grid off the tuning's workgroup size
+    void* UserData;
+    uint32_t SampleCount; // Timed runs per candidate, the median is kept. 0 uses ib_DefaultAutotuneSampleCount
+} ib_AutotuneComputeDesc;
+
+typedef struct
+{
+    ib_ComputeTuning Best;
+    double BestMs;
+    double WorstMs;
+    uint32_t CandidateCount;
+} ib_AutotuneResult;
+
+ib_AutotuneResult ib_autotuneComputePipeline(ib_Core* core, ib_AutotuneComputeDesc desc); // Blocks until every candidate is timed
+bool ib_getComputeTuning(ib_Core* core, ib_ShaderDesc const* shaderDesc, ib_ComputeTuning* outTuning);
+bool ib_saveComputeTunings(ib_Core* core); // Also called by ib_autotuneComputePipeline and ib_killCore
+
+// Batched compilation
+// Pipelines are compiled on worker threads against the shared pipeline cache.
+// Descs, the shader code and shader input ranges they point to, and the output arrays must stay alive until ib_waitPipelineBatch.
+#define ib_MaxPipelineBatchThreadCount 64
+typedef struct
+{
+    ib_range(ib_GraphicsPipelineDesc const) GraphicsDescs;
+    ib_range(ib_ComputePipelineDesc const) ComputeDescs;
+    ib_GraphicsPipeline* OutGraphicsPipelines; // GraphicsDescs.Count entries, each valid once ib_isGraphicsPipelineReady returns true
+    ib_ComputePipeline* OutComputePipelines; // ComputeDescs.Count entries
+    uint32_t ThreadCount; // 0 uses one thread per core
+} ib_PipelineBatchDesc;
+
+typedef struct
+{
+    uint64_t WallCPUTicks; // From ib_compilePipelineBatch until the last pipeline was done
+    uint64_t CompileCPUTicks; // Summed across workers, CompileCPUTicks / WallCPUTicks is the speedup over compiling serially
+    uint32_t ThreadCount;
+} ib_PipelineBatchStats;
+
+typedef struct ib_PipelineBatch ib_PipelineBatch;
+
+ib_PipelineBatch* ib_compilePipelineBatch(ib_Core* core, ib_PipelineBatchDesc desc);
+bool ib_isGraphicsPipelineReady(ib_PipelineBatch const* batch, uint32_t index);
+bool ib_isComputePipelineReady(ib_PipelineBatch const* batch, uint32_t index);
+ib_PipelineBatchStats ib_waitPipelineBatch(ib_PipelineBatch* batch); // Blocks until every pipeline is compiled and frees the batch
+
+// Hot reload
+// A worker thread watches SPIR-V files and rebuilds the pipelines using them when they change.
+// Rebuilt pipelines are swapped in by ib_advancePipelineReloads at a frame boundary and the replaced ones are freed
+// once no frame in flight can reference them, so an edit never stalls rendering.
+// Everything a watched desc points to, other than the shader code, must stay alive while it's watched.
+typedef struct ib_PipelineReloader ib_PipelineReloader;
+
+void ib_initPipelineReloader(ib_Core* core);
+void ib_killPipelineReloader(ib_Core* core); // Frees retired pipelines, the GPU must be idle
+void ib_watchGraphicsPipeline(ib_Core* core, ib_GraphicsPipeline* pipeline, ib_GraphicsPipelineDesc desc, char const* const* shaderPaths); // One path per desc.ShaderDescs entry. Specialization constants are referenced, not copied
+void ib_watchComputePipeline(ib_Core* core, ib_ComputePipeline* pipeline, ib_ComputePipelineDesc desc, char const* shaderPath);
+void ib_unwatchPipeline(ib_Core* core, void const* pipeline); // Call before freeing a watched pipeline, does nothing without a reloader
+
+// Swaps in rebuilt pipelines and frees the ones replaced at least framesInFlight frames ago.
+// Call once the oldest frame in flight is done, the render graph does this in ibr_beginFrame.
+// Calls that don't move frameNumber forward are ignored, so every render graph pool can report the same frame.
+void ib_advancePipelineReloads(ib_Core* core, uint64_t frameNumber, uint32_t framesInFlight);
+
 // Utility
+// Executable statistics as reported by the driver, register counts, spills, LDS usage, instruction counts, etc.
+// Works for any pipeline, requires ib_Core::ShaderStatisticsEnabled.
+#define ib_MaxPipelineExecutableCount 8
+#define ib_MaxPipelineExecutableStatisticCount 32
+#define ib_MaxPipelineStatisticNameLength 64
+
+typedef struct
+{
+    char Name[ib_MaxPipelineStatisticNameLength];
+    double Value; // Booleans are 0 or 1
+} ib_PipelineExecutableStatistic;
+
+typedef struct
+{
+    char Name[ib_MaxPipelineStatisticNameLength];
+    VkShaderStageFlags Stages;
+    uint32_t SubgroupSize;
+    ib_PipelineExecutableStatistic Statistics[ib_MaxPipelineExecutableStatisticCount];
+    uint32_t StatisticCount;
+} ib_PipelineExecutable;
+
+typedef struct
+{
+    ib_PipelineExecutable Executables[ib_MaxPipelineExecutableCount];
+    uint32_t ExecutableCount;
+} ib_PipelineExecutableReport;
+
+bool ib_getPipelineExecutableReport(ib_Core* core, VkPipeline pipeline, ib_PipelineExecutableReport* outReport);
+void ib_printPipelineExecutableReport(ib_PipelineExecutableReport const* report);
 void ib_printComputePipelineStatistics(ib_Core* core, ib_ComputePipeline const* pipeline);
 
+// Baselines catch shader cost regressions, save one from a known good build and diff later builds against it.
+typedef struct
+{
+    char const* Name; // Identifies the pipeline across runs
+    ib_PipelineExecutableReport const* Report;
+} ib_NamedPipelineExecutableReport;
+
+typedef ib_range(ib_NamedPipelineExecutableReport const) ib_PipelineReportRange;
+
+bool ib_savePipelineStatisticsBaseline(char const* path, ib_PipelineReportRange reports);
+
+typedef struct
+{
+    char const* PipelineName; // Points into the diffed reports
+    char const* ExecutableName;
+    ib_PipelineExecutableStatistic const* Statistic;
+    double BaselineValue;
+} ib_PipelineStatisticChange;
+
+typedef struct
+{
+    char const* BaselinePath;
+    ib_PipelineReportRange Reports;
+    // Relative change allowed in either direction before a statistic is flagged, 0.05 is 5%.
+    // Some statistics are costs and some (e.g. subgroup occupancy) are better when higher, so callers judge the direction.
+    double Tolerance;
+    ib_PipelineStatisticChange* OutChanges; // Optional, receives the first MaxChangeCount flagged statistics
+    uint32_t MaxChangeCount;
+} ib_DiffPipelineStatisticsDesc;
+
+// Returns false if the baseline couldn't be read, otherwise writes the number of flagged statistics to outChangeCount
+bool ib_diffPipelineStatisticsBaseline(ib_DiffPipelineStatisticsDesc desc, uint32_t* outChangeCount);
+
 // Timer
+typedef struct
+{
+    uint64_t InputAssemblyVertices;
+    uint64_t InputAssemblyPrimitives;
+    uint64_t VertexShaderInvocations;
+    uint64_t ClippingPrimitives;
+    uint64_t FragmentShaderInvocations;
+    uint64_t ComputeShaderInvocations;
+} ib_PipelineStatistics;
+
 typedef struct
 {
     VkQueryPool TimestampPool;
     uint32_t NextTimestamp;
     uint32_t MaxTimestampCount;
+    uint64_t* ResolvedTimestamps; // Filled by ib_resolveTimers
+
+    // Only created if MaxPipelineStatisticsCount was requested and the device supports it.
+    VkQueryPool PipelineStatisticsPool;
+    uint32_t NextPipelineStatistics;
+    uint32_t MaxPipelineStatisticsCount;
+    ib_PipelineStatistics* ResolvedPipelineStatistics;
 } ib_TimerManager;
 
 typedef struct
@@ -495,10 +843,16 @@ typedef struct
     uint32_t TimestampIndex;
 } ib_Timer;
 
+typedef struct
+{
+    uint32_t QueryIndex;
+} ib_PipelineStatisticsQuery;
+
 typedef struct
 {
     ib_Core* Core;
     uint32_t MaxTimerCount;
+    uint32_t MaxPipelineStatisticsCount;
 } ib_TimerManagerDesc;
 
 void ib_initTimerManager(ib_TimerManagerDesc desc, ib_TimerManager* outManager);
@@ -516,18 +870,150 @@ inline double ib_queryTimerBlocking(ib_Core* core, ib_TimerManager* manager, ib_
     return ib_queryTimer(core, manager, timer, true);
 }
 
+// Begin and end of the timer in milliseconds on the device timeline, for comparing timers against each other.
+// Returns false if query not ready.
+bool ib_queryTimerRange(ib_Core* core, ib_TimerManager* manager, ib_Timer const* timer, bool blocking, double* outBegin, double* outEnd);
+
+// Pipeline statistics can't be nested within a command buffer and need a graphics capable queue.
+ib_PipelineStatisticsQuery ib_beginPipelineStatistics(ib_TimerManager* manager, VkCommandBuffer commandBuffer);
+void ib_endPipelineStatistics(ib_TimerManager* manager, VkCommandBuffer commandBuffer, ib_PipelineStatisticsQuery const* query);
+
+// Reads back every query used since the last reset with a single call per query pool.
+// The ib_getResolved* functions then read from that copy. Returns false if the queries aren't ready.
+bool ib_resolveTimers(ib_Core* core, ib_TimerManager* manager, bool blocking);
+void ib_getResolvedTimerRange(ib_Core* core, ib_TimerManager const* manager, ib_Timer const* timer, double* outBegin, double* outEnd);
+ib_PipelineStatistics ib_getResolvedPipelineStatistics(ib_TimerManager const* manager, ib_PipelineStatisticsQuery const* query);
+
+typedef struct
+{
+    double GPUTime; // Milliseconds on the device timeline
+    uint64_t CPUTicks; // ib_cpuTicks at the same instant
+    double MaxDeviation; // Milliseconds
+} ib_TimestampCalibration;
+
+// Samples the device and CPU clocks together so GPU timers can be placed on the CPU timeline.
+// Returns false if VK_EXT_calibrated_timestamps isn't available.
+bool ib_calibrateTimestamps(ib_Core* core, ib_TimestampCalibration* outCalibration);
+
+// Bindless
+// Textures and storage buffers register themselves in one global update-after-bind descriptor set on allocation.
+// Their index is stable for their lifetime, shaders index the heap arrays with it (see ib_bindless.hsh).
+// Freed indices are only handed out again once the frames that could still reference them are done.
+// When modifying, make sure to match with ib_bindless.hsh
+enum
+{
+    ib_BindlessBinding_SampledImages = 0,
+    ib_BindlessBinding_StorageImages,
+    ib_BindlessBinding_StorageBuffers,
+    ib_BindlessBinding_Samplers,
+    ib_BindlessBinding_Count
+};
+
+#define ib_InvalidBindlessIndex 0 // Slot 0 is never allocated so zero initialized resources read as invalid
+#define ib_MaxBindlessTextureCount (1024 * 64)
+#define ib_MaxBindlessBufferCount (1024 * 64)
+
+typedef struct
+{
+    uint32_t Index;
+    uint64_t Frame;
+} ib_RetiredBindlessIndex;
+
+typedef struct
+{
+    uint32_t Capacity;
+    uint32_t NextIndex; // Indices below this have been handed out at least once
+    uint32_t* FreeIndices;
+    uint32_t FreeCount;
+    ib_RetiredBindlessIndex* RetiredIndices; // Waiting for the GPU to be done with them
+    uint32_t RetiredCount;
+    uint32_t RetiredCapacity;
+} ib_BindlessSlots;
+
+typedef struct
+{
+    bool Enabled; // False if the device doesn't support update-after-bind descriptor indexing
+    VkDescriptorPool Pool;
+    ib_ShaderInputLayout Layout;
+    ib_ShaderInput Input;
+
+    ib_BindlessSlots TextureSlots;
+    ib_BindlessSlots BufferSlots;
+    uint64_t Frame; // Last frame number passed to ib_advanceBindlessFrame
+} ib_BindlessHeap;
+
+// Recycles indices freed at least framesInFlight frames ago, call once the oldest frame in flight is done.
+// The render graph does this in ibr_beginFrame. Calls that don't move frameNumber forward are ignored,
+// so several render graph pools sharing a core only advance the heap once per frame.
+void ib_advanceBindlessFrame(ib_Core* core, uint64_t frameNumber, uint32_t framesInFlight);
+
+#define ib_MaxPathLength 260
+
+typedef struct
+{
+    bool WarmStart; // The cache on disk matched this device and driver
+    uint32_t CompiledPipelineCount;
+    uint64_t CompileCPUTicks; // Time spent in vkCreate*Pipelines, compare a cold and a warm launch to see what the cache saves
+    uint32_t LinkedPipelineCount; // Graphics pipelines built from libraries
+    uint64_t LinkCPUTicks; // Compare the average against CompileCPUTicks to see what fast linking saves
+    uint32_t SavedPipelineCount; // Compiled and linked pipelines as of the last save
+} ib_PipelineCacheStats;
+
+// Pipelines sharing SPIR-V share a VkShaderModule.
+typedef struct
+{
+    uint64_t Hash;
+    size_t CodeSize;
+    void* Code; // Retained copy, compared on a hash match so that a collision can't hand out another shader's module
+    VkShaderModule Module;
+    uint32_t RefCount;
+} ib_ShaderModuleEntry;
+
+typedef struct
+{
+    ib_Mutex Lock; // Batch workers create pipelines concurrently
+    ib_ShaderModuleEntry* Entries;
+    uint32_t Count;
+    uint32_t Capacity;
+    uint32_t CreatedCount; // vkCreateShaderModule calls, compare against AcquiredCount to see the savings
+    uint32_t AcquiredCount;
+} ib_ShaderModuleCache;
+
+// Winning compute configurations from ib_autotuneComputePipeline, keyed by shader code and entry point.
+typedef struct
+{
+    uint64_t KernelHash;
+    ib_ComputeTuning Tuning;
+} ib_ComputeTuningEntry;
+
+typedef struct
+{
+    ib_Mutex Lock; // Batch workers look up tunings concurrently
+    ib_ComputeTuningEntry* Entries;
+    uint32_t Count;
+    uint32_t Capacity;
+    char Path[ib_MaxPathLength];
+} ib_ComputeTuningTable;
+
 typedef struct ib_Core
 {
     VkInstance Instance;
     VkPhysicalDevice PhysicalDevice;
     VkPhysicalDeviceLimits DeviceLimits;
     VkDevice LogicalDevice;
+    uint32_t MinWaveSize; // Range RequiredWaveSize can pick from for compute, both 0 if it can't be required
+    uint32_t MaxWaveSize;
 
     struct
     {
         VkDescriptorPool Pool;
     } Descriptors;
     VkPipelineCache PipelineCache;
+    char PipelineCachePath[ib_MaxPathLength];
+    ib_PipelineCacheStats PipelineCacheStats;
+    ib_ShaderModuleCache ShaderModules;
+    ib_ComputeTuningTable ComputeTunings;
+    ib_PipelineReloader* Reloader; // NULL unless ib_initPipelineReloader was called
 
     iba_GpuAllocator Allocator;
     ib_Staging Staging;
@@ -537,12 +1023,22 @@ typedef struct ib_Core
         uint32_t Index;
         VkQueue Queue;
         VkCommandPool CommandPool;
+        uint32_t TimestampValidBits; // 0 if the queue can't write timestamps
     } Queues[ib_Queue_Count];
 
     VkSampler Samplers[ib_Sampler_Count];
     ib_Texture DefaultTextures[ib_DefaultTexture_Count];
+    ib_BindlessHeap Bindless;
 
     bool RaytracingEnabled;
+    bool RaytracePipelineLibraryEnabled;
+    bool PipelineStatisticsEnabled;
+    bool CalibratedTimestampsEnabled;
+    bool PushDescriptorsEnabled;
+    bool PresentWaitEnabled; // VK_KHR_present_id and VK_KHR_present_wait, see ib_PresentStatistics
+    bool GraphicsPipelineLibraryEnabled;
+    bool ShaderStatisticsEnabled;
+    uint32_t WindowSystems; // Bit per ib_WindowSystem that surfaces can be created for
 } ib_Core;
 
 // Utility constants to reduce friction when creating graphics pipelines.
@@ -565,6 +1061,10 @@ typedef struct
 {
     ib_Core* Core;
     uint32_t AccelerationStructureScratchBufferAlignment;
+    uint32_t ShaderGroupHandleSize;
+    uint32_t ShaderGroupHandleAlignment;
+    uint32_t ShaderGroupBaseAlignment;
+    uint32_t MaxRayRecursionDepth;
 } ib_Raytracing;
 
 void ib_initRaytracing(ib_Core* core, ib_Raytracing* raytracing);
@@ -573,24 +1073,84 @@ void ib_killRaytracing(ib_Raytracing* raytracing);
 void ib_initRaytracingScratch(ib_Raytracing* raytracing, iba_StackAllocator* allocator);
 void ib_killRaytracingScratch(iba_StackAllocator* allocator);
 
+// Ray tracing pipelines
+#define ib_MaxRaytraceShaderCount 32
+#define ib_MaxRaytraceShaderGroupCount 64
+
+enum
+{
+    ib_RaytraceGroup_Raygen = 0,
+    ib_RaytraceGroup_Miss,
+    ib_RaytraceGroup_Hit,
+    ib_RaytraceGroup_Callable,
+    ib_RaytraceGroup_Count
+};
+typedef uint32_t ib_RaytraceGroupType;
+
+typedef struct
+{
+    ib_RaytraceGroupType Type;
+    // Point into ib_RaytracePipelineDesc::ShaderDescs
+    ib_ShaderDesc const* General; // Raygen, miss and callable groups
+    ib_ShaderDesc const* ClosestHit; // Hit groups, each hit shader is optional
+    ib_ShaderDesc const* AnyHit;
+    ib_ShaderDesc const* Intersection; // Procedural hit groups only
+} ib_RaytraceShaderGroupDesc;
+
+typedef struct ib_RaytracePipeline ib_RaytracePipeline;
+
 typedef struct
+{
+    ib_range(ib_ShaderDesc const) ShaderDescs;
+    ib_range(ib_RaytraceShaderGroupDesc const) Groups; // Any order, the shader binding table sorts them by type
+    ib_range(VkPushConstantRange const) PushConstants;
+    ib_PipelineShaderInputDesc ShaderInputs[ib_MaxShaderInputLayoutPerPipeline];
+    uint32_t MaxRecursionDepth; // 0 uses 1
+
+    // Pipeline libraries, requires ib_Core::RaytracePipelineLibraryEnabled.
+    // Shader inputs and push constants have to match across the libraries and the pipeline linking them.
+    bool IsLibrary; // Libraries have no shader binding table
+    ib_range(ib_RaytracePipeline const* const) Libraries; // Their groups come after this pipeline's own, in order
+    uint32_t MaxPayloadSize; // Bytes, required when building or linking libraries
+    uint32_t MaxHitAttributeSize;
+} ib_RaytracePipelineDesc;
+
+struct ib_RaytracePipeline
 {
     VkPipelineLayout Layout;
     VkPipeline VulkanPipeline;
-    ib_ShaderInputLayout ShaderInputLayout;
-
+    ib_ShaderInputLayout InlineShaderInputLayouts[ib_MaxShaderInputLayoutPerPipeline]; // Owned shader input layouts.
+    uint32_t InlineShaderInputLayoutCount;
+    VkShaderModule ShaderModules[ib_MaxRaytraceShaderCount]; // References into ib_Core::ShaderModules
+    uint32_t ShaderModuleCount;
+    ib_RaytraceGroupType GroupTypes[ib_MaxRaytraceShaderGroupCount]; // Own groups then the libraries' groups, in pipeline group order
+    uint32_t GroupCount;
+    bool IsLibrary;
+
+    // Each region holds its groups in the order they appear in GroupTypes.
+    // The raygen region holds one group, ib_traceRays offsets it to pick the raygen group.
     ib_Buffer ShaderBindingTable;
     VkStridedDeviceAddressRegionKHR RaygenShaderRegion;
     VkStridedDeviceAddressRegionKHR MissShaderRegion;
     VkStridedDeviceAddressRegionKHR HitShaderRegion;
     VkStridedDeviceAddressRegionKHR CallableShaderRegion;
-
-} ib_RaytracePipeline;
+    uint32_t RaygenGroupCount;
+};
 typedef struct
 {
     ib_Buffer Buffer;
     VkAccelerationStructureKHR AccelerationStructure;
     VkDeviceAddress Address;
+
+    // Kept for updates
+    VkBuildAccelerationStructureFlagsKHR Flags;
+    VkDeviceSize BuildScratchSize;
+    VkDeviceSize UpdateScratchSize;
+    uint32_t MaxPrimitiveCount; // The structure was sized for this many
+    uint32_t PrimitiveCount; // As of the last full build
+    uint32_t UpdatesSinceBuild;
+    float BuildSurfaceArea; // Bounds as of the last full build, 0 if unknown
+    bool IsCompacted; // Too small for a full rebuild in place
 } ib_AccelerationStructureData;
 
 // BLAS and TLAS share memory layout but conceptually different.
@@ -608,6 +1168,7 @@ typedef struct
 {
     VkGeometryFlagsKHR GeometryFlags;
     VkBuildAccelerationStructureFlagBitsKHR AccelerationStructureFlags;
+    bool AllowUpdate; // Needed for ib_updateBLAS, vertex positions can change but the topology can't
 
     struct
     {
@@ -628,8 +1189,10 @@ typedef struct
 typedef struct
 {
     VkBuildAccelerationStructureFlagBitsKHR AccelerationStructureFlags;
+    bool AllowUpdate; // Needed for ib_updateTLAS
     ib_Buffer* InstancesBuffer;
     uint32_t InstancesCount;
+    uint32_t MaxInstancesCount; // Optional, sizes the TLAS for instance counts up to this on later updates
 } ib_TLASDesc;
 
 
@@ -638,4 +1201,165 @@ ib_TLAS ib_allocTLAS(ib_Raytracing* raytracing, ib_TLASDesc desc, iba_StackAlloc
 void ib_freeBLAS(ib_Raytracing* raytracing, ib_BLAS* accelerationStructure);
 void ib_freeTLAS(ib_Raytracing* raytracing, ib_TLAS* accelerationStructure);
 
+// Batched BLAS builds
+// The builds share one scratch buffer and one submit instead of a submit each. Compaction copies every BLAS into a
+// buffer of its compacted size once the builds are done. BLASes with AllowUpdate are left at their full size since the
+// update policy can rebuild them in place. Blocks until the BLASes are ready, meant for load time.
+#define ib_DefaultBLASBatchScratchSize (1024 * 1024 * 64)
+typedef struct
+{
+    ib_range(ib_BLASDesc const) Descs;
+    ib_BLAS* OutBLASes; // Descs.Count entries
+    bool Compact; // Adds VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR to every build without AllowUpdate
+    VkDeviceSize MaxScratchSize; // Builds are grouped into build calls whose scratch fits, 0 uses ib_DefaultBLASBatchScratchSize
+    ib_timelineSemaphore* BuildingSemaphore;
+} ib_BLASBatchDesc;
+
+typedef struct
+{
+    uint32_t BuildCallCount;
+    VkDeviceSize ScratchSize;
+    VkDeviceSize BuiltSize; // Sum of the sizes the builds asked for
+    VkDeviceSize FinalSize; // After compaction, BuiltSize - FinalSize is the memory saved
+} ib_BLASBatchStats;
+
+ib_BLASBatchStats ib_buildBLASBatch(ib_Raytracing* raytracing, ib_BLASBatchDesc desc);
+
+// The shader binding table is written through staging, flush staging before the first trace.
+ib_RaytracePipeline ib_allocRaytracePipeline(ib_Raytracing* raytracing, ib_RaytracePipelineDesc desc);
+void ib_freeRaytracePipeline(ib_Raytracing* raytracing, ib_RaytracePipeline* pipeline);
+
+typedef struct
+{
+    uint32_t RaygenIndex; // Which raygen group, in pipeline order
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Depth; // 0 uses 1
+} ib_TraceRaysDesc;
+
+// Binds the pipeline and traces, shader inputs are bound by the caller with VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR.
+void ib_traceRays(VkCommandBuffer commandBuffer, ib_RaytracePipeline const* pipeline, ib_TraceRaysDesc desc);
+
+// Updates
+// Refitting in place is much cheaper than a build but the tree degrades as the geometry moves away from what it was
+// built for, so the policy falls back to a full rebuild after enough updates or once the bounds grew too much.
+// TLAS updates with a different instance count are always rebuilds. The render graph wraps these in ibr_updateBLAS/ibr_updateTLAS.
+#define ib_DefaultMaxAccelerationStructureUpdates 64
+typedef struct
+{
+    uint32_t MaxUpdates; // Rebuild after this many updates in a row, 0 uses ib_DefaultMaxAccelerationStructureUpdates
+    float MaxSurfaceAreaGrowth; // Rebuild once the bounds surface area reaches this multiple of the area at the last build, 1.5 is 50% larger. 0 never
+} ib_AccelerationStructureUpdatePolicy;
+
+typedef struct
+{
+    VkCommandBuffer CommandBuffer; // Synchronization against the inputs and the users is up to the caller
+    VkDeviceAddress ScratchAddress; // ib_accelerationStructureUpdateScratchSize bytes, aligned to ib_Raytracing::AccelerationStructureScratchBufferAlignment
+    ib_AccelerationStructureUpdatePolicy Policy;
+    float BoundsSurfaceArea; // Surface area of the geometry's current bounds, 0 skips the quality check
+} ib_AccelerationStructureUpdateDesc;
+
+VkDeviceSize ib_accelerationStructureUpdateScratchSize(ib_AccelerationStructureData const* data); // Covers a rebuild too
+// Records an update, or a full rebuild when the policy asks for one. Returns true if it rebuilt.
+bool ib_updateBLAS(ib_Raytracing* raytracing, ib_BLAS* blas, ib_BLASDesc const* desc, ib_AccelerationStructureUpdateDesc update);
+bool ib_updateTLAS(ib_Raytracing* raytracing, ib_TLAS* tlas, ib_TLASDesc const* desc, ib_AccelerationStructureUpdateDesc update);
+
+// Software ray tracing
+// CPU built BVH for when ib_Core::RaytracingEnabled is false. Nodes are 4 wide with their child bounds stored
+// as structure of arrays so a node tests all children at once. The layout matches ib_bvh.hsh, upload it with
+// ib_uploadBVH and trace it from compute shaders.
+#define ib_BVHWidth 4
+#define ib_BVHMaxLeafTriangles 4
+#define ib_BVHInvalidNode 0xFFFFFFFF
+#define ib_MaxBVHThreadCount 64
+// Traversal pops a node and pushes up to every child, so each level can leave ib_BVHWidth - 1 nodes behind on the stack.
+#define ib_bvhTraversalStackSize(maxDepth) ((maxDepth) * (ib_BVHWidth - 1) + 1)
+#ifndef ib_BVHShaderStackSize
+#define ib_BVHShaderStackSize 64 // Match ib_BVHStackSize in ib_bvh.hsh
+#endif // ib_BVHShaderStackSize
+
+// 128 bytes
+typedef struct
+{
+    float MinX[ib_BVHWidth];
+    float MaxX[ib_BVHWidth];
+    float MinY[ib_BVHWidth];
+    float MaxY[ib_BVHWidth];
+    float MinZ[ib_BVHWidth];
+    float MaxZ[ib_BVHWidth];
+    uint32_t Children[ib_BVHWidth]; // Node index for inner children, first triangle for leaves, ib_BVHInvalidNode for empty slots
+    uint32_t TriangleCounts; // 8 bits per child, 0 for inner children
+    uint32_t Padding[3];
+} ib_BVHNode;
+
+// 48 bytes, edges are precomputed for the intersection test
+typedef struct
+{
+    float V0[3];
+    uint32_t PrimitiveIndex; // Triangle index in the source mesh
+    float E1[4];
+    float E2[4];
+} ib_BVHTriangle;
+
+// Same triangle inputs as ib_BLASDesc but in CPU memory.
+typedef struct
+{
+    struct
+    {
+        void const* Vertices;
+        uint32_t VertexCount;
+        VkFormat VertexFormat; // Only VK_FORMAT_R32G32B32_SFLOAT
+        size_t VertexStride; // 0 for tightly packed
+
+        void const* Indices; // NULL reads the vertices as a triangle list
+        VkIndexType IndexType;
+
+        uint32_t TrianglesCount;
+    } Triangles;
+
+    uint32_t ThreadCount; // 0 uses ib_cpuCoreCount
+} ib_BVHDesc;
+
+typedef struct
+{
+    ib_BVHNode* Nodes; // Root is node 0
+    uint32_t NodeCount;
+    ib_BVHTriangle* Triangles; // In leaf order
+    uint32_t TriangleCount;
+    uint32_t MaxDepth; // Levels of inner nodes, the root is depth 1
+    uint32_t TraversalStackSize; // ib_bvhTraversalStackSize(MaxDepth)
+    double BuildMs;
+} ib_BVH;
+
+ib_BVH ib_buildBVH(ib_BVHDesc desc);
+void ib_freeBVH(ib_BVH* bvh);
+
+typedef struct
+{
+    float Origin[3];
+    float TMin;
+    float Direction[3];
+    float TMax;
+} ib_BVHRay;
+
+typedef struct
+{
+    float T;
+    float Barycentrics[2];
+    uint32_t PrimitiveIndex; // ib_BVHInvalidNode on a miss
+} ib_BVHHit;
+
+// Closest hit on the CPU, the same traversal as ib_bvh.hsh.
+bool ib_traceBVH(ib_BVH const* bvh, ib_BVHRay ray, ib_BVHHit* hit);
+
+// Storage buffers, bind them through their bindless indices or as regular shader inputs.
+typedef struct
+{
+    ib_Buffer Nodes;
+    ib_Buffer Triangles;
+} ib_BVHBuffers;
+
+ib_BVHBuffers ib_uploadBVH(ib_Core* core, ib_BVH const* bvh); // Checks that the BVH fits in ib_BVHShaderStackSize
+void ib_freeBVHBuffers(ib_Core* core, ib_BVHBuffers* buffers);
+
 #endif // IB_CORE_H
\ No newline at end of file
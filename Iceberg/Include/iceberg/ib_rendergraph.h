@@ -16,12 +16,29 @@ typedef struct
 {
     ib_Timer Timer;
     char const* Name;
+    uint64_t CPUBeginTicks;
+    uint64_t CPUEndTicks;
+    uint32_t Depth;
+    ib_Queue Queue;
+    bool IsCPUOnly;
+    bool HasPipelineStatistics;
+    ib_PipelineStatisticsQuery PipelineStatisticsQuery;
 } ibr_ProfilingScope;
 
 typedef struct
 {
-    double Timing;
+    double Timing; // GPU duration in milliseconds, 0 for CPU only scopes
     char const* Name;
+    double GPUBegin; // Milliseconds on the device timeline
+    double GPUEnd;
+    double CPUBegin; // Milliseconds on the CPU clock, while the scope was being recorded
+    double CPUEnd;
+    uint32_t Depth;
+    uint32_t ThreadIndex; // Recording context the scope was recorded on
+    ib_Queue Queue;
+    bool IsCPUOnly;
+    bool HasPipelineStatistics;
+    ib_PipelineStatistics PipelineStatistics;
 } ibr_ScopeTiming;
 
 typedef struct ibr_TransientTexture
@@ -42,11 +59,15 @@ typedef struct ibr_TransientImageView
     struct ibr_TransientImageView* Next;
 } ibr_TransientImageView;
 
-typedef struct ibr_TransientCommandBuffer
+// Command buffers are kept alive across frames and handed back out after their pool is reset.
+// The list only grows, in batches of ibr_CommandBufferAllocationBatchSize.
+#define ibr_CommandBufferAllocationBatchSize 8
+typedef struct
 {
-    VkCommandBuffer CommandBuffer;
-    struct ibr_TransientCommandBuffer* Next;
-} ibr_TransientCommandBuffer;
+    VkCommandBuffer* CommandBuffers;
+    uint32_t AllocatedCount;
+    uint32_t UsedCount;
+} ibr_CommandBufferList;
 
 typedef struct ibr_TransientProfileScope
 {
@@ -61,41 +82,196 @@ typedef struct ibr_TransientScopeTiming
 } ibr_TransientScopeTiming;
 
 #define ibr_MaxProfilingScopeCount 1024
+
+typedef struct
+{
+    uint32_t EmittedCount;
+    uint32_t EliminatedCount; // Transitions dropped because the resource was already in the requested state
+    uint32_t SplitCount; // Barriers recorded through ibr_signalSplitBarrier
+} ibr_BarrierStatistics;
+
+typedef struct
+{
+    VkEvent* Events;
+    uint32_t AllocatedCount;
+    uint32_t UsedCount;
+} ibr_EventList;
+
+typedef struct ibr_TransientSubmission
+{
+    ib_Queue Queue;
+    ib_Timer Timer;
+    bool IsTimed; // False if the queue doesn't support timestamps
+    uint64_t CPUBeginTicks;
+    uint64_t CPUEndTicks;
+    struct ibr_TransientSubmission* Next;
+} ibr_TransientSubmission;
+
+// GPU time spent on each queue's submissions for a frame, in milliseconds.
+// GraphicsOverlapTime is how long a queue was busy while the graphics queue was also busy,
+// async compute that doesn't overlap graphics isn't buying us anything.
+#define ibr_MaxSubmissionTimingCount 256
+typedef struct
+{
+    double BusyTime[ib_Queue_Count];
+    double GraphicsOverlapTime[ib_Queue_Count];
+    uint32_t SubmissionCount[ib_Queue_Count];
+} ibr_QueueTimings;
+
+// Frame thread calls that synchronize with the GPU, in milliseconds on the CPU clock.
+// Submissions to queues that support timestamps also carry their GPU range, offset it with GPUToCPUOffset.
+typedef enum
+{
+    ibr_TimelineEvent_Submit,
+    ibr_TimelineEvent_FenceWait,
+    ibr_TimelineEvent_Present
+} ibr_TimelineEventType;
+
+#define ibr_MaxTimelineEventCount 64
+typedef struct
+{
+    ibr_TimelineEventType Type;
+    ib_Queue Queue;
+    double CPUBegin;
+    double CPUEnd;
+    bool HasGPUTiming;
+    double GPUBegin;
+    double GPUEnd;
+} ibr_TimelineEvent;
+
+typedef struct ibr_RenderGraph ibr_RenderGraph;
+
+// Per-thread recording state.
+// Every thread that records commands owns a context so that passes can be recorded in parallel without locking.
+// Context 0 belongs to the thread driving the frame (ibr_beginFrame/ibr_submitCommandBuffers/ibr_endFrame).
+#define ibr_MaxRecordingContextCount 16
+typedef struct
+{
+    ibr_RenderGraph* Graph;
+    iba_StackAllocator FrameCPUStack;
+
+    VkCommandPool TransientCommandPools[ib_Queue_Count];
+    ibr_CommandBufferList TransientCommandBuffers[ib_Queue_Count];
+    ibr_CommandBufferList TransientSecondaryCommandBuffers[ib_Queue_Count];
+
+    ib_TimerManager TimerManager;
+    ibr_TransientProfileScope* ActiveProfilingScopes;
+    ibr_TransientProfileScope* CompletedScopes;
+    uint32_t CurrentProfilingDepth;
+    bool IsRecordingPipelineStatistics;
+} ibr_RecordingContext;
+
 typedef struct ibr_RenderGraph
 {
     ib_Core* Core;
-    iba_StackAllocator FrameCPUStack;
+
+    ibr_RecordingContext RecordingContexts[ibr_MaxRecordingContextCount];
+    uint32_t RecordingContextCount;
 
     ibr_TransientTexture* TransientTextures;
     ibr_TransientBuffer* TransientBuffers;
     ibr_TransientImageView* TransientImageViews;
     VkDescriptorPool TransientDescriptorPool;
-    VkCommandPool TransientCommandPools[ib_Queue_Count];
-    ibr_TransientCommandBuffer* TransientCommandBuffers[ib_Queue_Count];
-    ibr_TransientCommandBuffer* ActiveCommandBuffer[ib_Queue_Count];
     VkFence FrameFence;
     VkSemaphore FrameSemaphore;
     VkSemaphore SwapchainAcquireSemaphore;
+
+    // Every submission signals its queue's timeline, later submissions wait on it for cross queue dependencies.
+    ib_timelineSemaphore QueueTimelines[ib_Queue_Count];
+    ibr_TransientSubmission* Submissions;
+
+    ibr_EventList TransientEvents;
+    ibr_BarrierStatistics BarrierStatistics;
     uint32_t SwapchainTextureIndex;
     ib_Texture* SwapchainTexture;
     VkExtent2D ScreenExtent;
 
-    ib_TimerManager TimerManager;
-    ibr_TransientProfileScope* ActiveProfilingScopes;
-    ibr_TransientProfileScope* CompletedScopes;
-    uint32_t CurrentProfilingDepth;
+    uint64_t FrameNumber;
+    uint64_t FrameCPUBeginTicks;
+    uint64_t FrameCPUEndTicks;
+    uint64_t FirstSubmitCPUTicks;
+    uint64_t FenceWaitCPUBeginTicks; // The wait in ibr_beginFrame that started this frame
+    uint64_t FenceWaitCPUEndTicks;
+    uint64_t PresentCPUBeginTicks;
+    uint64_t PresentCPUEndTicks;
+    uint64_t InputCPUTicks; // See ibr_markInputSampled
+    uint64_t PacingSleepTicks;
 
     ibr_TransientScopeTiming* PreviousFrameTimings;
+    ibr_QueueTimings PreviousFrameQueueTimings;
+    ibr_BarrierStatistics PreviousFrameBarrierStatistics;
 } ibr_RenderGraph;
 
+// Every scope of a frame once the GPU is done with it.
+typedef struct
+{
+    uint64_t FrameNumber;
+    double CPUBegin; // ibr_beginFrame to ibr_endFrame
+    double CPUEnd;
+    double GPUToCPUOffset; // Added to GPU times to place them on the CPU clock
+    bool IsCalibrated; // False if GPUToCPUOffset was estimated from the first submission instead of calibrated timestamps
+
+    double CPUWaitTime; // Time ibr_beginFrame spent blocked on the GPU before the frame could start
+    double GPUIdleTime; // Time the graphics queue sat idle since the previous frame's graphics work ended
+    double GraphicsGPUEnd; // End of the frame's graphics work on the CPU clock
+    double PacingSleepTime; // Time ibr_LatencyMode_LowLatency held the frame back
+    double InputToPresentLatency; // From input sampling to the frame being ready to present, whichever of the present call and the GPU finished last
+
+    uint32_t TimingCount;
+    ibr_ScopeTiming Timings[ibr_MaxProfilingScopeCount];
+    uint32_t EventCount;
+    ibr_TimelineEvent Events[ibr_MaxTimelineEventCount];
+} ibr_ProfiledFrame;
+
+#define ibr_DefaultProfilingHistoryFrameCount 16
+#define ibr_DefaultMaxTimerCount 1024
+#define ibr_PipelineCacheSaveFrameInterval 1024 // ibr_endFrame saves the pipeline cache this often on a background thread if new pipelines were compiled
+typedef enum
+{
+    ibr_LatencyMode_Throughput, // Queue up frames as fast as the fences allow
+    ibr_LatencyMode_LowLatency // Sleep in ibr_beginFrame so the frame is submitted just as the GPU runs out of work
+} ibr_LatencyMode;
+
+typedef struct
+{
+    uint32_t RecordingThreadCount; // Threads that may record a frame concurrently, including the frame thread. 0 is treated as 1.
+    uint32_t ProfilingHistoryFrameCount; // 0 uses ibr_DefaultProfilingHistoryFrameCount
+    uint32_t MaxTimerCount; // Per recording thread, 0 uses ibr_DefaultMaxTimerCount
+    uint32_t MaxPipelineStatisticsCount; // Per recording thread, 0 disables ibr_PassFlag_PipelineStatistics
+    uint32_t FramesInFlight; // 1 to ib_MaxFramesInFlight, 0 uses ib_FramebufferCount
+    ibr_LatencyMode LatencyMode;
+    double LatencySlack; // Milliseconds of headroom kept between our submission and the GPU running dry in low latency mode
+} ibr_RenderGraphPoolDesc;
+
 typedef struct
 {
-    ibr_RenderGraph Graphs[ib_FramebufferCount];
+    ibr_RenderGraph Graphs[ib_MaxFramesInFlight];
+    uint32_t FramesInFlight;
+    ibr_RenderGraphPoolDesc Desc; // Kept around to allocate graphs when FramesInFlight changes
+
+    // Can be changed between frames.
+    ibr_LatencyMode LatencyMode;
+    double LatencySlack;
+
+    // Low latency pacing, in milliseconds.
+    double SmoothedGPUFrameTime;
+    double SmoothedCPUSubmitTime; // From the start of a frame to its first submission
+    uint64_t PredictedGPUEndTicks; // When we expect the GPU to finish the last submitted frame
+
+    uint64_t FrameNumber;
+    ibr_ProfiledFrame* ProfilingHistory; // Ring of the most recently profiled frames
+    uint32_t ProfilingHistoryCapacity;
+    uint32_t ProfiledFrameCount;
+
+    ib_Thread PipelineCacheSaveThread; // Last periodic save, joined before the next one and when the pool is freed
 } ibr_RenderGraphPool;
 
-ibr_RenderGraphPool ibr_allocRenderGraphPool(ib_Core* core);
+ibr_RenderGraphPool ibr_allocRenderGraphPool(ib_Core* core, ibr_RenderGraphPoolDesc desc);
 void ibr_freeRenderGraphPool(ib_Core* core, ibr_RenderGraphPool* pool);
 
+// Waits for every frame in flight before resizing the pool, frame indices passed to ibr_beginFrame must be below the new count.
+void ibr_setFramesInFlight(ib_Core* core, ibr_RenderGraphPool* pool, uint32_t framesInFlight);
+
 typedef struct
 {
     uint32_t FrameIndex;
@@ -105,8 +281,91 @@ typedef struct
 ibr_RenderGraph* ibr_beginFrame(ibr_RenderGraphPool* pool, ibr_BeginFrameDesc desc);
 void ibr_endFrame(ibr_RenderGraphPool* pool, ibr_RenderGraph* graph);
 
+// Input-to-present latency is measured from the end of ibr_beginFrame,
+// call this if input is sampled later in the frame.
+void ibr_markInputSampled(ibr_RenderGraph* graph);
+
+// Profiling
+// Scopes nest freely, passes push one for themselves and user scopes can be pushed inside them.
+// Pass VK_NULL_HANDLE as the command buffer for a CPU only scope.
+void ibr_pushProfilingScope(ibr_RecordingContext* context, VkCommandBuffer cmd, char const* name);
+void ibr_popProfilingScope(ibr_RecordingContext* context, VkCommandBuffer cmd);
+
+// 0 is the most recently profiled frame, returns NULL if we haven't profiled that many frames.
+ibr_ProfiledFrame const* ibr_getProfiledFrame(ibr_RenderGraphPool const* pool, uint32_t framesAgo);
+
+// Writes the profiling history as Chrome Trace Event JSON, loadable in chrome://tracing and Perfetto.
+// CPU scopes are grouped by recording thread, GPU scopes by queue.
+bool ibr_writeChromeTrace(ibr_RenderGraphPool const* pool, char const* filePath);
+
+// Headless benchmarking
+// Drives the pool without a surface for a fixed number of frames and aggregates the profiling history.
+// The record callback must submit its last work with graph->FrameFence, same as a windowed frame.
+#define ibr_MaxBenchmarkPassCount 64
+
+typedef void(*ibr_BenchmarkRecordFunc)(ibr_RenderGraph* graph, uint32_t frame, void* userData);
+
+typedef struct
+{
+    uint32_t FrameCount; // Measured frames
+    uint32_t WarmupFrameCount; // Rendered before measuring, lets pipelines and transient memory settle
+    ibr_BenchmarkRecordFunc RecordFrame;
+    void* UserData;
+    char const* ResultsPath; // Optional, written with ibr_writeBenchmarkJSON
+
+    // Optional readback of the last frame, written as a binary PPM.
+    // The texture needs VK_IMAGE_USAGE_TRANSFER_SRC_BIT and an 8 bit RGBA or BGRA format.
+    ib_Texture const* OutputTexture;
+    VkImageLayout OutputTextureLayout; // Layout the frame leaves the texture in
+    char const* OutputImagePath;
+} ibr_BenchmarkDesc;
+
+typedef struct
+{
+    char const* Name; // Points at the scope name given to the graph
+    uint32_t Depth;
+    uint32_t SampleCount;
+    double MeanGPUTime; // Milliseconds
+    double MinGPUTime;
+    double MaxGPUTime;
+} ibr_BenchmarkPassTiming;
+
+typedef struct
+{
+    char DeviceName[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE];
+    uint32_t FrameCount;
+    uint32_t ProfiledFrameCount; // Measured frames that made it into the profiling history
+
+    // Milliseconds, from one ibr_beginFrame to the next.
+    double MeanCPUFrameTime;
+    double MedianCPUFrameTime;
+    double P99CPUFrameTime;
+    double MaxCPUFrameTime;
+    double MeanCPUWaitTime;
+
+    // First to last GPU timestamp of the frame's scopes.
+    double MeanGPUFrameTime;
+    double MaxGPUFrameTime;
+
+    ibr_BenchmarkPassTiming Passes[ibr_MaxBenchmarkPassCount]; // In order of first appearance
+    uint32_t PassCount;
+
+    iba_GpuAllocatorStats Memory; // After the last measured frame
+    VkDeviceSize PeakAllocatedSize;
+    bool WroteImage;
+} ibr_BenchmarkResult;
+
+ibr_BenchmarkResult ibr_runBenchmark(ib_Core* core, ibr_RenderGraphPool* pool, ibr_BenchmarkDesc desc);
+bool ibr_writeBenchmarkJSON(ibr_BenchmarkResult const* result, char const* filePath);
+
+// Transient memory and command buffers from the graph belong to the frame thread.
+// Other recording threads must go through their own ibr_RecordingContext.
 void* ibr_allocTransientMemory(ibr_RenderGraph* graph, size_t size);
 
+ibr_RecordingContext* ibr_getRecordingContext(ibr_RenderGraph* graph, uint32_t threadIndex);
+void* ibr_allocContextTransientMemory(ibr_RecordingContext* context, size_t size);
+VkCommandBuffer ibr_allocContextCommandBuffer(ibr_RecordingContext* context, ib_Queue queue);
+
 enum
 {
     ibr_ResourceFlag_Transient = 0x01
@@ -139,6 +398,11 @@ typedef struct ibr_Resource
 
     VkPipelineStageFlags LastReleaseStageMask;
     VkAccessFlags LastReleaseAccessMask;
+
+    // Stages and accesses the last write has already been made visible to, reads covered by these need no barrier.
+    VkPipelineStageFlags VisibleStageMask;
+    VkAccessFlags VisibleAccessMask;
+    bool IsPreAcquired; // A split barrier already transitioned the resource to its current state.
 } ibr_Resource;
 
 typedef struct
@@ -178,12 +442,21 @@ VkImageView ibr_allocTransientImageView(ibr_RenderGraph* graph, ibr_AllocTransie
 ib_ShaderInput ibr_allocTransientShaderInput(ibr_RenderGraph* graph, ib_AllocShaderInputDesc desc);
 VkCommandBuffer ibr_allocTransientCommandBuffer(ibr_RenderGraph* graph, ib_Queue queue);
 
+typedef struct
+{
+    ib_Queue Queue; // Waits on everything submitted to this queue so far this frame.
+    VkPipelineStageFlags2 StageMask; // Stages of the waiting submission that consume the queue's results.
+} ibr_QueueWait;
+
 typedef struct
 {
     ib_Queue Queue;
     ib_srange(VkCommandBuffer, 1) CommandBuffers;
     ib_srange(VkSemaphore, 1) WaitSemaphores;
     ib_srange(VkSemaphore, 1) SignalSemaphores;
+    ib_srange(ibr_QueueWait, ib_Queue_Count) QueueWaits; // Terminates on the first wait with an empty stage mask.
+    VkPipelineStageFlags2 WaitStageMask; // Stages blocked by WaitSemaphores, defaults to all commands.
+    VkPipelineStageFlags2 SignalStageMask; // Stages that complete before signaling, defaults to all commands.
     VkFence SubmitFence;
 } ibr_SubmitCommandBufferDesc;
 void ibr_submitCommandBuffers(ibr_RenderGraph* graph, ibr_SubmitCommandBufferDesc desc);
@@ -203,6 +476,45 @@ typedef struct
 } ibr_ResourceToShaderInputDesc;
 ib_ShaderInput ibr_resourcesToShaderInput(ibr_RenderGraph* graph, ibr_ResourceToShaderInputDesc desc);
 
+// Binds transient inputs to a command buffer. Push descriptor layouts are written straight into the command buffer,
+// other layouts fall back to a set from the per-frame transient pool.
+typedef struct
+{
+    VkPipelineBindPoint BindPoint;
+    VkPipelineLayout PipelineLayout;
+    uint32_t SetIndex;
+    ib_ShaderInputLayout const* Layout;
+    ib_range(ib_ShaderInputWrite const) Inputs;
+} ibr_BindTransientShaderInputDesc;
+void ibr_bindTransientShaderInput(ibr_RenderGraph* graph, VkCommandBuffer commandBuffer, ibr_BindTransientShaderInputDesc desc);
+
+typedef struct
+{
+    VkPipelineBindPoint BindPoint;
+    VkPipelineLayout PipelineLayout;
+    uint32_t SetIndex;
+    ib_ShaderInputLayout const* Layout;
+    ib_ShaderInputRange ShaderInputs;
+    ib_range(ibr_Resource*) Resources;
+} ibr_BindResourcesToShaderInputDesc;
+void ibr_bindResourcesToShaderInput(ibr_RenderGraph* graph, VkCommandBuffer commandBuffer, ibr_BindResourcesToShaderInputDesc desc);
+
+// Acceleration structure updates
+// Recorded into the frame's command buffer with scratch from the frame's transient buffers instead of a standalone submit.
+// Earlier shader reads in the frame are waited on before the build and the result is made visible to later builds and
+// shader reads, update BLASes before the TLAS referencing them.
+// Writes to the vertex or instance buffers need a barrier to VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR first.
+typedef struct
+{
+    ib_Raytracing* Raytracing;
+    ib_AccelerationStructureUpdatePolicy Policy;
+    float BoundsSurfaceArea; // See ib_AccelerationStructureUpdateDesc
+} ibr_UpdateAccelerationStructureDesc;
+
+// Return true if the policy picked a full rebuild.
+bool ibr_updateBLAS(ibr_RenderGraph* graph, VkCommandBuffer cmd, ib_BLAS* blas, ib_BLASDesc const* desc, ibr_UpdateAccelerationStructureDesc update);
+bool ibr_updateTLAS(ibr_RenderGraph* graph, VkCommandBuffer cmd, ib_TLAS* tlas, ib_TLASDesc const* desc, ibr_UpdateAccelerationStructureDesc update);
+
 typedef struct
 {
     ibr_Resource* Resource;
@@ -223,6 +535,20 @@ typedef struct
 
 void ibr_barriers(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_BarriersDesc desc);
 
+// Split barriers
+// Signal right after the producer and wait right before the consumer, so that the work recorded in between
+// can overlap the transition. The resources are in their new states as soon as the barrier is signaled,
+// the consumer's matching states won't record another barrier.
+// Both halves have to be recorded on the same queue, and the resources can't be used in between.
+typedef struct
+{
+    VkEvent Event;
+    VkDependencyInfo Barriers;
+} ibr_SplitBarrier;
+
+ibr_SplitBarrier const* ibr_signalSplitBarrier(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_BarriersDesc desc);
+void ibr_waitSplitBarrier(VkCommandBuffer cmd, ibr_SplitBarrier const* barrier);
+
 typedef struct
 {
     ibr_Resource* Resource;
@@ -241,6 +567,14 @@ typedef struct
     VkPipelineStageFlags ReleaseStageMask; // When are future passes free to use this resource
 } ibr_RenderTargetState;
 
+enum
+{
+    ibr_PassFlag_None = 0x00,
+    ibr_PassFlag_SecondaryCommandBuffers = 0x01, // Pass contents are recorded in secondary command buffers, see ibr_beginSecondaryCommandBuffer.
+    ibr_PassFlag_PipelineStatistics = 0x02, // Attach pipeline statistics to the pass' scope. Graphics queue family only, ignored with secondaries.
+};
+typedef uint32_t ibr_PassFlags;
+
 typedef struct
 {
     ib_srange(ibr_RenderTargetState, 4) RenderTargets; // Rendertargets will be appropriately transitioned
@@ -252,6 +586,7 @@ typedef struct
     float MaxDepth;
 
     char const* PassName; // Can be NULL
+    ibr_PassFlags Flags;
 } ibr_BeginGraphicsPassDesc;
 
 void ibr_beginGraphicsPass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_BeginGraphicsPassDesc desc);
@@ -261,6 +596,7 @@ typedef struct
 {
     ibr_ResourceStateRange ResourceStates;
     char const* PassName; // Can be NULL
+    ibr_PassFlags Flags;
 } ibr_BeginComputePassDesc;
 
 void ibr_beginComputePass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_BeginComputePassDesc desc);
@@ -270,6 +606,7 @@ typedef struct
 {
     ibr_ResourceStateRange ResourceStates;
     char const* PassName; // Can be NULL
+    ibr_PassFlags Flags;
 } ibr_BeginTransferPassDesc;
 
 // Cheating - Compute and transfer do the same.
@@ -278,7 +615,8 @@ inline void ibr_beginTranserPass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ib
     ibr_beginComputePass(graph, cmd, (ibr_BeginComputePassDesc)
                          {
                              desc.ResourceStates,
-                             desc.PassName
+                             desc.PassName,
+                             desc.Flags
                          });
 }
 
@@ -287,6 +625,43 @@ inline void ibr_endTransferPass(ibr_RenderGraph* graph, VkCommandBuffer cmd)
     ibr_endComputePass(graph, cmd);
 }
 
+// Parallel recording
+// Passes are prepared in submission order on the frame thread, which resolves their barriers and resource states.
+// Any recording context can then record a prepared pass, either inline in one of its own primary command buffers
+// or, for passes flagged with ibr_PassFlag_SecondaryCommandBuffers, split across secondary command buffers
+// that are stitched back into the pass with ibr_executeSecondaryCommandBuffers.
+enum
+{
+    ibr_PassType_Graphics = 0,
+    ibr_PassType_Compute,
+};
+typedef uint32_t ibr_PassType;
+
+typedef struct
+{
+    ibr_PassType Type;
+    ibr_PassFlags Flags;
+    char const* PassName;
+
+    VkDependencyInfo Barriers;
+    VkRenderingInfo RenderingInfo;
+    VkCommandBufferInheritanceRenderingInfo InheritanceRenderingInfo;
+    VkViewport Viewport;
+    VkRect2D Scissor;
+} ibr_PreparedPass;
+
+ibr_PreparedPass const* ibr_prepareGraphicsPass(ibr_RenderGraph* graph, ibr_BeginGraphicsPassDesc desc);
+ibr_PreparedPass const* ibr_prepareComputePass(ibr_RenderGraph* graph, ibr_BeginComputePassDesc desc);
+void ibr_beginPreparedPass(ibr_RecordingContext* context, VkCommandBuffer cmd, ibr_PreparedPass const* pass);
+void ibr_endPreparedPass(ibr_RecordingContext* context, VkCommandBuffer cmd, ibr_PreparedPass const* pass);
+
+// Returns a begun secondary command buffer that continues the prepared pass. End it with vkEndCommandBuffer.
+VkCommandBuffer ibr_beginSecondaryCommandBuffer(ibr_RecordingContext* context, ib_Queue queue, ibr_PreparedPass const* pass);
+
+// Executes secondaries in array order. Null entries are skipped so jobs may leave their slot empty.
+typedef ib_range(VkCommandBuffer const) ibr_CommandBufferRange;
+void ibr_executeSecondaryCommandBuffers(VkCommandBuffer cmd, ibr_CommandBufferRange commandBuffers);
+
 // Utility resource states
 
 enum
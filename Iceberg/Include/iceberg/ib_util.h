@@ -95,6 +95,38 @@ uint32_t ib_firstBitHighU32(uint32_t value);
 uint32_t ib_firstBitLowU32(uint32_t value);
 uint32_t ib_bitCountU32(uint32_t value);
 
+// Monotonic CPU clock
+uint64_t ib_cpuTicks(void);
+double ib_cpuTicksToMs(uint64_t ticks);
+uint64_t ib_cpuMsToTicks(double ms);
+void ib_sleepMs(double ms); // Spins for the tail end of the sleep, accurate to well under a millisecond
+
+// Threads
+typedef struct
+{
+    void* Handle;
+} ib_Thread;
+
+typedef void(*ib_ThreadFunc)(void* userData);
+ib_Thread ib_startThread(ib_ThreadFunc func, void* userData);
+void ib_joinThread(ib_Thread* thread);
+uint32_t ib_cpuCoreCount(void);
+
+typedef struct
+{
+    void* Handle;
+} ib_Mutex;
+
+void ib_initMutex(ib_Mutex* mutex);
+void ib_lockMutex(ib_Mutex* mutex);
+void ib_unlockMutex(ib_Mutex* mutex);
+void ib_killMutex(ib_Mutex* mutex);
+
+// Return the new value
+uint32_t ib_atomicAddU32(uint32_t volatile* value, uint32_t add);
+uint64_t ib_atomicAddU64(uint64_t volatile* value, uint64_t add);
+uint32_t ib_atomicLoadU32(uint32_t volatile const* value);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -565,6 +565,9 @@ iba_GpuAllocation iba_gpuAlloc(iba_GpuAllocator* allocator, iba_GpuAllocationReq
         ib_assert(tlsfAlloc.Block != NULL); // If its null, abort.
     }
 
+    allocator->AllocatedSize += tlsfAlloc.Block->Size;
+    allocator->AllocationCount++;
+
     uint32_t rootIndex = getRootIndex(tlsfAlloc.RootUserData);
     uint8_t* mappedMem = foundPool->Roots[rootIndex].Map;
     iba_GpuAllocation allocation =
@@ -592,9 +595,29 @@ void iba_gpuFree(iba_GpuAllocator *allocator, iba_GpuAllocation* allocation)
     for (uint32_t i = 0; i < poolIndex; i++, memoryPool = memoryPool->Next)
     {
     }
+
+    allocator->AllocatedSize -= block->Size;
+    allocator->AllocationCount--;
     iba_tlsfFree(&memoryPool->TlsfAllocator, block);
 }
 
+iba_GpuAllocatorStats iba_getGpuAllocatorStats(iba_GpuAllocator const* allocator)
+{
+    iba_GpuAllocatorStats stats =
+    {
+        .AllocatedSize = allocator->AllocatedSize,
+        .AllocationCount = allocator->AllocationCount
+    };
+
+    for (iba_GpuMemoryPool const* pool = allocator->MemoryPools; pool != NULL; pool = pool->Next)
+    {
+        stats.RootCount += pool->RootCount;
+        stats.PoolCount++;
+    }
+    stats.ReservedSize = (VkDeviceSize)stats.RootCount * allocator->RootMemorySize;
+    return stats;
+}
+
 static VkAllocationCallbacks* ibsa_NoVkAllocator = NULL;
 void iba_initStackAllocator(iba_StackAllocatorDesc desc, iba_StackAllocator *allocator)
 {
@@ -16,10 +16,30 @@ typedef void* HMONITOR;
 typedef unsigned long DWORD;
 #include <vulkan/vulkan_win32.h>
 
+// Same for the Linux window systems, the handles are all we need from Xlib, XCB and Wayland.
+typedef struct _XDisplay Display;
+typedef unsigned long Window;
+typedef unsigned long VisualID;
+typedef struct xcb_connection_t xcb_connection_t;
+typedef uint32_t xcb_window_t;
+typedef uint32_t xcb_visualid_t;
+#include <vulkan/vulkan_xlib.h>
+#include <vulkan/vulkan_xcb.h>
+#include <vulkan/vulkan_wayland.h>
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <float.h>
+#include <math.h>
 #include <inttypes.h>
 #include <string.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif // __linux__
 
 // Vulkan functions
 
@@ -32,6 +52,14 @@ PFN_vkGetBufferDeviceAddressKHR ib_vkGetBufferDeviceAddressKHR;
 PFN_vkSetDebugUtilsObjectNameEXT ib_vkSetDebugUtilsObjectNameEXT;
 PFN_vkCmdBeginDebugUtilsLabelEXT ib_vkCmdBeginDebugUtilsLabelEXT;
 PFN_vkCmdEndDebugUtilsLabelEXT ib_vkCmdEndDebugUtilsLabelEXT;
+PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT ib_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT;
+PFN_vkGetCalibratedTimestampsEXT ib_vkGetCalibratedTimestampsEXT;
+PFN_vkCmdPushDescriptorSetKHR ib_vkCmdPushDescriptorSetKHR;
+PFN_vkCreateXlibSurfaceKHR ib_vkCreateXlibSurfaceKHR;
+PFN_vkCreateXcbSurfaceKHR ib_vkCreateXcbSurfaceKHR;
+PFN_vkCreateWaylandSurfaceKHR ib_vkCreateWaylandSurfaceKHR;
+PFN_vkCreateHeadlessSurfaceEXT ib_vkCreateHeadlessSurfaceEXT;
+PFN_vkWaitForPresentKHR ib_vkWaitForPresentKHR;
 
 VkResult vkCreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* createInfo, const VkAllocationCallbacks* allocator, VkDebugUtilsMessengerEXT* debugMessenger)
 {
@@ -154,6 +182,14 @@ void ib_loadVulkanFunctions(VkInstance instance)
     ib_vkSetDebugUtilsObjectNameEXT = ib_getVulkanFunc(instance, vkSetDebugUtilsObjectNameEXT);
     ib_vkCmdBeginDebugUtilsLabelEXT = ib_getVulkanFunc(instance, vkCmdBeginDebugUtilsLabelEXT);
     ib_vkCmdEndDebugUtilsLabelEXT = ib_getVulkanFunc(instance, vkCmdEndDebugUtilsLabelEXT);
+    ib_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT = ib_getVulkanFunc(instance, vkGetPhysicalDeviceCalibrateableTimeDomainsEXT);
+    ib_vkGetCalibratedTimestampsEXT = ib_getVulkanFunc(instance, vkGetCalibratedTimestampsEXT);
+    ib_vkCmdPushDescriptorSetKHR = ib_getVulkanFunc(instance, vkCmdPushDescriptorSetKHR);
+    ib_vkCreateXlibSurfaceKHR = ib_getVulkanFunc(instance, vkCreateXlibSurfaceKHR);
+    ib_vkCreateXcbSurfaceKHR = ib_getVulkanFunc(instance, vkCreateXcbSurfaceKHR);
+    ib_vkCreateWaylandSurfaceKHR = ib_getVulkanFunc(instance, vkCreateWaylandSurfaceKHR);
+    ib_vkCreateHeadlessSurfaceEXT = ib_getVulkanFunc(instance, vkCreateHeadlessSurfaceEXT);
+    ib_vkWaitForPresentKHR = ib_getVulkanFunc(instance, vkWaitForPresentKHR);
 }
 
 ib_timelineSemaphore ib_allocTimelineSemaphore(ib_Core* core, uint64_t initialValue)
@@ -351,11 +387,29 @@ VkBool32 ib_vkValidationCallback(
 
 const char *ib_InstanceExtensions[] = {
     VK_KHR_SURFACE_EXTENSION_NAME,
+#ifdef _WIN32
     VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
+#endif // _WIN32
 #ifdef IB_DEBUG
     VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
 #endif // IB_DEBUG
 };
+
+// Enabled when the loader has them, see ib_Core::WindowSystems.
+const char* ib_OptionalSurfaceExtensions[] =
+{
+    VK_KHR_XLIB_SURFACE_EXTENSION_NAME,
+    VK_KHR_XCB_SURFACE_EXTENSION_NAME,
+    VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME,
+    VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME,
+};
+ib_WindowSystem const ib_OptionalSurfaceSystems[] =
+{
+    ib_WindowSystem_Xlib,
+    ib_WindowSystem_Xcb,
+    ib_WindowSystem_Wayland,
+    ib_WindowSystem_Headless,
+};
 const char *ib_DeviceExtensions[] =
 {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME,
@@ -371,6 +425,13 @@ const char* ib_RaytracingDeviceExtensions[] =
     VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
     VK_KHR_RAY_QUERY_EXTENSION_NAME,
 };
+// ib_cpuTicks reads this clock, calibrated timestamps need to sample the same one.
+#ifdef _WIN32
+static VkTimeDomainEXT const ib_CPUTimeDomain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+static VkTimeDomainEXT const ib_CPUTimeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif // _WIN32
+
 const char *ib_ValidationLayers[] = { "VK_LAYER_KHRONOS_validation" };
 
 uint32_t const ib_MaxUniformBufferCount = 1000;
@@ -386,7 +447,526 @@ static VkDebugUtilsMessengerEXT ib_VkDebugUtilsMessenger;
 #endif // IB_DEBUGs
 
 // Forward from surface API
-static VkSurfaceKHR ib_createWin32VkSurface(VkInstance vkInstance, void const* windowHandle, void const* instanceHandle);
+static VkSurfaceKHR createVkSurface(ib_Core const* core, ib_Window window);
+// Bindless
+static void initBindlessSlots(ib_BindlessSlots* slots, uint32_t capacity)
+{
+    *slots = (ib_BindlessSlots)
+    {
+        .Capacity = capacity,
+        .NextIndex = ib_InvalidBindlessIndex + 1,
+        .FreeIndices = (uint32_t*)malloc(sizeof(uint32_t) * capacity)
+    };
+    ib_assert(slots->FreeIndices != NULL);
+}
+
+static void killBindlessSlots(ib_BindlessSlots* slots)
+{
+    free(slots->FreeIndices);
+    free(slots->RetiredIndices);
+    *slots = (ib_BindlessSlots) { 0 };
+}
+
+static uint32_t allocBindlessSlot(ib_BindlessSlots* slots)
+{
+    if (slots->FreeCount > 0)
+    {
+        return slots->FreeIndices[--slots->FreeCount];
+    }
+
+    ib_assert(slots->NextIndex < slots->Capacity, "Ran out of bindless slots! Increase ib_MaxBindless*Count.");
+    if (slots->NextIndex >= slots->Capacity)
+    {
+        return ib_InvalidBindlessIndex;
+    }
+    return slots->NextIndex++;
+}
+
+static void retireBindlessSlot(ib_BindlessSlots* slots, uint64_t frame, uint32_t index)
+{
+    if (slots->RetiredCount == slots->RetiredCapacity)
+    {
+        slots->RetiredCapacity = slots->RetiredCapacity > 0 ? slots->RetiredCapacity * 2 : 64;
+        slots->RetiredIndices = (ib_RetiredBindlessIndex*)realloc(slots->RetiredIndices, sizeof(ib_RetiredBindlessIndex) * slots->RetiredCapacity);
+        ib_assert(slots->RetiredIndices != NULL);
+    }
+    slots->RetiredIndices[slots->RetiredCount++] = (ib_RetiredBindlessIndex) { .Index = index, .Frame = frame };
+}
+
+static void recycleBindlessSlots(ib_BindlessSlots* slots, uint64_t currentFrame, uint32_t framesInFlight)
+{
+    // Retired indices are in frame order, everything before the first one still in flight can be recycled.
+    uint32_t recycledCount = 0;
+    for (; recycledCount < slots->RetiredCount; recycledCount++)
+    {
+        ib_RetiredBindlessIndex retired = slots->RetiredIndices[recycledCount];
+        if (retired.Frame + framesInFlight > currentFrame)
+        {
+            break;
+        }
+        slots->FreeIndices[slots->FreeCount++] = retired.Index;
+    }
+
+    memmove(slots->RetiredIndices, slots->RetiredIndices + recycledCount, sizeof(ib_RetiredBindlessIndex) * (slots->RetiredCount - recycledCount));
+    slots->RetiredCount -= recycledCount;
+}
+
+static void initBindlessHeap(ib_Core* core)
+{
+    ib_BindlessHeap* heap = &core->Bindless;
+    if (!heap->Enabled)
+    {
+        return;
+    }
+
+    VkPhysicalDeviceVulkan12Properties properties12 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES };
+    vkGetPhysicalDeviceProperties2(core->PhysicalDevice, &(VkPhysicalDeviceProperties2)
+                                   {
+                                       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+                                       .pNext = &properties12
+                                   });
+
+    uint32_t textureCapacity = ib_MaxBindlessTextureCount;
+    textureCapacity = ib_min(textureCapacity, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages);
+    textureCapacity = ib_min(textureCapacity, properties12.maxPerStageDescriptorUpdateAfterBindStorageImages);
+    textureCapacity = ib_min(textureCapacity, properties12.maxDescriptorSetUpdateAfterBindSampledImages);
+    textureCapacity = ib_min(textureCapacity, properties12.maxDescriptorSetUpdateAfterBindStorageImages);
+
+    uint32_t bufferCapacity = ib_MaxBindlessBufferCount;
+    bufferCapacity = ib_min(bufferCapacity, properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+    bufferCapacity = ib_min(bufferCapacity, properties12.maxDescriptorSetUpdateAfterBindStorageBuffers);
+
+    // Every binding is visible to all stages, so all of them count against the per stage resource limit.
+    // Shrink the texture and buffer arrays proportionally until they fit next to the immutable samplers.
+    ib_assert(properties12.maxPerStageDescriptorUpdateAfterBindSamplers >= ib_Sampler_Count && properties12.maxDescriptorSetUpdateAfterBindSamplers >= ib_Sampler_Count);
+    ib_assert(properties12.maxPerStageUpdateAfterBindResources > ib_Sampler_Count);
+    uint64_t resourceBudget = properties12.maxPerStageUpdateAfterBindResources - ib_Sampler_Count;
+    uint64_t resourceCount = (uint64_t)textureCapacity * 2 + bufferCapacity;
+    if (resourceCount > resourceBudget)
+    {
+        textureCapacity = (uint32_t)((uint64_t)textureCapacity * resourceBudget / resourceCount);
+        bufferCapacity = (uint32_t)((uint64_t)bufferCapacity * resourceBudget / resourceCount);
+    }
+
+    initBindlessSlots(&heap->TextureSlots, textureCapacity);
+    initBindlessSlots(&heap->BufferSlots, bufferCapacity);
+
+    VkDescriptorSetLayoutBinding bindings[ib_BindlessBinding_Count] =
+    {
+        [ib_BindlessBinding_SampledImages] = { ib_BindlessBinding_SampledImages, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, textureCapacity, VK_SHADER_STAGE_ALL },
+        [ib_BindlessBinding_StorageImages] = { ib_BindlessBinding_StorageImages, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, textureCapacity, VK_SHADER_STAGE_ALL },
+        [ib_BindlessBinding_StorageBuffers] = { ib_BindlessBinding_StorageBuffers, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferCapacity, VK_SHADER_STAGE_ALL },
+        [ib_BindlessBinding_Samplers] = { ib_BindlessBinding_Samplers, VK_DESCRIPTOR_TYPE_SAMPLER, ib_Sampler_Count, VK_SHADER_STAGE_ALL, core->Samplers }
+    };
+
+    VkDescriptorBindingFlags const bindlessFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorBindingFlags bindFlags[ib_BindlessBinding_Count] =
+    {
+        [ib_BindlessBinding_SampledImages] = bindlessFlags,
+        [ib_BindlessBinding_StorageImages] = bindlessFlags,
+        [ib_BindlessBinding_StorageBuffers] = bindlessFlags,
+        [ib_BindlessBinding_Samplers] = 0 // Immutable
+    };
+
+    VkDescriptorSetLayoutCreateInfo createLayout =
+    {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &(VkDescriptorSetLayoutBindingFlagsCreateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            .bindingCount = ib_BindlessBinding_Count,
+            .pBindingFlags = bindFlags
+        },
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = ib_BindlessBinding_Count,
+        .pBindings = bindings,
+    };
+    ib_vkCheck(vkCreateDescriptorSetLayout(core->LogicalDevice, &createLayout, ib_NoVkAllocator, &heap->Layout.DescriptorSetLayout));
+
+    VkDescriptorPoolSize poolSizes[] =
+    {
+        { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, textureCapacity },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, textureCapacity },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferCapacity },
+        { VK_DESCRIPTOR_TYPE_SAMPLER, ib_Sampler_Count }
+    };
+
+    VkDescriptorPoolCreateInfo poolCreate =
+    {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = ib_arrayCount(poolSizes),
+        .pPoolSizes = poolSizes
+    };
+    ib_vkCheck(vkCreateDescriptorPool(core->LogicalDevice, &poolCreate, ib_NoVkAllocator, &heap->Pool));
+
+    VkDescriptorSetAllocateInfo allocateInfo =
+    {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = heap->Pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &heap->Layout.DescriptorSetLayout
+    };
+    ib_vkCheck(vkAllocateDescriptorSets(core->LogicalDevice, &allocateInfo, &heap->Input.DescriptorSet));
+}
+
+static void killBindlessHeap(ib_Core* core)
+{
+    ib_BindlessHeap* heap = &core->Bindless;
+    if (!heap->Enabled)
+    {
+        return;
+    }
+
+    vkDestroyDescriptorPool(core->LogicalDevice, heap->Pool, ib_NoVkAllocator);
+    vkDestroyDescriptorSetLayout(core->LogicalDevice, heap->Layout.DescriptorSetLayout, ib_NoVkAllocator);
+    killBindlessSlots(&heap->TextureSlots);
+    killBindlessSlots(&heap->BufferSlots);
+}
+
+static uint32_t registerBindlessTexture(ib_Core* core, ib_Texture const* texture, VkImageUsageFlags usage)
+{
+    ib_BindlessHeap* heap = &core->Bindless;
+    bool isSampled = (usage & VK_IMAGE_USAGE_SAMPLED_BIT) != 0;
+    bool isStorage = (usage & VK_IMAGE_USAGE_STORAGE_BIT) != 0;
+    if (!heap->Enabled || (!isSampled && !isStorage))
+    {
+        return ib_InvalidBindlessIndex;
+    }
+
+    uint32_t index = allocBindlessSlot(&heap->TextureSlots);
+    if (index == ib_InvalidBindlessIndex)
+    {
+        return ib_InvalidBindlessIndex;
+    }
+
+    // Match the layouts the render graph transitions to for shader reads and writes.
+    bool isDepth = (texture->Aspect & VK_IMAGE_ASPECT_DEPTH_BIT) != 0;
+    VkDescriptorImageInfo sampledInfo = { .imageView = texture->View, .imageLayout = isDepth ? VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    VkDescriptorImageInfo storageInfo = { .imageView = texture->View, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+
+    VkWriteDescriptorSet writes[2];
+    uint32_t writeCount = 0;
+    if (isSampled)
+    {
+        writes[writeCount++] = (VkWriteDescriptorSet)
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = heap->Input.DescriptorSet,
+            .dstBinding = ib_BindlessBinding_SampledImages,
+            .dstArrayElement = index,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            .pImageInfo = &sampledInfo
+        };
+    }
+
+    if (isStorage)
+    {
+        writes[writeCount++] = (VkWriteDescriptorSet)
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = heap->Input.DescriptorSet,
+            .dstBinding = ib_BindlessBinding_StorageImages,
+            .dstArrayElement = index,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .pImageInfo = &storageInfo
+        };
+    }
+
+    vkUpdateDescriptorSets(core->LogicalDevice, writeCount, writes, 0, NULL);
+    return index;
+}
+
+static uint32_t registerBindlessBuffer(ib_Core* core, ib_Buffer const* buffer, VkBufferUsageFlags usage)
+{
+    ib_BindlessHeap* heap = &core->Bindless;
+    if (!heap->Enabled || (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) == 0)
+    {
+        return ib_InvalidBindlessIndex;
+    }
+
+    uint32_t index = allocBindlessSlot(&heap->BufferSlots);
+    if (index == ib_InvalidBindlessIndex)
+    {
+        return ib_InvalidBindlessIndex;
+    }
+
+    VkWriteDescriptorSet write =
+    {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = heap->Input.DescriptorSet,
+        .dstBinding = ib_BindlessBinding_StorageBuffers,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &(VkDescriptorBufferInfo) { .buffer = buffer->VulkanBuffer, .range = VK_WHOLE_SIZE }
+    };
+    vkUpdateDescriptorSets(core->LogicalDevice, 1, &write, 0, NULL);
+    return index;
+}
+
+void ib_advanceBindlessFrame(ib_Core* core, uint64_t frameNumber, uint32_t framesInFlight)
+{
+    ib_BindlessHeap* heap = &core->Bindless;
+    if (!heap->Enabled || frameNumber <= heap->Frame)
+    {
+        return;
+    }
+
+    heap->Frame = frameNumber;
+    recycleBindlessSlots(&heap->TextureSlots, heap->Frame, framesInFlight);
+    recycleBindlessSlots(&heap->BufferSlots, heap->Frame, framesInFlight);
+}
+
+// Pipeline cache
+// Our header sits in front of the driver's blob. The driver validates its own header too, but it doesn't know about
+// driver updates that keep the cache UUID or about truncated files, so we check those before handing the blob over.
+#define ib_PipelineCacheMagic 0x43504249 // IBPC
+#define ib_PipelineCacheVersion 1
+typedef struct
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t VendorID;
+    uint32_t DeviceID;
+    uint32_t DriverVersion;
+    uint8_t CacheUUID[VK_UUID_SIZE];
+    uint64_t DataSize;
+    uint64_t DataHash;
+} ib_PipelineCacheFileHeader;
+
+static uint64_t hashBytes(void const* bytes, size_t size)
+{
+    // FNV-1a
+    uint8_t const* data = (uint8_t const*)bytes;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static ib_PipelineCacheFileHeader pipelineCacheHeaderForDevice(ib_Core* core)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(core->PhysicalDevice, &properties);
+
+    ib_PipelineCacheFileHeader header =
+    {
+        .Magic = ib_PipelineCacheMagic,
+        .Version = ib_PipelineCacheVersion,
+        .VendorID = properties.vendorID,
+        .DeviceID = properties.deviceID,
+        .DriverVersion = properties.driverVersion,
+    };
+    memcpy(header.CacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+// Returns the driver blob if the file exists and was written by this device and driver, NULL otherwise.
+static void* loadPipelineCacheData(ib_Core* core, size_t* outSize)
+{
+    *outSize = 0;
+    FILE* file = fopen(core->PipelineCachePath, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    // The size in the header is only trusted up to what the file actually holds, a truncated or corrupt file is a miss.
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    void* data = NULL;
+    ib_PipelineCacheFileHeader expected = pipelineCacheHeaderForDevice(core);
+    ib_PipelineCacheFileHeader header;
+    if (fileSize >= (long)sizeof(header)
+        && fread(&header, sizeof(header), 1, file) == 1
+        && header.DataSize <= (uint64_t)fileSize - sizeof(header)
+        && header.Magic == expected.Magic
+        && header.Version == expected.Version
+        && header.VendorID == expected.VendorID
+        && header.DeviceID == expected.DeviceID
+        && header.DriverVersion == expected.DriverVersion
+        && memcmp(header.CacheUUID, expected.CacheUUID, VK_UUID_SIZE) == 0
+        && header.DataSize >= sizeof(VkPipelineCacheHeaderVersionOne))
+    {
+        data = malloc((size_t)header.DataSize);
+        if (data != NULL && fread(data, (size_t)header.DataSize, 1, file) == 1 && hashBytes(data, (size_t)header.DataSize) == header.DataHash)
+        {
+            *outSize = (size_t)header.DataSize;
+        }
+        else
+        {
+            free(data);
+            data = NULL;
+        }
+    }
+
+    fclose(file);
+    return data;
+}
+
+static void createPipelineCache(ib_Core* core)
+{
+    size_t initialDataSize = 0;
+    void* initialData = core->PipelineCachePath[0] != '\0' ? loadPipelineCacheData(core, &initialDataSize) : NULL;
+    core->PipelineCacheStats = (ib_PipelineCacheStats) { .WarmStart = initialData != NULL };
+
+    VkPipelineCacheCreateInfo pipelineCacheCreate =
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = initialDataSize,
+        .pInitialData = initialData
+    };
+
+    // Drivers are allowed to reject data they don't like, start cold rather than fail.
+    if (vkCreatePipelineCache(core->LogicalDevice, &pipelineCacheCreate, ib_NoVkAllocator, &core->PipelineCache) != VK_SUCCESS)
+    {
+        core->PipelineCacheStats.WarmStart = false;
+        pipelineCacheCreate.initialDataSize = 0;
+        pipelineCacheCreate.pInitialData = NULL;
+        ib_vkCheck(vkCreatePipelineCache(core->LogicalDevice, &pipelineCacheCreate, ib_NoVkAllocator, &core->PipelineCache));
+    }
+
+    free(initialData);
+}
+
+#ifdef _WIN32
+__declspec(dllimport) int __stdcall MoveFileExA(char const* existingFileName, char const* newFileName, unsigned long flags);
+#define ib_MoveFileReplaceExisting 0x1
+#define ib_MoveFileWriteThrough 0x8
+static bool replaceFile(char const* from, char const* to)
+{
+    return MoveFileExA(from, to, ib_MoveFileReplaceExisting | ib_MoveFileWriteThrough) != 0;
+}
+#else
+static bool replaceFile(char const* from, char const* to)
+{
+    return rename(from, to) == 0;
+}
+#endif // _WIN32
+
+bool ib_savePipelineCache(ib_Core* core)
+{
+    uint32_t pipelineCount = core->PipelineCacheStats.CompiledPipelineCount + core->PipelineCacheStats.LinkedPipelineCount;
+    if (core->PipelineCachePath[0] == '\0' || core->PipelineCacheStats.SavedPipelineCount == pipelineCount)
+    {
+        return true;
+    }
+
+    size_t dataSize = 0;
+    ib_vkCheck(vkGetPipelineCacheData(core->LogicalDevice, core->PipelineCache, &dataSize, NULL));
+    uint8_t* data = malloc(dataSize);
+    ib_vkCheck(vkGetPipelineCacheData(core->LogicalDevice, core->PipelineCache, &dataSize, data));
+
+    ib_PipelineCacheFileHeader header = pipelineCacheHeaderForDevice(core);
+    header.DataSize = dataSize;
+    header.DataHash = hashBytes(data, dataSize);
+
+    char tempPath[ib_MaxPathLength];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", core->PipelineCachePath);
+
+    bool saved = false;
+    FILE* file = fopen(tempPath, "wb");
+    if (file != NULL)
+    {
+        saved = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(data, dataSize, 1, file) == 1;
+        saved = fclose(file) == 0 && saved;
+        saved = saved && replaceFile(tempPath, core->PipelineCachePath);
+        if (!saved)
+        {
+            remove(tempPath);
+        }
+    }
+    free(data);
+
+    if (saved)
+    {
+        core->PipelineCacheStats.SavedPipelineCount = pipelineCount;
+    }
+    return saved;
+}
+
+// Compute tunings
+// The file is a header followed by the entries. Tunings only carry over to the same device and driver.
+#define ib_ComputeTuningMagic 0x54434249 // IBCT
+#define ib_ComputeTuningVersion 1
+typedef struct
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t VendorID;
+    uint32_t DeviceID;
+    uint32_t DriverVersion;
+    uint32_t EntryCount;
+} ib_ComputeTuningFileHeader;
+
+static ib_ComputeTuningFileHeader computeTuningHeaderForDevice(ib_Core* core)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(core->PhysicalDevice, &properties);
+    return (ib_ComputeTuningFileHeader)
+    {
+        .Magic = ib_ComputeTuningMagic,
+        .Version = ib_ComputeTuningVersion,
+        .VendorID = properties.vendorID,
+        .DeviceID = properties.deviceID,
+        .DriverVersion = properties.driverVersion
+    };
+}
+
+static void loadComputeTunings(ib_Core* core)
+{
+    FILE* file = fopen(core->ComputeTunings.Path, "rb");
+    if (file == NULL)
+    {
+        return;
+    }
+
+    ib_ComputeTuningFileHeader expected = computeTuningHeaderForDevice(core);
+    ib_ComputeTuningFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) == 1
+        && header.Magic == expected.Magic
+        && header.Version == expected.Version
+        && header.VendorID == expected.VendorID
+        && header.DeviceID == expected.DeviceID
+        && header.DriverVersion == expected.DriverVersion
+        && header.EntryCount > 0)
+    {
+        ib_ComputeTuningEntry* entries = (ib_ComputeTuningEntry*)malloc(sizeof(ib_ComputeTuningEntry) * header.EntryCount);
+        if (fread(entries, sizeof(ib_ComputeTuningEntry), header.EntryCount, file) == header.EntryCount)
+        {
+            core->ComputeTunings.Entries = entries;
+            core->ComputeTunings.Count = header.EntryCount;
+            core->ComputeTunings.Capacity = header.EntryCount;
+        }
+        else
+        {
+            free(entries);
+        }
+    }
+    fclose(file);
+}
+
+// Pipelines can be compiled from batch workers, keep the stats atomic.
+static void recordPipelineCompile(ib_Core* core, uint64_t beginTicks)
+{
+    ib_atomicAddU32(&core->PipelineCacheStats.CompiledPipelineCount, 1);
+    ib_atomicAddU64(&core->PipelineCacheStats.CompileCPUTicks, ib_cpuTicks() - beginTicks);
+}
+
+static void recordPipelineLink(ib_Core* core, uint64_t beginTicks)
+{
+    ib_atomicAddU32(&core->PipelineCacheStats.LinkedPipelineCount, 1);
+    ib_atomicAddU64(&core->PipelineCacheStats.LinkCPUTicks, ib_cpuTicks() - beginTicks);
+}
+
 void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
 {
     *outCore = (ib_Core) { 0 };
@@ -413,13 +993,42 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
             .pEnabledValidationFeatures = (VkValidationFeatureEnableEXT[]) { VK_VALIDATION_FEATURE_ENABLE_DEBUG_PRINTF_EXT }
         };
  
+        char const* instanceExtensions[ib_arrayCount(ib_InstanceExtensions) + ib_arrayCount(ib_OptionalSurfaceExtensions)];
+        uint32_t instanceExtensionCount = ib_arrayCount(ib_InstanceExtensions);
+        memcpy(instanceExtensions, ib_InstanceExtensions, sizeof(ib_InstanceExtensions));
+#ifdef _WIN32
+        outCore->WindowSystems = 1 << ib_WindowSystem_Win32;
+#endif // _WIN32
+        {
+#define maxInstanceExtensionCount 256
+            uint32_t availableExtensionCount = maxInstanceExtensionCount;
+            VkExtensionProperties availableExtensions[maxInstanceExtensionCount];
+            VkResult enumerateResult = vkEnumerateInstanceExtensionProperties(NULL, &availableExtensionCount, availableExtensions);
+            ib_assert(enumerateResult == VK_SUCCESS || enumerateResult == VK_INCOMPLETE);
+            ib_potentiallyUnused(enumerateResult);
+#undef maxInstanceExtensionCount
+
+            for (uint32_t i = 0; i < ib_arrayCount(ib_OptionalSurfaceExtensions); i++)
+            {
+                for (uint32_t e = 0; e < availableExtensionCount; e++)
+                {
+                    if (strcmp(availableExtensions[e].extensionName, ib_OptionalSurfaceExtensions[i]) == 0)
+                    {
+                        instanceExtensions[instanceExtensionCount++] = ib_OptionalSurfaceExtensions[i];
+                        outCore->WindowSystems |= 1 << ib_OptionalSurfaceSystems[i];
+                        break;
+                    }
+                }
+            }
+        }
+
         VkInstanceCreateInfo createInfo =
         {
             .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
             .pNext = &validationFeatures,
             .pApplicationInfo = &appInfo,
-            .enabledExtensionCount = ib_arrayCount(ib_InstanceExtensions),
-            .ppEnabledExtensionNames = ib_InstanceExtensions,
+            .enabledExtensionCount = instanceExtensionCount,
+            .ppEnabledExtensionNames = instanceExtensions,
         };
 
 #ifdef IB_DEBUG
@@ -445,7 +1054,7 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
 
     // Device
     {
-#define maxPhysicalDeviceCount 2
+#define maxPhysicalDeviceCount 8
 #define maxPhysicalDeviceProperties 64
 
         uint32_t physicalDeviceCount;
@@ -454,6 +1063,12 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
         uint32_t queuePropertyCounts[maxPhysicalDeviceCount];
         VkQueueFamilyProperties queueProperties[maxPhysicalDeviceCount][maxPhysicalDeviceProperties];
 
+        ib_Window mainWindow = desc.MainWindow;
+        if (desc.Win32MainWindowHandle != NULL)
+        {
+            mainWindow = (ib_Window) { ib_WindowSystem_Win32, desc.Win32MainInstanceHandle, desc.Win32MainWindowHandle };
+        }
+
         // Enumerate the physical device properties
         {
             ib_vkCheck(vkEnumeratePhysicalDevices(outCore->Instance, &physicalDeviceCount, NULL));
@@ -478,6 +1093,16 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
             uint32_t physicalDeviceIndex = UINT32_MAX;
             for (uint32_t deviceIndex = 0; deviceIndex < physicalDeviceCount; deviceIndex++)
             {
+                if (desc.DeviceNameFilter != NULL)
+                {
+                    VkPhysicalDeviceProperties deviceProperties;
+                    vkGetPhysicalDeviceProperties(physicalDevices[deviceIndex], &deviceProperties);
+                    if (strstr(deviceProperties.deviceName, desc.DeviceNameFilter) == NULL)
+                    {
+                        continue;
+                    }
+                }
+
                 uint32_t graphicsQueue = UINT32_MAX;
                 uint32_t computeQueue = UINT32_MAX;
                 uint32_t presentQueue = UINT32_MAX;
@@ -491,26 +1116,30 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
                         continue;
                     }
 
-                    if (queueProperties[deviceIndex][propIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+                    VkQueueFlags const queueFlags = queueProperties[deviceIndex][propIndex].queueFlags;
+                    if (queueFlags & VK_QUEUE_GRAPHICS_BIT)
                     {
                         graphicsQueue = propIndex;
                     }
 
-                    if (queueProperties[deviceIndex][propIndex].queueFlags & VK_QUEUE_COMPUTE_BIT)
+                    // Prefer dedicated compute and transfer families so that their work can overlap graphics.
+                    if ((queueFlags & VK_QUEUE_COMPUTE_BIT)
+                        && (computeQueue == UINT32_MAX || (queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0))
                     {
                         computeQueue = propIndex;
                     }
 
-                    if (queueProperties[deviceIndex][propIndex].queueFlags & VK_QUEUE_TRANSFER_BIT)
+                    if ((queueFlags & VK_QUEUE_TRANSFER_BIT)
+                        && (transferQueue == UINT32_MAX || (queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0))
                     {
                         transferQueue = propIndex;
                     }
                 }
 
-                if (desc.Win32MainWindowHandle != NULL)
+                if (mainWindow.System != ib_WindowSystem_None)
                 {
                     // Create a temporary surface based on our main window to select our device.
-                    VkSurfaceKHR const temporarySurface = ib_createWin32VkSurface(outCore->Instance, desc.Win32MainWindowHandle, desc.Win32MainInstanceHandle);
+                    VkSurfaceKHR const temporarySurface = createVkSurface(outCore, mainWindow);
 
                     // Find our present queue
                     for (uint32_t propIndex = 0; propIndex < queuePropertyCounts[deviceIndex]; propIndex++)
@@ -546,6 +1175,10 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
                     outCore->Queues[ib_Queue_Compute].Index = computeQueue;
                     outCore->Queues[ib_Queue_Present].Index = presentQueue;
                     outCore->Queues[ib_Queue_Transfer].Index = transferQueue;
+                    for (uint32_t i = 0; i < ib_Queue_Count; i++)
+                    {
+                        outCore->Queues[i].TimestampValidBits = queueProperties[deviceIndex][outCore->Queues[i].Index].timestampValidBits;
+                    }
                     physicalDeviceIndex = deviceIndex;
                     break;
                 }
@@ -557,6 +1190,15 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
     }
 
     outCore->RaytracingEnabled = false;
+    outCore->CalibratedTimestampsEnabled = false;
+    outCore->PushDescriptorsEnabled = false;
+    outCore->GraphicsPipelineLibraryEnabled = false;
+    outCore->PresentWaitEnabled = false;
+#ifdef IB_DEBUG
+    outCore->ShaderStatisticsEnabled = true;
+#else
+    outCore->ShaderStatisticsEnabled = desc.CaptureShaderStatistics;
+#endif // IB_DEBUG
     {
         uint32_t propertyCount;
         ib_vkCheck(vkEnumerateDeviceExtensionProperties(outCore->PhysicalDevice, NULL, &propertyCount, NULL));
@@ -566,33 +1208,120 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
         VkExtensionProperties extensions[maxPhysicalExtensionCount];
         ib_vkCheck(vkEnumerateDeviceExtensionProperties(outCore->PhysicalDevice, NULL, &propertyCount, extensions));
 
-        // Use VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME as a proxy for raytracing
+        bool calibratedTimestampsSupported = false;
+        bool pipelineLibrarySupported = false;
+        bool graphicsPipelineLibrarySupported = false;
+        bool presentIDSupported = false;
+        bool presentWaitSupported = false;
         for (uint32_t i = 0; i < propertyCount; i++)
         {
+            // Use VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME as a proxy for raytracing
             if (strcmp(extensions[i].extensionName, VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME) == 0)
             {
                 outCore->RaytracingEnabled = true;
-                break;
+            }
+            else if (strcmp(extensions[i].extensionName, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) == 0)
+            {
+                calibratedTimestampsSupported = true;
+            }
+            else if (strcmp(extensions[i].extensionName, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME) == 0)
+            {
+                outCore->PushDescriptorsEnabled = true;
+            }
+            else if (strcmp(extensions[i].extensionName, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) == 0)
+            {
+                pipelineLibrarySupported = true;
+            }
+            else if (strcmp(extensions[i].extensionName, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) == 0)
+            {
+                graphicsPipelineLibrarySupported = true;
+            }
+            else if (strcmp(extensions[i].extensionName, VK_KHR_PRESENT_ID_EXTENSION_NAME) == 0)
+            {
+                presentIDSupported = true;
+            }
+            else if (strcmp(extensions[i].extensionName, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) == 0)
+            {
+                presentWaitSupported = true;
             }
         }
+        outCore->PresentWaitEnabled = presentIDSupported && presentWaitSupported && ib_vkWaitForPresentKHR != NULL; // Features checked below
+        outCore->GraphicsPipelineLibraryEnabled = pipelineLibrarySupported && graphicsPipelineLibrarySupported; // Feature checked below
+        outCore->RaytracePipelineLibraryEnabled = pipelineLibrarySupported && outCore->RaytracingEnabled;
 #undef maxPhysicalExtensionCount
-    }
-
-    // Create the logical device
-    {
-        VkDeviceQueueCreateInfo queueCreateInfo[ib_Queue_Count] = { 0 };
-        uint32_t queueCreateInfoCount = 0;
 
-        uint32_t queueCreatedList = 0;
-        for (uint32_t i = 0; i < ib_Queue_Count; i++)
+        // Calibration is only useful if we can sample the device clock alongside the clock ib_cpuTicks uses.
+        if (calibratedTimestampsSupported && ib_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT != NULL)
         {
-            ib_assert(outCore->Queues[i].Index < 32);
-            if (queueCreatedList & (1 << outCore->Queues[i].Index))
+#define maxTimeDomainCount 8
+            uint32_t timeDomainCount = maxTimeDomainCount;
+            VkTimeDomainEXT timeDomains[maxTimeDomainCount];
+            VkResult result = ib_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(outCore->PhysicalDevice, &timeDomainCount, timeDomains);
+#undef maxTimeDomainCount
+
+            bool hasDeviceDomain = false;
+            bool hasCPUDomain = false;
+            for (uint32_t i = 0; i < timeDomainCount && result >= VK_SUCCESS; i++)
             {
-                continue;
+                hasDeviceDomain |= timeDomains[i] == VK_TIME_DOMAIN_DEVICE_EXT;
+                hasCPUDomain |= timeDomains[i] == ib_CPUTimeDomain;
             }
-            queueCreatedList |= (1 << outCore->Queues[i].Index);
-
+            outCore->CalibratedTimestampsEnabled = hasDeviceDomain && hasCPUDomain;
+        }
+    }
+
+    {
+        VkPhysicalDevicePresentWaitFeaturesKHR supportedPresentWaitFeatures = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR };
+        VkPhysicalDevicePresentIdFeaturesKHR supportedPresentIDFeatures =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+            .pNext = &supportedPresentWaitFeatures
+        };
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT supportedGraphicsPipelineLibraryFeatures =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+            .pNext = outCore->PresentWaitEnabled ? &supportedPresentIDFeatures : NULL
+        };
+        VkPhysicalDeviceVulkan12Features supported12Features =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+            .pNext = outCore->GraphicsPipelineLibraryEnabled ? (void*)&supportedGraphicsPipelineLibraryFeatures
+                : outCore->PresentWaitEnabled ? (void*)&supportedPresentIDFeatures : NULL
+        };
+        VkPhysicalDeviceFeatures2 supportedFeatures =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &supported12Features
+        };
+        vkGetPhysicalDeviceFeatures2(outCore->PhysicalDevice, &supportedFeatures);
+        outCore->PipelineStatisticsEnabled = supportedFeatures.features.pipelineStatisticsQuery == VK_TRUE;
+        outCore->GraphicsPipelineLibraryEnabled = outCore->GraphicsPipelineLibraryEnabled && supportedGraphicsPipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+        outCore->PresentWaitEnabled = outCore->PresentWaitEnabled && supportedPresentIDFeatures.presentId == VK_TRUE && supportedPresentWaitFeatures.presentWait == VK_TRUE;
+
+        outCore->Bindless.Enabled = supported12Features.descriptorBindingSampledImageUpdateAfterBind
+            && supported12Features.descriptorBindingStorageImageUpdateAfterBind
+            && supported12Features.descriptorBindingStorageBufferUpdateAfterBind
+            && supported12Features.descriptorBindingUpdateUnusedWhilePending
+            && supported12Features.shaderSampledImageArrayNonUniformIndexing
+            && supported12Features.shaderStorageImageArrayNonUniformIndexing
+            && supported12Features.shaderStorageBufferArrayNonUniformIndexing;
+    }
+
+    // Create the logical device
+    {
+        VkDeviceQueueCreateInfo queueCreateInfo[ib_Queue_Count] = { 0 };
+        uint32_t queueCreateInfoCount = 0;
+
+        uint32_t queueCreatedList = 0;
+        for (uint32_t i = 0; i < ib_Queue_Count; i++)
+        {
+            ib_assert(outCore->Queues[i].Index < 32);
+            if (queueCreatedList & (1 << outCore->Queues[i].Index))
+            {
+                continue;
+            }
+            queueCreatedList |= (1 << outCore->Queues[i].Index);
+
             float const queuePriority = 1.0f;
             VkDeviceQueueCreateInfo createQueueInfo =
             {
@@ -611,7 +1340,8 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
             .multiDrawIndirect = VK_TRUE,
             .drawIndirectFirstInstance = VK_TRUE,
             .shaderInt64 = VK_TRUE,
-            .dualSrcBlend = VK_TRUE
+            .dualSrcBlend = VK_TRUE,
+            .pipelineStatisticsQuery = outCore->PipelineStatisticsEnabled ? VK_TRUE : VK_FALSE
         };
 
         // Intel iGPU doesn't support int64 atomics.
@@ -647,11 +1377,7 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
         {
             .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR,
             .pNext = outCore->RaytracingEnabled ? &rayQueryFeatures : NULL,
-#if IB_DEBUG
-            .pipelineExecutableInfo = VK_TRUE,
-#else
-            .pipelineExecutableInfo = VK_FALSE,
-#endif // IB_DEBUG
+            .pipelineExecutableInfo = outCore->ShaderStatisticsEnabled ? VK_TRUE : VK_FALSE,
         };
 
         VkPhysicalDeviceVulkan13Features vulkan13Features =
@@ -678,7 +1404,14 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
             .bufferDeviceAddress = VK_TRUE,
             .hostQueryReset = VK_TRUE,
             .scalarBlockLayout = VK_TRUE,
-            .descriptorBindingPartiallyBound = VK_TRUE
+            .descriptorBindingPartiallyBound = VK_TRUE,
+            .descriptorBindingSampledImageUpdateAfterBind = outCore->Bindless.Enabled ? VK_TRUE : VK_FALSE,
+            .descriptorBindingStorageImageUpdateAfterBind = outCore->Bindless.Enabled ? VK_TRUE : VK_FALSE,
+            .descriptorBindingStorageBufferUpdateAfterBind = outCore->Bindless.Enabled ? VK_TRUE : VK_FALSE,
+            .descriptorBindingUpdateUnusedWhilePending = outCore->Bindless.Enabled ? VK_TRUE : VK_FALSE,
+            .shaderSampledImageArrayNonUniformIndexing = outCore->Bindless.Enabled ? VK_TRUE : VK_FALSE,
+            .shaderStorageImageArrayNonUniformIndexing = outCore->Bindless.Enabled ? VK_TRUE : VK_FALSE,
+            .shaderStorageBufferArrayNonUniformIndexing = outCore->Bindless.Enabled ? VK_TRUE : VK_FALSE
         };
 
         VkPhysicalDeviceVulkan11Features vulkan11Features =
@@ -690,9 +1423,29 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
             .shaderDrawParameters = VK_TRUE
         };
 
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+            .pNext = &vulkan11Features,
+            .graphicsPipelineLibrary = VK_TRUE
+        };
+
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+            .pNext = outCore->GraphicsPipelineLibraryEnabled ? (void*)&graphicsPipelineLibraryFeatures : (void*)&vulkan11Features,
+            .presentWait = VK_TRUE
+        };
+
+        VkPhysicalDevicePresentIdFeaturesKHR presentIDFeatures =
+        {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+            .pNext = &presentWaitFeatures,
+            .presentId = VK_TRUE
+        };
 
         uint32_t extensionCount = ib_arrayCount(ib_DeviceExtensions);
-        char const* deviceExtensions[ib_arrayCount(ib_DeviceExtensions) + ib_arrayCount(ib_RaytracingDeviceExtensions)];
+        char const* deviceExtensions[ib_arrayCount(ib_DeviceExtensions) + ib_arrayCount(ib_RaytracingDeviceExtensions) + 6];
         memcpy((void*)deviceExtensions, ib_DeviceExtensions, sizeof(ib_DeviceExtensions));
         if (outCore->RaytracingEnabled)
         {
@@ -700,10 +1453,37 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
             extensionCount += ib_arrayCount(ib_RaytracingDeviceExtensions);
         }
 
+        if (outCore->CalibratedTimestampsEnabled)
+        {
+            deviceExtensions[extensionCount++] = VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME;
+        }
+
+        if (outCore->PushDescriptorsEnabled)
+        {
+            deviceExtensions[extensionCount++] = VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME;
+        }
+
+        if (outCore->GraphicsPipelineLibraryEnabled || outCore->RaytracePipelineLibraryEnabled)
+        {
+            deviceExtensions[extensionCount++] = VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME;
+        }
+
+        if (outCore->GraphicsPipelineLibraryEnabled)
+        {
+            deviceExtensions[extensionCount++] = VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME;
+        }
+
+        if (outCore->PresentWaitEnabled)
+        {
+            deviceExtensions[extensionCount++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+            deviceExtensions[extensionCount++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+        }
+
         VkDeviceCreateInfo deviceCreateInfo =
         {
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            .pNext = &vulkan11Features,
+            .pNext = outCore->PresentWaitEnabled ? (void const*)&presentIDFeatures
+                : outCore->GraphicsPipelineLibraryEnabled ? (void const*)&graphicsPipelineLibraryFeatures : (void const*)&vulkan11Features,
             .enabledExtensionCount = extensionCount,
             .queueCreateInfoCount = queueCreateInfoCount,
             .pQueueCreateInfos = queueCreateInfo,
@@ -722,9 +1502,15 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
         }
 
         {
-            VkPhysicalDeviceProperties properties;
-            vkGetPhysicalDeviceProperties(outCore->PhysicalDevice, &properties);
-            outCore->DeviceLimits = properties.limits;
+            VkPhysicalDeviceVulkan13Properties properties13 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_PROPERTIES };
+            VkPhysicalDeviceProperties2 properties = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &properties13 };
+            vkGetPhysicalDeviceProperties2(outCore->PhysicalDevice, &properties);
+            outCore->DeviceLimits = properties.properties.limits;
+            if (properties13.requiredSubgroupSizeStages & VK_SHADER_STAGE_COMPUTE_BIT)
+            {
+                outCore->MinWaveSize = properties13.minSubgroupSize;
+                outCore->MaxWaveSize = properties13.maxSubgroupSize;
+            }
         }
     }
 
@@ -774,8 +1560,25 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
 
     // Create the pipeline cache
     {
-        VkPipelineCacheCreateInfo pipelineCacheCreate = { .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
-        ib_vkCheck(vkCreatePipelineCache(outCore->LogicalDevice, &pipelineCacheCreate, ib_NoVkAllocator, &outCore->PipelineCache));
+        outCore->PipelineCachePath[0] = '\0';
+        if (desc.PipelineCachePath != NULL)
+        {
+            ib_assert(strlen(desc.PipelineCachePath) < ib_MaxPathLength - 4, "Pipeline cache path is too long."); // Leave room for .tmp
+            snprintf(outCore->PipelineCachePath, ib_MaxPathLength - 4, "%s", desc.PipelineCachePath);
+        }
+        createPipelineCache(outCore);
+
+        outCore->ShaderModules = (ib_ShaderModuleCache) { 0 };
+        ib_initMutex(&outCore->ShaderModules.Lock);
+
+        outCore->ComputeTunings = (ib_ComputeTuningTable) { 0 };
+        ib_initMutex(&outCore->ComputeTunings.Lock);
+        if (desc.ComputeTuningPath != NULL)
+        {
+            ib_assert(strlen(desc.ComputeTuningPath) < ib_MaxPathLength - 4, "Compute tuning path is too long.");
+            snprintf(outCore->ComputeTunings.Path, ib_MaxPathLength - 4, "%s", desc.ComputeTuningPath);
+            loadComputeTunings(outCore);
+        }
     }
 
     // Create the command pools
@@ -851,6 +1654,8 @@ void ib_initCore(ib_CoreDesc desc, ib_Core* outCore)
         }
     }
 
+    initBindlessHeap(outCore);
+
     // Default textures
     {
         ib_TextureDesc textureDescs[] =
@@ -885,6 +1690,7 @@ void ib_killCore(ib_Core* core)
     {
         ib_freeTexture(core, &core->DefaultTextures[i]);
     }
+    killBindlessHeap(core);
 
     for (uint32_t i = 0; i < ib_Sampler_Count; i++)
     {
@@ -896,6 +1702,25 @@ void ib_killCore(ib_Core* core)
         vkDestroyCommandPool(core->LogicalDevice, core->Queues[i].CommandPool, ib_NoVkAllocator);
     }
 
+    if (core->Reloader != NULL)
+    {
+        ib_killPipelineReloader(core);
+    }
+
+    ib_assert(core->ShaderModules.Count == 0, "Shader modules are still referenced, free every pipeline before killing the core.");
+    for (uint32_t i = 0; i < core->ShaderModules.Count; i++)
+    {
+        vkDestroyShaderModule(core->LogicalDevice, core->ShaderModules.Entries[i].Module, ib_NoVkAllocator);
+        free(core->ShaderModules.Entries[i].Code);
+    }
+    free(core->ShaderModules.Entries);
+    ib_killMutex(&core->ShaderModules.Lock);
+
+    ib_saveComputeTunings(core);
+    free(core->ComputeTunings.Entries);
+    ib_killMutex(&core->ComputeTunings.Lock);
+
+    ib_savePipelineCache(core);
     vkDestroyPipelineCache(core->LogicalDevice, core->PipelineCache, ib_NoVkAllocator);
     vkDestroyDescriptorPool(core->LogicalDevice, core->Descriptors.Pool, ib_NoVkAllocator);
 
@@ -933,7 +1758,7 @@ void ib_allocCommandBuffers(ib_Core* core, ib_AllocCommandBuffersDesc desc)
     VkCommandBufferAllocateInfo commandBufferAllocateInfo =
     {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .level = desc.Level,
         .commandBufferCount = desc.OutCommandBuffers.Count,
         .commandPool = desc.Pool != VK_NULL_HANDLE ? desc.Pool : core->Queues[desc.Queue].CommandPool,
     };
@@ -1002,6 +1827,24 @@ void ib_endAndSubmitCommandBuffer(ib_Core* core, VkCommandBuffer commandBuffer,
 }
 
 // Texture
+// Resources are shared between the graphics, compute and transfer families so the render graph can use them on any queue.
+static uint32_t getSharedQueueFamilies(ib_Core* core, uint32_t outQueueFamilies[3])
+{
+    uint32_t queueFamilyCount = 0;
+    outQueueFamilies[queueFamilyCount++] = core->Queues[ib_Queue_Graphics].Index;
+    if (core->Queues[ib_Queue_Compute].Index != core->Queues[ib_Queue_Graphics].Index)
+    {
+        outQueueFamilies[queueFamilyCount++] = core->Queues[ib_Queue_Compute].Index;
+    }
+
+    if (core->Queues[ib_Queue_Transfer].Index != core->Queues[ib_Queue_Graphics].Index
+        && core->Queues[ib_Queue_Transfer].Index != core->Queues[ib_Queue_Compute].Index)
+    {
+        outQueueFamilies[queueFamilyCount++] = core->Queues[ib_Queue_Transfer].Index;
+    }
+    return queueFamilyCount;
+}
+
 ib_Texture ib_allocTexture(ib_Core* core, ib_TextureDesc desc)
 {
     ib_Texture texture =
@@ -1015,18 +1858,8 @@ ib_Texture ib_allocTexture(ib_Core* core, ib_TextureDesc desc)
 
     bool is3D = desc.Extent.depth > 1;
     {
-        uint32_t queueFamilyCount = 1;
-        uint32_t queueFamilies[3] = { core->Queues[ib_Queue_Graphics].Index };
-        if (core->Queues[ib_Queue_Compute].Index != core->Queues[ib_Queue_Graphics].Index)
-        {
-            queueFamilies[queueFamilyCount++] = core->Queues[ib_Queue_Compute].Index;
-        }
-
-        if (core->Queues[ib_Queue_Transfer].Index != core->Queues[ib_Queue_Graphics].Index
-            && core->Queues[ib_Queue_Transfer].Index != core->Queues[ib_Queue_Compute].Index)
-        {
-            queueFamilies[queueFamilyCount++] = core->Queues[ib_Queue_Transfer].Index;
-        }
+        uint32_t queueFamilies[3];
+        uint32_t queueFamilyCount = getSharedQueueFamilies(core, queueFamilies);
 
         VkImageCreateInfo imageCreate =
         {
@@ -1129,6 +1962,8 @@ ib_Texture ib_allocTexture(ib_Core* core, ib_TextureDesc desc)
         }
     }
 
+    texture.BindlessIndex = registerBindlessTexture(core, &texture, desc.Usage);
+
     if (desc.InitialWrite.Data != NULL)
     {
         ib_assert(desc.InitialWrite.Size != 0);
@@ -1152,6 +1987,12 @@ void ib_freeTexture(ib_Core* core, ib_Texture* texture)
         vkDestroyImageView(core->LogicalDevice, texture->View, ib_NoVkAllocator);
         iba_gpuFree(&core->Allocator, &texture->Allocation);
     }
+
+    if (texture->BindlessIndex != ib_InvalidBindlessIndex)
+    {
+        retireBindlessSlot(&core->Bindless.TextureSlots, core->Bindless.Frame, texture->BindlessIndex);
+        texture->BindlessIndex = ib_InvalidBindlessIndex;
+    }
 }
 
 void ib_writeToTexture(ib_Core* core, ib_WriteToTextureDesc desc)
@@ -1374,12 +2215,18 @@ ib_Buffer ib_allocBuffer(ib_Core* core, ib_BufferDesc desc)
     ib_Buffer buffer = { 0 };
     buffer.Size = desc.Size;
 
+    uint32_t queueFamilies[3];
+    uint32_t queueFamilyCount = getSharedQueueFamilies(core, queueFamilies);
+
     VkBufferUsageFlags const finalUsage = desc.Usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
     VkBufferCreateInfo bufferCreate =
     {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .size = desc.Size,
         .usage = finalUsage, // buffers created through create buffer can always be transfered to
+        .sharingMode = queueFamilyCount > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = queueFamilyCount,
+        .pQueueFamilyIndices = queueFamilies
     };
     ib_vkCheck(vkCreateBuffer(core->LogicalDevice, &bufferCreate, ib_NoVkAllocator, &buffer.VulkanBuffer));
 
@@ -1419,6 +2266,8 @@ ib_Buffer ib_allocBuffer(ib_Core* core, ib_BufferDesc desc)
 
         buffer.DeviceAddress = vkGetBufferDeviceAddressKHR(core->LogicalDevice, &addressQueryInfo);
     }
+
+    buffer.BindlessIndex = registerBindlessBuffer(core, &buffer, finalUsage);
     
     if (desc.InitialWrite.Data != NULL)
     {
@@ -1440,6 +2289,12 @@ void ib_freeBuffer(ib_Core* core, ib_Buffer* buffer)
 {
     vkDestroyBuffer(core->LogicalDevice, buffer->VulkanBuffer, ib_NoVkAllocator);
     iba_gpuFree(&core->Allocator, &buffer->Allocation);
+
+    if (buffer->BindlessIndex != ib_InvalidBindlessIndex)
+    {
+        retireBindlessSlot(&core->Bindless.BufferSlots, core->Bindless.Frame, buffer->BindlessIndex);
+        buffer->BindlessIndex = ib_InvalidBindlessIndex;
+    }
 }
 
 void ib_writeToBuffer(ib_Core* core, ib_WriteToBufferDesc desc)
@@ -1497,35 +2352,158 @@ void ib_writeToBuffer(ib_Core* core, ib_WriteToBufferDesc desc)
 }
 
 // Surface
-static VkSurfaceKHR ib_createWin32VkSurface(VkInstance vkInstance, void const* windowHandle, void const* instanceHandle)
+static VkSurfaceKHR createVkSurface(ib_Core const* core, ib_Window window)
 {
-    VkWin32SurfaceCreateInfoKHR surfaceCreateInfo =
+    ib_assert((core->WindowSystems & (1 << window.System)) != 0, "The Vulkan loader doesn't support this window system, see ib_Core::WindowSystems.");
+
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    switch (window.System)
+    {
+#ifdef _WIN32
+    case ib_WindowSystem_Win32:
+    {
+        VkWin32SurfaceCreateInfoKHR surfaceCreateInfo =
+        {
+            .sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR,
+            .hinstance = (HINSTANCE)window.Display,
+            .hwnd = (HWND)window.Window
+        };
+        ib_vkCheck(vkCreateWin32SurfaceKHR(core->Instance, &surfaceCreateInfo, ib_NoVkAllocator, &surface));
+        break;
+    }
+#endif // _WIN32
+    case ib_WindowSystem_Xlib:
+    {
+        VkXlibSurfaceCreateInfoKHR surfaceCreateInfo =
+        {
+            .sType = VK_STRUCTURE_TYPE_XLIB_SURFACE_CREATE_INFO_KHR,
+            .dpy = (Display*)window.Display,
+            .window = (Window)(uintptr_t)window.Window
+        };
+        ib_vkCheck(ib_vkCreateXlibSurfaceKHR(core->Instance, &surfaceCreateInfo, ib_NoVkAllocator, &surface));
+        break;
+    }
+    case ib_WindowSystem_Xcb:
+    {
+        VkXcbSurfaceCreateInfoKHR surfaceCreateInfo =
+        {
+            .sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR,
+            .connection = (xcb_connection_t*)window.Display,
+            .window = (xcb_window_t)(uintptr_t)window.Window
+        };
+        ib_vkCheck(ib_vkCreateXcbSurfaceKHR(core->Instance, &surfaceCreateInfo, ib_NoVkAllocator, &surface));
+        break;
+    }
+    case ib_WindowSystem_Wayland:
+    {
+        VkWaylandSurfaceCreateInfoKHR surfaceCreateInfo =
+        {
+            .sType = VK_STRUCTURE_TYPE_WAYLAND_SURFACE_CREATE_INFO_KHR,
+            .display = (struct wl_display*)window.Display,
+            .surface = (struct wl_surface*)window.Window
+        };
+        ib_vkCheck(ib_vkCreateWaylandSurfaceKHR(core->Instance, &surfaceCreateInfo, ib_NoVkAllocator, &surface));
+        break;
+    }
+    case ib_WindowSystem_Headless:
+    {
+        VkHeadlessSurfaceCreateInfoEXT surfaceCreateInfo = { .sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT };
+        ib_vkCheck(ib_vkCreateHeadlessSurfaceEXT(core->Instance, &surfaceCreateInfo, ib_NoVkAllocator, &surface));
+        break;
+    }
+    default:
+        ib_assert(false, "Unknown window system.");
+        break;
+    }
+
+    return surface;
+}
+
+// Window systems that let the swapchain pick the size report UINT32_MAX, fall back to what was asked for.
+static VkExtent3D surfaceExtent(VkSurfaceCapabilitiesKHR const* surfaceCapabilities, VkExtent3D requestedExtent)
+{
+    if (surfaceCapabilities->currentExtent.width != UINT32_MAX)
+    {
+        return (VkExtent3D) { surfaceCapabilities->currentExtent.width, surfaceCapabilities->currentExtent.height, 0 };
+    }
+
+    ib_assert(requestedExtent.width > 0 && requestedExtent.height > 0, "The window system doesn't set the surface size, ib_SurfaceDesc::Extent is required.");
+    return (VkExtent3D)
     {
-        .sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR,
-        .hinstance = (HINSTANCE)instanceHandle,
-        .hwnd = (HWND)windowHandle,
+        ib_clamp(requestedExtent.width, surfaceCapabilities->minImageExtent.width, surfaceCapabilities->maxImageExtent.width),
+        ib_clamp(requestedExtent.height, surfaceCapabilities->minImageExtent.height, surfaceCapabilities->maxImageExtent.height),
+        0
     };
+}
 
-    VkSurfaceKHR surface;
-    ib_vkCheck(vkCreateWin32SurfaceKHR(vkInstance, &surfaceCreateInfo, ib_NoVkAllocator, &surface));
+static void destroyRetiredSwapchain(ib_Core* core, ib_RetiredSwapchain* retired)
+{
+    for (uint32_t i = 0; i < retired->ViewCount; i++)
+    {
+        vkDestroyImageView(core->LogicalDevice, retired->Views[i], ib_NoVkAllocator);
+    }
+    vkDestroySwapchainKHR(core->LogicalDevice, retired->Swapchain, ib_NoVkAllocator);
+}
 
-    return surface;
+// Every frame in flight waits on its fence before preparing the surface,
+// once ib_MaxFramesInFlight frames have been prepared since a swapchain was replaced, no frame can still be using it.
+static void destroyFinishedSwapchains(ib_Core* core, ib_Surface* surface, bool waitForAll)
+{
+    uint32_t keptCount = 0;
+    for (uint32_t i = 0; i < surface->RetiredSwapchainCount; i++)
+    {
+        ib_RetiredSwapchain* retired = &surface->RetiredSwapchains[i];
+        if (waitForAll || surface->PrepareCount - retired->RetiredAtPrepare >= ib_MaxFramesInFlight)
+        {
+            destroyRetiredSwapchain(core, retired);
+        }
+        else
+        {
+            surface->RetiredSwapchains[keptCount++] = *retired;
+        }
+    }
+    surface->RetiredSwapchainCount = keptCount;
 }
 
 static void ib_buildSwapchain(ib_Core* core, ib_Surface* surface)
 {
     VkSwapchainKHR oldSwapchain = surface->Swapchain;
 
-    // Destroy our previous imageview
-    for (uint32_t fb = 0; fb < ib_FramebufferCount; fb++)
+    // The old swapchain's images can still be in flight, retire it instead of destroying it.
+    if (oldSwapchain != VK_NULL_HANDLE)
     {
-        vkDestroyImageView(core->LogicalDevice, surface->SwapchainTextures[fb].View, ib_NoVkAllocator);
+        // Rebuilding faster than frames retire, fall back to waiting.
+        if (surface->RetiredSwapchainCount == ib_MaxRetiredSwapchainCount)
+        {
+            vkDeviceWaitIdle(core->LogicalDevice);
+            destroyFinishedSwapchains(core, surface, true);
+        }
+
+        ib_RetiredSwapchain* retired = &surface->RetiredSwapchains[surface->RetiredSwapchainCount++];
+        *retired = (ib_RetiredSwapchain) { .Swapchain = oldSwapchain, .ViewCount = surface->SwapchainTextureCount, .RetiredAtPrepare = surface->PrepareCount };
+        for (uint32_t fb = 0; fb < surface->SwapchainTextureCount; fb++)
+        {
+            retired->Views[fb] = surface->SwapchainTextures[fb].View;
+        }
+    }
+
+    uint32_t imageCount = surface->RequestedImageCount;
+    {
+        VkSurfaceCapabilitiesKHR surfaceCapabilities;
+        ib_vkCheck(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(core->PhysicalDevice, surface->VulkanSurface, &surfaceCapabilities));
+
+        // A max image count of 0 means there's no limit.
+        imageCount = ib_max(imageCount, surfaceCapabilities.minImageCount);
+        if (surfaceCapabilities.maxImageCount > 0)
+        {
+            imageCount = ib_min(imageCount, surfaceCapabilities.maxImageCount);
+        }
     }
 
     VkSwapchainCreateInfoKHR swapchainCreate =
     {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-        .minImageCount = ib_FramebufferCount,
+        .minImageCount = imageCount,
         .imageArrayLayers = 1,
         .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
         .surface = surface->VulkanSurface,
@@ -1560,15 +2538,21 @@ static void ib_buildSwapchain(ib_Core* core, ib_Surface* surface)
     }
 
     ib_vkCheck(vkCreateSwapchainKHR(core->LogicalDevice, &swapchainCreate, ib_NoVkAllocator, &surface->Swapchain));
-    vkDestroySwapchainKHR(core->LogicalDevice, oldSwapchain, ib_NoVkAllocator);
 
-    VkImage swapchainImages[ib_FramebufferCount];
+    // Present IDs are per swapchain, completion tracking starts over.
+    surface->CompletedPresentID = surface->PresentID;
+    surface->PresentCompletedTicks = 0;
 
-    uint32_t swapchainImageCount = ib_FramebufferCount;
+    VkImage swapchainImages[ib_MaxSwapchainImageCount];
+
+    uint32_t swapchainImageCount;
+    ib_vkCheck(vkGetSwapchainImagesKHR(core->LogicalDevice, surface->Swapchain, &swapchainImageCount, NULL));
+    ib_assert(swapchainImageCount <= ib_MaxSwapchainImageCount, "Too many swapchain images! Increase ib_MaxSwapchainImageCount.");
+    swapchainImageCount = ib_min(swapchainImageCount, ib_MaxSwapchainImageCount);
     ib_vkCheck(vkGetSwapchainImagesKHR(core->LogicalDevice, surface->Swapchain, &swapchainImageCount, swapchainImages));
-    ib_assert(swapchainImageCount >= ib_FramebufferCount, "Too few swapchain images!");
+    surface->SwapchainTextureCount = swapchainImageCount;
 
-    for (uint32_t fb = 0; fb < ib_FramebufferCount; fb++)
+    for (uint32_t fb = 0; fb < swapchainImageCount; fb++)
     {
         VkImageViewCreateInfo imageViewCreate =
         {
@@ -1594,42 +2578,71 @@ static void ib_buildSwapchain(ib_Core* core, ib_Surface* surface)
 }
 
 ib_Surface ib_allocWin32Surface(ib_Core* core, ib_SurfaceDesc desc)
+{
+    desc.Window = (ib_Window) { ib_WindowSystem_Win32, desc.Win32InstanceHandle, desc.Win32WindowHandle };
+    return ib_allocSurface(core, desc);
+}
+
+static VkPresentModeKHR const ib_VkPresentModes[ib_PresentMode_Count] =
+{
+    [ib_PresentMode_Default] = VK_PRESENT_MODE_FIFO_KHR,
+    [ib_PresentMode_Fifo] = VK_PRESENT_MODE_FIFO_KHR,
+    [ib_PresentMode_FifoRelaxed] = VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+    [ib_PresentMode_Mailbox] = VK_PRESENT_MODE_MAILBOX_KHR,
+    [ib_PresentMode_Immediate] = VK_PRESENT_MODE_IMMEDIATE_KHR
+};
+
+static uint32_t getSupportedPresentModes(ib_Core* core, VkSurfaceKHR surface)
+{
+#define maxPresentModes 32
+    uint32_t presentModeCount;
+    VkPresentModeKHR presentModes[maxPresentModes];
+
+    ib_vkCheck(vkGetPhysicalDeviceSurfacePresentModesKHR(core->PhysicalDevice, surface, &presentModeCount, NULL));
+    ib_assert(presentModeCount > 0, "Failed to find a present mode.");
+    presentModeCount = presentModeCount < maxPresentModes ? presentModeCount : maxPresentModes;
+    ib_vkCheck(vkGetPhysicalDeviceSurfacePresentModesKHR(core->PhysicalDevice, surface, &presentModeCount, presentModes));
+#undef maxPresentModes
+
+    // FIFO is required to be supported.
+    uint32_t supportedModes = (1 << ib_PresentMode_Default) | (1 << ib_PresentMode_Fifo);
+    for (uint32_t i = 0; i < presentModeCount; i++)
+    {
+        for (uint32_t mode = ib_PresentMode_FifoRelaxed; mode < ib_PresentMode_Count; mode++)
+        {
+            if (ib_VkPresentModes[mode] == presentModes[i])
+            {
+                supportedModes |= 1 << mode;
+            }
+        }
+    }
+    return supportedModes;
+}
+
+ib_Surface ib_allocSurface(ib_Core* core, ib_SurfaceDesc desc)
 {
     ib_Surface surface = { 0 };
 
-    surface.VulkanSurface = ib_createWin32VkSurface(core->Instance, desc.Win32WindowHandle, desc.Win32InstanceHandle);
+    surface.VulkanSurface = createVkSurface(core, desc.Window);
+    surface.RequestedImageCount = desc.ImageCount > 0 ? ib_clamp(desc.ImageCount, 1, ib_MaxSwapchainImageCount) : ib_FramebufferCount;
 
     // Extents
     {
         VkSurfaceCapabilitiesKHR surfaceCapabilities;
         ib_vkCheck(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(core->PhysicalDevice, surface.VulkanSurface, &surfaceCapabilities));
-
-        ib_assert(surfaceCapabilities.currentExtent.width != UINT32_MAX, "Surface has invalid width.");
-        surface.Extent = (VkExtent3D) { surfaceCapabilities.currentExtent.width, surfaceCapabilities.currentExtent.height, 0 };
+        surface.Extent = surfaceExtent(&surfaceCapabilities, (VkExtent3D) { desc.Extent.width, desc.Extent.height, 0 });
     }
 
     // Present mode
-    surface.PresentMode = VK_PRESENT_MODE_FIFO_KHR;
-    if (!desc.UseVSync)
     {
-#define maxPresentModes 32
-        uint32_t presentModeCount;
-        VkPresentModeKHR presentModes[maxPresentModes];
-
-        ib_vkCheck(vkGetPhysicalDeviceSurfacePresentModesKHR(core->PhysicalDevice, surface.VulkanSurface, &presentModeCount, NULL));
-        ib_assert(presentModeCount > 0, "Failed to find a present mode.");
-        presentModeCount = presentModeCount < maxPresentModes ? presentModeCount : maxPresentModes;
-        ib_vkCheck(vkGetPhysicalDeviceSurfacePresentModesKHR(core->PhysicalDevice, surface.VulkanSurface, &presentModeCount, presentModes));
-#undef maxPresentModes
+        surface.SupportedPresentModes = getSupportedPresentModes(core, surface.VulkanSurface);
 
-        for (uint32_t i = 0; i < presentModeCount; i++)
+        ib_PresentMode presentMode = desc.PresentMode;
+        if (presentMode == ib_PresentMode_Default)
         {
-            if (VK_PRESENT_MODE_MAILBOX_KHR == presentModes[i])
-            {
-                surface.PresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
-                break;
-            }
+            presentMode = desc.UseVSync ? ib_PresentMode_Fifo : ib_PresentMode_Mailbox;
         }
+        surface.PresentMode = (surface.SupportedPresentModes & (1 << presentMode)) != 0 ? ib_VkPresentModes[presentMode] : VK_PRESENT_MODE_FIFO_KHR;
     }
 
     // Surface format
@@ -1669,9 +2682,10 @@ ib_Surface ib_allocWin32Surface(ib_Core* core, ib_SurfaceDesc desc)
     ib_buildSwapchain(core, &surface);
 
     // Acquire semaphore
+    // One per possible frame in flight so the render graph pool can change its frame count without touching the surface.
     {
         VkSemaphoreCreateInfo semaphoreCreateInfo = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
-        for (uint32_t i = 0; i < ib_FramebufferCount; i++)
+        for (uint32_t i = 0; i < ib_MaxFramesInFlight; i++)
         {
             ib_vkCheck(vkCreateSemaphore(core->LogicalDevice, &semaphoreCreateInfo, ib_NoVkAllocator, &surface.Framebuffers[i].AcquireSemaphore));
         }
@@ -1682,24 +2696,107 @@ ib_Surface ib_allocWin32Surface(ib_Core* core, ib_SurfaceDesc desc)
 
 void ib_freeSurface(ib_Core* core, ib_Surface* surface)
 {
-    for (uint32_t fb = 0; fb < ib_FramebufferCount; fb++)
+    destroyFinishedSwapchains(core, surface, true);
+    for (uint32_t fb = 0; fb < ib_MaxFramesInFlight; fb++)
     {
         vkDestroySemaphore(core->LogicalDevice, surface->Framebuffers[fb].AcquireSemaphore, ib_NoVkAllocator);
+    }
+
+    for (uint32_t fb = 0; fb < surface->SwapchainTextureCount; fb++)
+    {
         vkDestroyImageView(core->LogicalDevice, surface->SwapchainTextures[fb].View, ib_NoVkAllocator);
     }
     vkDestroySwapchainKHR(core->LogicalDevice, surface->Swapchain, ib_NoVkAllocator);
     vkDestroySurfaceKHR(core->Instance, surface->VulkanSurface, ib_NoVkAllocator);
 }
 
+void ib_setSurfaceImageCount(ib_Core* core, ib_Surface* surface, uint32_t imageCount)
+{
+    surface->RequestedImageCount = ib_clamp(imageCount, 1, ib_MaxSwapchainImageCount);
+    ib_rebuildSurface(core, surface);
+}
+
+bool ib_setSurfacePresentMode(ib_Core* core, ib_Surface* surface, ib_PresentMode presentMode)
+{
+    ib_assert(presentMode < ib_PresentMode_Count);
+    if ((surface->SupportedPresentModes & (1 << presentMode)) == 0)
+    {
+        return false;
+    }
+
+    if (surface->PresentMode != ib_VkPresentModes[presentMode])
+    {
+        surface->PresentMode = ib_VkPresentModes[presentMode];
+        ib_rebuildSurface(core, surface);
+    }
+    return true;
+}
+
+// Polls the latest present, vblanks that went by beyond the presents that completed were missed.
+static void updatePresentCompletion(ib_Core* core, ib_Surface* surface)
+{
+    if (!core->PresentWaitEnabled || surface->CompletedPresentID == surface->PresentID)
+    {
+        return;
+    }
+
+    if (ib_vkWaitForPresentKHR(core->LogicalDevice, surface->Swapchain, surface->PresentID, 0) != VK_SUCCESS)
+    {
+        return;
+    }
+
+    uint64_t nowTicks = ib_cpuTicks();
+    uint64_t completedCount = surface->PresentID - surface->CompletedPresentID;
+    ib_PresentStatistics* statistics = &surface->Statistics;
+    statistics->CompletedPresentCount += completedCount;
+
+    bool isFifo = surface->PresentMode == VK_PRESENT_MODE_FIFO_KHR || surface->PresentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    if (surface->PresentCompletedTicks != 0 && isFifo)
+    {
+        double interval = ib_cpuTicksToMs(nowTicks - surface->PresentCompletedTicks) / (double)completedCount;
+
+        // Polling jitters, average the intervals that look like a single refresh.
+        if (statistics->RefreshInterval == 0.0)
+        {
+            statistics->RefreshInterval = interval;
+        }
+        else if (interval < statistics->RefreshInterval * 1.25)
+        {
+            statistics->RefreshInterval += (interval - statistics->RefreshInterval) * 0.1;
+        }
+
+        double vblankCount = (double)(uint64_t)(interval * (double)completedCount / statistics->RefreshInterval + 0.5);
+        if (vblankCount > (double)completedCount)
+        {
+            statistics->MissedVBlankCount += (uint64_t)vblankCount - completedCount;
+        }
+    }
+
+    surface->CompletedPresentID = surface->PresentID;
+    surface->PresentCompletedTicks = nowTicks;
+}
+
 ib_PrepareSurfaceResult ib_prepareSurface(ib_Core* core, ib_PrepareSurfaceDesc prepareDesc)
 {
     ib_PrepareSurfaceResult prepareResult = { 0 };
+    ib_Surface* surface = prepareDesc.Surface;
 
-    VkSemaphore acquireSemaphore = prepareDesc.Surface->Framebuffers[prepareDesc.Framebuffer].AcquireSemaphore;
+    surface->PrepareCount++;
+    destroyFinishedSwapchains(core, surface, false);
+    updatePresentCompletion(core, surface);
+
+    VkSemaphore acquireSemaphore = surface->Framebuffers[prepareDesc.Framebuffer].AcquireSemaphore;
 
     uint64_t acquireTimeout = 100000000; // 100ms
-    VkResult acquireResult = vkAcquireNextImageKHR(core->LogicalDevice, prepareDesc.Surface->Swapchain, acquireTimeout, acquireSemaphore, VK_NULL_HANDLE, &prepareResult.SwapchainTextureIndex);
-        
+    uint64_t acquireBeginTicks = ib_cpuTicks();
+    VkResult acquireResult = vkAcquireNextImageKHR(core->LogicalDevice, surface->Swapchain, acquireTimeout, acquireSemaphore, VK_NULL_HANDLE, &prepareResult.SwapchainTextureIndex);
+
+    ib_PresentStatistics* statistics = &surface->Statistics;
+    statistics->LastAcquireWaitTime = ib_cpuTicksToMs(ib_cpuTicks() - acquireBeginTicks);
+    statistics->MaxAcquireWaitTime = ib_max(statistics->MaxAcquireWaitTime, statistics->LastAcquireWaitTime);
+    statistics->TotalAcquireWaitTime += statistics->LastAcquireWaitTime;
+    statistics->AcquireCount++;
+
     if (acquireResult != VK_SUCCESS && acquireResult != VK_SUBOPTIMAL_KHR)
     {
         if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
@@ -1717,9 +2814,19 @@ ib_PrepareSurfaceResult ib_prepareSurface(ib_Core* core, ib_PrepareSurfaceDesc p
 
 ib_SurfaceState ib_presentSurface(ib_Core* core, ib_PresentSurfaceDesc presentDesc)
 {
+    ib_Surface* surface = presentDesc.Surface;
+    uint64_t presentID = surface->PresentID + 1;
+    VkPresentIdKHR presentIDInfo =
+    {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .swapchainCount = 1,
+        .pPresentIds = &presentID
+    };
+
     VkPresentInfoKHR presentInfo =
     {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+        .pNext = core->PresentWaitEnabled ? &presentIDInfo : NULL,
         .waitSemaphoreCount = presentDesc.WaitSemaphore != VK_NULL_HANDLE ? 1 : 0,
         .pWaitSemaphores = &presentDesc.WaitSemaphore,
         .swapchainCount = 1,
@@ -1728,6 +2835,12 @@ ib_SurfaceState ib_presentSurface(ib_Core* core, ib_PresentSurfaceDesc presentDe
     };
 
     VkResult presentResult = vkQueuePresentKHR(core->Queues[ib_Queue_Present].Queue, &presentInfo);
+    if (presentResult == VK_SUCCESS || presentResult == VK_SUBOPTIMAL_KHR)
+    {
+        surface->PresentID = presentID;
+        surface->Statistics.PresentCount++;
+    }
+
     if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR)
     {
         return ib_SurfaceState_ShouldRebuild;
@@ -1740,34 +2853,100 @@ ib_SurfaceState ib_presentSurface(ib_Core* core, ib_PresentSurfaceDesc presentDe
 
 void ib_rebuildSurface(ib_Core* core, ib_Surface* surface)
 {
-    vkDeviceWaitIdle(core->LogicalDevice);
     VkSurfaceCapabilitiesKHR surfaceCapabilities;
     ib_vkCheck(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(core->PhysicalDevice, surface->VulkanSurface, &surfaceCapabilities));
-    ib_assert(surfaceCapabilities.currentExtent.width != UINT32_MAX, "Surface extents are undefined.");
     
-    if (surfaceCapabilities.currentExtent.width > 0 && surfaceCapabilities.currentExtent.height > 0)
+    VkExtent3D extent = surfaceExtent(&surfaceCapabilities, surface->Extent);
+    if (extent.width > 0 && extent.height > 0)
     {
-        surface->Extent = (VkExtent3D) { surfaceCapabilities.currentExtent.width, surfaceCapabilities.currentExtent.height };
+        surface->Extent = extent;
         ib_buildSwapchain(core, surface);
+        surface->Statistics.RebuildCount++;
     }
 }
 
 // Graphics pipelines
+// Template data is one entry per descriptor, laid out binding after binding.
+typedef union
+{
+    VkDescriptorImageInfo Image;
+    VkDescriptorBufferInfo Buffer;
+    VkAccelerationStructureKHR AccelerationStructure;
+} ShaderInputTemplateEntry;
+
+static void allocShaderInputUpdateTemplate(ib_Core* core, ib_ShaderInputLayoutDesc desc, ib_ShaderInputLayout* layout)
+{
+    VkDescriptorUpdateTemplateEntry entries[ib_MaxShaderInputsPerLayout];
+    uint32_t entryCount = 0;
+    uint32_t descriptorCount = 0;
+    for (uint32_t i = 0; i < desc.Inputs.Count; i++)
+    {
+        ib_ShaderInputDesc const* input = &desc.Inputs.Data[i];
+        if (input->UseImmutableSamplers)
+        {
+            continue;
+        }
+
+        // Variable sized bindings can't be written in full, leave those to vkUpdateDescriptorSets.
+        uint32_t arraySize = input->ArraySize == 0 ? 1 : input->ArraySize;
+        if ((input->BindingFlags & VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT) != 0 || descriptorCount + arraySize > ib_MaxTemplatedDescriptorCount)
+        {
+            return;
+        }
+
+        layout->TemplateOffsets[i] = (uint16_t)descriptorCount;
+        entries[entryCount++] = (VkDescriptorUpdateTemplateEntry)
+        {
+            .dstBinding = i,
+            .dstArrayElement = 0,
+            .descriptorCount = arraySize,
+            .descriptorType = input->Type,
+            .offset = descriptorCount * sizeof(ShaderInputTemplateEntry),
+            .stride = sizeof(ShaderInputTemplateEntry)
+        };
+        descriptorCount += arraySize;
+    }
+
+    if (entryCount == 0)
+    {
+        return;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo createTemplate =
+    {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,
+        .descriptorUpdateEntryCount = entryCount,
+        .pDescriptorUpdateEntries = entries,
+        .templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,
+        .descriptorSetLayout = layout->DescriptorSetLayout
+    };
+    ib_vkCheck(vkCreateDescriptorUpdateTemplate(core->LogicalDevice, &createTemplate, ib_NoVkAllocator, &layout->UpdateTemplate));
+    layout->TemplateDescriptorCount = descriptorCount;
+}
+
 ib_ShaderInputLayout ib_allocShaderInputLayout(ib_Core* core, ib_ShaderInputLayoutDesc blockLayoutDesc)
 {
     ib_ShaderInputLayout blockLayout = { 0 };
     
     ib_assert(blockLayoutDesc.Inputs.Data == NULL || blockLayoutDesc.Inputs.Count > 0);
 
-#define maxShaderInputPerBlock 32
-    ib_assert(blockLayoutDesc.Inputs.Count < maxShaderInputPerBlock, "Too many shader inputs! Increase MaxShaderInputPerBlock.");
+    ib_assert(blockLayoutDesc.Inputs.Count < ib_MaxShaderInputsPerLayout, "Too many shader inputs! Increase ib_MaxShaderInputsPerLayout.");
+
+    ib_assert(!blockLayoutDesc.PushDescriptor || core->PushDescriptorsEnabled, "Push descriptors aren't supported, check ib_Core::PushDescriptorsEnabled.");
+    blockLayout.IsPushDescriptor = blockLayoutDesc.PushDescriptor && core->PushDescriptorsEnabled;
+
+    // Pushed descriptors are never updated after binding and have no variable count, the flags are invalid with them.
+    VkDescriptorBindingFlagsEXT const pushInvalidBindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+        | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+        | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
 
-    VkDescriptorSetLayoutBinding bindings[maxShaderInputPerBlock] = { 0 };
-    VkDescriptorBindingFlagsEXT bindFlags[maxShaderInputPerBlock] = { 0 };
-#undef maxShaderInputPerBlock
+    VkDescriptorSetLayoutBinding bindings[ib_MaxShaderInputsPerLayout] = { 0 };
+    VkDescriptorBindingFlagsEXT bindFlags[ib_MaxShaderInputsPerLayout] = { 0 };
     for (uint32_t i = 0; i < blockLayoutDesc.Inputs.Count; i++)
     {
         ib_ShaderInputDesc inputDesc = blockLayoutDesc.Inputs.Data[i];
+        ib_assert(!blockLayoutDesc.PushDescriptor || (inputDesc.BindingFlags & pushInvalidBindingFlags) == 0,
+                  "Push descriptor layouts can't use update after bind or variable descriptor counts.");
 
         bindings[i].stageFlags = inputDesc.Shaders;
         bindings[i].binding = i;
@@ -1782,7 +2961,7 @@ ib_ShaderInputLayout ib_allocShaderInputLayout(ib_Core* core, ib_ShaderInputLayo
         else
         {
             bindings[i].descriptorCount = inputDesc.ArraySize == 0 ? 1 : inputDesc.ArraySize;
-            bindFlags[i] = inputDesc.BindingFlags;
+            bindFlags[i] = blockLayout.IsPushDescriptor ? inputDesc.BindingFlags & ~pushInvalidBindingFlags : inputDesc.BindingFlags;
         }
     }
 
@@ -1797,17 +2976,27 @@ ib_ShaderInputLayout ib_allocShaderInputLayout(ib_Core* core, ib_ShaderInputLayo
     {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
         .pNext = &extendedInfo,
+        .flags = blockLayout.IsPushDescriptor ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0,
         .bindingCount = blockLayoutDesc.Inputs.Count,
         .pBindings = bindings,
     };
     ib_vkCheck(vkCreateDescriptorSetLayout(core->LogicalDevice, &createLayout, ib_NoVkAllocator, &blockLayout.DescriptorSetLayout));
+
+    if (!blockLayout.IsPushDescriptor)
+    {
+        allocShaderInputUpdateTemplate(core, blockLayoutDesc, &blockLayout);
+    }
     
     return blockLayout;
 }
 
 void ib_freeShaderInputLayout(ib_Core* core, ib_ShaderInputLayout* layout)
 {
-    vkDestroyDescriptorSetLayout(core->LogicalDevice, layout->DescriptorSetLayout, ib_NoVkAllocator);
+    if (layout->UpdateTemplate != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorUpdateTemplate(core->LogicalDevice, layout->UpdateTemplate, ib_NoVkAllocator);
+    }
+    vkDestroyDescriptorSetLayout(core->LogicalDevice, layout->DescriptorSetLayout, ib_NoVkAllocator);
 }
 
 ib_ShaderInput ib_allocShaderInput(ib_Core* core, ib_AllocShaderInputDesc allocDesc)
@@ -1815,6 +3004,7 @@ ib_ShaderInput ib_allocShaderInput(ib_Core* core, ib_AllocShaderInputDesc allocD
     ib_ShaderInput block = { 0 };
 
     ib_assert(allocDesc.Layout != NULL);
+    ib_assert(!allocDesc.Layout->IsPushDescriptor, "Push descriptor layouts can't be allocated, use ib_pushShaderInputs.");
 
     VkDescriptorPool pool = allocDesc.Pool != VK_NULL_HANDLE ? allocDesc.Pool : core->Descriptors.Pool;
     VkDescriptorSetAllocateInfo descriptorSetAlloc =
@@ -1832,7 +3022,8 @@ ib_ShaderInput ib_allocShaderInput(ib_Core* core, ib_AllocShaderInputDesc allocD
         ib_writeToShaderInput(core, (ib_WriteToShaderInputDesc)
                               {
                                   &block,
-                                  { allocDesc.Inputs.Data, allocDesc.Inputs.Count }
+                                  { allocDesc.Inputs.Data, allocDesc.Inputs.Count },
+                                  allocDesc.Layout
                               });
     }
 
@@ -1883,90 +3074,317 @@ static uint32_t getShaderInputType(ib_ShaderInputWrite const* input)
     return shaderInputType;
 }
 
-void ib_writeToShaderInput(ib_Core* core, ib_WriteToShaderInputDesc desc)
+static VkDescriptorBufferInfo toDescriptorBufferInfo(ib_ShaderInputWrite const* input)
 {
-#define maxWritesPerCall 32
-    ib_assert(desc.Inputs.Data == NULL || desc.Inputs.Count > 0);
+    return (VkDescriptorBufferInfo)
+    {
+        .buffer = input->BufferInput.Buffer->VulkanBuffer,
+        .offset = input->BufferInput.Offset,
+        .range = input->BufferInput.Size != 0 ? input->BufferInput.Size : VK_WHOLE_SIZE
+    };
+}
 
-    ib_assert(desc.Inputs.Count < maxWritesPerCall, "Too many writes. Update this function to be more resilient.");
-    VkWriteDescriptorSet writes[maxWritesPerCall] = { 0 };
+static VkDescriptorImageInfo toDescriptorImageInfo(ib_ShaderInputWrite const* input, uint32_t type)
+{
+    if (type == ib_ShaderInputWriteType_Sampler)
+    {
+        ib_assert(!input->Desc->UseImmutableSamplers);
+        return (VkDescriptorImageInfo) { .sampler = input->SamplerInput };
+    }
 
-    uint32_t bufferWriteCount = 0;
-    VkDescriptorBufferInfo bufferWrites[maxWritesPerCall] = { 0 };
+    return (VkDescriptorImageInfo)
+    {
+        // Allow users to feed a custom image view
+        .imageView = input->TextureInput.View != VK_NULL_HANDLE ? input->TextureInput.View : input->TextureInput.Texture->View,
+        .imageLayout = input->TextureInput.Layout
+    };
+}
 
-    uint32_t imageWriteCount = 0;
-    VkDescriptorImageInfo imageWrites[maxWritesPerCall];
+// Scratch for the descriptor infos VkWriteDescriptorSet points into.
+#define maxWritesPerCall 32
+#define maxDescriptorsPerCall 256
+typedef struct
+{
+    VkWriteDescriptorSet Writes[maxWritesPerCall];
+    VkDescriptorBufferInfo BufferWrites[maxDescriptorsPerCall];
+    VkDescriptorImageInfo ImageWrites[maxDescriptorsPerCall];
+    VkAccelerationStructureKHR AccelerationStructures[maxDescriptorsPerCall];
+    VkWriteDescriptorSetAccelerationStructureKHR AccelerationStructureWrites[maxWritesPerCall];
+    uint32_t WriteCount;
+} ShaderInputWrites;
+
+// Consecutive inputs targeting consecutive elements of the same binding are merged into one write.
+// Returns how many inputs were consumed, call again with the remainder once the scratch is flushed.
+static uint32_t buildShaderInputWrites(VkDescriptorSet descriptorSet, ib_ShaderInputWrite const* inputs, uint32_t inputCount, ShaderInputWrites* outWrites)
+{
+    ib_assert(inputs == NULL || inputCount > 0);
 
+    uint32_t bufferWriteCount = 0;
+    uint32_t imageWriteCount = 0;
+    uint32_t accelerationStructureCount = 0;
     uint32_t accelerationStructureWriteCount = 0;
-    VkWriteDescriptorSetAccelerationStructureKHR accelerationStructureWrites[maxWritesPerCall] = { 0 };
-#undef maxWritesPerCall
+    outWrites->WriteCount = 0;
 
-    for (uint32_t i = 0; i < desc.Inputs.Count; i++)
+    uint32_t previousType = ib_ShaderInputWriteType_None;
+    uint32_t i = 0;
+    for (; i < inputCount; i++)
     {
-        writes[i] = (VkWriteDescriptorSet)
+        if (bufferWriteCount == maxDescriptorsPerCall || imageWriteCount == maxDescriptorsPerCall || accelerationStructureCount == maxDescriptorsPerCall)
         {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .dstSet = desc.ShaderInput->DescriptorSet,
-            .descriptorType = desc.Inputs.Data[i].Desc->Type,
-            .dstBinding = desc.Inputs.Data[i].Desc->Index,
-            .descriptorCount = 1, // TODO: Support multiple array writes
-            .dstArrayElement = desc.Inputs.Data[i].ArrayIndex
-        };
+            break;
+        }
 
-        uint32_t type = getShaderInputType(&desc.Inputs.Data[i]);
-        if (type == ib_ShaderInputWriteType_Buffer)
+        uint32_t type = getShaderInputType(&inputs[i]);
+
+        VkWriteDescriptorSet* previousWrite = outWrites->WriteCount > 0 ? &outWrites->Writes[outWrites->WriteCount - 1] : NULL;
+        bool extendsPreviousWrite = previousWrite != NULL
+            && type == previousType
+            && inputs[i].Desc == inputs[i - 1].Desc
+            && inputs[i].ArrayIndex == previousWrite->dstArrayElement + previousWrite->descriptorCount;
+
+        if (!extendsPreviousWrite)
         {
-            VkDeviceSize bufferOffset = desc.Inputs.Data[i].BufferInput.Offset;
-            VkDeviceSize bufferRange = desc.Inputs.Data[i].BufferInput.Size != 0 ? desc.Inputs.Data[i].BufferInput.Size : VK_WHOLE_SIZE;
+            if (outWrites->WriteCount == maxWritesPerCall)
+            {
+                break;
+            }
 
-            bufferWrites[bufferWriteCount] = (VkDescriptorBufferInfo)
+            outWrites->Writes[outWrites->WriteCount++] = (VkWriteDescriptorSet)
             {
-                .buffer = desc.Inputs.Data[i].BufferInput.Buffer->VulkanBuffer,
-                .offset = bufferOffset,
-                .range = bufferRange
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = descriptorSet,
+                .descriptorType = inputs[i].Desc->Type,
+                .dstBinding = inputs[i].Desc->Index,
+                .descriptorCount = 0,
+                .dstArrayElement = inputs[i].ArrayIndex
             };
-            writes[i].pBufferInfo = &bufferWrites[bufferWriteCount];
-            bufferWriteCount++;
         }
-        else if (type == ib_ShaderInputWriteType_Texture)
+
+        // Infos of a merged write stay contiguous since each type appends to its own array.
+        VkWriteDescriptorSet* write = &outWrites->Writes[outWrites->WriteCount - 1];
+        if (type == ib_ShaderInputWriteType_Buffer)
         {
-            imageWrites[imageWriteCount] = (VkDescriptorImageInfo)
+            outWrites->BufferWrites[bufferWriteCount] = toDescriptorBufferInfo(&inputs[i]);
+            if (!extendsPreviousWrite)
             {
-                // Allow users to feed a custom image view
-                .imageView = desc.Inputs.Data[i].TextureInput.View != VK_NULL_HANDLE ? desc.Inputs.Data[i].TextureInput.View : desc.Inputs.Data[i].TextureInput.Texture->View,
-                .imageLayout = desc.Inputs.Data[i].TextureInput.Layout
-            };
-            writes[i].pImageInfo = &imageWrites[imageWriteCount];
-            imageWriteCount++;
+                write->pBufferInfo = &outWrites->BufferWrites[bufferWriteCount];
+            }
+            bufferWriteCount++;
         }
-        else if (type == ib_ShaderInputWriteType_Sampler)
+        else if (type == ib_ShaderInputWriteType_Texture || type == ib_ShaderInputWriteType_Sampler)
         {
-            ib_assert(!desc.Inputs.Data[i].Desc->UseImmutableSamplers);
-            imageWrites[imageWriteCount] = (VkDescriptorImageInfo)
+            outWrites->ImageWrites[imageWriteCount] = toDescriptorImageInfo(&inputs[i], type);
+            if (!extendsPreviousWrite)
             {
-                .sampler = desc.Inputs.Data[i].SamplerInput,
-            };
-            writes[i].pImageInfo = &imageWrites[imageWriteCount];
+                write->pImageInfo = &outWrites->ImageWrites[imageWriteCount];
+            }
             imageWriteCount++;
         }
         else if (type == ib_ShaderInputWriteType_AccelerationStructure)
         {
-            accelerationStructureWrites[accelerationStructureWriteCount] = (VkWriteDescriptorSetAccelerationStructureKHR)
+            outWrites->AccelerationStructures[accelerationStructureCount] = inputs[i].AccelerationStructureInput;
+            if (!extendsPreviousWrite)
             {
-                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR,
-                .accelerationStructureCount = 1,
-                .pAccelerationStructures = &desc.Inputs.Data[i].AccelerationStructureInput,
-            };
-            writes[i].pNext = &accelerationStructureWrites[accelerationStructureWriteCount];
-            accelerationStructureWriteCount++;
+                outWrites->AccelerationStructureWrites[accelerationStructureWriteCount] = (VkWriteDescriptorSetAccelerationStructureKHR)
+                {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR,
+                    .pAccelerationStructures = &outWrites->AccelerationStructures[accelerationStructureCount],
+                };
+                write->pNext = &outWrites->AccelerationStructureWrites[accelerationStructureWriteCount];
+                accelerationStructureWriteCount++;
+            }
+            outWrites->AccelerationStructureWrites[accelerationStructureWriteCount - 1].accelerationStructureCount++;
+            accelerationStructureCount++;
         }
         else
         {
             ib_assert(false, "Unsupported shader write type.");
         }
+
+        write->descriptorCount++;
+        previousType = type;
+    }
+
+    return i;
+}
+#undef maxDescriptorsPerCall
+#undef maxWritesPerCall
+
+// The template writes every descriptor it covers, it's only usable when the inputs fill the whole set.
+static bool writeToShaderInputWithTemplate(ib_Core* core, ib_ShaderInputLayout const* layout, VkDescriptorSet descriptorSet, ib_ShaderInputWrite const* inputs, uint32_t inputCount)
+{
+    if (layout == NULL || layout->UpdateTemplate == VK_NULL_HANDLE || inputCount != layout->TemplateDescriptorCount)
+    {
+        return false;
+    }
+
+    ShaderInputTemplateEntry data[ib_MaxTemplatedDescriptorCount];
+    uint32_t written[ib_MaxTemplatedDescriptorCount / 32] = { 0 };
+    for (uint32_t i = 0; i < inputCount; i++)
+    {
+        ib_assert(inputs[i].Desc->Index < ib_MaxShaderInputsPerLayout);
+        uint32_t entry = layout->TemplateOffsets[inputs[i].Desc->Index] + inputs[i].ArrayIndex;
+        ib_assert(entry < layout->TemplateDescriptorCount);
+
+        uint32_t mask = 1u << (entry % 32);
+        if ((written[entry / 32] & mask) != 0)
+        {
+            return false; // Written twice, something else got skipped.
+        }
+        written[entry / 32] |= mask;
+
+        uint32_t type = getShaderInputType(&inputs[i]);
+        if (type == ib_ShaderInputWriteType_Buffer)
+        {
+            data[entry].Buffer = toDescriptorBufferInfo(&inputs[i]);
+        }
+        else if (type == ib_ShaderInputWriteType_AccelerationStructure)
+        {
+            data[entry].AccelerationStructure = inputs[i].AccelerationStructureInput;
+        }
+        else
+        {
+            data[entry].Image = toDescriptorImageInfo(&inputs[i], type);
+        }
+    }
+
+    vkUpdateDescriptorSetWithTemplate(core->LogicalDevice, descriptorSet, layout->UpdateTemplate, data);
+    return true;
+}
+
+void ib_writeToShaderInput(ib_Core* core, ib_WriteToShaderInputDesc desc)
+{
+    if (writeToShaderInputWithTemplate(core, desc.Layout, desc.ShaderInput->DescriptorSet, desc.Inputs.Data, desc.Inputs.Count))
+    {
+        return;
+    }
+
+    ShaderInputWrites writes;
+    for (uint32_t i = 0; i < desc.Inputs.Count;)
+    {
+        i += buildShaderInputWrites(desc.ShaderInput->DescriptorSet, desc.Inputs.Data + i, desc.Inputs.Count - i, &writes);
+        vkUpdateDescriptorSets(core->LogicalDevice, writes.WriteCount, writes.Writes, 0, NULL);
+    }
+}
+
+void ib_pushShaderInputs(ib_Core* core, VkCommandBuffer commandBuffer, ib_PushShaderInputsDesc desc)
+{
+    ib_assert(core->PushDescriptorsEnabled);
+    ib_potentiallyUnused(core);
+
+    ShaderInputWrites writes;
+    uint32_t consumed = buildShaderInputWrites(VK_NULL_HANDLE, desc.Inputs.Data, desc.Inputs.Count, &writes);
+    ib_assert(consumed == desc.Inputs.Count, "Too many inputs to push in one go.");
+    ib_potentiallyUnused(consumed);
+    ib_vkCmdPushDescriptorSetKHR(commandBuffer, desc.BindPoint, desc.PipelineLayout, desc.SetIndex, writes.WriteCount, writes.Writes);
+}
+
+static VkPipelineCreateFlags pipelineCaptureFlags(ib_Core* core)
+{
+    return core->ShaderStatisticsEnabled ? VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR | VK_PIPELINE_CREATE_CAPTURE_INTERNAL_REPRESENTATIONS_BIT_KHR : 0;
+}
+
+// Map entries read the values straight out of the constant array, no need to repack them.
+static VkSpecializationInfo const* fillSpecializationInfo(ib_ShaderDesc const* shaderDesc, VkSpecializationInfo* outInfo, VkSpecializationMapEntry* outEntries)
+{
+    if (shaderDesc->Constants.Count == 0)
+    {
+        return NULL;
+    }
+
+    ib_assert(shaderDesc->Constants.Count <= ib_MaxSpecializationConstantCount);
+    for (uint32_t i = 0; i < shaderDesc->Constants.Count; i++)
+    {
+        outEntries[i] = (VkSpecializationMapEntry)
+        {
+            .constantID = shaderDesc->Constants.Data[i].Id,
+            .offset = (uint32_t)(i * sizeof(ib_SpecializationConstant) + offsetof(ib_SpecializationConstant, Value)),
+            .size = sizeof(uint32_t)
+        };
+    }
+
+    *outInfo = (VkSpecializationInfo)
+    {
+        .mapEntryCount = shaderDesc->Constants.Count,
+        .pMapEntries = outEntries,
+        .dataSize = shaderDesc->Constants.Count * sizeof(ib_SpecializationConstant),
+        .pData = shaderDesc->Constants.Data
+    };
+    return outInfo;
+}
+
+// Shader modules
+
+static VkShaderModule acquireShaderModule(ib_Core* core, ib_ShaderDesc const* shaderDesc)
+{
+    uint64_t hash = hashBytes(shaderDesc->Code, shaderDesc->CodeSize);
+
+    ib_ShaderModuleCache* cache = &core->ShaderModules;
+    ib_lockMutex(&cache->Lock);
+    cache->AcquiredCount++;
+
+    VkShaderModule module = VK_NULL_HANDLE;
+    for (uint32_t i = 0; i < cache->Count; i++)
+    {
+        ib_ShaderModuleEntry* entry = &cache->Entries[i];
+        if (entry->Hash == hash && entry->CodeSize == shaderDesc->CodeSize && memcmp(entry->Code, shaderDesc->Code, shaderDesc->CodeSize) == 0)
+        {
+            entry->RefCount++;
+            module = entry->Module;
+            break;
+        }
+    }
+
+    if (module == VK_NULL_HANDLE)
+    {
+        VkShaderModuleCreateInfo createShader =
+        {
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .pCode = (const uint32_t *)shaderDesc->Code,
+            .codeSize = shaderDesc->CodeSize
+        };
+        ib_vkCheck(vkCreateShaderModule(core->LogicalDevice, &createShader, ib_NoVkAllocator, &module));
+        cache->CreatedCount++;
+
+        if (cache->Count == cache->Capacity)
+        {
+            cache->Capacity = cache->Capacity == 0 ? 64 : cache->Capacity * 2;
+            cache->Entries = (ib_ShaderModuleEntry*)realloc(cache->Entries, sizeof(ib_ShaderModuleEntry) * cache->Capacity);
+            ib_assert(cache->Entries != NULL);
+        }
+        void* code = malloc(shaderDesc->CodeSize);
+        ib_assert(code != NULL);
+        memcpy(code, shaderDesc->Code, shaderDesc->CodeSize);
+        cache->Entries[cache->Count++] = (ib_ShaderModuleEntry) { .Hash = hash, .CodeSize = shaderDesc->CodeSize, .Code = code, .Module = module, .RefCount = 1 };
+    }
+
+    ib_unlockMutex(&cache->Lock);
+    return module;
+}
+
+static void releaseShaderModule(ib_Core* core, VkShaderModule module)
+{
+    if (module == VK_NULL_HANDLE)
+    {
+        return;
     }
 
-    vkUpdateDescriptorSets(core->LogicalDevice, desc.Inputs.Count, writes, 0, NULL);
+    ib_ShaderModuleCache* cache = &core->ShaderModules;
+    ib_lockMutex(&cache->Lock);
+    for (uint32_t i = 0; i < cache->Count; i++)
+    {
+        if (cache->Entries[i].Module == module)
+        {
+            if (--cache->Entries[i].RefCount == 0)
+            {
+                vkDestroyShaderModule(core->LogicalDevice, module, ib_NoVkAllocator);
+                free(cache->Entries[i].Code);
+                cache->Entries[i] = cache->Entries[--cache->Count];
+            }
+            break;
+        }
+    }
+    ib_unlockMutex(&cache->Lock);
 }
 
 ib_GraphicsPipeline ib_allocGraphicsPipeline(ib_Core* core, ib_GraphicsPipelineDesc desc)
@@ -2020,43 +3438,90 @@ ib_GraphicsPipeline ib_allocGraphicsPipeline(ib_Core* core, ib_GraphicsPipelineD
     VkGraphicsPipelineCreateInfo graphicsPipelineCreate =
     {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT
-#ifdef IB_DEBUG
-            | VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR | VK_PIPELINE_CREATE_CAPTURE_INTERNAL_REPRESENTATIONS_BIT_KHR,
-#endif // IB_DEBUG
+        .flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT | pipelineCaptureFlags(core)
     };
 
-    // Shaders
-#define maxShaderCount 32
-    ib_assert(desc.ShaderDescs.Data == NULL || desc.ShaderDescs.Count > 0);
+    // Pipeline libraries
+    VkGraphicsPipelineLibraryFlagsEXT const allLibraryParts = VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT
+        | VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT
+        | VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT
+        | VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+
+    VkGraphicsPipelineLibraryFlagsEXT linkedParts = 0;
+    VkPipeline libraries[ib_GraphicsPipelineLibraryPartCount];
+    ib_assert(desc.Libraries.Count <= ib_GraphicsPipelineLibraryPartCount);
+    for (uint32_t i = 0; i < desc.Libraries.Count; i++)
+    {
+        ib_assert(desc.Libraries.Data[i]->LibraryParts != 0, "Only pipelines built with LibraryParts can be linked.");
+        ib_assert((linkedParts & desc.Libraries.Data[i]->LibraryParts) == 0, "Libraries overlap.");
+        linkedParts |= desc.Libraries.Data[i]->LibraryParts;
+        libraries[i] = desc.Libraries.Data[i]->VulkanPipeline;
+    }
+
+    // Parts this desc has to provide itself, 0 for a regular monolithic pipeline.
+    VkGraphicsPipelineLibraryFlagsEXT ownParts = desc.LibraryParts;
+    if (ownParts == 0 && desc.Libraries.Count > 0)
+    {
+        ownParts = allLibraryParts & ~linkedParts;
+    }
+    bool const usesLibraries = ownParts != 0 || desc.Libraries.Count > 0;
+    ib_assert(!usesLibraries || core->GraphicsPipelineLibraryEnabled, "Pipeline libraries aren't supported, check ib_Core::GraphicsPipelineLibraryEnabled.");
+
+    graphicsPipeline.LibraryParts = desc.LibraryParts;
+    if (desc.LibraryParts != 0)
+    {
+        graphicsPipelineCreate.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+    }
+    else if (desc.Libraries.Count > 0 && desc.LinkTimeOptimization)
+    {
+        graphicsPipelineCreate.flags |= VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+    }
+
+    VkPipelineLibraryCreateInfoKHR libraryCreate =
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+        .libraryCount = desc.Libraries.Count,
+        .pLibraries = libraries
+    };
 
-    ib_assert(desc.ShaderDescs.Count < maxShaderCount, "Too many shader blocks! Increase maxShaderCount or refactor.");
+    VkGraphicsPipelineLibraryCreateInfoEXT graphicsLibraryCreate =
+    {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+        .pNext = desc.Libraries.Count > 0 ? &libraryCreate : NULL,
+        .flags = ownParts
+    };
 
-    VkShaderModule shaderModules[maxShaderCount] = { 0 };
-    VkPipelineShaderStageCreateInfo shaderStages[maxShaderCount] = { 0 };
-#undef maxShaderCount
+    // Shaders
+    ib_assert(desc.ShaderDescs.Data == NULL || desc.ShaderDescs.Count > 0);
+    ib_assert(desc.ShaderDescs.Count <= ib_MaxShaderStagesPerPipeline, "Too many shader blocks! Increase ib_MaxShaderStagesPerPipeline or refactor.");
 
+    VkPipelineShaderStageCreateInfo shaderStages[ib_MaxShaderStagesPerPipeline] = { 0 };
+    VkSpecializationInfo specializations[ib_MaxShaderStagesPerPipeline];
+    VkSpecializationMapEntry specializationEntries[ib_MaxShaderStagesPerPipeline][ib_MaxSpecializationConstantCount];
     {
         for (uint32_t i = 0; i < desc.ShaderDescs.Count; i++)
         {
-            VkShaderModuleCreateInfo createShader =
+            // Libraries only take the stages of their own parts, the rest come from the linked libraries.
+            bool const isFragmentStage = desc.ShaderDescs.Data[i].Stage == VK_SHADER_STAGE_FRAGMENT_BIT;
+            VkGraphicsPipelineLibraryFlagsEXT const stagePart = isFragmentStage ? VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT : VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+            if (usesLibraries && (ownParts & stagePart) == 0)
             {
-                .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-                .pCode = (const uint32_t *)desc.ShaderDescs.Data[i].Code,
-                .codeSize = desc.ShaderDescs.Data[i].CodeSize
-            };
-            ib_vkCheck(vkCreateShaderModule(core->LogicalDevice, &createShader, ib_NoVkAllocator, &shaderModules[i]));
+                continue;
+            }
 
-            shaderStages[i] = (VkPipelineShaderStageCreateInfo)
+            uint32_t stageIndex = graphicsPipeline.ShaderModuleCount++;
+            graphicsPipeline.ShaderModules[stageIndex] = acquireShaderModule(core, &desc.ShaderDescs.Data[i]);
+            shaderStages[stageIndex] = (VkPipelineShaderStageCreateInfo)
             {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
                 .pName = desc.ShaderDescs.Data[i].EntryPoint,
-                .module = shaderModules[i],
-                .stage = desc.ShaderDescs.Data[i].Stage
+                .module = graphicsPipeline.ShaderModules[stageIndex],
+                .stage = desc.ShaderDescs.Data[i].Stage,
+                .pSpecializationInfo = fillSpecializationInfo(&desc.ShaderDescs.Data[i], &specializations[stageIndex], specializationEntries[stageIndex])
             };
         }
 
-        graphicsPipelineCreate.stageCount = desc.ShaderDescs.Count;
+        graphicsPipelineCreate.stageCount = graphicsPipeline.ShaderModuleCount;
         graphicsPipelineCreate.pStages = shaderStages;
     }
             
@@ -2091,11 +3556,22 @@ ib_GraphicsPipeline ib_allocGraphicsPipeline(ib_Core* core, ib_GraphicsPipelineD
     VkPipelineRenderingCreateInfoKHR pipelineRenderingCreateInfo =
     {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+        .pNext = NULL,
         .colorAttachmentCount = desc.RenderTargetDescs.Count,
         .pColorAttachmentFormats = colorFormats,
         .depthAttachmentFormat = desc.DepthDesc.Format
     };
 
+    // A pure link of libraries provides no parts itself, and the library info requires non zero flags.
+    if (ownParts != 0)
+    {
+        pipelineRenderingCreateInfo.pNext = &graphicsLibraryCreate;
+    }
+    else if (desc.Libraries.Count > 0)
+    {
+        pipelineRenderingCreateInfo.pNext = &libraryCreate;
+    }
+
     graphicsPipelineCreate.pNext = &pipelineRenderingCreateInfo;
     graphicsPipelineCreate.pDepthStencilState = &desc.DepthDesc.DepthState;
 
@@ -2128,11 +3604,15 @@ ib_GraphicsPipeline ib_allocGraphicsPipeline(ib_Core* core, ib_GraphicsPipelineD
     graphicsPipelineCreate.pDynamicState = &dynamicStateCreate;
     graphicsPipelineCreate.pViewportState = &viewportStateCreate;
 
+    uint64_t compileBeginTicks = ib_cpuTicks();
     ib_vkCheck(vkCreateGraphicsPipelines(core->LogicalDevice, core->PipelineCache, 1, &graphicsPipelineCreate, ib_NoVkAllocator, &graphicsPipeline.VulkanPipeline));
-
-    for (uint32_t i = 0; i < desc.ShaderDescs.Count; i++)
+    if (desc.LibraryParts == 0 && desc.Libraries.Count > 0)
+    {
+        recordPipelineLink(core, compileBeginTicks);
+    }
+    else
     {
-        vkDestroyShaderModule(core->LogicalDevice, shaderModules[i], ib_NoVkAllocator);
+        recordPipelineCompile(core, compileBeginTicks);
     }
 
     return graphicsPipeline;
@@ -2141,6 +3621,10 @@ ib_GraphicsPipeline ib_allocGraphicsPipeline(ib_Core* core, ib_GraphicsPipelineD
 void ib_freeGraphicsPipeline(ib_Core* core, ib_GraphicsPipeline* pipeline)
 {
     vkDestroyPipeline(core->LogicalDevice, pipeline->VulkanPipeline, ib_NoVkAllocator);
+    for (uint32_t i = 0; i < pipeline->ShaderModuleCount; i++)
+    {
+        releaseShaderModule(core, pipeline->ShaderModules[i]);
+    }
     vkDestroyPipelineLayout(core->LogicalDevice, pipeline->Layout, ib_NoVkAllocator);
     for (uint32_t i = 0; i < ib_MaxShaderInputLayoutPerPipeline; i++)
     {
@@ -2149,7 +3633,7 @@ void ib_freeGraphicsPipeline(ib_Core* core, ib_GraphicsPipeline* pipeline)
     *pipeline = (ib_GraphicsPipeline) { 0 };
 }
 
-ib_ComputePipeline ib_allocComputePipeline(ib_Core* core, ib_ComputePipelineDesc desc)
+static ib_ComputePipeline createComputePipeline(ib_Core* core, ib_ComputePipelineDesc desc)
 {
     ib_ComputePipeline computePipeline = { 0 };
 
@@ -2200,30 +3684,21 @@ ib_ComputePipeline ib_allocComputePipeline(ib_Core* core, ib_ComputePipelineDesc
     VkComputePipelineCreateInfo computePipelineCreate =
     {
         .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-        .flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT
-#ifdef IB_DEBUG
-            | VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR | VK_PIPELINE_CREATE_CAPTURE_INTERNAL_REPRESENTATIONS_BIT_KHR,
-#endif // IB_DEBUG
+        .flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT | pipelineCaptureFlags(core)
     };
 
     // Shaders
-    VkShaderModule shaderModule = { 0 };
     VkPipelineShaderStageCreateInfo shaderStage = { 0 };
-
+    VkSpecializationInfo specialization;
+    VkSpecializationMapEntry specializationEntries[ib_MaxSpecializationConstantCount];
+    VkPipelineShaderStageRequiredSubgroupSizeCreateInfo requiredWaveSize =
     {
-        VkShaderModuleCreateInfo createShader =
-        {
-            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-            .pCode = (const uint32_t *)desc.ShaderDesc.Code,
-            .codeSize = desc.ShaderDesc.CodeSize
-        };
-        ib_vkCheck(vkCreateShaderModule(core->LogicalDevice, &createShader, ib_NoVkAllocator, &shaderModule));
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO,
+        .requiredSubgroupSize = desc.ShaderDesc.RequiredWaveSize
+    };
 
-        VkPipelineShaderStageRequiredSubgroupSizeCreateInfo requiredWaveSize =
-        {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO,
-            .requiredSubgroupSize = desc.ShaderDesc.RequiredWaveSize
-        };
+    {
+        computePipeline.ShaderModule = acquireShaderModule(core, &desc.ShaderDesc);
 
         shaderStage = (VkPipelineShaderStageCreateInfo)
         {
@@ -2231,528 +3706,3134 @@ ib_ComputePipeline ib_allocComputePipeline(ib_Core* core, ib_ComputePipelineDesc
             .pNext = desc.ShaderDesc.RequiredWaveSize > 0 ? &requiredWaveSize : NULL,
             .flags = desc.ShaderDesc.RequiredWaveSize == 0 ? VK_PIPELINE_SHADER_STAGE_CREATE_ALLOW_VARYING_SUBGROUP_SIZE_BIT : 0,
             .pName = desc.ShaderDesc.EntryPoint,
-            .module = shaderModule,
-            .stage = desc.ShaderDesc.Stage
+            .module = computePipeline.ShaderModule,
+            .stage = desc.ShaderDesc.Stage,
+            .pSpecializationInfo = fillSpecializationInfo(&desc.ShaderDesc, &specialization, specializationEntries)
         };
 
         computePipelineCreate.stage = shaderStage;
     }
             
     computePipelineCreate.layout = computePipeline.Layout;
+    uint64_t compileBeginTicks = ib_cpuTicks();
     ib_vkCheck(vkCreateComputePipelines(core->LogicalDevice, core->PipelineCache, 1, &computePipelineCreate, ib_NoVkAllocator, &computePipeline.VulkanPipeline));
-
-    vkDestroyShaderModule(core->LogicalDevice, shaderModule, ib_NoVkAllocator);
+    recordPipelineCompile(core, compileBeginTicks);
 
     return computePipeline;
 }
 
-void ib_freeComputePipeline(ib_Core* core, ib_ComputePipeline* pipeline)
+// Compute tunings
+
+static uint64_t kernelHash(ib_ShaderDesc const* shaderDesc)
 {
-    vkDestroyPipeline(core->LogicalDevice, pipeline->VulkanPipeline, ib_NoVkAllocator);
-    vkDestroyPipelineLayout(core->LogicalDevice, pipeline->Layout, ib_NoVkAllocator);
-    for (uint32_t i = 0; i < ib_MaxShaderInputLayoutPerPipeline; i++)
+    uint64_t hash = hashBytes(shaderDesc->Code, shaderDesc->CodeSize);
+    return hash ^ (hashBytes(shaderDesc->EntryPoint, strlen(shaderDesc->EntryPoint)) * 0x100000001b3ull);
+}
+
+// The tuned workgroup size replaces constants with the same ids, the rest of the shader's constants are kept.
+static void applyComputeTuning(ib_ComputeTuning const* tuning, ib_ShaderDesc* shaderDesc, ib_SpecializationConstant* outConstants)
+{
+    shaderDesc->RequiredWaveSize = tuning->RequiredWaveSize;
+    if (tuning->WorkgroupSize.width == 0)
     {
-        ib_freeShaderInputLayout(core, &pipeline->InlineShaderInputLayouts[i]);
+        return;
     }
-    *pipeline = (ib_ComputePipeline) { 0 };
+
+    uint32_t const sizes[3] = { tuning->WorkgroupSize.width, tuning->WorkgroupSize.height, tuning->WorkgroupSize.depth };
+    uint32_t constantCount = 0;
+    for (uint32_t i = 0; i < shaderDesc->Constants.Count; i++)
+    {
+        ib_SpecializationConstant constant = shaderDesc->Constants.Data[i];
+        if (constant.Id != tuning->WorkgroupSizeIds[0] && constant.Id != tuning->WorkgroupSizeIds[1] && constant.Id != tuning->WorkgroupSizeIds[2])
+        {
+            outConstants[constantCount++] = constant;
+        }
+    }
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        outConstants[constantCount++] = (ib_SpecializationConstant) { tuning->WorkgroupSizeIds[i], sizes[i] };
+    }
+    ib_assert(constantCount <= ib_MaxSpecializationConstantCount);
+    shaderDesc->Constants = (ib_SpecializationConstantRange) { outConstants, constantCount };
 }
 
-// utility
+bool ib_getComputeTuning(ib_Core* core, ib_ShaderDesc const* shaderDesc, ib_ComputeTuning* outTuning)
+{
+    uint64_t hash = kernelHash(shaderDesc);
 
-void ib_printComputePipelineStatistics(ib_Core* core, ib_ComputePipeline const* pipeline)
+    bool found = false;
+    ib_lockMutex(&core->ComputeTunings.Lock);
+    for (uint32_t i = 0; i < core->ComputeTunings.Count; i++)
+    {
+        if (core->ComputeTunings.Entries[i].KernelHash == hash)
+        {
+            *outTuning = core->ComputeTunings.Entries[i].Tuning;
+            found = true;
+            break;
+        }
+    }
+    ib_unlockMutex(&core->ComputeTunings.Lock);
+    return found;
+}
+
+static void storeComputeTuning(ib_Core* core, uint64_t hash, ib_ComputeTuning const* tuning)
 {
-#define maxStatCount 128
+    ib_ComputeTuningTable* table = &core->ComputeTunings;
+    ib_lockMutex(&table->Lock);
 
-    uint32_t statCount = 0;
-    VkPipelineExecutableStatisticKHR stats[maxStatCount] = { 0 };
-    for (uint32_t i = 0; i < ib_arrayCount(stats); i++)
+    uint32_t index = 0;
+    for (; index < table->Count; index++)
     {
-        stats[i].sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR;
+        if (table->Entries[index].KernelHash == hash)
+        {
+            break;
+        }
     }
 
-    VkPipelineExecutableInfoKHR executableInfo =
+    if (index == table->Count)
     {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR,
-        .pipeline = pipeline->VulkanPipeline,
-        .executableIndex = 0
-    };
+        if (table->Count == table->Capacity)
+        {
+            table->Capacity = table->Capacity == 0 ? 16 : table->Capacity * 2;
+            table->Entries = (ib_ComputeTuningEntry*)realloc(table->Entries, sizeof(ib_ComputeTuningEntry) * table->Capacity);
+        }
+        table->Count++;
+    }
+    table->Entries[index] = (ib_ComputeTuningEntry) { .KernelHash = hash, .Tuning = *tuning };
+
+    ib_unlockMutex(&table->Lock);
+}
+
+bool ib_saveComputeTunings(ib_Core* core)
+{
+    ib_ComputeTuningTable* table = &core->ComputeTunings;
+    if (table->Path[0] == '\0')
+    {
+        return true;
+    }
 
-    ib_vkCheck(vkGetPipelineExecutableStatisticsKHR(core->LogicalDevice, &executableInfo, &statCount, NULL));
-    statCount = ib_min(statCount, maxStatCount);
+    char tempPath[ib_MaxPathLength];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", table->Path);
 
-    ib_vkCheck(vkGetPipelineExecutableStatisticsKHR(core->LogicalDevice, &executableInfo, &statCount, stats));
+    ib_lockMutex(&table->Lock);
+    ib_ComputeTuningFileHeader header = computeTuningHeaderForDevice(core);
+    header.EntryCount = table->Count;
 
-    printf("Compute Pipeline\n");
-    for (uint32_t i = 0; i < statCount; i++)
+    bool saved = false;
+    FILE* file = fopen(tempPath, "wb");
+    if (file != NULL)
     {
-        switch (stats[i].format)
+        saved = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(table->Entries, sizeof(ib_ComputeTuningEntry), table->Count, file) == table->Count;
+        saved = fclose(file) == 0 && saved;
+        saved = saved && replaceFile(tempPath, table->Path);
+        if (!saved)
         {
-            case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_BOOL32_KHR:
-                printf("    %s: %s\n", stats[i].name, stats[i].value.b32 == VK_TRUE ? "True" : "False");
-                break;
-            case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_FLOAT64_KHR:
-                printf("    %s: %f\n", stats[i].name, stats[i].value.f64);
-                break;
-            case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR:
-                printf("    %s: %" PRId64 "\n", stats[i].name, stats[i].value.i64);
-                break;
-            case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR:
-                printf("    %s: %" PRIu64 "\n", stats[i].name, stats[i].value.u64);
-                break;
+            remove(tempPath);
         }
     }
-
-#undef maxStatCount
+    ib_unlockMutex(&table->Lock);
+    return saved;
 }
 
-// Timers
-void ib_initTimerManager(ib_TimerManagerDesc desc, ib_TimerManager* outManager)
+ib_ComputePipeline ib_allocComputePipeline(ib_Core* core, ib_ComputePipelineDesc desc)
 {
-    *outManager = (ib_TimerManager) { 0 };
+    ib_ComputeTuning tuning = { 0 };
+    ib_SpecializationConstant tunedConstants[ib_MaxSpecializationConstantCount + 3];
+    bool isTuned = desc.ApplyStoredTuning && ib_getComputeTuning(core, &desc.ShaderDesc, &tuning);
+    if (isTuned)
+    {
+        applyComputeTuning(&tuning, &desc.ShaderDesc, tunedConstants);
+    }
 
-    outManager->MaxTimestampCount = desc.MaxTimerCount * 2;
-    ib_vkCheck(vkCreateQueryPool(desc.Core->LogicalDevice,
-                                 &(VkQueryPoolCreateInfo)
-                                 {
-                                     .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
-                                     .queryType = VK_QUERY_TYPE_TIMESTAMP,
-                                     .queryCount = outManager->MaxTimestampCount,
-                                 }, ib_NoVkAllocator, &outManager->TimestampPool));
+    ib_ComputePipeline pipeline = createComputePipeline(core, desc);
+    pipeline.Tuning = tuning;
+    pipeline.IsTuned = isTuned;
+    return pipeline;
 }
 
-void ib_killTimerManager(ib_Core* core, ib_TimerManager* manager)
+static bool isWaveSizeSupported(ib_Core* core, uint32_t waveSize)
 {
-    vkDestroyQueryPool(core->LogicalDevice, manager->TimestampPool, ib_NoVkAllocator);
+    return waveSize == 0 || (waveSize >= core->MinWaveSize && waveSize <= core->MaxWaveSize && ib_bitCountU32(waveSize) == 1);
 }
 
-void ib_resetTimers(ib_TimerManager* manager, VkCommandBuffer commandBuffer)
+static bool isWorkgroupSizeSupported(ib_Core* core, VkExtent3D size)
 {
-    vkCmdResetQueryPool(commandBuffer, manager->TimestampPool, 0, manager->MaxTimestampCount); // Reset all active timers
-    manager->NextTimestamp = 0;
+    VkPhysicalDeviceLimits const* limits = &core->DeviceLimits;
+    return size.width > 0 && size.height > 0 && size.depth > 0
+        && size.width <= limits->maxComputeWorkGroupSize[0]
+        && size.height <= limits->maxComputeWorkGroupSize[1]
+        && size.depth <= limits->maxComputeWorkGroupSize[2]
+        && size.width * size.height * size.depth <= limits->maxComputeWorkGroupInvocations;
 }
 
-void ib_resetTimersCPU(ib_Core* core, ib_TimerManager* manager)
+static int compareDoubles(void const* lhs, void const* rhs)
 {
-    vkResetQueryPool(core->LogicalDevice, manager->TimestampPool, 0, manager->MaxTimestampCount);
-    manager->NextTimestamp = 0;
+    double l = *(double const*)lhs;
+    double r = *(double const*)rhs;
+    return (l > r) - (l < r);
 }
 
-ib_Timer ib_beginTimer(ib_TimerManager* manager, VkCommandBuffer commandBuffer)
+static void recordComputeToComputeBarrier(VkCommandBuffer commandBuffer)
 {
-    ib_assert(manager->NextTimestamp < manager->MaxTimestampCount);
+    VkMemoryBarrier2 barrier =
+    {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier2(commandBuffer, &(VkDependencyInfo)
+                          {
+                              .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+                              .memoryBarrierCount = 1,
+                              .pMemoryBarriers = &barrier
+                          });
+}
 
-    ib_Timer timer = { manager->NextTimestamp };
-    manager->NextTimestamp += 2;
-
-    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, manager->TimestampPool, timer.TimestampIndex);
+ib_AutotuneResult ib_autotuneComputePipeline(ib_Core* core, ib_AutotuneComputeDesc desc)
+{
+    ib_assert(desc.Desc != NULL && desc.Dispatch != NULL);
+
+    uint32_t const defaultWaveSizes[] = { 32, 64 };
+    uint32_t const* waveSizes = desc.WaveSizes.Count > 0 ? desc.WaveSizes.Data : defaultWaveSizes;
+    uint32_t waveSizeCount = desc.WaveSizes.Count > 0 ? desc.WaveSizes.Count : ib_arrayCount(defaultWaveSizes);
+    uint32_t workgroupSizeCount = ib_max(desc.WorkgroupSizes.Count, 1);
+    uint32_t sampleCount = desc.SampleCount > 0 ? desc.SampleCount : ib_DefaultAutotuneSampleCount;
+
+    // One extra slot lets the driver pick when the device can't run any of the requested wave sizes.
+    uint32_t maxCandidateCount = (waveSizeCount + 1) * workgroupSizeCount;
+    ib_ComputeTuning* candidates = (ib_ComputeTuning*)malloc(sizeof(ib_ComputeTuning) * maxCandidateCount);
+    uint32_t candidateCount = 0;
+    for (uint32_t w = 0; w < workgroupSizeCount; w++)
+    {
+        ib_ComputeTuning candidate = { 0 };
+        if (desc.WorkgroupSizes.Count > 0)
+        {
+            if (!isWorkgroupSizeSupported(core, desc.WorkgroupSizes.Data[w]))
+            {
+                continue;
+            }
+            candidate.WorkgroupSize = desc.WorkgroupSizes.Data[w];
+            memcpy(candidate.WorkgroupSizeIds, desc.WorkgroupSizeIds, sizeof(candidate.WorkgroupSizeIds));
+        }
 
-    return timer;
-}
+        uint32_t firstCandidate = candidateCount;
+        for (uint32_t i = 0; i < waveSizeCount; i++)
+        {
+            if (isWaveSizeSupported(core, waveSizes[i]))
+            {
+                candidate.RequiredWaveSize = waveSizes[i];
+                candidates[candidateCount++] = candidate;
+            }
+        }
 
-void ib_endTimer(ib_TimerManager* manager, VkCommandBuffer commandBuffer, ib_Timer* timer)
-{
-    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, manager->TimestampPool, timer->TimestampIndex + 1);
-}
+        if (candidateCount == firstCandidate)
+        {
+            candidate.RequiredWaveSize = 0;
+            candidates[candidateCount++] = candidate;
+        }
+    }
+    ib_assert(candidateCount > 0, "None of the workgroup sizes fit the device limits.");
 
-double ib_queryTimer(ib_Core* core, ib_TimerManager* manager, ib_Timer const* timer, bool blocking)
-{
-    uint32_t flags = VK_QUERY_RESULT_64_BIT;
-    if (blocking)
+    ib_ComputePipeline* pipelines = (ib_ComputePipeline*)malloc(sizeof(ib_ComputePipeline) * candidateCount);
+    for (uint32_t i = 0; i < candidateCount; i++)
     {
-        flags |= VK_QUERY_RESULT_WAIT_BIT;
+        ib_ComputePipelineDesc candidateDesc = *desc.Desc;
+        ib_SpecializationConstant constants[ib_MaxSpecializationConstantCount + 3];
+        applyComputeTuning(&candidates[i], &candidateDesc.ShaderDesc, constants);
+        pipelines[i] = createComputePipeline(core, candidateDesc);
+        pipelines[i].Tuning = candidates[i];
+        pipelines[i].IsTuned = true;
     }
-    uint64_t timestamps[2];
-    VkResult result = vkGetQueryPoolResults(core->LogicalDevice, manager->TimestampPool, timer->TimestampIndex, 2, sizeof(uint64_t) * 2, timestamps, sizeof(uint64_t), flags);
-	
-    if (result == VK_NOT_READY)
+
+    // Each candidate gets an untimed warm up run, then sampleCount timed runs that can't overlap each other.
+    ib_Queue queue = core->Queues[ib_Queue_Compute].TimestampValidBits > 0 ? ib_Queue_Compute : ib_Queue_Graphics;
+    ib_TimerManager timers;
+    ib_initTimerManager((ib_TimerManagerDesc) { .Core = core, .MaxTimerCount = candidateCount * sampleCount }, &timers);
+    ib_Timer* samples = (ib_Timer*)malloc(sizeof(ib_Timer) * candidateCount * sampleCount);
+
+    VkCommandBuffer commandBuffer = ib_allocAndBeginCommandBuffer(core, queue);
+    ib_resetTimers(&timers, commandBuffer);
+    for (uint32_t i = 0; i < candidateCount; i++)
     {
-        return ib_TimerQueryNotReady;
+        desc.Dispatch(commandBuffer, &pipelines[i], &candidates[i], desc.UserData);
+        recordComputeToComputeBarrier(commandBuffer);
+        for (uint32_t s = 0; s < sampleCount; s++)
+        {
+            ib_Timer* timer = &samples[i * sampleCount + s];
+            *timer = ib_beginTimer(&timers, commandBuffer);
+            desc.Dispatch(commandBuffer, &pipelines[i], &candidates[i], desc.UserData);
+            ib_endTimer(&timers, commandBuffer, timer);
+            recordComputeToComputeBarrier(commandBuffer);
+        }
     }
-    else
+    ib_endAndSubmitCommandBuffer(core, commandBuffer, queue);
+    ib_vkCheck(vkQueueWaitIdle(core->Queues[queue].Queue));
+    ib_check(ib_resolveTimers(core, &timers, true));
+
+    ib_AutotuneResult result = { .BestMs = -1.0, .CandidateCount = candidateCount };
+    double* times = (double*)malloc(sizeof(double) * sampleCount);
+    for (uint32_t i = 0; i < candidateCount; i++)
     {
-        double duration = (double)(timestamps[1] - timestamps[0]) * core->DeviceLimits.timestampPeriod;
-        duration /= 1000000.0; // nanoseconds to milliseconds
+        for (uint32_t s = 0; s < sampleCount; s++)
+        {
+            double begin, end;
+            ib_getResolvedTimerRange(core, &timers, &samples[i * sampleCount + s], &begin, &end);
+            times[s] = end - begin;
+        }
+        qsort(times, sampleCount, sizeof(double), compareDoubles);
+        double median = times[sampleCount / 2];
 
-        return duration;
+        if (result.BestMs < 0.0 || median < result.BestMs)
+        {
+            result.Best = candidates[i];
+            result.BestMs = median;
+        }
+        result.WorstMs = ib_max(result.WorstMs, median);
     }
-}
+    free(times);
 
-// Raytracing
+    ib_freeCommandBuffer(core, queue, commandBuffer);
+    ib_killTimerManager(core, &timers);
+    free(samples);
+    for (uint32_t i = 0; i < candidateCount; i++)
+    {
+        ib_freeComputePipeline(core, &pipelines[i]);
+    }
+    free(pipelines);
+    free(candidates);
 
-PFN_vkCreateAccelerationStructureKHR ib_vkCreateAccelerationStructureKHR;
-PFN_vkDestroyAccelerationStructureKHR ib_vkDestroyAccelerationStructureKHR;
-PFN_vkCmdBuildAccelerationStructuresKHR ib_vkCmdBuildAccelerationStructuresKHR;
-PFN_vkGetAccelerationStructureDeviceAddressKHR ib_vkGetAccelerationStructureDeviceAddressKHR;
-PFN_vkGetAccelerationStructureBuildSizesKHR ib_vkGetAccelerationStructureBuildSizesKHR;
+    storeComputeTuning(core, kernelHash(&desc.Desc->ShaderDesc), &result.Best);
+    ib_saveComputeTunings(core);
+    return result;
+}
 
-VkResult VKAPI_CALL vkCreateAccelerationStructureKHR(
-    VkDevice device,
-    const VkAccelerationStructureCreateInfoKHR* pCreateInfo,
-    const VkAllocationCallbacks* pAllocator,
-    VkAccelerationStructureKHR* pAccelerationStructure)
+void ib_freeComputePipeline(ib_Core* core, ib_ComputePipeline* pipeline)
 {
-    if (ib_vkCreateAccelerationStructureKHR == NULL)
+    vkDestroyPipeline(core->LogicalDevice, pipeline->VulkanPipeline, ib_NoVkAllocator);
+    releaseShaderModule(core, pipeline->ShaderModule);
+    vkDestroyPipelineLayout(core->LogicalDevice, pipeline->Layout, ib_NoVkAllocator);
+    for (uint32_t i = 0; i < ib_MaxShaderInputLayoutPerPipeline; i++)
     {
-        return VK_ERROR_EXTENSION_NOT_PRESENT;
+        ib_freeShaderInputLayout(core, &pipeline->InlineShaderInputLayouts[i]);
     }
+    *pipeline = (ib_ComputePipeline) { 0 };
+}
 
-    return ib_vkCreateAccelerationStructureKHR(
-        device,
-        pCreateInfo,
-        pAllocator,
-        pAccelerationStructure);
+// Pipeline variants
+
+ib_PipelineVariantCache ib_allocPipelineVariantCache(ib_PipelineVariantCacheDesc desc)
+{
+    ib_assert((desc.GraphicsDesc != NULL) != (desc.ComputeDesc != NULL), "Variant caches hold either graphics or compute pipelines.");
+    return (ib_PipelineVariantCache) { .Desc = desc };
 }
 
-void VKAPI_CALL vkDestroyAccelerationStructureKHR(
-    VkDevice device,
-    VkAccelerationStructureKHR accelerationStructure,
-    const VkAllocationCallbacks* pAllocator)
+void ib_freePipelineVariantCache(ib_Core* core, ib_PipelineVariantCache* cache)
 {
-    if (ib_vkDestroyAccelerationStructureKHR == NULL)
+    while (cache->Variants != NULL)
     {
-        ib_vkCheck(VK_ERROR_EXTENSION_NOT_PRESENT);
-        return;
+        ib_PipelineVariant* variant = cache->Variants;
+        cache->Variants = variant->Next;
+        if (cache->Desc.ComputeDesc != NULL)
+        {
+            ib_freeComputePipeline(core, &variant->Compute);
+        }
+        else
+        {
+            ib_freeGraphicsPipeline(core, &variant->Graphics);
+        }
+        free(variant);
     }
-
-    ib_vkDestroyAccelerationStructureKHR(
-        device,
-        accelerationStructure,
-        pAllocator);
+    *cache = (ib_PipelineVariantCache) { 0 };
 }
 
-void VKAPI_CALL vkCmdBuildAccelerationStructuresKHR(
-    VkCommandBuffer commandBuffer,
-    uint32_t infoCount,
-    const VkAccelerationStructureBuildGeometryInfoKHR* pInfos,
-    const VkAccelerationStructureBuildRangeInfoKHR * const* ppBuildRangeInfos)
+// Variants are allocated one by one so the pipelines we hand out never move.
+static ib_PipelineVariant* findOrAddPipelineVariant(ib_PipelineVariantCache* cache, ib_SpecializationConstantRange constants, bool* outAdded)
 {
-    if (ib_vkCmdBuildAccelerationStructuresKHR == NULL)
+    ib_assert(constants.Count <= ib_MaxSpecializationConstantCount);
+
+    // Callers can list the same constants in any order, sort them by id so they map to the same variant.
+    ib_SpecializationConstant sortedConstants[ib_MaxSpecializationConstantCount];
+    uint32_t constantCount = ib_min(constants.Count, ib_MaxSpecializationConstantCount);
+    for (uint32_t i = 0; i < constantCount; i++)
     {
-        ib_vkCheck(VK_ERROR_EXTENSION_NOT_PRESENT);
-        return;
+        ib_SpecializationConstant constant = constants.Data[i];
+        uint32_t insert = i;
+        for (; insert > 0 && sortedConstants[insert - 1].Id > constant.Id; insert--)
+        {
+            sortedConstants[insert] = sortedConstants[insert - 1];
+        }
+        ib_assert(insert == 0 || sortedConstants[insert - 1].Id != constant.Id, "Specialization constant ids must be unique.");
+        sortedConstants[insert] = constant;
     }
+    constants = (ib_SpecializationConstantRange) { sortedConstants, constantCount };
 
-    ib_vkCmdBuildAccelerationStructuresKHR(
-        commandBuffer,
-        infoCount,
-        pInfos,
-        ppBuildRangeInfos
-    );
-}
+    size_t constantsSize = constants.Count * sizeof(ib_SpecializationConstant);
+    uint64_t hash = hashBytes(constants.Data, constantsSize);
+    for (ib_PipelineVariant* variant = cache->Variants; variant != NULL; variant = variant->Next)
+    {
+        if (variant->Hash == hash && variant->ConstantCount == constants.Count && memcmp(variant->Constants, constants.Data, constantsSize) == 0)
+        {
+            *outAdded = false;
+            return variant;
+        }
+    }
 
-VkDeviceAddress VKAPI_CALL vkGetAccelerationStructureDeviceAddressKHR(
-    VkDevice device,
-    const VkAccelerationStructureDeviceAddressInfoKHR* pInfo)
-{
-    if (ib_vkGetAccelerationStructureDeviceAddressKHR == NULL)
+    ib_PipelineVariant* variant = (ib_PipelineVariant*)calloc(1, sizeof(ib_PipelineVariant));
+    variant->Hash = hash;
+    variant->ConstantCount = constants.Count;
+    if (constantsSize > 0)
     {
-        ib_vkCheck(VK_ERROR_EXTENSION_NOT_PRESENT);
-        return 0;
+        memcpy(variant->Constants, constants.Data, constantsSize);
     }
+    variant->Next = cache->Variants;
+    cache->Variants = variant;
+    cache->VariantCount++;
 
-    return ib_vkGetAccelerationStructureDeviceAddressKHR(
-        device,
-        pInfo);
+    *outAdded = true;
+    return variant;
 }
 
-void VKAPI_CALL vkGetAccelerationStructureBuildSizesKHR(
-    VkDevice device,
-    VkAccelerationStructureBuildTypeKHR buildType,
-    const VkAccelerationStructureBuildGeometryInfoKHR* pBuildInfo,
-    const uint32_t* pMaxPrimitiveCounts,
-    VkAccelerationStructureBuildSizesInfoKHR* pSizeInfo)
+ib_GraphicsPipeline const* ib_getGraphicsPipelineVariant(ib_Core* core, ib_PipelineVariantCache* cache, ib_SpecializationConstantRange constants)
 {
-    if (ib_vkGetAccelerationStructureBuildSizesKHR == NULL)
+    ib_assert(cache->Desc.GraphicsDesc != NULL);
+
+    bool added;
+    ib_PipelineVariant* variant = findOrAddPipelineVariant(cache, constants, &added);
+    if (added)
     {
-        ib_vkCheck(VK_ERROR_EXTENSION_NOT_PRESENT);
-        return;
-    }
+        ib_GraphicsPipelineDesc desc = *cache->Desc.GraphicsDesc;
+        ib_assert(desc.ShaderDescs.Count <= ib_MaxShaderStagesPerPipeline);
 
-    ib_vkGetAccelerationStructureBuildSizesKHR(
-        device,
-        buildType,
-        pBuildInfo,
-        pMaxPrimitiveCounts,
-        pSizeInfo);
+        ib_ShaderDesc shaderDescs[ib_MaxShaderStagesPerPipeline];
+        for (uint32_t i = 0; i < desc.ShaderDescs.Count; i++)
+        {
+            shaderDescs[i] = desc.ShaderDescs.Data[i];
+            shaderDescs[i].Constants = (ib_SpecializationConstantRange) { variant->Constants, variant->ConstantCount };
+        }
+        desc.ShaderDescs.Data = shaderDescs;
+
+        variant->Graphics = ib_allocGraphicsPipeline(core, desc);
+    }
+    return &variant->Graphics;
 }
 
-static iba_PageHeader* allocRaytracingStagingMemoryPage(void* userData, size_t pageSize)
+ib_ComputePipeline const* ib_getComputePipelineVariant(ib_Core* core, ib_PipelineVariantCache* cache, ib_SpecializationConstantRange constants)
 {
-    StackGpuMemoryPage* page = calloc(1, sizeof(StackGpuMemoryPage));
+    ib_assert(cache->Desc.ComputeDesc != NULL);
 
-    ib_Raytracing* raytracing = (ib_Raytracing*)userData;
-    VkDevice logicalDevice = raytracing->Core->LogicalDevice;
-    VkBufferCreateInfo bufferCreate =
+    bool added;
+    ib_PipelineVariant* variant = findOrAddPipelineVariant(cache, constants, &added);
+    if (added)
     {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = pageSize,
-        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-    };
-    ib_vkCheck(vkCreateBuffer(logicalDevice, &bufferCreate, ib_NoVkAllocator, &page->Buffer));
+        ib_ComputePipelineDesc desc = *cache->Desc.ComputeDesc;
+        desc.ShaderDesc.Constants = (ib_SpecializationConstantRange) { variant->Constants, variant->ConstantCount };
+        variant->Compute = ib_allocComputePipeline(core, desc);
+    }
+    return &variant->Compute;
+}
 
-    VkMemoryRequirements memoryRequirements;
-    vkGetBufferMemoryRequirements(logicalDevice, page->Buffer, &memoryRequirements);
+// Batched compilation
 
-    page->PageAlloc = iba_gpuAlloc(&raytracing->Core->Allocator, (iba_GpuAllocationRequest)
-                                   {
-                                       .Size = pageSize,
-                                       .Alignment = raytracing->AccelerationStructureScratchBufferAlignment,
-                                       .TypeBits = memoryRequirements.memoryTypeBits,
-                                       .RequiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                   });
+struct ib_PipelineBatch
+{
+    ib_Core* Core;
+    ib_PipelineBatchDesc Desc;
+    uint32_t JobCount; // Graphics jobs first, then compute
+    uint32_t volatile NextJob;
+    uint32_t volatile CompletedJobCount;
+    uint32_t volatile* ReadyJobs;
+
+    uint64_t BeginTicks;
+    uint64_t EndTicks;
+    uint64_t volatile CompileCPUTicks;
+
+    ib_Thread Threads[ib_MaxPipelineBatchThreadCount];
+    uint32_t ThreadCount;
+};
 
-    ib_vkCheck(vkBindBufferMemory(logicalDevice, page->Buffer, page->PageAlloc.Memory, page->PageAlloc.Offset));
+static void pipelineBatchWorker(void* userData)
+{
+    ib_PipelineBatch* batch = (ib_PipelineBatch*)userData;
+    while (true)
+    {
+        uint32_t job = ib_atomicAddU32(&batch->NextJob, 1) - 1;
+        if (job >= batch->JobCount)
+        {
+            break;
+        }
 
-    return &page->Header;
+        uint64_t beginTicks = ib_cpuTicks();
+        uint32_t graphicsCount = batch->Desc.GraphicsDescs.Count;
+        if (job < graphicsCount)
+        {
+            batch->Desc.OutGraphicsPipelines[job] = ib_allocGraphicsPipeline(batch->Core, batch->Desc.GraphicsDescs.Data[job]);
+        }
+        else
+        {
+            batch->Desc.OutComputePipelines[job - graphicsCount] = ib_allocComputePipeline(batch->Core, batch->Desc.ComputeDescs.Data[job - graphicsCount]);
+        }
+        ib_atomicAddU64(&batch->CompileCPUTicks, ib_cpuTicks() - beginTicks);
+
+        ib_atomicAddU32(&batch->ReadyJobs[job], 1);
+        if (ib_atomicAddU32(&batch->CompletedJobCount, 1) == batch->JobCount)
+        {
+            batch->EndTicks = ib_cpuTicks();
+        }
+    }
 }
 
-static void freeRaytracingStagingMemoryPage(void* userData, iba_PageHeader* pageHeader)
+ib_PipelineBatch* ib_compilePipelineBatch(ib_Core* core, ib_PipelineBatchDesc desc)
 {
-    ib_Raytracing* raytracing = (ib_Raytracing*)userData;
-    StackGpuMemoryPage* page = (StackGpuMemoryPage*)pageHeader;
+    ib_assert(desc.GraphicsDescs.Count == 0 || desc.OutGraphicsPipelines != NULL);
+    ib_assert(desc.ComputeDescs.Count == 0 || desc.OutComputePipelines != NULL);
+
+    ib_PipelineBatch* batch = (ib_PipelineBatch*)calloc(1, sizeof(ib_PipelineBatch));
+    batch->Core = core;
+    batch->Desc = desc;
+    batch->JobCount = desc.GraphicsDescs.Count + desc.ComputeDescs.Count;
+    batch->ReadyJobs = (uint32_t volatile*)calloc(batch->JobCount > 0 ? batch->JobCount : 1, sizeof(uint32_t));
+    batch->BeginTicks = ib_cpuTicks();
+    batch->EndTicks = batch->BeginTicks;
+
+    uint32_t threadCount = desc.ThreadCount != 0 ? desc.ThreadCount : ib_cpuCoreCount();
+    threadCount = ib_min(threadCount, batch->JobCount);
+    threadCount = ib_min(threadCount, ib_MaxPipelineBatchThreadCount);
+    batch->ThreadCount = threadCount;
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        batch->Threads[i] = ib_startThread(pipelineBatchWorker, batch);
+    }
 
-    vkDestroyBuffer(raytracing->Core->LogicalDevice, page->Buffer, ib_NoVkAllocator);
-    iba_gpuFree(&raytracing->Core->Allocator, &page->PageAlloc);
-    free(page);
+    return batch;
 }
 
-void ib_initRaytracing(ib_Core* core, ib_Raytracing* raytracing)
+bool ib_isGraphicsPipelineReady(ib_PipelineBatch const* batch, uint32_t index)
 {
-    raytracing->Core = core;
+    ib_assert(index < batch->Desc.GraphicsDescs.Count);
+    return ib_atomicLoadU32(&batch->ReadyJobs[index]) != 0;
+}
 
-    ib_vkCreateAccelerationStructureKHR = ib_getVulkanFunc(core->Instance, vkCreateAccelerationStructureKHR);
-    ib_vkDestroyAccelerationStructureKHR = ib_getVulkanFunc(core->Instance, vkDestroyAccelerationStructureKHR);
-    ib_vkCmdBuildAccelerationStructuresKHR = ib_getVulkanFunc(core->Instance, vkCmdBuildAccelerationStructuresKHR);
-    ib_vkGetAccelerationStructureDeviceAddressKHR = ib_getVulkanFunc(core->Instance, vkGetAccelerationStructureDeviceAddressKHR);
-    ib_vkGetAccelerationStructureBuildSizesKHR = ib_getVulkanFunc(core->Instance, vkGetAccelerationStructureBuildSizesKHR);
+bool ib_isComputePipelineReady(ib_PipelineBatch const* batch, uint32_t index)
+{
+    ib_assert(index < batch->Desc.ComputeDescs.Count);
+    return ib_atomicLoadU32(&batch->ReadyJobs[batch->Desc.GraphicsDescs.Count + index]) != 0;
+}
 
-    VkPhysicalDeviceAccelerationStructurePropertiesKHR asProps = {
-        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR,
+ib_PipelineBatchStats ib_waitPipelineBatch(ib_PipelineBatch* batch)
+{
+    for (uint32_t i = 0; i < batch->ThreadCount; i++)
+    {
+        ib_joinThread(&batch->Threads[i]);
+    }
+
+    ib_PipelineBatchStats stats =
+    {
+        .WallCPUTicks = batch->EndTicks - batch->BeginTicks,
+        .CompileCPUTicks = batch->CompileCPUTicks,
+        .ThreadCount = batch->ThreadCount
     };
-    raytracing->AccelerationStructureScratchBufferAlignment = asProps.minAccelerationStructureScratchOffsetAlignment;
+
+    free((void*)batch->ReadyJobs);
+    free(batch);
+    return stats;
 }
 
-void ib_killRaytracing(ib_Raytracing* raytracing)
+// Hot reload
+
+#define ib_ReloadPollIntervalMs 100.0
+
+typedef struct
 {
-    // Nothing to do here. Function exists for symmetry for now.
-    ib_potentiallyUnused(raytracing);
-}
+    char Path[ib_MaxPathLength];
+    uint32_t FileNameOffset; // Into Path, an offset stays valid as entries are copied around
+    int64_t ModifiedTime;
+    int WatchDescriptor; // inotify watch on the containing directory
+} ReloadShaderFile;
 
+typedef struct
+{
+    uint32_t Id;
+    void* Target; // ib_GraphicsPipeline or ib_ComputePipeline
+    bool IsCompute;
+    ib_GraphicsPipelineDesc GraphicsDesc;
+    ib_ComputePipelineDesc ComputeDesc;
+    ib_ShaderDesc ShaderDescs[ib_MaxShaderStagesPerPipeline]; // GraphicsDesc.ShaderDescs points here
+    ReloadShaderFile Files[ib_MaxShaderStagesPerPipeline];
+    uint32_t FileCount;
+    bool Dirty;
+
+    bool HasPending;
+    ib_GraphicsPipeline PendingGraphics;
+    ib_ComputePipeline PendingCompute;
+} ReloadEntry;
+
+typedef struct
+{
+    bool IsCompute;
+    ib_GraphicsPipeline Graphics;
+    ib_ComputePipeline Compute;
+    uint64_t Frame;
+} RetiredPipeline;
 
-void ib_initRaytracingScratch(ib_Raytracing* raytracing, iba_StackAllocator* allocator)
+struct ib_PipelineReloader
 {
-    iba_StackAllocatorDesc createInfo = {
-        .PageAllocator = {
-            .AllocPage = &allocRaytracingStagingMemoryPage,
-            .FreePage = &freeRaytracingStagingMemoryPage,
-            .UserData = raytracing
-        },
-        .PageSize = 1024 * 1024 * 256
-    };
-    iba_initStackAllocator(createInfo, allocator);
-}
+    ib_Core* Core;
+    ib_Thread Thread;
+    uint32_t volatile Stop;
+    ib_Mutex Lock; // Guards everything below
+
+    ReloadEntry* Entries;
+    uint32_t EntryCount;
+    uint32_t EntryCapacity;
+    uint32_t NextId;
+
+    RetiredPipeline* Retired;
+    uint32_t RetiredCount;
+    uint32_t RetiredCapacity;
+    uint64_t Frame;
+
+    int NotifyHandle; // inotify, -1 when files are polled instead
+};
 
-void ib_killRaytracingScratch(iba_StackAllocator* allocator)
+static int64_t fileModifiedTime(char const* path)
 {
-    iba_killStackAllocator(allocator);
+    struct stat fileStat;
+    return stat(path, &fileStat) == 0 ? (int64_t)fileStat.st_mtime : 0;
 }
 
-static ib_AccelerationStructureData buildAccelerationStructureInternal(
-    ib_Raytracing* raytracing,
-    VkAccelerationStructureBuildGeometryInfoKHR* buildInfo,
-    uint32_t* primitiveCount,
-    iba_StackAllocator* scratchMemoryStack,
-    ib_timelineSemaphore* buildingSemaphore)
+// Returns NULL if the file is missing or doesn't hold SPIR-V yet, editors can leave half written files behind.
+static void* readSPIRVFile(char const* path, size_t* outSize)
 {
-    ib_AccelerationStructureData out = { 0 };
-  
-    VkAccelerationStructureBuildSizesInfoKHR sizesInfo = {
-        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR
-    };
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
 
-    vkGetAccelerationStructureBuildSizesKHR(
-        raytracing->Core->LogicalDevice,
-        VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-        buildInfo,
-        primitiveCount,
-        &sizesInfo);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
 
-    out.Buffer = ib_allocBuffer(raytracing->Core, (ib_BufferDesc)
-                                {
-                                    .Usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                                    .Size = sizesInfo.accelerationStructureSize,
-                                    .RequiredMemoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    uint32_t const spirvMagic = 0x07230203;
+    uint32_t* code = NULL;
+    if (size >= 4 && size % 4 == 0)
+    {
+        code = (uint32_t*)malloc((size_t)size);
+        if (fread(code, (size_t)size, 1, file) != 1 || code[0] != spirvMagic)
+        {
+            free(code);
+            code = NULL;
+        }
+    }
+
+    fclose(file);
+    *outSize = code != NULL ? (size_t)size : 0;
+    return code;
+}
+
+static ReloadEntry* findReloadEntry(ib_PipelineReloader* reloader, uint32_t id)
+{
+    for (uint32_t i = 0; i < reloader->EntryCount; i++)
+    {
+        if (reloader->Entries[i].Id == id)
+        {
+            return &reloader->Entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void freeReloadedPipeline(ib_Core* core, bool isCompute, ib_GraphicsPipeline* graphics, ib_ComputePipeline* compute)
+{
+    if (isCompute)
+    {
+        ib_freeComputePipeline(core, compute);
+    }
+    else
+    {
+        ib_freeGraphicsPipeline(core, graphics);
+    }
+}
+
+static void markChangedReloadFiles(ib_PipelineReloader* reloader)
+{
+#ifdef __linux__
+    if (reloader->NotifyHandle >= 0)
+    {
+        struct pollfd pollDesc = { .fd = reloader->NotifyHandle, .events = POLLIN };
+        if (poll(&pollDesc, 1, (int)ib_ReloadPollIntervalMs) <= 0)
+        {
+            return;
+        }
+
+        _Alignas(struct inotify_event) char events[4096];
+        ssize_t readSize = read(reloader->NotifyHandle, events, sizeof(events));
+
+        ib_lockMutex(&reloader->Lock);
+        for (char const* iter = events; readSize > 0 && iter < events + readSize;)
+        {
+            struct inotify_event const* event = (struct inotify_event const*)iter;
+            for (uint32_t i = 0; i < reloader->EntryCount && event->len > 0; i++)
+            {
+                ReloadEntry* entry = &reloader->Entries[i];
+                for (uint32_t f = 0; f < entry->FileCount; f++)
+                {
+                    entry->Dirty |= entry->Files[f].WatchDescriptor == event->wd && strcmp(entry->Files[f].Path + entry->Files[f].FileNameOffset, event->name) == 0;
+                }
+            }
+            iter += sizeof(struct inotify_event) + event->len;
+        }
+        ib_unlockMutex(&reloader->Lock);
+        return;
+    }
+#endif // __linux__
+
+    ib_sleepMs(ib_ReloadPollIntervalMs);
+
+    ib_lockMutex(&reloader->Lock);
+    for (uint32_t i = 0; i < reloader->EntryCount; i++)
+    {
+        ReloadEntry* entry = &reloader->Entries[i];
+        for (uint32_t f = 0; f < entry->FileCount; f++)
+        {
+            int64_t modifiedTime = fileModifiedTime(entry->Files[f].Path);
+            if (modifiedTime != entry->Files[f].ModifiedTime)
+            {
+                entry->Files[f].ModifiedTime = modifiedTime;
+                entry->Dirty = true;
+            }
+        }
+    }
+    ib_unlockMutex(&reloader->Lock);
+}
+
+static void rebuildReloadEntry(ib_PipelineReloader* reloader, ReloadEntry snapshot)
+{
+    void* code[ib_MaxShaderStagesPerPipeline] = { 0 };
+    bool allLoaded = true;
+    for (uint32_t f = 0; f < snapshot.FileCount; f++)
+    {
+        code[f] = readSPIRVFile(snapshot.Files[f].Path, &snapshot.ShaderDescs[f].CodeSize);
+        snapshot.ShaderDescs[f].Code = code[f];
+        allLoaded &= code[f] != NULL;
+    }
+
+    if (allLoaded)
+    {
+        ib_GraphicsPipeline graphics = { 0 };
+        ib_ComputePipeline compute = { 0 };
+        if (snapshot.IsCompute)
+        {
+            snapshot.ComputeDesc.ShaderDesc = snapshot.ShaderDescs[0];
+            compute = ib_allocComputePipeline(reloader->Core, snapshot.ComputeDesc);
+        }
+        else
+        {
+            snapshot.GraphicsDesc.ShaderDescs.Data = snapshot.ShaderDescs;
+            graphics = ib_allocGraphicsPipeline(reloader->Core, snapshot.GraphicsDesc);
+        }
+
+        ib_lockMutex(&reloader->Lock);
+        ReloadEntry* entry = findReloadEntry(reloader, snapshot.Id);
+        if (entry != NULL)
+        {
+            // A pending pipeline was never handed out, it can go right away.
+            if (entry->HasPending)
+            {
+                freeReloadedPipeline(reloader->Core, entry->IsCompute, &entry->PendingGraphics, &entry->PendingCompute);
+            }
+            entry->PendingGraphics = graphics;
+            entry->PendingCompute = compute;
+            entry->HasPending = true;
+        }
+        else
+        {
+            freeReloadedPipeline(reloader->Core, snapshot.IsCompute, &graphics, &compute); // Unwatched while compiling
+        }
+        ib_unlockMutex(&reloader->Lock);
+    }
+#ifdef IB_DEBUG
+    else
+    {
+        printf("Pipeline reload skipped, couldn't read valid SPIR-V for every stage.\n");
+    }
+#endif // IB_DEBUG
+
+    for (uint32_t f = 0; f < snapshot.FileCount; f++)
+    {
+        free(code[f]);
+    }
+}
+
+static void pipelineReloaderWorker(void* userData)
+{
+    ib_PipelineReloader* reloader = (ib_PipelineReloader*)userData;
+    while (ib_atomicLoadU32(&reloader->Stop) == 0)
+    {
+        markChangedReloadFiles(reloader);
+
+        // Compile outside the lock so the frame thread never waits on the driver.
+        while (true)
+        {
+            bool found = false;
+            ReloadEntry snapshot;
+            ib_lockMutex(&reloader->Lock);
+            for (uint32_t i = 0; i < reloader->EntryCount; i++)
+            {
+                if (reloader->Entries[i].Dirty)
+                {
+                    reloader->Entries[i].Dirty = false;
+                    snapshot = reloader->Entries[i];
+                    found = true;
+                    break;
+                }
+            }
+            ib_unlockMutex(&reloader->Lock);
+
+            if (!found)
+            {
+                break;
+            }
+            rebuildReloadEntry(reloader, snapshot);
+        }
+    }
+}
+
+void ib_initPipelineReloader(ib_Core* core)
+{
+    ib_assert(core->Reloader == NULL);
+
+    ib_PipelineReloader* reloader = (ib_PipelineReloader*)calloc(1, sizeof(ib_PipelineReloader));
+    reloader->Core = core;
+    reloader->NotifyHandle = -1;
+    ib_initMutex(&reloader->Lock);
+#ifdef __linux__
+    reloader->NotifyHandle = inotify_init1(IN_NONBLOCK);
+#endif // __linux__
+
+    core->Reloader = reloader;
+    reloader->Thread = ib_startThread(pipelineReloaderWorker, reloader);
+}
+
+void ib_killPipelineReloader(ib_Core* core)
+{
+    ib_PipelineReloader* reloader = core->Reloader;
+    ib_atomicAddU32(&reloader->Stop, 1);
+    ib_joinThread(&reloader->Thread);
+
+    for (uint32_t i = 0; i < reloader->EntryCount; i++)
+    {
+        ReloadEntry* entry = &reloader->Entries[i];
+        if (entry->HasPending)
+        {
+            freeReloadedPipeline(core, entry->IsCompute, &entry->PendingGraphics, &entry->PendingCompute);
+        }
+    }
+
+    for (uint32_t i = 0; i < reloader->RetiredCount; i++)
+    {
+        RetiredPipeline* retired = &reloader->Retired[i];
+        freeReloadedPipeline(core, retired->IsCompute, &retired->Graphics, &retired->Compute);
+    }
+
+#ifdef __linux__
+    if (reloader->NotifyHandle >= 0)
+    {
+        close(reloader->NotifyHandle);
+    }
+#endif // __linux__
+
+    ib_killMutex(&reloader->Lock);
+    free(reloader->Entries);
+    free(reloader->Retired);
+    free(reloader);
+    core->Reloader = NULL;
+}
+
+static void watchPipeline(ib_Core* core, ReloadEntry entry, char const* const* shaderPaths)
+{
+    ib_PipelineReloader* reloader = core->Reloader;
+    ib_assert(reloader != NULL, "Call ib_initPipelineReloader before watching pipelines.");
+
+    for (uint32_t f = 0; f < entry.FileCount; f++)
+    {
+        ReloadShaderFile* file = &entry.Files[f];
+        ib_assert(strlen(shaderPaths[f]) < ib_MaxPathLength);
+        snprintf(file->Path, ib_MaxPathLength, "%s", shaderPaths[f]);
+        file->ModifiedTime = fileModifiedTime(file->Path);
+        file->WatchDescriptor = -1;
+
+        char const* separator = strrchr(file->Path, '/');
+        char const* backSeparator = strrchr(file->Path, '\\');
+        separator = backSeparator > separator ? backSeparator : separator;
+        file->FileNameOffset = separator != NULL ? (uint32_t)(separator + 1 - file->Path) : 0;
+
+#ifdef __linux__
+        // Watch the directory, editors often save by replacing the file which would drop a watch on the file itself.
+        if (reloader->NotifyHandle >= 0)
+        {
+            char directory[ib_MaxPathLength];
+            int directoryLength = separator != NULL ? (int)(separator - file->Path) : 1;
+            snprintf(directory, sizeof(directory), "%.*s", directoryLength, separator != NULL ? file->Path : ".");
+            file->WatchDescriptor = inotify_add_watch(reloader->NotifyHandle, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+        }
+#endif // __linux__
+    }
+
+    ib_lockMutex(&reloader->Lock);
+    if (reloader->EntryCount == reloader->EntryCapacity)
+    {
+        reloader->EntryCapacity = reloader->EntryCapacity == 0 ? 32 : reloader->EntryCapacity * 2;
+        reloader->Entries = (ReloadEntry*)realloc(reloader->Entries, sizeof(ReloadEntry) * reloader->EntryCapacity);
+        ib_assert(reloader->Entries != NULL);
+    }
+    entry.Id = reloader->NextId++;
+    reloader->Entries[reloader->EntryCount++] = entry;
+    ib_unlockMutex(&reloader->Lock);
+}
+
+void ib_watchGraphicsPipeline(ib_Core* core, ib_GraphicsPipeline* pipeline, ib_GraphicsPipelineDesc desc, char const* const* shaderPaths)
+{
+    ib_assert(desc.ShaderDescs.Count <= ib_MaxShaderStagesPerPipeline);
+
+    ReloadEntry entry = { .Target = pipeline, .IsCompute = false, .GraphicsDesc = desc, .FileCount = desc.ShaderDescs.Count };
+    memcpy(entry.ShaderDescs, desc.ShaderDescs.Data, sizeof(ib_ShaderDesc) * desc.ShaderDescs.Count);
+    watchPipeline(core, entry, shaderPaths);
+}
+
+void ib_watchComputePipeline(ib_Core* core, ib_ComputePipeline* pipeline, ib_ComputePipelineDesc desc, char const* shaderPath)
+{
+    ReloadEntry entry = { .Target = pipeline, .IsCompute = true, .ComputeDesc = desc, .FileCount = 1 };
+    entry.ShaderDescs[0] = desc.ShaderDesc;
+    watchPipeline(core, entry, &shaderPath);
+}
+
+#ifdef __linux__
+// Directories are watched once no matter how many files in them are watched, keep the watch while another entry uses it.
+static void removeUnusedWatches(ib_PipelineReloader* reloader, ReloadEntry const* removed)
+{
+    for (uint32_t f = 0; f < removed->FileCount; f++)
+    {
+        int watchDescriptor = removed->Files[f].WatchDescriptor;
+        bool isUsed = watchDescriptor < 0;
+        for (uint32_t i = 0; i < reloader->EntryCount && !isUsed; i++)
+        {
+            for (uint32_t other = 0; other < reloader->Entries[i].FileCount; other++)
+            {
+                isUsed |= reloader->Entries[i].Files[other].WatchDescriptor == watchDescriptor;
+            }
+        }
+
+        // Earlier files of the same entry can share the directory, only remove it once.
+        for (uint32_t previous = 0; previous < f && !isUsed; previous++)
+        {
+            isUsed |= removed->Files[previous].WatchDescriptor == watchDescriptor;
+        }
+
+        if (!isUsed)
+        {
+            inotify_rm_watch(reloader->NotifyHandle, watchDescriptor);
+        }
+    }
+}
+#endif // __linux__
+
+void ib_unwatchPipeline(ib_Core* core, void const* pipeline)
+{
+    ib_PipelineReloader* reloader = core->Reloader;
+    if (reloader == NULL)
+    {
+        return;
+    }
+
+    ib_lockMutex(&reloader->Lock);
+    for (uint32_t i = 0; i < reloader->EntryCount; i++)
+    {
+        ReloadEntry* entry = &reloader->Entries[i];
+        if (entry->Target == pipeline)
+        {
+            if (entry->HasPending)
+            {
+                freeReloadedPipeline(core, entry->IsCompute, &entry->PendingGraphics, &entry->PendingCompute);
+            }
+
+            ReloadEntry removed = *entry;
+            *entry = reloader->Entries[--reloader->EntryCount];
+#ifdef __linux__
+            if (reloader->NotifyHandle >= 0)
+            {
+                removeUnusedWatches(reloader, &removed);
+            }
+#else
+            ib_potentiallyUnused(removed);
+#endif // __linux__
+            break;
+        }
+    }
+    ib_unlockMutex(&reloader->Lock);
+}
+
+void ib_advancePipelineReloads(ib_Core* core, uint64_t frameNumber, uint32_t framesInFlight)
+{
+    ib_PipelineReloader* reloader = core->Reloader;
+    if (reloader == NULL)
+    {
+        return;
+    }
+
+    ib_lockMutex(&reloader->Lock);
+    if (frameNumber <= reloader->Frame)
+    {
+        ib_unlockMutex(&reloader->Lock);
+        return;
+    }
+    reloader->Frame = frameNumber;
+
+    // Frames still in flight may be using the old pipeline, retire it instead of freeing it.
+    for (uint32_t i = 0; i < reloader->EntryCount; i++)
+    {
+        ReloadEntry* entry = &reloader->Entries[i];
+        if (!entry->HasPending)
+        {
+            continue;
+        }
+
+        if (reloader->RetiredCount == reloader->RetiredCapacity)
+        {
+            reloader->RetiredCapacity = reloader->RetiredCapacity == 0 ? 16 : reloader->RetiredCapacity * 2;
+            reloader->Retired = (RetiredPipeline*)realloc(reloader->Retired, sizeof(RetiredPipeline) * reloader->RetiredCapacity);
+            ib_assert(reloader->Retired != NULL);
+        }
+
+        RetiredPipeline* retired = &reloader->Retired[reloader->RetiredCount++];
+        *retired = (RetiredPipeline) { .IsCompute = entry->IsCompute, .Frame = reloader->Frame };
+        if (entry->IsCompute)
+        {
+            retired->Compute = *(ib_ComputePipeline*)entry->Target;
+            *(ib_ComputePipeline*)entry->Target = entry->PendingCompute;
+        }
+        else
+        {
+            retired->Graphics = *(ib_GraphicsPipeline*)entry->Target;
+            *(ib_GraphicsPipeline*)entry->Target = entry->PendingGraphics;
+        }
+        entry->HasPending = false;
+    }
+
+    for (uint32_t i = 0; i < reloader->RetiredCount;)
+    {
+        RetiredPipeline* retired = &reloader->Retired[i];
+        if (retired->Frame + framesInFlight <= reloader->Frame)
+        {
+            freeReloadedPipeline(core, retired->IsCompute, &retired->Graphics, &retired->Compute);
+            *retired = reloader->Retired[--reloader->RetiredCount];
+        }
+        else
+        {
+            i++;
+        }
+    }
+    ib_unlockMutex(&reloader->Lock);
+}
+
+// utility
+
+bool ib_getPipelineExecutableReport(ib_Core* core, VkPipeline pipeline, ib_PipelineExecutableReport* outReport)
+{
+    *outReport = (ib_PipelineExecutableReport) { 0 };
+    if (!core->ShaderStatisticsEnabled)
+    {
+        return false;
+    }
+
+    VkPipelineInfoKHR pipelineInfo = { .sType = VK_STRUCTURE_TYPE_PIPELINE_INFO_KHR, .pipeline = pipeline };
+    VkPipelineExecutablePropertiesKHR properties[ib_MaxPipelineExecutableCount];
+    for (uint32_t i = 0; i < ib_MaxPipelineExecutableCount; i++)
+    {
+        properties[i] = (VkPipelineExecutablePropertiesKHR) { .sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_PROPERTIES_KHR };
+    }
+
+    uint32_t executableCount = ib_MaxPipelineExecutableCount;
+    if (vkGetPipelineExecutablePropertiesKHR(core->LogicalDevice, &pipelineInfo, &executableCount, properties) < VK_SUCCESS)
+    {
+        return false;
+    }
+
+    VkPipelineExecutableStatisticKHR stats[ib_MaxPipelineExecutableStatisticCount];
+    for (uint32_t e = 0; e < executableCount; e++)
+    {
+        ib_PipelineExecutable* executable = &outReport->Executables[outReport->ExecutableCount++];
+        snprintf(executable->Name, sizeof(executable->Name), "%s", properties[e].name);
+        executable->Stages = properties[e].stages;
+        executable->SubgroupSize = properties[e].subgroupSize;
+
+        for (uint32_t i = 0; i < ib_MaxPipelineExecutableStatisticCount; i++)
+        {
+            stats[i] = (VkPipelineExecutableStatisticKHR) { .sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR };
+        }
+
+        VkPipelineExecutableInfoKHR executableInfo =
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR,
+            .pipeline = pipeline,
+            .executableIndex = e
+        };
+
+        uint32_t statCount = ib_MaxPipelineExecutableStatisticCount;
+        if (vkGetPipelineExecutableStatisticsKHR(core->LogicalDevice, &executableInfo, &statCount, stats) < VK_SUCCESS)
+        {
+            continue;
+        }
+
+        for (uint32_t i = 0; i < statCount; i++)
+        {
+            ib_PipelineExecutableStatistic* statistic = &executable->Statistics[executable->StatisticCount++];
+            snprintf(statistic->Name, sizeof(statistic->Name), "%s", stats[i].name);
+            switch (stats[i].format)
+            {
+                case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_BOOL32_KHR:
+                    statistic->Value = stats[i].value.b32 == VK_TRUE ? 1.0 : 0.0;
+                    break;
+                case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_FLOAT64_KHR:
+                    statistic->Value = stats[i].value.f64;
+                    break;
+                case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR:
+                    statistic->Value = (double)stats[i].value.i64;
+                    break;
+                case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR:
+                    statistic->Value = (double)stats[i].value.u64;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    return true;
+}
+
+void ib_printPipelineExecutableReport(ib_PipelineExecutableReport const* report)
+{
+    for (uint32_t e = 0; e < report->ExecutableCount; e++)
+    {
+        ib_PipelineExecutable const* executable = &report->Executables[e];
+        printf("%s (Subgroup Size: %u)\n", executable->Name, executable->SubgroupSize);
+        for (uint32_t i = 0; i < executable->StatisticCount; i++)
+        {
+            printf("    %s: %g\n", executable->Statistics[i].Name, executable->Statistics[i].Value);
+        }
+    }
+}
+
+void ib_printComputePipelineStatistics(ib_Core* core, ib_ComputePipeline const* pipeline)
+{
+    ib_PipelineExecutableReport* report = (ib_PipelineExecutableReport*)malloc(sizeof(ib_PipelineExecutableReport));
+    if (ib_getPipelineExecutableReport(core, pipeline->VulkanPipeline, report))
+    {
+        printf("Compute Pipeline\n");
+        ib_printPipelineExecutableReport(report);
+    }
+    free(report);
+}
+
+// Baselines are text, one statistic per line: pipeline, executable, statistic and value separated by tabs.
+// Names are whatever the driver reports, so keep one baseline per vendor and driver.
+bool ib_savePipelineStatisticsBaseline(char const* path, ib_PipelineReportRange reports)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    for (uint32_t r = 0; r < reports.Count; r++)
+    {
+        ib_PipelineExecutableReport const* report = reports.Data[r].Report;
+        for (uint32_t e = 0; e < report->ExecutableCount; e++)
+        {
+            ib_PipelineExecutable const* executable = &report->Executables[e];
+            for (uint32_t i = 0; i < executable->StatisticCount; i++)
+            {
+                fprintf(file, "%s\t%s\t%s\t%.17g\n", reports.Data[r].Name, executable->Name, executable->Statistics[i].Name, executable->Statistics[i].Value);
+            }
+        }
+    }
+
+    return fclose(file) == 0;
+}
+
+static bool findBaselineStatistic(ib_PipelineReportRange reports, char const* pipelineName, char const* executableName, char const* statisticName, ib_PipelineStatisticChange* outChange)
+{
+    for (uint32_t r = 0; r < reports.Count; r++)
+    {
+        if (strcmp(reports.Data[r].Name, pipelineName) != 0)
+        {
+            continue;
+        }
+
+        ib_PipelineExecutableReport const* report = reports.Data[r].Report;
+        for (uint32_t e = 0; e < report->ExecutableCount; e++)
+        {
+            if (strcmp(report->Executables[e].Name, executableName) != 0)
+            {
+                continue;
+            }
+
+            for (uint32_t i = 0; i < report->Executables[e].StatisticCount; i++)
+            {
+                if (strcmp(report->Executables[e].Statistics[i].Name, statisticName) == 0)
+                {
+                    outChange->PipelineName = reports.Data[r].Name;
+                    outChange->ExecutableName = report->Executables[e].Name;
+                    outChange->Statistic = &report->Executables[e].Statistics[i];
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool ib_diffPipelineStatisticsBaseline(ib_DiffPipelineStatisticsDesc desc, uint32_t* outChangeCount)
+{
+    ib_assert(outChangeCount != NULL);
+    ib_assert(desc.OutChanges != NULL || desc.MaxChangeCount == 0);
+
+    *outChangeCount = 0;
+    FILE* file = fopen(desc.BaselinePath, "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char* pipelineName = strtok(line, "\t");
+        char* executableName = strtok(NULL, "\t");
+        char* statisticName = strtok(NULL, "\t");
+        char* value = strtok(NULL, "\t\n");
+        if (pipelineName == NULL || executableName == NULL || statisticName == NULL || value == NULL)
+        {
+            continue;
+        }
+
+        ib_PipelineStatisticChange change = { .BaselineValue = atof(value) };
+        if (!findBaselineStatistic(desc.Reports, pipelineName, executableName, statisticName, &change))
+        {
+            continue; // Pipeline wasn't part of this run or the driver stopped reporting the statistic.
+        }
+
+        // A zero baseline flags any change at all.
+        if (fabs(change.Statistic->Value - change.BaselineValue) > fabs(change.BaselineValue) * desc.Tolerance)
+        {
+            if (*outChangeCount < desc.MaxChangeCount)
+            {
+                desc.OutChanges[*outChangeCount] = change;
+            }
+            (*outChangeCount)++;
+        }
+    }
+
+    bool readFailed = ferror(file) != 0;
+    fclose(file);
+    return !readFailed;
+}
+
+// Timers
+void ib_initTimerManager(ib_TimerManagerDesc desc, ib_TimerManager* outManager)
+{
+    *outManager = (ib_TimerManager) { 0 };
+
+    outManager->MaxTimestampCount = desc.MaxTimerCount * 2;
+    ib_vkCheck(vkCreateQueryPool(desc.Core->LogicalDevice,
+                                 &(VkQueryPoolCreateInfo)
+                                 {
+                                     .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                                     .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                                     .queryCount = outManager->MaxTimestampCount,
+                                 }, ib_NoVkAllocator, &outManager->TimestampPool));
+    outManager->ResolvedTimestamps = (uint64_t*)malloc(sizeof(uint64_t) * outManager->MaxTimestampCount);
+
+    if (desc.MaxPipelineStatisticsCount > 0 && desc.Core->PipelineStatisticsEnabled)
+    {
+        // Order matches ib_PipelineStatistics, results are written in bit order.
+        VkQueryPipelineStatisticFlags const statistics =
+            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+            | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+            | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+            | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+            | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+            | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+        outManager->MaxPipelineStatisticsCount = desc.MaxPipelineStatisticsCount;
+        ib_vkCheck(vkCreateQueryPool(desc.Core->LogicalDevice,
+                                     &(VkQueryPoolCreateInfo)
+                                     {
+                                         .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                                         .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+                                         .queryCount = outManager->MaxPipelineStatisticsCount,
+                                         .pipelineStatistics = statistics
+                                     }, ib_NoVkAllocator, &outManager->PipelineStatisticsPool));
+        outManager->ResolvedPipelineStatistics = (ib_PipelineStatistics*)malloc(sizeof(ib_PipelineStatistics) * outManager->MaxPipelineStatisticsCount);
+    }
+}
+
+void ib_killTimerManager(ib_Core* core, ib_TimerManager* manager)
+{
+    vkDestroyQueryPool(core->LogicalDevice, manager->TimestampPool, ib_NoVkAllocator);
+    free(manager->ResolvedTimestamps);
+    if (manager->PipelineStatisticsPool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(core->LogicalDevice, manager->PipelineStatisticsPool, ib_NoVkAllocator);
+        free(manager->ResolvedPipelineStatistics);
+    }
+}
+
+void ib_resetTimers(ib_TimerManager* manager, VkCommandBuffer commandBuffer)
+{
+    vkCmdResetQueryPool(commandBuffer, manager->TimestampPool, 0, manager->MaxTimestampCount); // Reset all active timers
+    manager->NextTimestamp = 0;
+    if (manager->PipelineStatisticsPool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(commandBuffer, manager->PipelineStatisticsPool, 0, manager->MaxPipelineStatisticsCount);
+    }
+    manager->NextPipelineStatistics = 0;
+}
+
+void ib_resetTimersCPU(ib_Core* core, ib_TimerManager* manager)
+{
+    vkResetQueryPool(core->LogicalDevice, manager->TimestampPool, 0, manager->MaxTimestampCount);
+    manager->NextTimestamp = 0;
+    if (manager->PipelineStatisticsPool != VK_NULL_HANDLE)
+    {
+        vkResetQueryPool(core->LogicalDevice, manager->PipelineStatisticsPool, 0, manager->MaxPipelineStatisticsCount);
+    }
+    manager->NextPipelineStatistics = 0;
+}
+
+ib_Timer ib_beginTimer(ib_TimerManager* manager, VkCommandBuffer commandBuffer)
+{
+    ib_assert(manager->NextTimestamp < manager->MaxTimestampCount);
+
+    ib_Timer timer = { manager->NextTimestamp };
+    manager->NextTimestamp += 2;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, manager->TimestampPool, timer.TimestampIndex);
+
+    return timer;
+}
+
+void ib_endTimer(ib_TimerManager* manager, VkCommandBuffer commandBuffer, ib_Timer* timer)
+{
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, manager->TimestampPool, timer->TimestampIndex + 1);
+}
+
+bool ib_queryTimerRange(ib_Core* core, ib_TimerManager* manager, ib_Timer const* timer, bool blocking, double* outBegin, double* outEnd)
+{
+    uint32_t flags = VK_QUERY_RESULT_64_BIT;
+    if (blocking)
+    {
+        flags |= VK_QUERY_RESULT_WAIT_BIT;
+    }
+    uint64_t timestamps[2];
+    VkResult result = vkGetQueryPoolResults(core->LogicalDevice, manager->TimestampPool, timer->TimestampIndex, 2, sizeof(uint64_t) * 2, timestamps, sizeof(uint64_t), flags);
+
+    if (result == VK_NOT_READY)
+    {
+        return false;
+    }
+
+    // nanoseconds to milliseconds
+    *outBegin = (double)timestamps[0] * core->DeviceLimits.timestampPeriod / 1000000.0;
+    *outEnd = (double)timestamps[1] * core->DeviceLimits.timestampPeriod / 1000000.0;
+    return true;
+}
+
+double ib_queryTimer(ib_Core* core, ib_TimerManager* manager, ib_Timer const* timer, bool blocking)
+{
+    uint32_t flags = VK_QUERY_RESULT_64_BIT;
+    if (blocking)
+    {
+        flags |= VK_QUERY_RESULT_WAIT_BIT;
+    }
+    uint64_t timestamps[2];
+    VkResult result = vkGetQueryPoolResults(core->LogicalDevice, manager->TimestampPool, timer->TimestampIndex, 2, sizeof(uint64_t) * 2, timestamps, sizeof(uint64_t), flags);
+	
+    if (result == VK_NOT_READY)
+    {
+        return ib_TimerQueryNotReady;
+    }
+    else
+    {
+        double duration = (double)(timestamps[1] - timestamps[0]) * core->DeviceLimits.timestampPeriod;
+        duration /= 1000000.0; // nanoseconds to milliseconds
+
+        return duration;
+    }
+}
+
+ib_PipelineStatisticsQuery ib_beginPipelineStatistics(ib_TimerManager* manager, VkCommandBuffer commandBuffer)
+{
+    ib_assert(manager->PipelineStatisticsPool != VK_NULL_HANDLE);
+    ib_assert(manager->NextPipelineStatistics < manager->MaxPipelineStatisticsCount);
+
+    ib_PipelineStatisticsQuery query = { manager->NextPipelineStatistics++ };
+    vkCmdBeginQuery(commandBuffer, manager->PipelineStatisticsPool, query.QueryIndex, 0);
+    return query;
+}
+
+void ib_endPipelineStatistics(ib_TimerManager* manager, VkCommandBuffer commandBuffer, ib_PipelineStatisticsQuery const* query)
+{
+    vkCmdEndQuery(commandBuffer, manager->PipelineStatisticsPool, query->QueryIndex);
+}
+
+bool ib_resolveTimers(ib_Core* core, ib_TimerManager* manager, bool blocking)
+{
+    uint32_t flags = VK_QUERY_RESULT_64_BIT;
+    if (blocking)
+    {
+        flags |= VK_QUERY_RESULT_WAIT_BIT;
+    }
+
+    if (manager->NextTimestamp > 0)
+    {
+        VkResult result = vkGetQueryPoolResults(core->LogicalDevice, manager->TimestampPool, 0, manager->NextTimestamp,
+                                                sizeof(uint64_t) * manager->NextTimestamp, manager->ResolvedTimestamps, sizeof(uint64_t), flags);
+        if (result == VK_NOT_READY)
+        {
+            return false;
+        }
+    }
+
+    if (manager->NextPipelineStatistics > 0)
+    {
+        VkResult result = vkGetQueryPoolResults(core->LogicalDevice, manager->PipelineStatisticsPool, 0, manager->NextPipelineStatistics,
+                                                sizeof(ib_PipelineStatistics) * manager->NextPipelineStatistics, manager->ResolvedPipelineStatistics,
+                                                sizeof(ib_PipelineStatistics), flags);
+        if (result == VK_NOT_READY)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ib_getResolvedTimerRange(ib_Core* core, ib_TimerManager const* manager, ib_Timer const* timer, double* outBegin, double* outEnd)
+{
+    ib_assert(timer->TimestampIndex + 1 < manager->NextTimestamp);
+
+    // nanoseconds to milliseconds
+    *outBegin = (double)manager->ResolvedTimestamps[timer->TimestampIndex] * core->DeviceLimits.timestampPeriod / 1000000.0;
+    *outEnd = (double)manager->ResolvedTimestamps[timer->TimestampIndex + 1] * core->DeviceLimits.timestampPeriod / 1000000.0;
+}
+
+ib_PipelineStatistics ib_getResolvedPipelineStatistics(ib_TimerManager const* manager, ib_PipelineStatisticsQuery const* query)
+{
+    ib_assert(query->QueryIndex < manager->NextPipelineStatistics);
+    return manager->ResolvedPipelineStatistics[query->QueryIndex];
+}
+
+bool ib_calibrateTimestamps(ib_Core* core, ib_TimestampCalibration* outCalibration)
+{
+    if (!core->CalibratedTimestampsEnabled)
+    {
+        return false;
+    }
+
+    VkCalibratedTimestampInfoEXT timestampInfos[2] =
+    {
+        {
+            .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,
+            .timeDomain = VK_TIME_DOMAIN_DEVICE_EXT
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,
+            .timeDomain = ib_CPUTimeDomain
+        }
+    };
+
+    uint64_t timestamps[2];
+    uint64_t maxDeviation;
+    if (ib_vkGetCalibratedTimestampsEXT(core->LogicalDevice, ib_arrayCount(timestampInfos), timestampInfos, timestamps, &maxDeviation) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    // Device ticks to milliseconds, same units as ib_getResolvedTimerRange.
+    *outCalibration = (ib_TimestampCalibration)
+    {
+        .GPUTime = (double)timestamps[0] * core->DeviceLimits.timestampPeriod / 1000000.0,
+        .CPUTicks = timestamps[1],
+        .MaxDeviation = (double)maxDeviation / 1000000.0
+    };
+    return true;
+}
+
+// Raytracing
+
+PFN_vkCreateAccelerationStructureKHR ib_vkCreateAccelerationStructureKHR;
+PFN_vkDestroyAccelerationStructureKHR ib_vkDestroyAccelerationStructureKHR;
+PFN_vkCmdBuildAccelerationStructuresKHR ib_vkCmdBuildAccelerationStructuresKHR;
+PFN_vkGetAccelerationStructureDeviceAddressKHR ib_vkGetAccelerationStructureDeviceAddressKHR;
+PFN_vkGetAccelerationStructureBuildSizesKHR ib_vkGetAccelerationStructureBuildSizesKHR;
+PFN_vkCmdWriteAccelerationStructuresPropertiesKHR ib_vkCmdWriteAccelerationStructuresPropertiesKHR;
+PFN_vkCmdCopyAccelerationStructureKHR ib_vkCmdCopyAccelerationStructureKHR;
+PFN_vkCreateRayTracingPipelinesKHR ib_vkCreateRayTracingPipelinesKHR;
+PFN_vkGetRayTracingShaderGroupHandlesKHR ib_vkGetRayTracingShaderGroupHandlesKHR;
+PFN_vkCmdTraceRaysKHR ib_vkCmdTraceRaysKHR;
+
+VkResult VKAPI_CALL vkCreateAccelerationStructureKHR(
+    VkDevice device,
+    const VkAccelerationStructureCreateInfoKHR* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator,
+    VkAccelerationStructureKHR* pAccelerationStructure)
+{
+    if (ib_vkCreateAccelerationStructureKHR == NULL)
+    {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    return ib_vkCreateAccelerationStructureKHR(
+        device,
+        pCreateInfo,
+        pAllocator,
+        pAccelerationStructure);
+}
+
+void VKAPI_CALL vkDestroyAccelerationStructureKHR(
+    VkDevice device,
+    VkAccelerationStructureKHR accelerationStructure,
+    const VkAllocationCallbacks* pAllocator)
+{
+    if (ib_vkDestroyAccelerationStructureKHR == NULL)
+    {
+        ib_vkCheck(VK_ERROR_EXTENSION_NOT_PRESENT);
+        return;
+    }
+
+    ib_vkDestroyAccelerationStructureKHR(
+        device,
+        accelerationStructure,
+        pAllocator);
+}
+
+void VKAPI_CALL vkCmdBuildAccelerationStructuresKHR(
+    VkCommandBuffer commandBuffer,
+    uint32_t infoCount,
+    const VkAccelerationStructureBuildGeometryInfoKHR* pInfos,
+    const VkAccelerationStructureBuildRangeInfoKHR * const* ppBuildRangeInfos)
+{
+    if (ib_vkCmdBuildAccelerationStructuresKHR == NULL)
+    {
+        ib_vkCheck(VK_ERROR_EXTENSION_NOT_PRESENT);
+        return;
+    }
+
+    ib_vkCmdBuildAccelerationStructuresKHR(
+        commandBuffer,
+        infoCount,
+        pInfos,
+        ppBuildRangeInfos
+    );
+}
+
+VkDeviceAddress VKAPI_CALL vkGetAccelerationStructureDeviceAddressKHR(
+    VkDevice device,
+    const VkAccelerationStructureDeviceAddressInfoKHR* pInfo)
+{
+    if (ib_vkGetAccelerationStructureDeviceAddressKHR == NULL)
+    {
+        ib_vkCheck(VK_ERROR_EXTENSION_NOT_PRESENT);
+        return 0;
+    }
+
+    return ib_vkGetAccelerationStructureDeviceAddressKHR(
+        device,
+        pInfo);
+}
+
+void VKAPI_CALL vkGetAccelerationStructureBuildSizesKHR(
+    VkDevice device,
+    VkAccelerationStructureBuildTypeKHR buildType,
+    const VkAccelerationStructureBuildGeometryInfoKHR* pBuildInfo,
+    const uint32_t* pMaxPrimitiveCounts,
+    VkAccelerationStructureBuildSizesInfoKHR* pSizeInfo)
+{
+    if (ib_vkGetAccelerationStructureBuildSizesKHR == NULL)
+    {
+        ib_vkCheck(VK_ERROR_EXTENSION_NOT_PRESENT);
+        return;
+    }
+
+    ib_vkGetAccelerationStructureBuildSizesKHR(
+        device,
+        buildType,
+        pBuildInfo,
+        pMaxPrimitiveCounts,
+        pSizeInfo);
+}
+
+void VKAPI_CALL vkCmdWriteAccelerationStructuresPropertiesKHR(
+    VkCommandBuffer commandBuffer,
+    uint32_t accelerationStructureCount,
+    const VkAccelerationStructureKHR* pAccelerationStructures,
+    VkQueryType queryType,
+    VkQueryPool queryPool,
+    uint32_t firstQuery)
+{
+    if (ib_vkCmdWriteAccelerationStructuresPropertiesKHR == NULL)
+    {
+        ib_vkCheck(VK_ERROR_EXTENSION_NOT_PRESENT);
+        return;
+    }
+
+    ib_vkCmdWriteAccelerationStructuresPropertiesKHR(
+        commandBuffer,
+        accelerationStructureCount,
+        pAccelerationStructures,
+        queryType,
+        queryPool,
+        firstQuery);
+}
+
+void VKAPI_CALL vkCmdCopyAccelerationStructureKHR(
+    VkCommandBuffer commandBuffer,
+    const VkCopyAccelerationStructureInfoKHR* pInfo)
+{
+    if (ib_vkCmdCopyAccelerationStructureKHR == NULL)
+    {
+        ib_vkCheck(VK_ERROR_EXTENSION_NOT_PRESENT);
+        return;
+    }
+
+    ib_vkCmdCopyAccelerationStructureKHR(
+        commandBuffer,
+        pInfo);
+}
+
+VkResult VKAPI_CALL vkCreateRayTracingPipelinesKHR(
+    VkDevice device,
+    VkDeferredOperationKHR deferredOperation,
+    VkPipelineCache pipelineCache,
+    uint32_t createInfoCount,
+    const VkRayTracingPipelineCreateInfoKHR* pCreateInfos,
+    const VkAllocationCallbacks* pAllocator,
+    VkPipeline* pPipelines)
+{
+    if (ib_vkCreateRayTracingPipelinesKHR == NULL)
+    {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    return ib_vkCreateRayTracingPipelinesKHR(
+        device,
+        deferredOperation,
+        pipelineCache,
+        createInfoCount,
+        pCreateInfos,
+        pAllocator,
+        pPipelines);
+}
+
+VkResult VKAPI_CALL vkGetRayTracingShaderGroupHandlesKHR(
+    VkDevice device,
+    VkPipeline pipeline,
+    uint32_t firstGroup,
+    uint32_t groupCount,
+    size_t dataSize,
+    void* pData)
+{
+    if (ib_vkGetRayTracingShaderGroupHandlesKHR == NULL)
+    {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+
+    return ib_vkGetRayTracingShaderGroupHandlesKHR(
+        device,
+        pipeline,
+        firstGroup,
+        groupCount,
+        dataSize,
+        pData);
+}
+
+void VKAPI_CALL vkCmdTraceRaysKHR(
+    VkCommandBuffer commandBuffer,
+    const VkStridedDeviceAddressRegionKHR* pRaygenShaderBindingTable,
+    const VkStridedDeviceAddressRegionKHR* pMissShaderBindingTable,
+    const VkStridedDeviceAddressRegionKHR* pHitShaderBindingTable,
+    const VkStridedDeviceAddressRegionKHR* pCallableShaderBindingTable,
+    uint32_t width,
+    uint32_t height,
+    uint32_t depth)
+{
+    if (ib_vkCmdTraceRaysKHR == NULL)
+    {
+        ib_vkCheck(VK_ERROR_EXTENSION_NOT_PRESENT);
+        return;
+    }
+
+    ib_vkCmdTraceRaysKHR(
+        commandBuffer,
+        pRaygenShaderBindingTable,
+        pMissShaderBindingTable,
+        pHitShaderBindingTable,
+        pCallableShaderBindingTable,
+        width,
+        height,
+        depth);
+}
+
+static iba_PageHeader* allocRaytracingStagingMemoryPage(void* userData, size_t pageSize)
+{
+    StackGpuMemoryPage* page = calloc(1, sizeof(StackGpuMemoryPage));
+
+    ib_Raytracing* raytracing = (ib_Raytracing*)userData;
+    VkDevice logicalDevice = raytracing->Core->LogicalDevice;
+    VkBufferCreateInfo bufferCreate =
+    {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = pageSize,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+    };
+    ib_vkCheck(vkCreateBuffer(logicalDevice, &bufferCreate, ib_NoVkAllocator, &page->Buffer));
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(logicalDevice, page->Buffer, &memoryRequirements);
+
+    page->PageAlloc = iba_gpuAlloc(&raytracing->Core->Allocator, (iba_GpuAllocationRequest)
+                                   {
+                                       .Size = pageSize,
+                                       .Alignment = raytracing->AccelerationStructureScratchBufferAlignment,
+                                       .TypeBits = memoryRequirements.memoryTypeBits,
+                                       .RequiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                   });
+
+    ib_vkCheck(vkBindBufferMemory(logicalDevice, page->Buffer, page->PageAlloc.Memory, page->PageAlloc.Offset));
+
+    return &page->Header;
+}
+
+static void freeRaytracingStagingMemoryPage(void* userData, iba_PageHeader* pageHeader)
+{
+    ib_Raytracing* raytracing = (ib_Raytracing*)userData;
+    StackGpuMemoryPage* page = (StackGpuMemoryPage*)pageHeader;
+
+    vkDestroyBuffer(raytracing->Core->LogicalDevice, page->Buffer, ib_NoVkAllocator);
+    iba_gpuFree(&raytracing->Core->Allocator, &page->PageAlloc);
+    free(page);
+}
+
+void ib_initRaytracing(ib_Core* core, ib_Raytracing* raytracing)
+{
+    raytracing->Core = core;
+
+    ib_vkCreateAccelerationStructureKHR = ib_getVulkanFunc(core->Instance, vkCreateAccelerationStructureKHR);
+    ib_vkDestroyAccelerationStructureKHR = ib_getVulkanFunc(core->Instance, vkDestroyAccelerationStructureKHR);
+    ib_vkCmdBuildAccelerationStructuresKHR = ib_getVulkanFunc(core->Instance, vkCmdBuildAccelerationStructuresKHR);
+    ib_vkGetAccelerationStructureDeviceAddressKHR = ib_getVulkanFunc(core->Instance, vkGetAccelerationStructureDeviceAddressKHR);
+    ib_vkGetAccelerationStructureBuildSizesKHR = ib_getVulkanFunc(core->Instance, vkGetAccelerationStructureBuildSizesKHR);
+    ib_vkCmdWriteAccelerationStructuresPropertiesKHR = ib_getVulkanFunc(core->Instance, vkCmdWriteAccelerationStructuresPropertiesKHR);
+    ib_vkCmdCopyAccelerationStructureKHR = ib_getVulkanFunc(core->Instance, vkCmdCopyAccelerationStructureKHR);
+    ib_vkCreateRayTracingPipelinesKHR = ib_getVulkanFunc(core->Instance, vkCreateRayTracingPipelinesKHR);
+    ib_vkGetRayTracingShaderGroupHandlesKHR = ib_getVulkanFunc(core->Instance, vkGetRayTracingShaderGroupHandlesKHR);
+    ib_vkCmdTraceRaysKHR = ib_getVulkanFunc(core->Instance, vkCmdTraceRaysKHR);
+
+    VkPhysicalDeviceRayTracingPipelinePropertiesKHR pipelineProps = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR,
+    };
+    VkPhysicalDeviceAccelerationStructurePropertiesKHR asProps = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR,
+        .pNext = &pipelineProps
+    };
+    vkGetPhysicalDeviceProperties2(core->PhysicalDevice, &(VkPhysicalDeviceProperties2)
+                                   {
+                                       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+                                       .pNext = &asProps
+                                   });
+    raytracing->AccelerationStructureScratchBufferAlignment = asProps.minAccelerationStructureScratchOffsetAlignment;
+    raytracing->ShaderGroupHandleSize = pipelineProps.shaderGroupHandleSize;
+    raytracing->ShaderGroupHandleAlignment = pipelineProps.shaderGroupHandleAlignment;
+    raytracing->ShaderGroupBaseAlignment = pipelineProps.shaderGroupBaseAlignment;
+    raytracing->MaxRayRecursionDepth = pipelineProps.maxRayRecursionDepth;
+}
+
+void ib_killRaytracing(ib_Raytracing* raytracing)
+{
+    // Nothing to do here. Function exists for symmetry for now.
+    ib_potentiallyUnused(raytracing);
+}
+
+
+void ib_initRaytracingScratch(ib_Raytracing* raytracing, iba_StackAllocator* allocator)
+{
+    iba_StackAllocatorDesc createInfo = {
+        .PageAllocator = {
+            .AllocPage = &allocRaytracingStagingMemoryPage,
+            .FreePage = &freeRaytracingStagingMemoryPage,
+            .UserData = raytracing
+        },
+        .PageSize = 1024 * 1024 * 256
+    };
+    iba_initStackAllocator(createInfo, allocator);
+}
+
+void ib_killRaytracingScratch(iba_StackAllocator* allocator)
+{
+    iba_killStackAllocator(allocator);
+}
+
+static ib_AccelerationStructureData allocAccelerationStructureData(ib_Raytracing* raytracing, VkAccelerationStructureTypeKHR type, VkDeviceSize size)
+{
+    ib_AccelerationStructureData out = { 0 };
+    out.Buffer = ib_allocBuffer(raytracing->Core, (ib_BufferDesc)
+                                {
+                                    .Usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                    .Size = size,
+                                    .RequiredMemoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
                                 });
 
-    iba_StackAllocation allocation = iba_stackAlloc(scratchMemoryStack, (iba_StackAllocationRequest) {
-        .Alignment = raytracing->AccelerationStructureScratchBufferAlignment,
-        .Size = sizesInfo.buildScratchSize,
-    });
-   
-    StackGpuMemoryPage* page = (StackGpuMemoryPage*)allocation.Page;
-   
-    VkBufferDeviceAddressInfo addressQueryInfo = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-        .buffer = page->Buffer,
-    };
-    VkDeviceAddress stagingAddress = vkGetBufferDeviceAddressKHR(raytracing->Core->LogicalDevice, &addressQueryInfo) + allocation.Offset;
+    VkAccelerationStructureCreateInfoKHR createASInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
+        .type = type,
+        .buffer = out.Buffer.VulkanBuffer,
+        .size = size,
+    };
+
+    ib_vkCheck(vkCreateAccelerationStructureKHR(
+        raytracing->Core->LogicalDevice,
+        &createASInfo,
+        ib_NoVkAllocator,
+        &out.AccelerationStructure));
+
+    VkAccelerationStructureDeviceAddressInfoKHR ASAddressQueryInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR,
+        .accelerationStructure = out.AccelerationStructure
+    };
+    out.Address = vkGetAccelerationStructureDeviceAddressKHR(raytracing->Core->LogicalDevice, &ASAddressQueryInfo);
+    return out;
+}
+
+static void keepAccelerationStructureBuildState(ib_AccelerationStructureData* data, VkAccelerationStructureBuildGeometryInfoKHR const* buildInfo, VkAccelerationStructureBuildSizesInfoKHR const* sizesInfo, uint32_t maxPrimitiveCount, uint32_t primitiveCount)
+{
+    data->Flags = buildInfo->flags;
+    data->BuildScratchSize = sizesInfo->buildScratchSize;
+    data->UpdateScratchSize = sizesInfo->updateScratchSize;
+    data->MaxPrimitiveCount = maxPrimitiveCount;
+    data->PrimitiveCount = primitiveCount;
+}
+
+static void freeAccelerationStructureData(ib_Raytracing* raytracing, ib_AccelerationStructureData* data)
+{
+    vkDestroyAccelerationStructureKHR(raytracing->Core->LogicalDevice, data->AccelerationStructure, ib_NoVkAllocator);
+    ib_freeBuffer(raytracing->Core, &data->Buffer);
+}
+
+// Orders the work after the previous build on the semaphore and signals the next value.
+static void submitAccelerationStructureCommands(ib_Raytracing* raytracing, VkCommandBuffer cmd, ib_timelineSemaphore* buildingSemaphore)
+{
+    VkSubmitInfo2 submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = &(VkCommandBufferSubmitInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+            .commandBuffer = cmd
+        },
+        .waitSemaphoreInfoCount = 1,
+        .pWaitSemaphoreInfos = &(VkSemaphoreSubmitInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = buildingSemaphore->Semaphore,
+            .value = buildingSemaphore->LastSignalValue,
+            .stageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+        },
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos = &(VkSemaphoreSubmitInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = buildingSemaphore->Semaphore,
+            .value = ++buildingSemaphore->LastSignalValue,
+            .stageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+        },
+    };
+
+    ib_vkCheck(vkQueueSubmit2(raytracing->Core->Queues[ib_Queue_Graphics].Queue, 1, &submitInfo, VK_NULL_HANDLE));
+}
+
+static ib_AccelerationStructureData buildAccelerationStructureInternal(
+    ib_Raytracing* raytracing,
+    VkAccelerationStructureBuildGeometryInfoKHR* buildInfo,
+    uint32_t* primitiveCount,
+    uint32_t maxPrimitiveCount,
+    iba_StackAllocator* scratchMemoryStack,
+    ib_timelineSemaphore* buildingSemaphore)
+{
+    VkAccelerationStructureBuildSizesInfoKHR sizesInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR
+    };
+
+    maxPrimitiveCount = ib_max(maxPrimitiveCount, *primitiveCount);
+    vkGetAccelerationStructureBuildSizesKHR(
+        raytracing->Core->LogicalDevice,
+        VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+        buildInfo,
+        &maxPrimitiveCount,
+        &sizesInfo);
+
+    ib_AccelerationStructureData out = allocAccelerationStructureData(raytracing, VK_ACCELERATION_STRUCTURE_TYPE_GENERIC_KHR, sizesInfo.accelerationStructureSize);
+    keepAccelerationStructureBuildState(&out, buildInfo, &sizesInfo, maxPrimitiveCount, *primitiveCount);
+
+    iba_StackAllocation allocation = iba_stackAlloc(scratchMemoryStack, (iba_StackAllocationRequest) {
+        .Alignment = raytracing->AccelerationStructureScratchBufferAlignment,
+        .Size = sizesInfo.buildScratchSize,
+    });
+   
+    StackGpuMemoryPage* page = (StackGpuMemoryPage*)allocation.Page;
+   
+    VkBufferDeviceAddressInfo addressQueryInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .buffer = page->Buffer,
+    };
+    VkDeviceAddress stagingAddress = vkGetBufferDeviceAddressKHR(raytracing->Core->LogicalDevice, &addressQueryInfo) + allocation.Offset;
+
+    buildInfo->dstAccelerationStructure = out.AccelerationStructure;
+    buildInfo->scratchData.deviceAddress = stagingAddress;
+
+    VkAccelerationStructureBuildRangeInfoKHR rangeInfo = (VkAccelerationStructureBuildRangeInfoKHR)
+    {
+        .firstVertex = 0,
+        .primitiveCount = *primitiveCount,
+        .primitiveOffset = 0,
+        .transformOffset = 0
+    };
+    VkAccelerationStructureBuildRangeInfoKHR* pRangeInfo = &rangeInfo;
+
+    VkCommandBuffer cmd = ib_allocCommandBuffer(raytracing->Core, (ib_AllocCommandBufferDesc) { .Queue = ib_Queue_Graphics });
+    VkCommandBufferBeginInfo beginBufferInfo =
+    {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+
+    ib_vkCheck(vkBeginCommandBuffer(cmd, &beginBufferInfo));
+
+    vkCmdBuildAccelerationStructuresKHR(cmd, 1, buildInfo, &pRangeInfo);
+
+    ib_vkCheck(vkEndCommandBuffer(cmd));
+    submitAccelerationStructureCommands(raytracing, cmd, buildingSemaphore);
+    return out;
+}
+
+static VkAccelerationStructureGeometryKHR toBLASGeometry(ib_BLASDesc const* desc)
+{
+    ib_assert(desc->Triangles.Vertices != NULL && desc->Triangles.Indices != NULL);
+
+    VkAccelerationStructureGeometryTrianglesDataKHR trianglesGeometry = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR,
+        .vertexData.deviceAddress = desc->Triangles.Vertices->DeviceAddress,
+        .vertexFormat = desc->Triangles.VertexFormat,
+        .vertexStride = desc->Triangles.VertexStride,
+        .maxVertex = desc->Triangles.VertexCount - 1,
+        .indexData.deviceAddress = desc->Triangles.Indices->DeviceAddress,
+        .indexType = desc->Triangles.IndexType
+    };
+
+    return (VkAccelerationStructureGeometryKHR) {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+        .flags = desc->GeometryFlags,
+        .geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR,
+        .geometry.triangles = trianglesGeometry
+    };
+}
+
+ib_BLAS ib_allocBLAS(ib_Raytracing* raytracing, ib_BLASDesc desc, iba_StackAllocator* scratchMemoryStack, ib_timelineSemaphore* buildingSemaphore)
+{
+    VkAccelerationStructureGeometryKHR ASGeometry = toBLASGeometry(&desc);
+
+    VkAccelerationStructureBuildGeometryInfoKHR BLASBuildInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+        .type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+        .flags = desc.AccelerationStructureFlags | (desc.AllowUpdate ? VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR : 0),
+        .mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+        .geometryCount = 1,
+        .pGeometries = &ASGeometry,
+    };
+
+    ib_BLAS blas = { 0 };
+    blas.Data = buildAccelerationStructureInternal(
+        raytracing,
+        &BLASBuildInfo,
+        &desc.Triangles.TrianglesCount,
+        0,
+        scratchMemoryStack,
+        buildingSemaphore);
+    return blas;
+}
+
+static VkAccelerationStructureGeometryKHR toTLASGeometry(ib_TLASDesc const* desc)
+{
+    ib_assert(desc->InstancesBuffer != NULL);
+
+    return (VkAccelerationStructureGeometryKHR) {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+        .geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR,
+        .geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR,
+        .geometry.instances.arrayOfPointers = VK_FALSE,
+        .geometry.instances.data.deviceAddress = desc->InstancesBuffer->DeviceAddress
+    };
+}
+
+ib_TLAS ib_allocTLAS(ib_Raytracing* raytracing, ib_TLASDesc desc, iba_StackAllocator* scratchMemoryStack, ib_timelineSemaphore* buildingSemaphore)
+{
+    VkAccelerationStructureGeometryKHR ASGeometry = toTLASGeometry(&desc);
+
+    VkAccelerationStructureBuildGeometryInfoKHR TLASBuildInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+        .type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+        .flags = desc.AccelerationStructureFlags | (desc.AllowUpdate ? VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR : 0),
+        .mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+        .geometryCount = 1,
+        .pGeometries = &ASGeometry
+    };
+
+    ib_TLAS tlas = { 0 };
+    tlas.Data = buildAccelerationStructureInternal(
+        raytracing,
+        &TLASBuildInfo,
+        &desc.InstancesCount,
+        desc.MaxInstancesCount,
+        scratchMemoryStack,
+        buildingSemaphore);
+    return tlas;
+}
+
+void ib_freeBLAS(ib_Raytracing* raytracing, ib_BLAS* accelerationStructure)
+{
+    vkDestroyAccelerationStructureKHR(raytracing->Core->LogicalDevice, accelerationStructure->Data.AccelerationStructure, ib_NoVkAllocator);
+    ib_freeBuffer(raytracing->Core, &accelerationStructure->Data.Buffer);
+}
+
+void ib_freeTLAS(ib_Raytracing* raytracing, ib_TLAS* accelerationStructure)
+{
+    vkDestroyAccelerationStructureKHR(raytracing->Core->LogicalDevice, accelerationStructure->Data.AccelerationStructure, ib_NoVkAllocator);
+    ib_freeBuffer(raytracing->Core, &accelerationStructure->Data.Buffer);
+}
+
+static VkDeviceSize alignDeviceSize(VkDeviceSize size, VkDeviceSize alignment)
+{
+    return alignment > 0 ? (size + alignment - 1) / alignment * alignment : size;
+}
+
+static void recordAccelerationStructureBuildBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
+{
+    VkMemoryBarrier2 barrier =
+    {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        .srcAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+        .dstStageMask = dstStage,
+        .dstAccessMask = dstAccess
+    };
+    vkCmdPipelineBarrier2(cmd, &(VkDependencyInfo)
+                          {
+                              .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+                              .memoryBarrierCount = 1,
+                              .pMemoryBarriers = &barrier
+                          });
+}
+
+ib_BLASBatchStats ib_buildBLASBatch(ib_Raytracing* raytracing, ib_BLASBatchDesc desc)
+{
+    ib_Core* core = raytracing->Core;
+    uint32_t buildCount = desc.Descs.Count;
+    ib_assert(desc.OutBLASes != NULL && desc.BuildingSemaphore != NULL);
+
+    ib_BLASBatchStats stats = { 0 };
+    if (buildCount == 0)
+    {
+        return stats;
+    }
+
+    VkDeviceSize maxScratchSize = desc.MaxScratchSize > 0 ? desc.MaxScratchSize : ib_DefaultBLASBatchScratchSize;
+    VkDeviceSize scratchAlignment = raytracing->AccelerationStructureScratchBufferAlignment;
+
+    VkAccelerationStructureGeometryKHR* geometries = (VkAccelerationStructureGeometryKHR*)malloc(sizeof(VkAccelerationStructureGeometryKHR) * buildCount);
+    VkAccelerationStructureBuildGeometryInfoKHR* buildInfos = (VkAccelerationStructureBuildGeometryInfoKHR*)malloc(sizeof(VkAccelerationStructureBuildGeometryInfoKHR) * buildCount);
+    VkAccelerationStructureBuildRangeInfoKHR* ranges = (VkAccelerationStructureBuildRangeInfoKHR*)malloc(sizeof(VkAccelerationStructureBuildRangeInfoKHR) * buildCount);
+    VkAccelerationStructureBuildRangeInfoKHR const** rangePtrs = (VkAccelerationStructureBuildRangeInfoKHR const**)malloc(sizeof(VkAccelerationStructureBuildRangeInfoKHR*) * buildCount);
+    VkDeviceSize* scratchOffsets = (VkDeviceSize*)malloc(sizeof(VkDeviceSize) * buildCount);
+    VkDeviceSize* builtSizes = (VkDeviceSize*)malloc(sizeof(VkDeviceSize) * buildCount);
+    uint32_t* compactIndices = (uint32_t*)malloc(sizeof(uint32_t) * buildCount);
+    uint32_t compactCount = 0;
+    uint32_t* groupEnds = (uint32_t*)malloc(sizeof(uint32_t) * buildCount); // One past the last build of each build call
+
+    // Size everything up front. Builds are packed into one build call until their scratch no longer fits,
+    // the next call reuses the scratch from the start once the previous call is done with it.
+    VkDeviceSize groupScratchSize = 0;
+    for (uint32_t i = 0; i < buildCount; i++)
+    {
+        ib_BLASDesc const* blasDesc = &desc.Descs.Data[i];
+        // A full rebuild wouldn't fit in the compacted copy, updatable BLASes keep their build size.
+        bool compact = desc.Compact && !blasDesc->AllowUpdate;
+        if (compact)
+        {
+            compactIndices[compactCount++] = i;
+        }
+
+        geometries[i] = toBLASGeometry(blasDesc);
+        buildInfos[i] = (VkAccelerationStructureBuildGeometryInfoKHR)
+        {
+            .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+            .type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+            .flags = blasDesc->AccelerationStructureFlags
+                | (compact ? VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR : 0)
+                | (blasDesc->AllowUpdate ? VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR : 0),
+            .mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+            .geometryCount = 1,
+            .pGeometries = &geometries[i],
+        };
+        ranges[i] = (VkAccelerationStructureBuildRangeInfoKHR) { .primitiveCount = blasDesc->Triangles.TrianglesCount };
+        rangePtrs[i] = &ranges[i];
+
+        VkAccelerationStructureBuildSizesInfoKHR sizesInfo = { .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR };
+        vkGetAccelerationStructureBuildSizesKHR(core->LogicalDevice, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfos[i], &blasDesc->Triangles.TrianglesCount, &sizesInfo);
+
+        desc.OutBLASes[i].Data = allocAccelerationStructureData(raytracing, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizesInfo.accelerationStructureSize);
+        buildInfos[i].dstAccelerationStructure = desc.OutBLASes[i].Data.AccelerationStructure;
+        keepAccelerationStructureBuildState(&desc.OutBLASes[i].Data, &buildInfos[i], &sizesInfo, ranges[i].primitiveCount, ranges[i].primitiveCount);
+        builtSizes[i] = sizesInfo.accelerationStructureSize;
+        stats.BuiltSize += sizesInfo.accelerationStructureSize;
+
+        VkDeviceSize buildScratchSize = alignDeviceSize(sizesInfo.buildScratchSize, scratchAlignment);
+        if (i > 0 && groupScratchSize + buildScratchSize > maxScratchSize)
+        {
+            groupEnds[stats.BuildCallCount++] = i;
+            groupScratchSize = 0;
+        }
+        scratchOffsets[i] = groupScratchSize;
+        groupScratchSize += buildScratchSize;
+        stats.ScratchSize = ib_max(stats.ScratchSize, groupScratchSize);
+    }
+    groupEnds[stats.BuildCallCount++] = buildCount;
+
+    // Over allocate so the base address can be aligned, buffers are only guaranteed their memory alignment.
+    ib_Buffer scratch = ib_allocBuffer(core, (ib_BufferDesc)
+                                       {
+                                           .Usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                           .Size = (size_t)(stats.ScratchSize + scratchAlignment),
+                                           .RequiredMemoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                           .DebugName = "BLAS Batch Scratch"
+                                       });
+    VkDeviceAddress scratchAddress = alignDeviceSize(scratch.DeviceAddress, scratchAlignment);
+    for (uint32_t i = 0; i < buildCount; i++)
+    {
+        buildInfos[i].scratchData.deviceAddress = scratchAddress + scratchOffsets[i];
+    }
+
+    VkQueryPool compactedSizePool = VK_NULL_HANDLE;
+    if (compactCount > 0)
+    {
+        ib_vkCheck(vkCreateQueryPool(core->LogicalDevice,
+                                     &(VkQueryPoolCreateInfo)
+                                     {
+                                         .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                                         .queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+                                         .queryCount = compactCount,
+                                     }, ib_NoVkAllocator, &compactedSizePool));
+    }
+
+    VkCommandBuffer cmd = ib_allocAndBeginCommandBuffer(core, ib_Queue_Graphics);
+    if (compactCount > 0)
+    {
+        vkCmdResetQueryPool(cmd, compactedSizePool, 0, compactCount);
+    }
+
+    uint32_t groupBegin = 0;
+    for (uint32_t g = 0; g < stats.BuildCallCount; g++)
+    {
+        if (g > 0)
+        {
+            recordAccelerationStructureBuildBarrier(cmd, VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                                                    VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR);
+        }
+        vkCmdBuildAccelerationStructuresKHR(cmd, groupEnds[g] - groupBegin, &buildInfos[groupBegin], &rangePtrs[groupBegin]);
+        groupBegin = groupEnds[g];
+    }
+
+    VkAccelerationStructureKHR* compactable = (VkAccelerationStructureKHR*)malloc(sizeof(VkAccelerationStructureKHR) * buildCount);
+    for (uint32_t c = 0; c < compactCount; c++)
+    {
+        compactable[c] = desc.OutBLASes[compactIndices[c]].Data.AccelerationStructure;
+    }
+
+    if (compactCount > 0)
+    {
+        recordAccelerationStructureBuildBarrier(cmd, VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR);
+        vkCmdWriteAccelerationStructuresPropertiesKHR(cmd, compactCount, compactable, VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, compactedSizePool, 0);
+    }
+    ib_vkCheck(vkEndCommandBuffer(cmd));
+    submitAccelerationStructureCommands(raytracing, cmd, desc.BuildingSemaphore);
+    ib_waitTimelineSemaphore(core, desc.BuildingSemaphore);
+    ib_freeCommandBuffer(core, ib_Queue_Graphics, cmd);
+    ib_freeBuffer(core, &scratch);
+
+    stats.FinalSize = stats.BuiltSize;
+    if (compactCount > 0)
+    {
+        VkDeviceSize* compactedSizes = (VkDeviceSize*)malloc(sizeof(VkDeviceSize) * compactCount);
+        ib_vkCheck(vkGetQueryPoolResults(core->LogicalDevice, compactedSizePool, 0, compactCount, sizeof(VkDeviceSize) * compactCount, compactedSizes, sizeof(VkDeviceSize),
+                                         VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        vkDestroyQueryPool(core->LogicalDevice, compactedSizePool, ib_NoVkAllocator);
+
+        ib_AccelerationStructureData* uncompacted = (ib_AccelerationStructureData*)malloc(sizeof(ib_AccelerationStructureData) * compactCount);
+        cmd = ib_allocAndBeginCommandBuffer(core, ib_Queue_Graphics);
+        for (uint32_t c = 0; c < compactCount; c++)
+        {
+            // The compacted structure keeps the build state, only the allocation changes.
+            ib_AccelerationStructureData* data = &desc.OutBLASes[compactIndices[c]].Data;
+            uncompacted[c] = *data;
+            ib_AccelerationStructureData compacted = allocAccelerationStructureData(raytracing, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, compactedSizes[c]);
+            data->Buffer = compacted.Buffer;
+            data->AccelerationStructure = compacted.AccelerationStructure;
+            data->Address = compacted.Address;
+            data->IsCompacted = true;
+            stats.FinalSize -= builtSizes[compactIndices[c]] - compactedSizes[c];
+
+            vkCmdCopyAccelerationStructureKHR(cmd, &(VkCopyAccelerationStructureInfoKHR)
+                                              {
+                                                  .sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR,
+                                                  .src = uncompacted[c].AccelerationStructure,
+                                                  .dst = data->AccelerationStructure,
+                                                  .mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR
+                                              });
+        }
+        ib_vkCheck(vkEndCommandBuffer(cmd));
+        submitAccelerationStructureCommands(raytracing, cmd, desc.BuildingSemaphore);
+        ib_waitTimelineSemaphore(core, desc.BuildingSemaphore);
+        ib_freeCommandBuffer(core, ib_Queue_Graphics, cmd);
+
+        for (uint32_t c = 0; c < compactCount; c++)
+        {
+            freeAccelerationStructureData(raytracing, &uncompacted[c]);
+        }
+        free(uncompacted);
+        free(compactedSizes);
+    }
+
+    free(compactable);
+    free(compactIndices);
+    free(builtSizes);
+    free(groupEnds);
+    free(scratchOffsets);
+    free(rangePtrs);
+    free(ranges);
+    free(buildInfos);
+    free(geometries);
+    return stats;
+}
+
+VkDeviceSize ib_accelerationStructureUpdateScratchSize(ib_AccelerationStructureData const* data)
+{
+    return ib_max(data->BuildScratchSize, data->UpdateScratchSize);
+}
+
+static bool recordAccelerationStructureUpdate(ib_AccelerationStructureData* data, VkAccelerationStructureBuildGeometryInfoKHR* buildInfo, uint32_t primitiveCount, ib_AccelerationStructureUpdateDesc update)
+{
+    ib_assert((data->Flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR) != 0, "The acceleration structure wasn't built with AllowUpdate.");
+    ib_assert(primitiveCount <= data->MaxPrimitiveCount, "Updates can't grow an acceleration structure past the size it was built for.");
+    ib_assert(!data->IsCompacted, "Compacted acceleration structures are too small to rebuild in place.");
+
+    if (data->BuildSurfaceArea == 0.0f)
+    {
+        data->BuildSurfaceArea = update.BoundsSurfaceArea; // First update after the initial build sets the reference
+    }
+
+    uint32_t maxUpdates = update.Policy.MaxUpdates > 0 ? update.Policy.MaxUpdates : ib_DefaultMaxAccelerationStructureUpdates;
+    bool degraded = update.Policy.MaxSurfaceAreaGrowth > 0.0f
+        && update.BoundsSurfaceArea > 0.0f
+        && data->BuildSurfaceArea > 0.0f
+        && update.BoundsSurfaceArea >= data->BuildSurfaceArea * update.Policy.MaxSurfaceAreaGrowth;
+    bool rebuild = degraded || data->UpdatesSinceBuild >= maxUpdates || primitiveCount != data->PrimitiveCount;
+
+    buildInfo->flags = data->Flags;
+    buildInfo->mode = rebuild ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+    buildInfo->srcAccelerationStructure = rebuild ? VK_NULL_HANDLE : data->AccelerationStructure;
+    buildInfo->dstAccelerationStructure = data->AccelerationStructure;
+    buildInfo->scratchData.deviceAddress = update.ScratchAddress;
+
+    VkAccelerationStructureBuildRangeInfoKHR range = { .primitiveCount = primitiveCount };
+    VkAccelerationStructureBuildRangeInfoKHR const* rangePtr = &range;
+    vkCmdBuildAccelerationStructuresKHR(update.CommandBuffer, 1, buildInfo, &rangePtr);
+
+    if (rebuild)
+    {
+        data->UpdatesSinceBuild = 0;
+        data->PrimitiveCount = primitiveCount;
+        data->BuildSurfaceArea = update.BoundsSurfaceArea;
+    }
+    else
+    {
+        data->UpdatesSinceBuild++;
+    }
+    return rebuild;
+}
+
+bool ib_updateBLAS(ib_Raytracing* raytracing, ib_BLAS* blas, ib_BLASDesc const* desc, ib_AccelerationStructureUpdateDesc update)
+{
+    ib_unused(raytracing);
+    VkAccelerationStructureGeometryKHR geometry = toBLASGeometry(desc);
+    VkAccelerationStructureBuildGeometryInfoKHR buildInfo =
+    {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+        .type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+        .geometryCount = 1,
+        .pGeometries = &geometry
+    };
+    return recordAccelerationStructureUpdate(&blas->Data, &buildInfo, desc->Triangles.TrianglesCount, update);
+}
+
+bool ib_updateTLAS(ib_Raytracing* raytracing, ib_TLAS* tlas, ib_TLASDesc const* desc, ib_AccelerationStructureUpdateDesc update)
+{
+    ib_unused(raytracing);
+    VkAccelerationStructureGeometryKHR geometry = toTLASGeometry(desc);
+    VkAccelerationStructureBuildGeometryInfoKHR buildInfo =
+    {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+        .type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+        .geometryCount = 1,
+        .pGeometries = &geometry
+    };
+    return recordAccelerationStructureUpdate(&tlas->Data, &buildInfo, desc->InstancesCount, update);
+}
+
+// Ray tracing pipelines
+
+static uint32_t raytraceShaderIndex(ib_RaytracePipelineDesc const* desc, ib_ShaderDesc const* shader)
+{
+    if (shader == NULL)
+    {
+        return VK_SHADER_UNUSED_KHR;
+    }
+
+    ib_assert(shader >= desc->ShaderDescs.Data && shader < desc->ShaderDescs.Data + desc->ShaderDescs.Count, "Group shaders have to point into ShaderDescs.");
+    return (uint32_t)(shader - desc->ShaderDescs.Data);
+}
+
+// Regions are laid out raygen, miss, hit, callable, each starting on the base alignment.
+// Raygen regions have to be exactly one handle, so every raygen handle gets its own base aligned slot for ib_traceRays to offset to.
+static void buildShaderBindingTable(ib_Raytracing* raytracing, ib_RaytracePipeline* pipeline)
+{
+    ib_Core* core = raytracing->Core;
+    uint32_t handleSize = raytracing->ShaderGroupHandleSize;
+    VkDeviceSize baseAlignment = ib_max(raytracing->ShaderGroupBaseAlignment, 1);
+    VkDeviceSize handleStride = alignDeviceSize(handleSize, raytracing->ShaderGroupHandleAlignment);
+
+    uint32_t groupCounts[ib_RaytraceGroup_Count] = { 0 };
+    for (uint32_t i = 0; i < pipeline->GroupCount; i++)
+    {
+        groupCounts[pipeline->GroupTypes[i]]++;
+    }
+
+    VkDeviceSize strides[ib_RaytraceGroup_Count] = { alignDeviceSize(handleStride, baseAlignment), handleStride, handleStride, handleStride };
+    VkDeviceSize offsets[ib_RaytraceGroup_Count];
+    VkDeviceSize tableSize = 0;
+    for (uint32_t t = 0; t < ib_RaytraceGroup_Count; t++)
+    {
+        offsets[t] = tableSize;
+        tableSize = alignDeviceSize(tableSize + groupCounts[t] * strides[t], baseAlignment);
+    }
+
+    uint8_t* handles = (uint8_t*)malloc((size_t)handleSize * pipeline->GroupCount);
+    ib_vkCheck(vkGetRayTracingShaderGroupHandlesKHR(core->LogicalDevice, pipeline->VulkanPipeline, 0, pipeline->GroupCount, (size_t)handleSize * pipeline->GroupCount, handles));
+
+    uint8_t* table = (uint8_t*)calloc(1, (size_t)tableSize);
+    uint32_t writtenCounts[ib_RaytraceGroup_Count] = { 0 };
+    for (uint32_t i = 0; i < pipeline->GroupCount; i++)
+    {
+        ib_RaytraceGroupType type = pipeline->GroupTypes[i];
+        memcpy(table + offsets[type] + writtenCounts[type]++ * strides[type], handles + (size_t)i * handleSize, handleSize);
+    }
+
+    // Over allocate so the table can start on the base alignment, buffers are only guaranteed their memory alignment.
+    pipeline->ShaderBindingTable = ib_allocBuffer(core, (ib_BufferDesc)
+                                                  {
+                                                      .Usage = VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                      .Size = (size_t)(tableSize + baseAlignment),
+                                                      .RequiredMemoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                      .DebugName = "Shader Binding Table"
+                                                  });
+    VkDeviceAddress tableAddress = alignDeviceSize(pipeline->ShaderBindingTable.DeviceAddress, baseAlignment);
+    ib_writeToBuffer(core, (ib_WriteToBufferDesc)
+                     {
+                         .Buffer = &pipeline->ShaderBindingTable,
+                         .Data = table,
+                         .Size = (size_t)tableSize,
+                         .Alignment = 4,
+                         .WriteOffset = (size_t)(tableAddress - pipeline->ShaderBindingTable.DeviceAddress)
+                     });
+    free(table);
+    free(handles);
+
+    VkStridedDeviceAddressRegionKHR* regions[ib_RaytraceGroup_Count] =
+    {
+        &pipeline->RaygenShaderRegion,
+        &pipeline->MissShaderRegion,
+        &pipeline->HitShaderRegion,
+        &pipeline->CallableShaderRegion
+    };
+    for (uint32_t t = 0; t < ib_RaytraceGroup_Count; t++)
+    {
+        if (groupCounts[t] > 0)
+        {
+            *regions[t] = (VkStridedDeviceAddressRegionKHR)
+            {
+                .deviceAddress = tableAddress + offsets[t],
+                .stride = strides[t],
+                .size = t == ib_RaytraceGroup_Raygen ? strides[t] : groupCounts[t] * strides[t]
+            };
+        }
+    }
+    pipeline->RaygenGroupCount = groupCounts[ib_RaytraceGroup_Raygen];
+}
+
+ib_RaytracePipeline ib_allocRaytracePipeline(ib_Raytracing* raytracing, ib_RaytracePipelineDesc desc)
+{
+    ib_Core* core = raytracing->Core;
+    ib_assert(core->RaytracingEnabled, "Ray tracing isn't supported, check ib_Core::RaytracingEnabled.");
+
+    ib_RaytracePipeline raytracePipeline = { 0 };
+    raytracePipeline.IsLibrary = desc.IsLibrary;
+
+    // Pipeline layout
+    VkDescriptorSetLayout layouts[ib_MaxShaderInputLayoutPerPipeline] = { 0 };
+    uint32_t layoutCount = 0;
+    for (uint32_t i = 0; i < ib_MaxShaderInputLayoutPerPipeline; i++)
+    {
+        ib_PipelineShaderInputDesc const* input = &desc.ShaderInputs[i];
+        if (input->Inline.Count > 0)
+        {
+            uint32_t inlineCount = raytracePipeline.InlineShaderInputLayoutCount++;
+            raytracePipeline.InlineShaderInputLayouts[inlineCount] = ib_allocShaderInputLayout(core, (ib_ShaderInputLayoutDesc) { input->Inline });
+            layouts[i] = raytracePipeline.InlineShaderInputLayouts[inlineCount].DescriptorSetLayout;
+        }
+        else if (input->External != NULL)
+        {
+            layouts[i] = input->External->DescriptorSetLayout;
+        }
+        else
+        {
+            break; // No more shader inputs.
+        }
+
+        layoutCount++;
+    }
+
+    ib_assert(desc.PushConstants.Data == NULL || desc.PushConstants.Count > 0);
+    VkPipelineLayoutCreateInfo pipelineLayoutCreate =
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = layoutCount,
+        .pSetLayouts = layouts,
+        .pushConstantRangeCount = desc.PushConstants.Count,
+        .pPushConstantRanges = desc.PushConstants.Data
+    };
+
+    ib_vkCheck(vkCreatePipelineLayout(core->LogicalDevice, &pipelineLayoutCreate, ib_NoVkAllocator, &raytracePipeline.Layout));
+
+    // Shaders
+    ib_assert(desc.ShaderDescs.Count <= ib_MaxRaytraceShaderCount, "Too many shaders! Increase ib_MaxRaytraceShaderCount or split into libraries.");
+    VkPipelineShaderStageCreateInfo shaderStages[ib_MaxRaytraceShaderCount] = { 0 };
+    VkSpecializationInfo specializations[ib_MaxRaytraceShaderCount];
+    VkSpecializationMapEntry specializationEntries[ib_MaxRaytraceShaderCount][ib_MaxSpecializationConstantCount];
+    for (uint32_t i = 0; i < desc.ShaderDescs.Count; i++)
+    {
+        raytracePipeline.ShaderModules[i] = acquireShaderModule(core, &desc.ShaderDescs.Data[i]);
+        shaderStages[i] = (VkPipelineShaderStageCreateInfo)
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pName = desc.ShaderDescs.Data[i].EntryPoint,
+            .module = raytracePipeline.ShaderModules[i],
+            .stage = desc.ShaderDescs.Data[i].Stage,
+            .pSpecializationInfo = fillSpecializationInfo(&desc.ShaderDescs.Data[i], &specializations[i], specializationEntries[i])
+        };
+    }
+    raytracePipeline.ShaderModuleCount = desc.ShaderDescs.Count;
+
+    // Groups
+    VkRayTracingShaderGroupCreateInfoKHR groups[ib_MaxRaytraceShaderGroupCount];
+    ib_assert(desc.Groups.Count <= ib_MaxRaytraceShaderGroupCount);
+    for (uint32_t i = 0; i < desc.Groups.Count; i++)
+    {
+        ib_RaytraceShaderGroupDesc const* group = &desc.Groups.Data[i];
+        bool isHitGroup = group->Type == ib_RaytraceGroup_Hit;
+        ib_assert(isHitGroup ? group->General == NULL : group->General != NULL, "Raygen, miss and callable groups take a single General shader.");
+
+        VkRayTracingShaderGroupTypeKHR type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
+        if (isHitGroup)
+        {
+            type = group->Intersection != NULL ? VK_RAY_TRACING_SHADER_GROUP_TYPE_PROCEDURAL_HIT_GROUP_KHR : VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
+        }
+
+        groups[i] = (VkRayTracingShaderGroupCreateInfoKHR)
+        {
+            .sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR,
+            .type = type,
+            .generalShader = raytraceShaderIndex(&desc, group->General),
+            .closestHitShader = raytraceShaderIndex(&desc, group->ClosestHit),
+            .anyHitShader = raytraceShaderIndex(&desc, group->AnyHit),
+            .intersectionShader = raytraceShaderIndex(&desc, group->Intersection)
+        };
+        raytracePipeline.GroupTypes[raytracePipeline.GroupCount++] = group->Type;
+    }
+
+    // Pipeline libraries
+    bool const usesLibraries = desc.IsLibrary || desc.Libraries.Count > 0;
+    ib_assert(!usesLibraries || core->RaytracePipelineLibraryEnabled, "Pipeline libraries aren't supported, check ib_Core::RaytracePipelineLibraryEnabled.");
+    ib_assert(!usesLibraries || desc.MaxPayloadSize > 0, "Libraries need the payload size up front.");
+
+    VkPipeline libraries[ib_MaxRaytraceShaderGroupCount];
+    ib_assert(desc.Libraries.Count <= ib_MaxRaytraceShaderGroupCount);
+    for (uint32_t i = 0; i < desc.Libraries.Count; i++)
+    {
+        ib_RaytracePipeline const* library = desc.Libraries.Data[i];
+        ib_assert(library->IsLibrary, "Only pipelines built with IsLibrary can be linked.");
+        ib_assert(raytracePipeline.GroupCount + library->GroupCount <= ib_MaxRaytraceShaderGroupCount);
+        memcpy(raytracePipeline.GroupTypes + raytracePipeline.GroupCount, library->GroupTypes, sizeof(ib_RaytraceGroupType) * library->GroupCount);
+        raytracePipeline.GroupCount += library->GroupCount;
+        libraries[i] = library->VulkanPipeline;
+    }
+
+    VkPipelineLibraryCreateInfoKHR libraryCreate =
+    {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+        .libraryCount = desc.Libraries.Count,
+        .pLibraries = libraries
+    };
+
+    VkRayTracingPipelineInterfaceCreateInfoKHR libraryInterface =
+    {
+        .sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_INTERFACE_CREATE_INFO_KHR,
+        .maxPipelineRayPayloadSize = desc.MaxPayloadSize,
+        .maxPipelineRayHitAttributeSize = desc.MaxHitAttributeSize
+    };
+
+    uint32_t recursionDepth = desc.MaxRecursionDepth > 0 ? desc.MaxRecursionDepth : 1;
+    ib_assert(recursionDepth <= raytracing->MaxRayRecursionDepth, "The device supports a recursion depth of %u.", raytracing->MaxRayRecursionDepth);
+
+    VkRayTracingPipelineCreateInfoKHR raytracePipelineCreate =
+    {
+        .sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR,
+        .flags = pipelineCaptureFlags(core) | (desc.IsLibrary ? VK_PIPELINE_CREATE_LIBRARY_BIT_KHR : 0),
+        .stageCount = desc.ShaderDescs.Count,
+        .pStages = shaderStages,
+        .groupCount = desc.Groups.Count,
+        .pGroups = groups,
+        .maxPipelineRayRecursionDepth = recursionDepth,
+        .pLibraryInfo = desc.Libraries.Count > 0 ? &libraryCreate : NULL,
+        .pLibraryInterface = usesLibraries ? &libraryInterface : NULL,
+        .layout = raytracePipeline.Layout
+    };
+
+    uint64_t compileBeginTicks = ib_cpuTicks();
+    ib_vkCheck(vkCreateRayTracingPipelinesKHR(core->LogicalDevice, VK_NULL_HANDLE, core->PipelineCache, 1, &raytracePipelineCreate, ib_NoVkAllocator, &raytracePipeline.VulkanPipeline));
+    if (desc.ShaderDescs.Count > 0)
+    {
+        recordPipelineCompile(core, compileBeginTicks);
+    }
+    else
+    {
+        recordPipelineLink(core, compileBeginTicks);
+    }
+
+    if (!desc.IsLibrary)
+    {
+        buildShaderBindingTable(raytracing, &raytracePipeline);
+    }
+    return raytracePipeline;
+}
+
+void ib_freeRaytracePipeline(ib_Raytracing* raytracing, ib_RaytracePipeline* pipeline)
+{
+    ib_Core* core = raytracing->Core;
+    vkDestroyPipeline(core->LogicalDevice, pipeline->VulkanPipeline, ib_NoVkAllocator);
+    for (uint32_t i = 0; i < pipeline->ShaderModuleCount; i++)
+    {
+        releaseShaderModule(core, pipeline->ShaderModules[i]);
+    }
+    vkDestroyPipelineLayout(core->LogicalDevice, pipeline->Layout, ib_NoVkAllocator);
+    for (uint32_t i = 0; i < ib_MaxShaderInputLayoutPerPipeline; i++)
+    {
+        ib_freeShaderInputLayout(core, &pipeline->InlineShaderInputLayouts[i]);
+    }
+
+    if (!pipeline->IsLibrary)
+    {
+        ib_freeBuffer(core, &pipeline->ShaderBindingTable);
+    }
+    *pipeline = (ib_RaytracePipeline) { 0 };
+}
+
+void ib_traceRays(VkCommandBuffer commandBuffer, ib_RaytracePipeline const* pipeline, ib_TraceRaysDesc desc)
+{
+    ib_assert(!pipeline->IsLibrary, "Libraries can't be traced, link them into a pipeline first.");
+    ib_assert(desc.RaygenIndex < pipeline->RaygenGroupCount);
+
+    VkStridedDeviceAddressRegionKHR raygenRegion = pipeline->RaygenShaderRegion;
+    raygenRegion.deviceAddress += desc.RaygenIndex * raygenRegion.stride;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline->VulkanPipeline);
+    vkCmdTraceRaysKHR(commandBuffer,
+                      &raygenRegion,
+                      &pipeline->MissShaderRegion,
+                      &pipeline->HitShaderRegion,
+                      &pipeline->CallableShaderRegion,
+                      desc.Width,
+                      desc.Height,
+                      desc.Depth > 0 ? desc.Depth : 1);
+}
+
+// Software ray tracing
+
+#define BVHBinCount 16
+#define BVHSerialTriangleCount 4096 // Subtrees smaller than this are built by the thread that split them off
+#define BVHTraversalStackSize 64 // Deeper BVHs traverse with a heap allocated stack
+
+typedef struct
+{
+    float Min[3];
+    float Max[3];
+} BVHBounds;
+
+static BVHBounds const EmptyBVHBounds = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+
+typedef struct
+{
+    uint32_t Node;
+    uint32_t Begin;
+    uint32_t End;
+} BVHBuildJob;
+
+typedef struct
+{
+    BVHBounds* TriangleBounds;
+    float (*Centroids)[3];
+    uint32_t* Order; // Triangle indices, partitioned in place as the tree is built
+    uint32_t ThreadCount;
+
+    ib_BVHNode* Nodes;
+    uint32_t volatile NodeCount;
+
+    ib_Mutex JobLock;
+    BVHBuildJob* Jobs;
+    uint32_t JobCount;
+    uint32_t volatile PendingJobCount; // Pushed and not finished yet
+} BVHBuilder;
+
+static void growBVHBounds(BVHBounds* bounds, BVHBounds const* other)
+{
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bounds->Min[i] = ib_min(bounds->Min[i], other->Min[i]);
+        bounds->Max[i] = ib_max(bounds->Max[i], other->Max[i]);
+    }
+}
+
+static float bvhBoundsArea(BVHBounds const* bounds)
+{
+    if (bounds->Min[0] > bounds->Max[0])
+    {
+        return 0.0f; // Empty
+    }
+
+    float x = bounds->Max[0] - bounds->Min[0];
+    float y = bounds->Max[1] - bounds->Min[1];
+    float z = bounds->Max[2] - bounds->Min[2];
+    return 2.0f * (x * y + y * z + z * x);
+}
+
+static BVHBounds bvhRangeBounds(BVHBuilder const* builder, uint32_t begin, uint32_t end)
+{
+    BVHBounds bounds = EmptyBVHBounds;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        growBVHBounds(&bounds, &builder->TriangleBounds[builder->Order[i]]);
+    }
+    return bounds;
+}
+
+static void fetchBVHTriangle(ib_BVHDesc const* desc, uint32_t triangle, float vertices[3][3])
+{
+    size_t stride = desc->Triangles.VertexStride != 0 ? desc->Triangles.VertexStride : sizeof(float) * 3;
+    for (uint32_t v = 0; v < 3; v++)
+    {
+        uint32_t index = triangle * 3 + v;
+        if (desc->Triangles.Indices != NULL)
+        {
+            index = desc->Triangles.IndexType == VK_INDEX_TYPE_UINT16 ? ((uint16_t const*)desc->Triangles.Indices)[index] : ((uint32_t const*)desc->Triangles.Indices)[index];
+        }
+
+        ib_assert(index < desc->Triangles.VertexCount);
+        memcpy(vertices[v], (uint8_t const*)desc->Triangles.Vertices + index * stride, sizeof(float) * 3);
+    }
+}
 
-    VkAccelerationStructureCreateInfoKHR createASInfo = {
-        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
-        .type = VK_ACCELERATION_STRUCTURE_TYPE_GENERIC_KHR,
-        .buffer = out.Buffer.VulkanBuffer,
-        .size = sizesInfo.accelerationStructureSize,
-    };
+static uint32_t bvhBin(float centroid, float min, float scale)
+{
+    uint32_t bin = (uint32_t)((centroid - min) * scale);
+    return ib_min(bin, BVHBinCount - 1);
+}
 
-    ib_vkCheck(vkCreateAccelerationStructureKHR(
-        raytracing->Core->LogicalDevice,
-        &createASInfo,
-        ib_NoVkAllocator,
-        &out.AccelerationStructure));
-    
-    buildInfo->dstAccelerationStructure = out.AccelerationStructure;
-    buildInfo->scratchData.deviceAddress = stagingAddress;
+// Binned SAH over the triangle centroids, partitions [begin, end) and returns where the right side starts.
+static uint32_t splitBVHRange(BVHBuilder* builder, uint32_t begin, uint32_t end)
+{
+    BVHBounds centroidBounds = EmptyBVHBounds;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        float const* centroid = builder->Centroids[builder->Order[i]];
+        BVHBounds point = { { centroid[0], centroid[1], centroid[2] }, { centroid[0], centroid[1], centroid[2] } };
+        growBVHBounds(&centroidBounds, &point);
+    }
 
-    VkAccelerationStructureBuildRangeInfoKHR rangeInfo = (VkAccelerationStructureBuildRangeInfoKHR)
+    float bestCost = FLT_MAX;
+    uint32_t bestAxis = 0;
+    uint32_t bestSplit = 0;
+    for (uint32_t axis = 0; axis < 3; axis++)
     {
-        .firstVertex = 0,
-        .primitiveCount = *primitiveCount,
-        .primitiveOffset = 0,
-        .transformOffset = 0
-    };
-    VkAccelerationStructureBuildRangeInfoKHR* pRangeInfo = &rangeInfo;
+        float extent = centroidBounds.Max[axis] - centroidBounds.Min[axis];
+        if (extent <= 0.0f)
+        {
+            continue;
+        }
 
-    VkCommandBuffer cmd = ib_allocCommandBuffer(raytracing->Core, (ib_AllocCommandBufferDesc) { .Queue = ib_Queue_Graphics });
-    VkCommandBufferBeginInfo beginBufferInfo =
+        float scale = (float)BVHBinCount / extent;
+        uint32_t counts[BVHBinCount] = { 0 };
+        BVHBounds bins[BVHBinCount];
+        for (uint32_t b = 0; b < BVHBinCount; b++)
+        {
+            bins[b] = EmptyBVHBounds;
+        }
+
+        for (uint32_t i = begin; i < end; i++)
+        {
+            uint32_t triangle = builder->Order[i];
+            uint32_t bin = bvhBin(builder->Centroids[triangle][axis], centroidBounds.Min[axis], scale);
+            counts[bin]++;
+            growBVHBounds(&bins[bin], &builder->TriangleBounds[triangle]);
+        }
+
+        // Sweep from the right for the cost of every right side, then from the left to pick the split.
+        float rightCosts[BVHBinCount];
+        BVHBounds right = EmptyBVHBounds;
+        uint32_t rightCount = 0;
+        for (uint32_t b = BVHBinCount - 1; b > 0; b--)
+        {
+            growBVHBounds(&right, &bins[b]);
+            rightCount += counts[b];
+            rightCosts[b] = bvhBoundsArea(&right) * (float)rightCount;
+        }
+
+        BVHBounds left = EmptyBVHBounds;
+        uint32_t leftCount = 0;
+        for (uint32_t b = 0; b < BVHBinCount - 1; b++)
+        {
+            growBVHBounds(&left, &bins[b]);
+            leftCount += counts[b];
+            float cost = bvhBoundsArea(&left) * (float)leftCount + rightCosts[b + 1];
+            if (leftCount > 0 && leftCount < end - begin && cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b + 1;
+            }
+        }
+    }
+
+    if (bestCost == FLT_MAX)
     {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-    };
+        return begin + (end - begin) / 2; // Every centroid is the same point, any split is as good as another.
+    }
 
-    ib_vkCheck(vkBeginCommandBuffer(cmd, &beginBufferInfo));
+    float scale = (float)BVHBinCount / (centroidBounds.Max[bestAxis] - centroidBounds.Min[bestAxis]);
+    uint32_t left = begin;
+    uint32_t right = end;
+    while (left < right)
+    {
+        uint32_t triangle = builder->Order[left];
+        if (bvhBin(builder->Centroids[triangle][bestAxis], centroidBounds.Min[bestAxis], scale) < bestSplit)
+        {
+            left++;
+        }
+        else
+        {
+            builder->Order[left] = builder->Order[--right];
+            builder->Order[right] = triangle;
+        }
+    }
+    return left;
+}
 
-    vkCmdBuildAccelerationStructuresKHR(cmd, 1, buildInfo, &pRangeInfo);
+static void buildBVHNode(BVHBuilder* builder, uint32_t nodeIndex, uint32_t begin, uint32_t end)
+{
+    // Keep splitting the child with the largest surface area until the node is full or every child is a leaf.
+    uint32_t begins[ib_BVHWidth] = { begin };
+    uint32_t ends[ib_BVHWidth] = { end };
+    BVHBounds bounds[ib_BVHWidth] = { bvhRangeBounds(builder, begin, end) };
+    uint32_t childCount = 1;
+    while (childCount < ib_BVHWidth)
+    {
+        uint32_t largest = ib_BVHWidth;
+        float largestArea = -1.0f;
+        for (uint32_t c = 0; c < childCount; c++)
+        {
+            float area = bvhBoundsArea(&bounds[c]);
+            if (ends[c] - begins[c] > ib_BVHMaxLeafTriangles && area > largestArea)
+            {
+                largest = c;
+                largestArea = area;
+            }
+        }
 
-    ib_vkCheck(vkEndCommandBuffer(cmd));
+        if (largest == ib_BVHWidth)
+        {
+            break;
+        }
 
-    VkSubmitInfo2 submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
-        .commandBufferInfoCount = 1,
-        .pCommandBufferInfos = &(VkCommandBufferSubmitInfo)
+        uint32_t split = splitBVHRange(builder, begins[largest], ends[largest]);
+        begins[childCount] = split;
+        ends[childCount] = ends[largest];
+        ends[largest] = split;
+        bounds[largest] = bvhRangeBounds(builder, begins[largest], ends[largest]);
+        bounds[childCount] = bvhRangeBounds(builder, begins[childCount], ends[childCount]);
+        childCount++;
+    }
+
+    ib_BVHNode* node = &builder->Nodes[nodeIndex];
+    *node = (ib_BVHNode) { 0 };
+    for (uint32_t c = 0; c < ib_BVHWidth; c++)
+    {
+        BVHBounds const* childBounds = c < childCount ? &bounds[c] : &EmptyBVHBounds;
+        node->MinX[c] = childBounds->Min[0];
+        node->MaxX[c] = childBounds->Max[0];
+        node->MinY[c] = childBounds->Min[1];
+        node->MaxY[c] = childBounds->Max[1];
+        node->MinZ[c] = childBounds->Min[2];
+        node->MaxZ[c] = childBounds->Max[2];
+        node->Children[c] = ib_BVHInvalidNode;
+    }
+
+    for (uint32_t c = 0; c < childCount; c++)
+    {
+        uint32_t triangleCount = ends[c] - begins[c];
+        if (triangleCount <= ib_BVHMaxLeafTriangles)
         {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
-            .commandBuffer = cmd
-        },
-        .waitSemaphoreInfoCount = 1,
-        .pWaitSemaphoreInfos = &(VkSemaphoreSubmitInfo)
+            node->Children[c] = begins[c];
+            node->TriangleCounts |= triangleCount << (c * 8);
+            continue;
+        }
+
+        uint32_t child = ib_atomicAddU32(&builder->NodeCount, 1) - 1;
+        node->Children[c] = child;
+        if (builder->ThreadCount == 1 || triangleCount < BVHSerialTriangleCount)
         {
-            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-            .semaphore = buildingSemaphore->Semaphore,
-            .value = buildingSemaphore->LastSignalValue,
-            .stageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
-        },
-        .signalSemaphoreInfoCount = 1,
-        .pSignalSemaphoreInfos = &(VkSemaphoreSubmitInfo)
+            buildBVHNode(builder, child, begins[c], ends[c]);
+        }
+        else
         {
-            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-            .semaphore = buildingSemaphore->Semaphore,
-            .value = ++buildingSemaphore->LastSignalValue,
-            .stageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
-        },
-    };
+            ib_atomicAddU32(&builder->PendingJobCount, 1);
+            ib_lockMutex(&builder->JobLock);
+            builder->Jobs[builder->JobCount++] = (BVHBuildJob) { child, begins[c], ends[c] };
+            ib_unlockMutex(&builder->JobLock);
+        }
+    }
+}
 
-    ib_vkCheck(vkQueueSubmit2(raytracing->Core->Queues[ib_Queue_Graphics].Queue, 1, &submitInfo, VK_NULL_HANDLE));
+static void bvhBuildWorker(void* userData)
+{
+    BVHBuilder* builder = (BVHBuilder*)userData;
+    while (ib_atomicLoadU32(&builder->PendingJobCount) > 0)
+    {
+        BVHBuildJob job;
+        bool hasJob = false;
+        ib_lockMutex(&builder->JobLock);
+        if (builder->JobCount > 0)
+        {
+            job = builder->Jobs[--builder->JobCount];
+            hasJob = true;
+        }
+        ib_unlockMutex(&builder->JobLock);
 
-    VkAccelerationStructureDeviceAddressInfoKHR ASAddressQueryInfo = {
-        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR,
-        .accelerationStructure = out.AccelerationStructure
-    };
+        // Children are pushed before their parent completes, the pending count only reaches 0 once the tree is done.
+        if (hasJob)
+        {
+            buildBVHNode(builder, job.Node, job.Begin, job.End);
+            ib_atomicAddU32(&builder->PendingJobCount, (uint32_t)-1);
+        }
+    }
+}
 
-    out.Address = vkGetAccelerationStructureDeviceAddressKHR(raytracing->Core->LogicalDevice, &ASAddressQueryInfo);
-    return out;
+ib_BVH ib_buildBVH(ib_BVHDesc desc)
+{
+    ib_assert(desc.Triangles.VertexFormat == VK_FORMAT_R32G32B32_SFLOAT, "Only float3 positions are supported.");
+    ib_assert(desc.Triangles.Indices == NULL || desc.Triangles.IndexType == VK_INDEX_TYPE_UINT16 || desc.Triangles.IndexType == VK_INDEX_TYPE_UINT32);
+
+    uint64_t beginTicks = ib_cpuTicks();
+    ib_BVH bvh = { 0 };
+    uint32_t triangleCount = desc.Triangles.TrianglesCount;
+    if (triangleCount == 0)
+    {
+        return bvh;
+    }
+
+    BVHBuilder builder = { 0 };
+    builder.TriangleBounds = (BVHBounds*)malloc(sizeof(BVHBounds) * triangleCount);
+    builder.Centroids = (float(*)[3])malloc(sizeof(float[3]) * triangleCount);
+    builder.Order = (uint32_t*)malloc(sizeof(uint32_t) * triangleCount);
+    for (uint32_t i = 0; i < triangleCount; i++)
+    {
+        float vertices[3][3];
+        fetchBVHTriangle(&desc, i, vertices);
+
+        BVHBounds bounds = EmptyBVHBounds;
+        for (uint32_t v = 0; v < 3; v++)
+        {
+            BVHBounds point = { { vertices[v][0], vertices[v][1], vertices[v][2] }, { vertices[v][0], vertices[v][1], vertices[v][2] } };
+            growBVHBounds(&bounds, &point);
+        }
+
+        builder.TriangleBounds[i] = bounds;
+        for (uint32_t axis = 0; axis < 3; axis++)
+        {
+            builder.Centroids[i][axis] = (bounds.Min[axis] + bounds.Max[axis]) * 0.5f;
+        }
+        builder.Order[i] = i;
+    }
+
+    // Every inner node splits its triangles at least once, there are always fewer nodes than triangles.
+    builder.Nodes = (ib_BVHNode*)malloc(sizeof(ib_BVHNode) * triangleCount);
+    builder.NodeCount = 1;
+    builder.Jobs = (BVHBuildJob*)malloc(sizeof(BVHBuildJob) * triangleCount);
+    builder.Jobs[builder.JobCount++] = (BVHBuildJob) { 0, 0, triangleCount };
+    builder.PendingJobCount = 1;
+    ib_initMutex(&builder.JobLock);
+
+    uint32_t threadCount = desc.ThreadCount != 0 ? desc.ThreadCount : ib_cpuCoreCount();
+    threadCount = ib_min(threadCount, ib_MaxBVHThreadCount);
+    threadCount = triangleCount < BVHSerialTriangleCount ? 1 : ib_max(threadCount, 1);
+    builder.ThreadCount = threadCount;
+
+    // The calling thread works too.
+    ib_Thread threads[ib_MaxBVHThreadCount];
+    for (uint32_t i = 1; i < threadCount; i++)
+    {
+        threads[i] = ib_startThread(bvhBuildWorker, &builder);
+    }
+    bvhBuildWorker(&builder);
+    for (uint32_t i = 1; i < threadCount; i++)
+    {
+        ib_joinThread(&threads[i]);
+    }
+    ib_killMutex(&builder.JobLock);
+
+    bvh.NodeCount = builder.NodeCount;
+    bvh.Nodes = (ib_BVHNode*)realloc(builder.Nodes, sizeof(ib_BVHNode) * bvh.NodeCount);
+
+    // Children are always allocated after their parent, one pass in node order sees every parent's depth first.
+    uint32_t* depths = (uint32_t*)malloc(sizeof(uint32_t) * bvh.NodeCount);
+    depths[0] = 1;
+    bvh.MaxDepth = 1;
+    for (uint32_t n = 0; n < bvh.NodeCount; n++)
+    {
+        ib_BVHNode const* node = &bvh.Nodes[n];
+        for (uint32_t c = 0; c < ib_BVHWidth; c++)
+        {
+            if (node->Children[c] != ib_BVHInvalidNode && ((node->TriangleCounts >> (c * 8)) & 0xFF) == 0)
+            {
+                ib_assert(node->Children[c] > n);
+                depths[node->Children[c]] = depths[n] + 1;
+                bvh.MaxDepth = ib_max(bvh.MaxDepth, depths[n] + 1);
+            }
+        }
+    }
+    free(depths);
+    bvh.TraversalStackSize = ib_bvhTraversalStackSize(bvh.MaxDepth);
+    bvh.TriangleCount = triangleCount;
+    bvh.Triangles = (ib_BVHTriangle*)malloc(sizeof(ib_BVHTriangle) * triangleCount);
+    for (uint32_t i = 0; i < triangleCount; i++)
+    {
+        float vertices[3][3];
+        fetchBVHTriangle(&desc, builder.Order[i], vertices);
+
+        ib_BVHTriangle* triangle = &bvh.Triangles[i];
+        *triangle = (ib_BVHTriangle) { .PrimitiveIndex = builder.Order[i] };
+        for (uint32_t axis = 0; axis < 3; axis++)
+        {
+            triangle->V0[axis] = vertices[0][axis];
+            triangle->E1[axis] = vertices[1][axis] - vertices[0][axis];
+            triangle->E2[axis] = vertices[2][axis] - vertices[0][axis];
+        }
+    }
+
+    free(builder.Jobs);
+    free(builder.Order);
+    free(builder.Centroids);
+    free(builder.TriangleBounds);
+
+    bvh.BuildMs = ib_cpuTicksToMs(ib_cpuTicks() - beginTicks);
+    return bvh;
 }
 
-ib_BLAS ib_allocBLAS(ib_Raytracing* raytracing, ib_BLASDesc desc, iba_StackAllocator* scratchMemoryStack, ib_timelineSemaphore* buildingSemaphore)
+void ib_freeBVH(ib_BVH* bvh)
 {
-    ib_assert(desc.Triangles.Vertices != NULL && desc.Triangles.Indices != NULL);
+    free(bvh->Nodes);
+    free(bvh->Triangles);
+    *bvh = (ib_BVH) { 0 };
+}
 
-    VkAccelerationStructureGeometryTrianglesDataKHR trianglesGeometry = {
-        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR,
-        .vertexData.deviceAddress = desc.Triangles.Vertices->DeviceAddress,
-        .vertexFormat = desc.Triangles.VertexFormat,
-        .vertexStride = desc.Triangles.VertexStride,
-        .maxVertex = desc.Triangles.VertexCount - 1,
-        .indexData.deviceAddress = desc.Triangles.Indices->DeviceAddress,
-        .indexType = desc.Triangles.IndexType
-    };
+static float dot3(float const* lhs, float const* rhs)
+{
+    return lhs[0] * rhs[0] + lhs[1] * rhs[1] + lhs[2] * rhs[2];
+}
 
-    VkAccelerationStructureGeometryKHR ASGeometry = {
-        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
-        .flags = desc.GeometryFlags,
-        .geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR,
-        .geometry.triangles = trianglesGeometry
-    };
+static void cross3(float const* lhs, float const* rhs, float* result)
+{
+    result[0] = lhs[1] * rhs[2] - lhs[2] * rhs[1];
+    result[1] = lhs[2] * rhs[0] - lhs[0] * rhs[2];
+    result[2] = lhs[0] * rhs[1] - lhs[1] * rhs[0];
+}
 
-    VkAccelerationStructureBuildGeometryInfoKHR BLASBuildInfo = {
-        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
-        .type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
-        .flags = desc.AccelerationStructureFlags,
-        .mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
-        .geometryCount = 1,
-        .pGeometries = &ASGeometry,
-    };
+// Moller-Trumbore, matches rayTriangleIntersect in ib_bvh.hsh.
+static bool intersectBVHTriangle(ib_BVHTriangle const* triangle, ib_BVHRay const* ray, ib_BVHHit* hit)
+{
+    float p[3];
+    cross3(ray->Direction, triangle->E2, p);
+    float det = dot3(triangle->E1, p);
+    if (det > -1e-12f && det < 1e-12f)
+    {
+        return false;
+    }
 
-    ib_BLAS blas = { 0 };
-    blas.Data = buildAccelerationStructureInternal(
-        raytracing,
-        &BLASBuildInfo,
-        &desc.Triangles.TrianglesCount,
-        scratchMemoryStack,
-        buildingSemaphore);
-    return blas;
+    float rcpDet = 1.0f / det;
+    float s[3] = { ray->Origin[0] - triangle->V0[0], ray->Origin[1] - triangle->V0[1], ray->Origin[2] - triangle->V0[2] };
+    float u = dot3(s, p) * rcpDet;
+    float q[3];
+    cross3(s, triangle->E1, q);
+    float v = dot3(ray->Direction, q) * rcpDet;
+    float t = dot3(triangle->E2, q) * rcpDet;
+    if (u < 0.0f || v < 0.0f || u + v > 1.0f || t < ray->TMin || t >= hit->T)
+    {
+        return false;
+    }
+
+    *hit = (ib_BVHHit) { t, { u, v }, triangle->PrimitiveIndex };
+    return true;
 }
 
-ib_TLAS ib_allocTLAS(ib_Raytracing* raytracing, ib_TLASDesc desc, iba_StackAllocator* scratchMemoryStack, ib_timelineSemaphore* buildingSemaphore)
+bool ib_traceBVH(ib_BVH const* bvh, ib_BVHRay ray, ib_BVHHit* hit)
 {
-    ib_assert(desc.InstancesBuffer != NULL);
+    *hit = (ib_BVHHit) { .T = ray.TMax, .PrimitiveIndex = ib_BVHInvalidNode };
+    if (bvh->NodeCount == 0)
+    {
+        return false;
+    }
 
-    VkAccelerationStructureGeometryKHR ASGeometry = {
-        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
-        .geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR,
-        .geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR,
-        .geometry.instances.arrayOfPointers = VK_FALSE,
-        .geometry.instances.data.deviceAddress = desc.InstancesBuffer->DeviceAddress
-    };
+    // Zero components would give 0 * inf = NaN for origins on a slab, a large finite value keeps the slab test well behaved.
+    float rcpDirection[3];
+    for (uint32_t axis = 0; axis < 3; axis++)
+    {
+        rcpDirection[axis] = ray.Direction[axis] != 0.0f ? 1.0f / ray.Direction[axis] : FLT_MAX;
+    }
+    uint32_t localStack[BVHTraversalStackSize];
+    uint32_t* stack = localStack;
+    if (bvh->TraversalStackSize > BVHTraversalStackSize)
+    {
+        stack = (uint32_t*)malloc(sizeof(uint32_t) * bvh->TraversalStackSize);
+    }
 
-    VkAccelerationStructureBuildGeometryInfoKHR TLASBuildInfo = {
-        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
-        .type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
-        .flags = desc.AccelerationStructureFlags,
-        .mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
-        .geometryCount = 1,
-        .pGeometries = &ASGeometry
-    };
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        ib_BVHNode const* node = &bvh->Nodes[stack[--stackSize]];
+        for (uint32_t c = 0; c < ib_BVHWidth; c++)
+        {
+            if (node->Children[c] == ib_BVHInvalidNode)
+            {
+                continue;
+            }
 
-    ib_TLAS tlas = { 0 };
-    tlas.Data = buildAccelerationStructureInternal(
-        raytracing,
-        &TLASBuildInfo,
-        &desc.InstancesCount,
-        scratchMemoryStack,
-        buildingSemaphore);
-    return tlas;
+            float t0x = (node->MinX[c] - ray.Origin[0]) * rcpDirection[0];
+            float t1x = (node->MaxX[c] - ray.Origin[0]) * rcpDirection[0];
+            float t0y = (node->MinY[c] - ray.Origin[1]) * rcpDirection[1];
+            float t1y = (node->MaxY[c] - ray.Origin[1]) * rcpDirection[1];
+            float t0z = (node->MinZ[c] - ray.Origin[2]) * rcpDirection[2];
+            float t1z = (node->MaxZ[c] - ray.Origin[2]) * rcpDirection[2];
+            float tNear = ib_max(ib_max(ib_min(t0x, t1x), ib_min(t0y, t1y)), ib_max(ib_min(t0z, t1z), ray.TMin));
+            float tFar = ib_min(ib_min(ib_max(t0x, t1x), ib_max(t0y, t1y)), ib_min(ib_max(t0z, t1z), hit->T));
+            if (tNear > tFar)
+            {
+                continue;
+            }
+
+            uint32_t triangleCount = (node->TriangleCounts >> (c * 8)) & 0xFF;
+            if (triangleCount == 0)
+            {
+                ib_assert(stackSize < bvh->TraversalStackSize);
+                stack[stackSize++] = node->Children[c];
+                continue;
+            }
+
+            for (uint32_t i = 0; i < triangleCount; i++)
+            {
+                intersectBVHTriangle(&bvh->Triangles[node->Children[c] + i], &ray, hit);
+            }
+        }
+    }
+
+    if (stack != localStack)
+    {
+        free(stack);
+    }
+    return hit->PrimitiveIndex != ib_BVHInvalidNode;
 }
 
-void ib_freeBLAS(ib_Raytracing* raytracing, ib_BLAS* accelerationStructure)
+ib_BVHBuffers ib_uploadBVH(ib_Core* core, ib_BVH const* bvh)
 {
-    vkDestroyAccelerationStructureKHR(raytracing->Core->LogicalDevice, accelerationStructure->Data.AccelerationStructure, ib_NoVkAllocator);
-    ib_freeBuffer(raytracing->Core, &accelerationStructure->Data.Buffer);
+    // Empty BVHs get a root without children so shaders don't need to special case them.
+    static ib_BVHNode const emptyRoot = { .Children = { ib_BVHInvalidNode, ib_BVHInvalidNode, ib_BVHInvalidNode, ib_BVHInvalidNode } };
+    ib_check(bvh->TraversalStackSize <= ib_BVHShaderStackSize, "BVH is too deep for ib_BVHStackSize, raise both it and ib_BVHShaderStackSize.");
+    ib_BVHNode const* nodes = bvh->NodeCount > 0 ? bvh->Nodes : &emptyRoot;
+    ib_BVHBuffers buffers =
+    {
+        .Nodes = ib_allocBuffer(core, (ib_BufferDesc)
+                                {
+                                    .Usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    .Size = sizeof(ib_BVHNode) * ib_max(bvh->NodeCount, 1),
+                                    .RequiredMemoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    .DebugName = "BVH Nodes",
+                                    .InitialWrite = { nodes, sizeof(ib_BVHNode) * ib_max(bvh->NodeCount, 1), 16, 0 }
+                                }),
+        .Triangles = ib_allocBuffer(core, (ib_BufferDesc)
+                                    {
+                                        .Usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                        .Size = sizeof(ib_BVHTriangle) * ib_max(bvh->TriangleCount, 1),
+                                        .RequiredMemoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                        .DebugName = "BVH Triangles",
+                                        .InitialWrite = { bvh->Triangles, sizeof(ib_BVHTriangle) * bvh->TriangleCount, 16, 0 }
+                                    })
+    };
+    return buffers;
 }
 
-void ib_freeTLAS(ib_Raytracing* raytracing, ib_TLAS* accelerationStructure)
+void ib_freeBVHBuffers(ib_Core* core, ib_BVHBuffers* buffers)
 {
-    vkDestroyAccelerationStructureKHR(raytracing->Core->LogicalDevice, accelerationStructure->Data.AccelerationStructure, ib_NoVkAllocator);
-    ib_freeBuffer(raytracing->Core, &accelerationStructure->Data.Buffer);
+    ib_freeBuffer(core, &buffers->Nodes);
+    ib_freeBuffer(core, &buffers->Triangles);
 }
 
 // Utility constants to reduce friction when creating graphics pipelines.
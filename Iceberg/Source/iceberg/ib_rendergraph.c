@@ -3,6 +3,8 @@
 #include <iceberg/ib_rendergraph.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <float.h>
 
 #define list_push(list, in) \
 	in->Next = *(list); \
@@ -24,29 +26,85 @@
 		out = _transient; \
 	}
 
-static void pushProfilingScope(ibr_RenderGraph* graph, VkCommandBuffer cmd, char const* passName)
+// Scopes don't know which queue their command buffer will be submitted to, look it up from our transient lists.
+// Command buffers we didn't hand out are assumed to be graphics.
+static ib_Queue findCommandBufferQueue(ibr_RecordingContext* context, VkCommandBuffer cmd)
 {
-	ibr_TransientProfileScope* transientScope;
-	list_pushAlloc(transientScope, ibr_TransientProfileScope, &graph->ActiveProfilingScopes);
+	for (uint32_t q = 0; q < ib_Queue_Count; q++)
+	{
+		ibr_CommandBufferList* lists[] = { &context->TransientCommandBuffers[q], &context->TransientSecondaryCommandBuffers[q] };
+		for (uint32_t l = 0; l < ib_arrayCount(lists); l++)
+		{
+			for (uint32_t i = 0; i < lists[l]->UsedCount; i++)
+			{
+				if (lists[l]->CommandBuffers[i] == cmd)
+				{
+					return (ib_Queue)q;
+				}
+			}
+		}
+	}
+	return ib_Queue_Graphics;
+}
+
+static void pushProfilingScope(ibr_RecordingContext* context, VkCommandBuffer cmd, char const* name, bool withPipelineStatistics)
+{
+	ibr_TransientProfileScope* transientScope = (ibr_TransientProfileScope*)ibr_allocContextTransientMemory(context, sizeof(ibr_TransientProfileScope));
+	list_push(&context->ActiveProfilingScopes, transientScope);
+
+	bool isCPUOnly = cmd == VK_NULL_HANDLE;
+	ib_Queue queue = isCPUOnly ? ib_Queue_Unknown : findCommandBufferQueue(context, cmd);
 	transientScope->Scope = (ibr_ProfilingScope)
 	{
-		.Timer = ib_beginTimer(&graph->TimerManager, cmd),
-		.Name = passName,
+		.Timer = isCPUOnly ? (ib_Timer) { 0 } : ib_beginTimer(&context->TimerManager, cmd),
+		.Name = name,
+		.CPUBeginTicks = ib_cpuTicks(),
+		.Depth = context->CurrentProfilingDepth,
+		.Queue = queue,
+		.IsCPUOnly = isCPUOnly
 	};
 
-	graph->CurrentProfilingDepth++;
-	ib_assert(graph->CurrentProfilingDepth == 1); // We don't currently support nested scopes.
+	// Statistics queries can't nest and need a graphics capable pool.
+	ib_Core* core = context->Graph->Core;
+	if (withPipelineStatistics
+		&& !isCPUOnly
+		&& !context->IsRecordingPipelineStatistics
+		&& context->TimerManager.PipelineStatisticsPool != VK_NULL_HANDLE
+		&& core->Queues[queue].Index == core->Queues[ib_Queue_Graphics].Index)
+	{
+		transientScope->Scope.HasPipelineStatistics = true;
+		transientScope->Scope.PipelineStatisticsQuery = ib_beginPipelineStatistics(&context->TimerManager, cmd);
+		context->IsRecordingPipelineStatistics = true;
+	}
+
+	context->CurrentProfilingDepth++;
+}
+
+void ibr_pushProfilingScope(ibr_RecordingContext* context, VkCommandBuffer cmd, char const* name)
+{
+	pushProfilingScope(context, cmd, name, false);
 }
 
-static void popProfilingScope(ibr_RenderGraph* graph, VkCommandBuffer cmd)
+void ibr_popProfilingScope(ibr_RecordingContext* context, VkCommandBuffer cmd)
 {
 	ibr_TransientProfileScope* transientScope;
-	list_pop(transientScope, &graph->ActiveProfilingScopes);
+	list_pop(transientScope, &context->ActiveProfilingScopes);
 	ib_assert(transientScope != NULL);
-	ib_endTimer(&graph->TimerManager, cmd, &transientScope->Scope.Timer);
+	ib_assert(transientScope->Scope.IsCPUOnly == (cmd == VK_NULL_HANDLE)); // Scopes have to be popped the way they were pushed.
+	if (transientScope->Scope.HasPipelineStatistics)
+	{
+		ib_endPipelineStatistics(&context->TimerManager, cmd, &transientScope->Scope.PipelineStatisticsQuery);
+		context->IsRecordingPipelineStatistics = false;
+	}
+
+	if (!transientScope->Scope.IsCPUOnly)
+	{
+		ib_endTimer(&context->TimerManager, cmd, &transientScope->Scope.Timer);
+	}
+	transientScope->Scope.CPUEndTicks = ib_cpuTicks();
 
-	list_push(&graph->CompletedScopes, transientScope);
-	graph->CurrentProfilingDepth--;
+	list_push(&context->CompletedScopes, transientScope);
+	context->CurrentProfilingDepth--;
 }
 
 static void getAcquireAndReleaseMask(ibr_ResourceState state, VkPipelineStageFlags* acquire, VkPipelineStageFlags* release)
@@ -71,6 +129,108 @@ static void getAcquireAndReleaseMask(ibr_ResourceState state, VkPipelineStageFla
 	}
 }
 
+typedef struct
+{
+	ibr_Resource* Resource;
+	VkImageLayout Layout;
+	VkPipelineStageFlags AcquireStageMask;
+	VkAccessFlags AcquireAccessMask;
+	VkPipelineStageFlags ReleaseStageMask;
+	VkAccessFlags ReleaseAccessMask;
+	bool IsSplitBarrier;
+} ResourceTransition;
+
+// A transition is redundant if the resource is read again in the same layout and the last write was already made visible
+// to the stages and accesses that want it now. A split barrier pre-acquires its states, so the next matching use is redundant too.
+static bool isRedundantTransition(ResourceTransition transition)
+{
+	ibr_Resource const* resource = transition.Resource;
+	bool sameLayout = resource->Type != ibr_ResourceType_Texture || resource->TextureLayout == transition.Layout;
+	bool alreadyVisible = (transition.AcquireStageMask & ~resource->VisibleStageMask) == 0
+		&& (transition.AcquireAccessMask & ~resource->VisibleAccessMask) == 0;
+	if (!sameLayout || !alreadyVisible || transition.IsSplitBarrier)
+	{
+		return false;
+	}
+
+	bool readAfterRead = resource->LastReleaseAccessMask == VK_ACCESS_NONE && transition.ReleaseAccessMask == VK_ACCESS_NONE;
+	return resource->IsPreAcquired || readAfterRead;
+}
+
+// Updates the resource's tracked state, returns false if the transition is redundant and has no barrier to record.
+static bool transitionResource(ibr_RenderGraph* graph, ResourceTransition transition, VkImageMemoryBarrier2* outImageBarrier, VkBufferMemoryBarrier2* outBufferBarrier)
+{
+	ibr_Resource* resource = transition.Resource;
+	if (isRedundantTransition(transition))
+	{
+		if (resource->IsPreAcquired)
+		{
+			// The split barrier already set our release masks.
+			resource->IsPreAcquired = false;
+		}
+		else
+		{
+			// Merge our readers, the next write has to wait on all of them.
+			resource->LastReleaseStageMask |= transition.ReleaseStageMask;
+		}
+
+		graph->BarrierStatistics.EliminatedCount++;
+		return false;
+	}
+
+	if (resource->Type == ibr_ResourceType_Texture)
+	{
+		*outImageBarrier = ib_createTextureBarrier(graph->Core, (ib_TextureBarrierDesc)
+												{
+													.Texture = resource->Texture,
+													.OldLayout = resource->TextureLayout,
+													.NewLayout = transition.Layout,
+													.SourceStageMask = resource->LastReleaseStageMask,
+													.DestStageMask = transition.AcquireStageMask,
+													.SourceAccessMask = resource->LastReleaseAccessMask,
+													.DestAccessMask = transition.AcquireAccessMask
+												});
+	}
+	else
+	{
+		*outBufferBarrier = (VkBufferMemoryBarrier2)
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+			.buffer = resource->Buffer->VulkanBuffer,
+			.size = VK_WHOLE_SIZE,
+			.srcStageMask = resource->LastReleaseStageMask,
+			.dstStageMask = transition.AcquireStageMask,
+			.srcAccessMask = resource->LastReleaseAccessMask,
+			.dstAccessMask = transition.AcquireAccessMask,
+		};
+	}
+
+	// Without a write or a layout change since the last barrier, what was visible then is still visible.
+	bool sameLayout = resource->Type != ibr_ResourceType_Texture || resource->TextureLayout == transition.Layout;
+	if (resource->LastReleaseAccessMask == VK_ACCESS_NONE && sameLayout)
+	{
+		resource->VisibleStageMask |= transition.AcquireStageMask;
+		resource->VisibleAccessMask |= transition.AcquireAccessMask;
+	}
+	else
+	{
+		resource->VisibleStageMask = transition.AcquireStageMask;
+		resource->VisibleAccessMask = transition.AcquireAccessMask;
+	}
+
+	// ASSUMPTION: Assume that what where we acquire is where we release for now.
+	resource->LastReleaseAccessMask = transition.ReleaseAccessMask;
+	resource->LastReleaseStageMask = transition.ReleaseStageMask;
+	if (resource->Type == ibr_ResourceType_Texture)
+	{
+		resource->TextureLayout = transition.Layout;
+	}
+	resource->IsPreAcquired = transition.IsSplitBarrier;
+
+	graph->BarrierStatistics.EmittedCount++;
+	return true;
+}
+
 typedef struct
 {
 	ibr_ResourceStateRange States;
@@ -78,6 +238,7 @@ typedef struct
 	uint32_t* OutImageBarrierCount;
 	VkBufferMemoryBarrier2** OutMemoryBarriers;
 	uint32_t* OutMemoryBarrierCount;
+	bool IsSplitBarrier;
 } CreatePipelineBarriersDesc;
 
 static void createPipelineBarriers(ibr_RenderGraph* graph, CreatePipelineBarriersDesc desc)
@@ -115,6 +276,8 @@ static void createPipelineBarriers(ibr_RenderGraph* graph, CreatePipelineBarrier
 		}
 	}
 
+	// Preallocated arrays may already hold barriers, append after them.
+	uint32_t imageBarrierWrite = 0;
 	VkImageMemoryBarrier2* imageBarriers = *desc.OutImageBarriers;
 	if (imageBarriers == NULL)
 	{
@@ -122,10 +285,10 @@ static void createPipelineBarriers(ibr_RenderGraph* graph, CreatePipelineBarrier
 	}
 	else
 	{
-		// API must have set OutImageBarrierCount if passing a preallocated array.
-		ib_assert(imageBarrierCount <= *desc.OutImageBarrierCount);
+		imageBarrierWrite = *desc.OutImageBarrierCount;
 	}
 
+	uint32_t memoryBarrierWrite = 0;
 	VkBufferMemoryBarrier2* memoryBarriers = *desc.OutMemoryBarriers;
 	if (memoryBarriers == NULL)
 	{
@@ -133,12 +296,9 @@ static void createPipelineBarriers(ibr_RenderGraph* graph, CreatePipelineBarrier
 	}
 	else
 	{
-		// API must have set OutImageBarrierCount if passing a preallocated array.
-		ib_assert(memoryBarrierCount <= *desc.OutMemoryBarrierCount);
+		memoryBarrierWrite = *desc.OutMemoryBarrierCount;
 	}
 
-	uint32_t imageBarrierWrite = 0;
-	uint32_t memoryBarrierWrite = 0;
 	for (ibr_ResourceState *iter = stateBegin; iter != stateEnd; iter++)
 	{
 		if (iter->Resource == NULL)
@@ -152,48 +312,28 @@ static void createPipelineBarriers(ibr_RenderGraph* graph, CreatePipelineBarrier
 		VkPipelineStageFlags releaseStageMask;
 		getAcquireAndReleaseMask(state, &acquireStageMask, &releaseStageMask);
 
+		ResourceTransition transition =
+		{
+			.Resource = state.Resource,
+			.Layout = state.Layout,
+			.AcquireStageMask = acquireStageMask,
+			.AcquireAccessMask = state.AcquireAccessMask,
+			.ReleaseStageMask = releaseStageMask,
+			.ReleaseAccessMask = state.ReleaseAccessMask,
+			.IsSplitBarrier = desc.IsSplitBarrier
+		};
+
 		if (state.Resource->Type == ibr_ResourceType_Texture)
 		{
-			ib_assert(imageBarrierWrite < imageBarrierCount);
-			if (imageBarrierWrite < imageBarrierCount)
+			if (transitionResource(graph, transition, &imageBarriers[imageBarrierWrite], NULL))
 			{
-				imageBarriers[imageBarrierWrite] = ib_createTextureBarrier(graph->Core, (ib_TextureBarrierDesc)
-																						{
-																							.Texture = state.Resource->Texture,
-																							.OldLayout = state.Resource->TextureLayout,
-																							.NewLayout = state.Layout,
-																							.SourceStageMask = state.Resource->LastReleaseStageMask,
-																							.DestStageMask = acquireStageMask,
-																							.SourceAccessMask = state.Resource->LastReleaseAccessMask,
-																							.DestAccessMask = state.AcquireAccessMask
-																						});
-
-				// ASSUMPTION: Assume that what where we acquire is where we release for now.
-				state.Resource->LastReleaseAccessMask = state.ReleaseAccessMask;
-				state.Resource->LastReleaseStageMask = releaseStageMask;
-				state.Resource->TextureLayout = state.Layout;
 				imageBarrierWrite++;
 			}
 		}
 		else if (state.Resource->Type == ibr_ResourceType_Buffer)
 		{
-			ib_assert(memoryBarrierWrite < memoryBarrierCount);
-			if (memoryBarrierWrite < memoryBarrierCount)
+			if (transitionResource(graph, transition, NULL, &memoryBarriers[memoryBarrierWrite]))
 			{
-				memoryBarriers[memoryBarrierWrite] = (VkBufferMemoryBarrier2)
-				{
-					.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
-					.buffer = state.Resource->Buffer->VulkanBuffer,
-					.size = VK_WHOLE_SIZE,
-					.srcStageMask = state.Resource->LastReleaseStageMask,
-					.dstStageMask = acquireStageMask,
-					.srcAccessMask = state.Resource->LastReleaseAccessMask,
-					.dstAccessMask = state.AcquireAccessMask,
-				};
-
-				// ASSUMPTION: Assume that what where we acquire is where we release for now.
-				state.Resource->LastReleaseAccessMask = state.ReleaseAccessMask;
-				state.Resource->LastReleaseStageMask = releaseStageMask;
 				memoryBarrierWrite++;
 			}
 		}
@@ -203,9 +343,9 @@ static void createPipelineBarriers(ibr_RenderGraph* graph, CreatePipelineBarrier
 		}
 	}
 	*desc.OutImageBarriers = imageBarriers;
-	*desc.OutImageBarrierCount = imageBarrierCount;
+	*desc.OutImageBarrierCount = imageBarrierWrite;
 	*desc.OutMemoryBarriers = memoryBarriers;
-	*desc.OutMemoryBarrierCount = memoryBarrierCount;
+	*desc.OutMemoryBarrierCount = memoryBarrierWrite;
 }
 
 typedef struct
@@ -232,127 +372,352 @@ void* stackPageToMemory(iba_PageHeader* header, size_t offset)
 	return ((uint8_t *)header) + sizeof(iba_PageHeader) + offset;
 }
 
-ibr_RenderGraphPool ibr_allocRenderGraphPool(ib_Core* core)
+static void initRecordingContext(ib_Core* core, ibr_RenderGraphPoolDesc const* desc, ibr_RecordingContext* context)
 {
-	ibr_RenderGraphPool pool = (ibr_RenderGraphPool) { 0 };
-	for (uint32_t i = 0; i < ib_FramebufferCount; i++)
-	{
-		pool.Graphs[i].Core = core;
-
-		static size_t const fullPageSize = 1024 * 1024;
-		iba_initStackAllocator((iba_StackAllocatorDesc)
-							{
-								.PageAllocator =
-								{
-									.AllocPage = &allocCPUPage,
-									.FreePage = &freeCPUPage
-								},
-								// Remove page header from page size to get the full page.
-								.PageSize = fullPageSize - sizeof(iba_PageHeader)
-							}, &pool.Graphs[i].FrameCPUStack);
-
-		ib_initTimerManager((ib_TimerManagerDesc)
+	static size_t const fullPageSize = 1024 * 1024;
+	iba_initStackAllocator((iba_StackAllocatorDesc)
+						{
+							.PageAllocator =
 							{
-								.Core = core,
-								.MaxTimerCount = 1024,
-							}, &pool.Graphs[i].TimerManager);
+								.AllocPage = &allocCPUPage,
+								.FreePage = &freeCPUPage
+							},
+							// Remove page header from page size to get the full page.
+							.PageSize = fullPageSize - sizeof(iba_PageHeader)
+						}, &context->FrameCPUStack);
+
+	ib_initTimerManager((ib_TimerManagerDesc)
+						{
+							.Core = core,
+							.MaxTimerCount = desc->MaxTimerCount > 0 ? desc->MaxTimerCount : ibr_DefaultMaxTimerCount,
+							.MaxPipelineStatisticsCount = desc->MaxPipelineStatisticsCount
+						}, &context->TimerManager);
 
-		// Create the descriptor pools
+	for (uint32_t q = 0; q < ib_Queue_Count; q++)
+	{
+		VkCommandPoolCreateInfo commandPoolCreateInfo =
 		{
-			uint32_t const maxTransientDescriptorTypeCount = 128;
-			uint32_t const maxTransientDescriptorSetCount = 128;
-			VkDescriptorPoolSize descriptorPoolSizes[] =
-			{
-				{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxTransientDescriptorTypeCount },
-				{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxTransientDescriptorTypeCount },
-				{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxTransientDescriptorTypeCount },
-				{ VK_DESCRIPTOR_TYPE_SAMPLER, maxTransientDescriptorTypeCount },
-				{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, maxTransientDescriptorTypeCount },
-			};
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+			.queueFamilyIndex = core->Queues[q].Index,
+		};
 
-			VkDescriptorPoolCreateInfo descriptorPoolCreate =
-			{
-				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-				.flags = 0,
-				.maxSets = maxTransientDescriptorSetCount,
-				.poolSizeCount = ib_arrayCount(descriptorPoolSizes),
-				.pPoolSizes = descriptorPoolSizes
-			};
+		ib_vkCheck(vkCreateCommandPool(core->LogicalDevice, &commandPoolCreateInfo, ib_NoVkAllocator, &context->TransientCommandPools[q]));
+	}
+}
 
-			ib_vkCheck(vkCreateDescriptorPool(core->LogicalDevice, &descriptorPoolCreate, ib_NoVkAllocator, &pool.Graphs[i].TransientDescriptorPool));
-		}
+static void killRecordingContext(ib_Core* core, ibr_RecordingContext* context)
+{
+	for (uint32_t q = 0; q < ib_Queue_Count; q++)
+	{
+		// Destroying the pool frees all of its command buffers.
+		vkDestroyCommandPool(core->LogicalDevice, context->TransientCommandPools[q], ib_NoVkAllocator);
+		free(context->TransientCommandBuffers[q].CommandBuffers);
+		free(context->TransientSecondaryCommandBuffers[q].CommandBuffers);
+		context->TransientCommandBuffers[q] = (ibr_CommandBufferList) { 0 };
+		context->TransientSecondaryCommandBuffers[q] = (ibr_CommandBufferList) { 0 };
+	}
 
-		for (uint32_t q = 0; q < ib_Queue_Count; q++)
+	ib_killTimerManager(core, &context->TimerManager);
+	iba_killStackAllocator(&context->FrameCPUStack);
+}
+
+static void initRenderGraph(ib_Core* core, ibr_RenderGraphPoolDesc const* desc, ibr_RenderGraph* graph)
+{
+	uint32_t recordingContextCount = desc->RecordingThreadCount > 0 ? desc->RecordingThreadCount : 1;
+	ib_assert(recordingContextCount <= ibr_MaxRecordingContextCount);
+
+	*graph = (ibr_RenderGraph) { 0 };
+	graph->Core = core;
+
+	// Contexts get their graph pointer in ibr_beginFrame, the pool is returned by copy.
+	graph->RecordingContextCount = recordingContextCount;
+	for (uint32_t c = 0; c < recordingContextCount; c++)
+	{
+		initRecordingContext(core, desc, &graph->RecordingContexts[c]);
+	}
+
+	// Create the descriptor pools
+	{
+		uint32_t const maxTransientDescriptorTypeCount = 128;
+		uint32_t const maxTransientDescriptorSetCount = 128;
+		VkDescriptorPoolSize descriptorPoolSizes[] =
 		{
-			VkCommandPoolCreateInfo commandPoolCreateInfo =
-			{
-				.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-				.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-				.queueFamilyIndex = core->Queues[q].Index,
-			};
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxTransientDescriptorTypeCount },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxTransientDescriptorTypeCount },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxTransientDescriptorTypeCount },
+			{ VK_DESCRIPTOR_TYPE_SAMPLER, maxTransientDescriptorTypeCount },
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, maxTransientDescriptorTypeCount },
+		};
 
-			ib_vkCheck(vkCreateCommandPool(core->LogicalDevice, &commandPoolCreateInfo, ib_NoVkAllocator, &pool.Graphs[i].TransientCommandPools[q]));
-		}
+		VkDescriptorPoolCreateInfo descriptorPoolCreate =
+		{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.flags = 0,
+			.maxSets = maxTransientDescriptorSetCount,
+			.poolSizeCount = ib_arrayCount(descriptorPoolSizes),
+			.pPoolSizes = descriptorPoolSizes
+		};
 
-		ib_vkCheck(vkCreateSemaphore(core->LogicalDevice, &(VkSemaphoreCreateInfo)
-									{
-										.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
-									}, ib_NoVkAllocator, &pool.Graphs[i].FrameSemaphore));
+		ib_vkCheck(vkCreateDescriptorPool(core->LogicalDevice, &descriptorPoolCreate, ib_NoVkAllocator, &graph->TransientDescriptorPool));
+	}
 
-		ib_vkCheck(vkCreateFence(core->LogicalDevice, &(VkFenceCreateInfo)
+	ib_vkCheck(vkCreateSemaphore(core->LogicalDevice, &(VkSemaphoreCreateInfo)
 								{
-									.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-									.flags = VK_FENCE_CREATE_SIGNALED_BIT
-								}, ib_NoVkAllocator, &pool.Graphs[i].FrameFence));
+									.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+								}, ib_NoVkAllocator, &graph->FrameSemaphore));
+
+	ib_vkCheck(vkCreateFence(core->LogicalDevice, &(VkFenceCreateInfo)
+							{
+								.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+								.flags = VK_FENCE_CREATE_SIGNALED_BIT
+							}, ib_NoVkAllocator, &graph->FrameFence));
+
+	for (uint32_t q = 0; q < ib_Queue_Count; q++)
+	{
+		graph->QueueTimelines[q] = ib_allocTimelineSemaphore(core, 0);
+	}
+}
+
+static void killRenderGraph(ib_Core* core, ibr_RenderGraph* graph)
+{
+	for (ibr_TransientTexture* iter = graph->TransientTextures; iter != NULL; iter = iter->Next)
+	{
+		ib_freeTexture(graph->Core, &iter->Texture);
+	}
+
+	for (ibr_TransientBuffer* iter = graph->TransientBuffers; iter != NULL; iter = iter->Next)
+	{
+		ib_freeBuffer(graph->Core, &iter->Buffer);
+	}
+
+	for (ibr_TransientImageView* iter = graph->TransientImageViews; iter != NULL; iter = iter->Next)
+	{
+		vkDestroyImageView(graph->Core->LogicalDevice, iter->View, ib_NoVkAllocator);
+	}
+
+	vkDestroyDescriptorPool(core->LogicalDevice, graph->TransientDescriptorPool, ib_NoVkAllocator);
+
+	for (uint32_t e = 0; e < graph->TransientEvents.AllocatedCount; e++)
+	{
+		vkDestroyEvent(core->LogicalDevice, graph->TransientEvents.Events[e], ib_NoVkAllocator);
+	}
+	free(graph->TransientEvents.Events);
+	graph->TransientEvents = (ibr_EventList) { 0 };
+
+	vkDestroyFence(core->LogicalDevice, graph->FrameFence, ib_NoVkAllocator);
+	vkDestroySemaphore(core->LogicalDevice, graph->FrameSemaphore, ib_NoVkAllocator);
+	for (uint32_t q = 0; q < ib_Queue_Count; q++)
+	{
+		ib_freeTimelineSemaphore(core, &graph->QueueTimelines[q]);
+	}
+
+	for (uint32_t c = 0; c < graph->RecordingContextCount; c++)
+	{
+		killRecordingContext(core, &graph->RecordingContexts[c]);
+	}
+}
+
+ibr_RenderGraphPool ibr_allocRenderGraphPool(ib_Core* core, ibr_RenderGraphPoolDesc desc)
+{
+	ibr_RenderGraphPool pool = (ibr_RenderGraphPool) { 0 };
+	pool.Desc = desc;
+	pool.FramesInFlight = desc.FramesInFlight > 0 ? ib_min(desc.FramesInFlight, ib_MaxFramesInFlight) : ib_FramebufferCount;
+	pool.LatencyMode = desc.LatencyMode;
+	pool.LatencySlack = desc.LatencySlack;
+	pool.ProfilingHistoryCapacity = desc.ProfilingHistoryFrameCount > 0 ? desc.ProfilingHistoryFrameCount : ibr_DefaultProfilingHistoryFrameCount;
+	pool.ProfilingHistory = (ibr_ProfiledFrame*)calloc(pool.ProfilingHistoryCapacity, sizeof(ibr_ProfiledFrame));
+	ib_assert(pool.ProfilingHistory != NULL);
+
+	for (uint32_t i = 0; i < pool.FramesInFlight; i++)
+	{
+		initRenderGraph(core, &desc, &pool.Graphs[i]);
 	}
 	return pool;
 }
 
 void ibr_freeRenderGraphPool(ib_Core* core, ibr_RenderGraphPool* pool)
 {
-	ib_potentiallyUnused(core);
+	if (pool->PipelineCacheSaveThread.Handle != NULL)
+	{
+		ib_joinThread(&pool->PipelineCacheSaveThread);
+	}
 
-	for (uint32_t i = 0; i < ib_FramebufferCount; i++)
+	for (uint32_t i = 0; i < pool->FramesInFlight; i++)
 	{
-		ibr_RenderGraph* graph = &pool->Graphs[i];
+		killRenderGraph(core, &pool->Graphs[i]);
+	}
+	pool->FramesInFlight = 0;
+
+	free(pool->ProfilingHistory);
+	pool->ProfilingHistory = NULL;
+	pool->ProfilingHistoryCapacity = 0;
+}
 
-		for (ibr_TransientTexture* iter = graph->TransientTextures; iter != NULL; iter = iter->Next)
+void ibr_setFramesInFlight(ib_Core* core, ibr_RenderGraphPool* pool, uint32_t framesInFlight)
+{
+	framesInFlight = ib_clamp(framesInFlight, 1, ib_MaxFramesInFlight);
+	if (framesInFlight == pool->FramesInFlight)
+	{
+		return;
+	}
+
+	// Only the graphs being removed have to be idle, but the frame indices are going to wrap differently.
+	// Let everything drain so no graph is still in flight when its slot gets reused.
+	for (uint32_t i = 0; i < pool->FramesInFlight; i++)
+	{
+		ibr_RenderGraph* graph = &pool->Graphs[i];
+		ib_vkCheck(vkWaitForFences(core->LogicalDevice, 1, &graph->FrameFence, VK_TRUE, UINT64_MAX));
+		for (uint32_t q = 0; q < ib_Queue_Count; q++)
 		{
-			ib_freeTexture(graph->Core, &iter->Texture);
+			ib_waitTimelineSemaphore(core, &graph->QueueTimelines[q]);
 		}
+	}
+
+	for (uint32_t i = framesInFlight; i < pool->FramesInFlight; i++)
+	{
+		killRenderGraph(core, &pool->Graphs[i]);
+	}
+
+	for (uint32_t i = pool->FramesInFlight; i < framesInFlight; i++)
+	{
+		initRenderGraph(core, &pool->Desc, &pool->Graphs[i]);
+	}
+	pool->FramesInFlight = framesInFlight;
+	pool->PredictedGPUEndTicks = 0;
+}
+
+static double overlapTime(double beginA, double endA, double beginB, double endB)
+{
+	double begin = beginA > beginB ? beginA : beginB;
+	double end = endA < endB ? endA : endB;
+	return end > begin ? end - begin : 0.0;
+}
 
-		for (ibr_TransientBuffer* iter = graph->TransientBuffers; iter != NULL; iter = iter->Next)
+static void pushTimelineEvent(ibr_ProfiledFrame* profiledFrame, ibr_TimelineEvent timelineEvent)
+{
+	if (profiledFrame != NULL && profiledFrame->EventCount < ibr_MaxTimelineEventCount)
+	{
+		profiledFrame->Events[profiledFrame->EventCount++] = timelineEvent;
+	}
+}
+
+// Submission timers live in the frame stack, this has to run before the stack gets reset and after the timers were resolved.
+static void gatherQueueTimings(ibr_RenderGraph* graph, ibr_ProfiledFrame* profiledFrame)
+{
+	typedef struct
+	{
+		ib_Queue Queue;
+		double Begin;
+		double End;
+	} SubmissionTiming;
+
+	SubmissionTiming timings[ibr_MaxSubmissionTimingCount];
+	uint32_t timingCount = 0;
+
+	ibr_RecordingContext* context = &graph->RecordingContexts[0];
+	for (ibr_TransientSubmission* iter = graph->Submissions; iter != NULL && timingCount < ibr_MaxSubmissionTimingCount; iter = iter->Next)
+	{
+		ibr_TimelineEvent timelineEvent =
 		{
-			ib_freeBuffer(graph->Core, &iter->Buffer);
-		}
+			.Type = ibr_TimelineEvent_Submit,
+			.Queue = iter->Queue,
+			.CPUBegin = ib_cpuTicksToMs(iter->CPUBeginTicks),
+			.CPUEnd = ib_cpuTicksToMs(iter->CPUEndTicks),
+			.HasGPUTiming = iter->IsTimed
+		};
 
-		for (ibr_TransientImageView* iter = graph->TransientImageViews; iter != NULL; iter = iter->Next)
+		if (iter->IsTimed)
 		{
-			vkDestroyImageView(graph->Core->LogicalDevice, iter->View, ib_NoVkAllocator);
+			SubmissionTiming timing = { .Queue = iter->Queue };
+			ib_getResolvedTimerRange(graph->Core, &context->TimerManager, &iter->Timer, &timing.Begin, &timing.End);
+			timings[timingCount++] = timing;
+
+			timelineEvent.GPUBegin = timing.Begin;
+			timelineEvent.GPUEnd = timing.End;
 		}
+		pushTimelineEvent(profiledFrame, timelineEvent);
+	}
+	list_clear(&graph->Submissions);
 
-		vkDestroyDescriptorPool(core->LogicalDevice, graph->TransientDescriptorPool, ib_NoVkAllocator);
+	ibr_QueueTimings queueTimings = { 0 };
+	for (uint32_t i = 0; i < timingCount; i++)
+	{
+		SubmissionTiming timing = timings[i];
+		queueTimings.BusyTime[timing.Queue] += timing.End - timing.Begin;
+		queueTimings.SubmissionCount[timing.Queue]++;
 
-		for (uint32_t q = 0; q < ib_Queue_Count; q++)
+		if (timing.Queue == ib_Queue_Graphics)
+		{
+			continue;
+		}
+
+		for (uint32_t g = 0; g < timingCount; g++)
 		{
-			vkDestroyCommandPool(core->LogicalDevice, graph->TransientCommandPools[q], ib_NoVkAllocator);
+			if (timings[g].Queue == ib_Queue_Graphics)
+			{
+				queueTimings.GraphicsOverlapTime[timing.Queue] += overlapTime(timing.Begin, timing.End, timings[g].Begin, timings[g].End);
+			}
 		}
+	}
+	graph->PreviousFrameQueueTimings = queueTimings;
+}
+
+// Sleep until the CPU can record and submit the frame just as the GPU finishes the previous one.
+// Input sampled after this is as fresh as it can be without starving the GPU.
+static uint64_t paceFrame(ibr_RenderGraphPool* pool)
+{
+	if (pool->LatencyMode != ibr_LatencyMode_LowLatency || pool->PredictedGPUEndTicks == 0)
+	{
+		return 0;
+	}
 
-		vkDestroyFence(core->LogicalDevice, graph->FrameFence, ib_NoVkAllocator);
-		vkDestroySemaphore(core->LogicalDevice, graph->FrameSemaphore, ib_NoVkAllocator);
+	uint64_t nowTicks = ib_cpuTicks();
+	if (pool->PredictedGPUEndTicks <= nowTicks)
+	{
+		return 0;
+	}
 
-		ib_killTimerManager(core, &graph->TimerManager);
-		iba_killStackAllocator(&graph->FrameCPUStack);
+	double untilGPUEnd = ib_cpuTicksToMs(pool->PredictedGPUEndTicks - nowTicks);
+	double sleepTime = untilGPUEnd - (pool->SmoothedCPUSubmitTime + pool->LatencySlack);
+	if (sleepTime <= 0.0)
+	{
+		return 0;
 	}
+
+	ib_sleepMs(sleepTime);
+	return ib_cpuTicks() - nowTicks;
+}
+
+static double smoothTime(double smoothed, double sample)
+{
+	double const smoothing = 0.1;
+	return smoothed == 0.0 ? sample : smoothed + (sample - smoothed) * smoothing;
 }
 
 ibr_RenderGraph* ibr_beginFrame(ibr_RenderGraphPool* pool, ibr_BeginFrameDesc desc)
 {
+	ib_assert(desc.FrameIndex < pool->FramesInFlight);
 	ibr_RenderGraph* graph = &pool->Graphs[desc.FrameIndex];
 
+	uint64_t pacingSleepTicks = paceFrame(pool);
+
 	// Fence is signaled - our resources are free, we're good to go!
+	uint64_t fenceWaitBeginTicks = ib_cpuTicks();
 	ib_vkCheck(vkWaitForFences(graph->Core->LogicalDevice, 1, &graph->FrameFence, VK_TRUE, UINT64_MAX));
 
+	// Submissions to other queues aren't covered by the frame fence, wait for them as well.
+	for (uint32_t q = 0; q < ib_Queue_Count; q++)
+	{
+		ib_waitTimelineSemaphore(graph->Core, &graph->QueueTimelines[q]);
+	}
+	uint64_t fenceWaitEndTicks = ib_cpuTicks();
+
+	// The oldest frame in flight is done, bindless slots and reloaded pipelines it could have referenced can be reused.
+	// Other pools on the same core report the same frame number, the core only advances on the first one.
+	ib_advanceBindlessFrame(graph->Core, pool->FrameNumber + 1, pool->FramesInFlight);
+	ib_advancePipelineReloads(graph->Core, pool->FrameNumber + 1, pool->FramesInFlight);
+
 	for (ibr_TransientTexture* head = graph->TransientTextures; head != NULL; head = head->Next)
 	{
 		ib_freeTexture(graph->Core, &head->Texture);
@@ -368,17 +733,29 @@ ibr_RenderGraph* ibr_beginFrame(ibr_RenderGraphPool* pool, ibr_BeginFrameDesc de
 		vkDestroyImageView(graph->Core->LogicalDevice, iter->View, ib_NoVkAllocator);
 	}
 
+	// The list nodes live in the frame stack which is about to be reset.
+	list_clear(&graph->TransientTextures);
+	list_clear(&graph->TransientBuffers);
+	list_clear(&graph->TransientImageViews);
+
 	vkResetDescriptorPool(graph->Core->LogicalDevice, graph->TransientDescriptorPool, 0);
-	for (uint32_t q = 0; q < ib_Queue_Count; q++)
+	for (uint32_t i = 0; i < graph->TransientEvents.UsedCount; i++)
+	{
+		ib_vkCheck(vkResetEvent(graph->Core->LogicalDevice, graph->TransientEvents.Events[i]));
+	}
+	graph->TransientEvents.UsedCount = 0;
+
+	for (uint32_t c = 0; c < graph->RecordingContextCount; c++)
 	{
-		vkResetCommandPool(graph->Core->LogicalDevice, graph->TransientCommandPools[q], 0);
-		// TODO: Revisit later. We should simply track the previous list of active command buffers and grow that list as we go.
-		// For now, just free our previous command buffers every frame.
-		for (ibr_TransientCommandBuffer* iter = graph->TransientCommandBuffers[q]; iter != NULL; iter = iter->Next)
+		ibr_RecordingContext* context = &graph->RecordingContexts[c];
+		context->Graph = graph;
+		for (uint32_t q = 0; q < ib_Queue_Count; q++)
 		{
-			vkFreeCommandBuffers(graph->Core->LogicalDevice, graph->TransientCommandPools[q], 1, &iter->CommandBuffer);
+			// Resetting the pool returns every command buffer to the initial state, we can hand them all out again.
+			vkResetCommandPool(graph->Core->LogicalDevice, context->TransientCommandPools[q], 0);
+			context->TransientCommandBuffers[q].UsedCount = 0;
+			context->TransientSecondaryCommandBuffers[q].UsedCount = 0;
 		}
-		list_clear(&graph->TransientCommandBuffers[q]);
 	}
 
 	if (desc.Surface != NULL)
@@ -409,41 +786,691 @@ ibr_RenderGraph* ibr_beginFrame(ibr_RenderGraphPool* pool, ibr_BeginFrameDesc de
 	// If we made it this far, we're good to go.
 	ib_vkCheck(vkResetFences(graph->Core->LogicalDevice, 1, &graph->FrameFence));
 
-	iba_stackReset(&graph->FrameCPUStack);
+	// Read back every context's queries in one go, the frame's fence was signaled so they should all be ready.
+	for (uint32_t c = 0; c < graph->RecordingContextCount; c++)
+	{
+		bool isBlocking = false;
+		bool isReady = ib_resolveTimers(graph->Core, &graph->RecordingContexts[c].TimerManager, isBlocking);
+		ib_assert(isReady);
+		ib_potentiallyUnused(isReady);
+	}
+
+	graph->PreviousFrameBarrierStatistics = graph->BarrierStatistics;
+	graph->BarrierStatistics = (ibr_BarrierStatistics) { 0 };
+
+	// Convert our timers to timings from the previous frame.
+	// Scopes live in the frame stacks, gather them before the stacks get reset.
+	ibr_ProfiledFrame const* previousProfiledFrame = ibr_getProfiledFrame(pool, 0);
+	ibr_ProfiledFrame* profiledFrame = NULL;
+	if (graph->FrameNumber != 0)
+	{
+		profiledFrame = &pool->ProfilingHistory[pool->ProfiledFrameCount % pool->ProfilingHistoryCapacity];
+		pool->ProfiledFrameCount++;
+
+		// The timing and event arrays make a profiled frame large, only reset the header and the counts
+		// instead of building a whole frame on the stack and copying it in.
+		profiledFrame->FrameNumber = graph->FrameNumber;
+		profiledFrame->CPUBegin = ib_cpuTicksToMs(graph->FrameCPUBeginTicks);
+		profiledFrame->CPUEnd = ib_cpuTicksToMs(graph->FrameCPUEndTicks);
+		profiledFrame->GPUToCPUOffset = 0.0;
+		profiledFrame->IsCalibrated = false;
+		profiledFrame->CPUWaitTime = ib_cpuTicksToMs(graph->FenceWaitCPUEndTicks - graph->FenceWaitCPUBeginTicks);
+		profiledFrame->GPUIdleTime = 0.0;
+		profiledFrame->GraphicsGPUEnd = 0.0;
+		profiledFrame->PacingSleepTime = 0.0;
+		profiledFrame->InputToPresentLatency = 0.0;
+		profiledFrame->TimingCount = 0;
+		profiledFrame->EventCount = 0;
+
+		pushTimelineEvent(profiledFrame, (ibr_TimelineEvent)
+		{
+			.Type = ibr_TimelineEvent_FenceWait,
+			.Queue = ib_Queue_Graphics,
+			.CPUBegin = ib_cpuTicksToMs(graph->FenceWaitCPUBeginTicks),
+			.CPUEnd = ib_cpuTicksToMs(graph->FenceWaitCPUEndTicks)
+		});
+	}
+	gatherQueueTimings(graph, profiledFrame);
+	if (graph->PreviousFrameQueueTimings.BusyTime[ib_Queue_Graphics] > 0.0)
+	{
+		pool->SmoothedGPUFrameTime = smoothTime(pool->SmoothedGPUFrameTime, graph->PreviousFrameQueueTimings.BusyTime[ib_Queue_Graphics]);
+	}
 
-	// Convert our timers to timings from the previous frame
+	if (profiledFrame != NULL && graph->PresentCPUBeginTicks != 0)
 	{
-		list_clear(&graph->PreviousFrameTimings);
-		for (ibr_TransientProfileScope* iter = graph->CompletedScopes; iter != NULL; iter = iter->Next)
+		pushTimelineEvent(profiledFrame, (ibr_TimelineEvent)
+		{
+			.Type = ibr_TimelineEvent_Present,
+			.Queue = ib_Queue_Present,
+			.CPUBegin = ib_cpuTicksToMs(graph->PresentCPUBeginTicks),
+			.CPUEnd = ib_cpuTicksToMs(graph->PresentCPUEndTicks)
+		});
+	}
+
+	double firstGPUBegin = 0.0;
+	for (uint32_t c = 0; c < graph->RecordingContextCount; c++)
+	{
+		ibr_RecordingContext* context = &graph->RecordingContexts[c];
+		for (ibr_TransientProfileScope* iter = context->CompletedScopes; iter != NULL && profiledFrame != NULL; iter = iter->Next)
 		{
-			bool isBlocking = false;
 			ibr_ProfilingScope* scope = &iter->Scope;
-			ibr_TransientScopeTiming* transientTiming;
-			list_pushAlloc(transientTiming, ibr_TransientScopeTiming, &graph->PreviousFrameTimings);
-			transientTiming->Timing = (ibr_ScopeTiming)
+			ib_assert(profiledFrame->TimingCount < ibr_MaxProfilingScopeCount);
+			if (profiledFrame->TimingCount == ibr_MaxProfilingScopeCount)
+			{
+				break;
+			}
+
+			ibr_ScopeTiming timing =
 			{
-				.Timing = ib_queryTimer(graph->Core, &graph->TimerManager, &scope->Timer, isBlocking),
 				.Name = scope->Name,
+				.CPUBegin = ib_cpuTicksToMs(scope->CPUBeginTicks),
+				.CPUEnd = ib_cpuTicksToMs(scope->CPUEndTicks),
+				.Depth = scope->Depth,
+				.ThreadIndex = c,
+				.Queue = scope->Queue,
+				.IsCPUOnly = scope->IsCPUOnly
 			};
-			ib_assert(transientTiming->Timing.Timing != ib_TimerQueryNotReady); // We should be ready, our frame's fence was signaled.
+
+			if (scope->HasPipelineStatistics)
+			{
+				timing.HasPipelineStatistics = true;
+				timing.PipelineStatistics = ib_getResolvedPipelineStatistics(&context->TimerManager, &scope->PipelineStatisticsQuery);
+			}
+
+			if (!scope->IsCPUOnly)
+			{
+				ib_getResolvedTimerRange(graph->Core, &context->TimerManager, &scope->Timer, &timing.GPUBegin, &timing.GPUEnd);
+				timing.Timing = timing.GPUEnd - timing.GPUBegin;
+
+				if (firstGPUBegin == 0.0 || timing.GPUBegin < firstGPUBegin)
+				{
+					firstGPUBegin = timing.GPUBegin;
+				}
+			}
+
+			profiledFrame->Timings[profiledFrame->TimingCount++] = timing;
 		}
-		list_clear(&graph->CompletedScopes);
+		list_clear(&context->CompletedScopes);
+
+		iba_stackReset(&context->FrameCPUStack);
+		ib_resetTimersCPU(graph->Core, &context->TimerManager);
+	}
+
+	list_clear(&graph->PreviousFrameTimings);
+	if (profiledFrame != NULL)
+	{
+		// Submissions bracket every scope, they give us the frame's GPU range.
+		double graphicsBegin = 0.0;
+		double graphicsEnd = 0.0;
+		for (uint32_t i = 0; i < profiledFrame->EventCount; i++)
+		{
+			ibr_TimelineEvent const* timelineEvent = &profiledFrame->Events[i];
+			if (!timelineEvent->HasGPUTiming)
+			{
+				continue;
+			}
+
+			if (firstGPUBegin == 0.0 || timelineEvent->GPUBegin < firstGPUBegin)
+			{
+				firstGPUBegin = timelineEvent->GPUBegin;
+			}
+
+			if (timelineEvent->Queue == ib_Queue_Graphics)
+			{
+				graphicsBegin = graphicsBegin == 0.0 ? timelineEvent->GPUBegin : ib_min(graphicsBegin, timelineEvent->GPUBegin);
+				graphicsEnd = ib_max(graphicsEnd, timelineEvent->GPUEnd);
+			}
+		}
+
+		ib_TimestampCalibration calibration;
+		if (ib_calibrateTimestamps(graph->Core, &calibration))
+		{
+			profiledFrame->GPUToCPUOffset = ib_cpuTicksToMs(calibration.CPUTicks) - calibration.GPUTime;
+			profiledFrame->IsCalibrated = true;
+		}
+		// Without a shared clock, line the GPU work up with the frame's first submission.
+		else if (firstGPUBegin != 0.0 && graph->FirstSubmitCPUTicks != 0)
+		{
+			profiledFrame->GPUToCPUOffset = ib_cpuTicksToMs(graph->FirstSubmitCPUTicks) - firstGPUBegin;
+		}
+
+		// Graphics submissions execute in order, anything in their range they weren't busy for is a bubble.
+		// The gap since the previous frame only means something if both frames are on a calibrated clock.
+		if (graphicsEnd > graphicsBegin)
+		{
+			profiledFrame->GraphicsGPUEnd = graphicsEnd + profiledFrame->GPUToCPUOffset;
+			profiledFrame->GPUIdleTime = ib_max(0.0, (graphicsEnd - graphicsBegin) - graph->PreviousFrameQueueTimings.BusyTime[ib_Queue_Graphics]);
+			if (profiledFrame->IsCalibrated
+				&& previousProfiledFrame != NULL
+				&& previousProfiledFrame->IsCalibrated
+				&& previousProfiledFrame->FrameNumber + 1 == profiledFrame->FrameNumber)
+			{
+				double gap = graphicsBegin + profiledFrame->GPUToCPUOffset - previousProfiledFrame->GraphicsGPUEnd;
+				profiledFrame->GPUIdleTime += ib_max(0.0, gap);
+			}
+		}
+
+		profiledFrame->PacingSleepTime = ib_cpuTicksToMs(graph->PacingSleepTicks);
+		if (graph->PresentCPUEndTicks != 0 && graph->InputCPUTicks != 0)
+		{
+			double presentReady = ib_cpuTicksToMs(graph->PresentCPUEndTicks);
+			if (profiledFrame->IsCalibrated)
+			{
+				presentReady = ib_max(presentReady, profiledFrame->GraphicsGPUEnd);
+			}
+			profiledFrame->InputToPresentLatency = presentReady - ib_cpuTicksToMs(graph->InputCPUTicks);
+		}
+
+		for (uint32_t i = 0; i < profiledFrame->TimingCount; i++)
+		{
+			ibr_TransientScopeTiming* transientTiming;
+			list_pushAlloc(transientTiming, ibr_TransientScopeTiming, &graph->PreviousFrameTimings);
+			transientTiming->Timing = profiledFrame->Timings[i];
+		}
+	}
+
+	graph->FrameNumber = ++pool->FrameNumber;
+	graph->FrameCPUBeginTicks = ib_cpuTicks();
+	graph->FrameCPUEndTicks = graph->FrameCPUBeginTicks;
+	graph->FirstSubmitCPUTicks = 0;
+	graph->FenceWaitCPUBeginTicks = fenceWaitBeginTicks;
+	graph->FenceWaitCPUEndTicks = fenceWaitEndTicks;
+	graph->PresentCPUBeginTicks = 0;
+	graph->PresentCPUEndTicks = 0;
+	graph->PacingSleepTicks = pacingSleepTicks;
+	graph->InputCPUTicks = graph->FrameCPUBeginTicks;
+
+	return graph;
+}
+
+static void savePipelineCacheThread(void* core)
+{
+	ib_savePipelineCache((ib_Core*)core);
+}
+
+void ibr_endFrame(ibr_RenderGraphPool* pool, ibr_RenderGraph* graph)
+{
+	for (uint32_t c = 0; c < graph->RecordingContextCount; c++)
+	{
+		ib_assert(graph->RecordingContexts[c].ActiveProfilingScopes == NULL);
+	}
+	graph->FrameCPUEndTicks = ib_cpuTicks();
+
+	// Work submitted this frame starts once the GPU is done with everything before it.
+	if (graph->FirstSubmitCPUTicks != 0)
+	{
+		pool->SmoothedCPUSubmitTime = smoothTime(pool->SmoothedCPUSubmitTime, ib_cpuTicksToMs(graph->FirstSubmitCPUTicks - graph->FrameCPUBeginTicks));
+		if (pool->SmoothedGPUFrameTime > 0.0)
+		{
+			uint64_t gpuBeginTicks = ib_max(graph->FirstSubmitCPUTicks, pool->PredictedGPUEndTicks);
+			pool->PredictedGPUEndTicks = gpuBeginTicks + ib_cpuMsToTicks(pool->SmoothedGPUFrameTime);
+		}
+	}
+
+	// Saving reads the whole cache back and writes a file, keep it off the frame thread.
+	if (graph->FrameNumber != 0 && graph->FrameNumber % ibr_PipelineCacheSaveFrameInterval == 0)
+	{
+		if (pool->PipelineCacheSaveThread.Handle != NULL)
+		{
+			ib_joinThread(&pool->PipelineCacheSaveThread);
+		}
+		pool->PipelineCacheSaveThread = ib_startThread(savePipelineCacheThread, graph->Core);
+	}
+}
+
+void ibr_markInputSampled(ibr_RenderGraph* graph)
+{
+	graph->InputCPUTicks = ib_cpuTicks();
+}
+
+ibr_ProfiledFrame const* ibr_getProfiledFrame(ibr_RenderGraphPool const* pool, uint32_t framesAgo)
+{
+	if (framesAgo >= pool->ProfiledFrameCount || framesAgo >= pool->ProfilingHistoryCapacity)
+	{
+		return NULL;
+	}
+
+	uint32_t index = (pool->ProfiledFrameCount - 1 - framesAgo) % pool->ProfilingHistoryCapacity;
+	return &pool->ProfilingHistory[index];
+}
+
+static void writeJSONString(FILE* file, char const* string)
+{
+	fputc('"', file);
+	for (char const* iter = string; *iter != '\0'; iter++)
+	{
+		if (*iter == '"' || *iter == '\\')
+		{
+			fputc('\\', file);
+		}
+
+		if ((unsigned char)*iter >= 0x20)
+		{
+			fputc(*iter, file);
+		}
+	}
+	fputc('"', file);
+}
+
+bool ibr_writeChromeTrace(ibr_RenderGraphPool const* pool, char const* filePath)
+{
+	FILE* file = fopen(filePath, "w");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	// Timestamps are in microseconds, CPU tracks live in process 0 and GPU tracks in process 1.
+	enum
+	{
+		CPUProcess = 0,
+		GPUProcess = 1
+	};
+
+	static char const* queueNames[ib_Queue_Count] =
+	{
+		[ib_Queue_Present] = "Present Queue",
+		[ib_Queue_Graphics] = "Graphics Queue",
+		[ib_Queue_Compute] = "Compute Queue",
+		[ib_Queue_Transfer] = "Transfer Queue"
+	};
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"CPU\"}},\n", CPUProcess);
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"GPU\"}}", GPUProcess);
+	for (uint32_t q = 0; q < ib_Queue_Count; q++)
+	{
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", GPUProcess, q, queueNames[q]);
+	}
+
+	for (uint32_t c = 0; c < pool->Graphs[0].RecordingContextCount; c++)
+	{
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"Recording Thread %u\"}}", CPUProcess, c, c);
+	}
+
+	static char const* timelineEventNames[] =
+	{
+		[ibr_TimelineEvent_Submit] = "Submit",
+		[ibr_TimelineEvent_FenceWait] = "Fence Wait",
+		[ibr_TimelineEvent_Present] = "Present"
+	};
+
+	uint32_t flowID = 0;
+	uint32_t frameCount = ib_min(pool->ProfiledFrameCount, pool->ProfilingHistoryCapacity);
+	for (uint32_t f = frameCount; f > 0; f--)
+	{
+		ibr_ProfiledFrame const* frame = ibr_getProfiledFrame(pool, f - 1);
+		fprintf(file, ",\n{\"name\":\"Frame %llu\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"cpuWait\":%.3f,\"gpuIdle\":%.3f,\"pacingSleep\":%.3f,\"inputToPresent\":%.3f,\"calibrated\":%s}}",
+				(unsigned long long)frame->FrameNumber, CPUProcess, frame->CPUBegin * 1000.0, (frame->CPUEnd - frame->CPUBegin) * 1000.0,
+				frame->CPUWaitTime, frame->GPUIdleTime, frame->PacingSleepTime, frame->InputToPresentLatency, frame->IsCalibrated ? "true" : "false");
+
+		for (uint32_t i = 0; i < frame->EventCount; i++)
+		{
+			ibr_TimelineEvent const* timelineEvent = &frame->Events[i];
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"sync\",\"ph\":\"X\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"queue\":\"%s\"}}",
+					timelineEventNames[timelineEvent->Type], CPUProcess, timelineEvent->CPUBegin * 1000.0, (timelineEvent->CPUEnd - timelineEvent->CPUBegin) * 1000.0,
+					queueNames[timelineEvent->Queue]);
+
+			if (timelineEvent->HasGPUTiming)
+			{
+				// Flow arrow from the submit call to the GPU picking the work up, long arrows are submission latency.
+				double gpuBegin = (timelineEvent->GPUBegin + frame->GPUToCPUOffset) * 1000.0;
+				fprintf(file, ",\n{\"name\":\"Submission\",\"cat\":\"submit\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+						GPUProcess, (uint32_t)timelineEvent->Queue, gpuBegin, (timelineEvent->GPUEnd - timelineEvent->GPUBegin) * 1000.0);
+				fprintf(file, ",\n{\"name\":\"Submit\",\"cat\":\"submit\",\"ph\":\"s\",\"id\":%u,\"pid\":%d,\"tid\":0,\"ts\":%.3f}",
+						flowID, CPUProcess, timelineEvent->CPUBegin * 1000.0);
+				fprintf(file, ",\n{\"name\":\"Submit\",\"cat\":\"submit\",\"ph\":\"f\",\"bp\":\"e\",\"id\":%u,\"pid\":%d,\"tid\":%u,\"ts\":%.3f}",
+						flowID, GPUProcess, (uint32_t)timelineEvent->Queue, gpuBegin);
+				flowID++;
+			}
+		}
+
+		for (uint32_t i = 0; i < frame->TimingCount; i++)
+		{
+			ibr_ScopeTiming const* timing = &frame->Timings[i];
+			char const* name = timing->Name != NULL ? timing->Name : "Unnamed Scope";
+
+			fprintf(file, ",\n{\"name\":");
+			writeJSONString(file, name);
+			fprintf(file, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%u}}",
+					CPUProcess, timing->ThreadIndex, timing->CPUBegin * 1000.0, (timing->CPUEnd - timing->CPUBegin) * 1000.0, timing->Depth);
+
+			if (!timing->IsCPUOnly)
+			{
+				fprintf(file, ",\n{\"name\":");
+				writeJSONString(file, name);
+				fprintf(file, ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%u,\"frame\":%llu",
+						GPUProcess, (uint32_t)timing->Queue, (timing->GPUBegin + frame->GPUToCPUOffset) * 1000.0, timing->Timing * 1000.0,
+						timing->Depth, (unsigned long long)frame->FrameNumber);
+
+				if (timing->HasPipelineStatistics)
+				{
+					ib_PipelineStatistics const* statistics = &timing->PipelineStatistics;
+					fprintf(file, ",\"vertices\":%llu,\"primitives\":%llu,\"vertexInvocations\":%llu,\"clippedPrimitives\":%llu,\"fragmentInvocations\":%llu,\"computeInvocations\":%llu",
+							(unsigned long long)statistics->InputAssemblyVertices, (unsigned long long)statistics->InputAssemblyPrimitives,
+							(unsigned long long)statistics->VertexShaderInvocations, (unsigned long long)statistics->ClippingPrimitives,
+							(unsigned long long)statistics->FragmentShaderInvocations, (unsigned long long)statistics->ComputeShaderInvocations);
+				}
+				fprintf(file, "}}");
+			}
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
+
+static int compareDoubles(void const* lhs, void const* rhs)
+{
+	double l = *(double const*)lhs;
+	double r = *(double const*)rhs;
+	return (l > r) - (l < r);
+}
+
+static void addBenchmarkPassTiming(ibr_BenchmarkResult* result, ibr_ScopeTiming const* timing)
+{
+	char const* name = timing->Name != NULL ? timing->Name : "Unnamed Scope";
+
+	ibr_BenchmarkPassTiming* pass = NULL;
+	for (uint32_t i = 0; i < result->PassCount; i++)
+	{
+		if (result->Passes[i].Depth == timing->Depth && strcmp(result->Passes[i].Name, name) == 0)
+		{
+			pass = &result->Passes[i];
+			break;
+		}
+	}
+
+	if (pass == NULL)
+	{
+		if (result->PassCount == ibr_MaxBenchmarkPassCount)
+		{
+			return;
+		}
+
+		pass = &result->Passes[result->PassCount++];
+		*pass = (ibr_BenchmarkPassTiming) { .Name = name, .Depth = timing->Depth, .MinGPUTime = DBL_MAX };
+	}
+
+	// Accumulated in the mean until the run is done.
+	pass->MeanGPUTime += timing->Timing;
+	pass->MinGPUTime = ib_min(pass->MinGPUTime, timing->Timing);
+	pass->MaxGPUTime = ib_max(pass->MaxGPUTime, timing->Timing);
+	pass->SampleCount++;
+}
+
+static bool writeBenchmarkImage(ib_Core* core, ib_Texture const* texture, VkImageLayout layout, char const* filePath)
+{
+	bool isBGRA = texture->Format == VK_FORMAT_B8G8R8A8_UNORM || texture->Format == VK_FORMAT_B8G8R8A8_SRGB;
+	bool isRGBA = texture->Format == VK_FORMAT_R8G8B8A8_UNORM || texture->Format == VK_FORMAT_R8G8B8A8_SRGB;
+	if (!isBGRA && !isRGBA)
+	{
+		return false;
+	}
+
+	uint32_t width = texture->Extent.width;
+	uint32_t height = texture->Extent.height;
+	ib_Buffer readback = ib_allocBuffer(core, (ib_BufferDesc)
+	{
+		.Usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		.Size = (size_t)width * height * 4,
+		.RequiredMemoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		.PreferredMemoryFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+		.DebugName = "Benchmark Readback"
+	});
+
+	// The device is idle, the barriers only have to move the texture in and out of the copy layout.
+	VkCommandBuffer cmd = ib_allocAndBeginCommandBuffer(core, ib_Queue_Graphics);
+	VkImageMemoryBarrier2 barrier = ib_createTextureBarrier(core, (ib_TextureBarrierDesc)
+	{
+		.Texture = texture,
+		.SourceAccessMask = 0,
+		.DestAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.SourceStageMask = VK_PIPELINE_STAGE_2_NONE,
+		.DestStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+		.OldLayout = layout,
+		.NewLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+	});
+	vkCmdPipelineBarrier2(cmd, &(VkDependencyInfo) { .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrier });
+
+	vkCmdCopyImageToBuffer(cmd, texture->Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.VulkanBuffer, 1, &(VkBufferImageCopy)
+	{
+		.imageSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1 },
+		.imageExtent = { width, height, 1 }
+	});
+
+	barrier = ib_createTextureBarrier(core, (ib_TextureBarrierDesc)
+	{
+		.Texture = texture,
+		.SourceAccessMask = 0,
+		.DestAccessMask = 0,
+		.SourceStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+		.DestStageMask = VK_PIPELINE_STAGE_2_NONE,
+		.OldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.NewLayout = layout
+	});
+	VkBufferMemoryBarrier2 hostBarrier =
+	{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+		.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+		.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = readback.VulkanBuffer,
+		.size = VK_WHOLE_SIZE
+	};
+	vkCmdPipelineBarrier2(cmd, &(VkDependencyInfo)
+	{
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.bufferMemoryBarrierCount = 1,
+		.pBufferMemoryBarriers = &hostBarrier,
+		.imageMemoryBarrierCount = layout != VK_IMAGE_LAYOUT_UNDEFINED ? 1 : 0,
+		.pImageMemoryBarriers = &barrier
+	});
+	ib_endAndSubmitCommandBuffer(core, cmd, ib_Queue_Graphics);
+	ib_vkCheck(vkQueueWaitIdle(core->Queues[ib_Queue_Graphics].Queue));
+	ib_freeCommandBuffer(core, ib_Queue_Graphics, cmd);
+
+	bool result = false;
+	FILE* file = fopen(filePath, "wb");
+	if (file != NULL)
+	{
+		fprintf(file, "P6\n%u %u\n255\n", width, height);
+
+		uint8_t const* pixels = (uint8_t const*)readback.Allocation.CPUMemory;
+		uint8_t* row = (uint8_t*)malloc((size_t)width * 3);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				uint8_t const* pixel = &pixels[((size_t)y * width + x) * 4];
+				row[x * 3 + 0] = pixel[isBGRA ? 2 : 0];
+				row[x * 3 + 1] = pixel[1];
+				row[x * 3 + 2] = pixel[isBGRA ? 0 : 2];
+			}
+			fwrite(row, 3, width, file);
+		}
+		free(row);
+		result = fclose(file) == 0;
+	}
+
+	ib_freeBuffer(core, &readback);
+	return result;
+}
+
+ibr_BenchmarkResult ibr_runBenchmark(ib_Core* core, ibr_RenderGraphPool* pool, ibr_BenchmarkDesc desc)
+{
+	ib_assert(desc.RecordFrame != NULL);
+
+	ibr_BenchmarkResult result = { .FrameCount = desc.FrameCount };
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(core->PhysicalDevice, &properties);
+	memcpy(result.DeviceName, properties.deviceName, sizeof(result.DeviceName));
+
+	// A frame is only profiled once its graph comes back around, keep going until the last measured frame has been.
+	uint32_t measuredEnd = desc.WarmupFrameCount + desc.FrameCount;
+	uint32_t totalFrameCount = measuredEnd + pool->FramesInFlight;
+	uint64_t firstFrameNumber = pool->FrameNumber + 1;
+	uint32_t seenProfiledFrameCount = pool->ProfiledFrameCount;
+
+	// CPU frame times are measured from one frame's begin to the next, so we need one more begin than measured frames.
+	uint64_t* beginTicks = (uint64_t*)malloc(sizeof(uint64_t) * (desc.FrameCount + 1));
+	double cpuWaitTime = 0.0;
+	double gpuFrameTime = 0.0;
+	for (uint32_t frame = 0; frame < totalFrameCount; frame++)
+	{
+		uint64_t frameBeginTicks = ib_cpuTicks();
+		if (frame >= desc.WarmupFrameCount && frame <= measuredEnd)
+		{
+			beginTicks[frame - desc.WarmupFrameCount] = frameBeginTicks;
+		}
+
+		ibr_RenderGraph* graph = ibr_beginFrame(pool, (ibr_BeginFrameDesc) { .FrameIndex = frame % pool->FramesInFlight });
+		ib_assert(graph != NULL);
+		desc.RecordFrame(graph, frame, desc.UserData);
+		ibr_endFrame(pool, graph);
+
+		if (frame < measuredEnd)
+		{
+			iba_GpuAllocatorStats memory = iba_getGpuAllocatorStats(&core->Allocator);
+			result.PeakAllocatedSize = ib_max(result.PeakAllocatedSize, memory.AllocatedSize);
+			if (frame + 1 == measuredEnd)
+			{
+				result.Memory = memory;
+			}
+		}
+
+		for (; seenProfiledFrameCount < pool->ProfiledFrameCount; seenProfiledFrameCount++)
+		{
+			ibr_ProfiledFrame const* profiledFrame = ibr_getProfiledFrame(pool, pool->ProfiledFrameCount - 1 - seenProfiledFrameCount);
+			if (profiledFrame == NULL)
+			{
+				continue;
+			}
+
+			uint64_t profiledIndex = profiledFrame->FrameNumber - firstFrameNumber;
+			if (profiledFrame->FrameNumber < firstFrameNumber || profiledIndex < desc.WarmupFrameCount || profiledIndex >= measuredEnd)
+			{
+				continue;
+			}
+
+			double gpuBegin = DBL_MAX;
+			double gpuEnd = 0.0;
+			for (uint32_t i = 0; i < profiledFrame->TimingCount; i++)
+			{
+				ibr_ScopeTiming const* timing = &profiledFrame->Timings[i];
+				if (timing->IsCPUOnly)
+				{
+					continue;
+				}
+
+				addBenchmarkPassTiming(&result, timing);
+				gpuBegin = ib_min(gpuBegin, timing->GPUBegin);
+				gpuEnd = ib_max(gpuEnd, timing->GPUEnd);
+			}
+
+			if (gpuEnd > gpuBegin)
+			{
+				gpuFrameTime += gpuEnd - gpuBegin;
+				result.MaxGPUFrameTime = ib_max(result.MaxGPUFrameTime, gpuEnd - gpuBegin);
+			}
+			cpuWaitTime += profiledFrame->CPUWaitTime;
+			result.ProfiledFrameCount++;
+		}
+	}
+
+	if (desc.FrameCount > 0)
+	{
+		double* frameTimes = (double*)malloc(sizeof(double) * desc.FrameCount);
+		double totalFrameTime = 0.0;
+		for (uint32_t i = 0; i < desc.FrameCount; i++)
+		{
+			frameTimes[i] = ib_cpuTicksToMs(beginTicks[i + 1] - beginTicks[i]);
+			totalFrameTime += frameTimes[i];
+		}
+		qsort(frameTimes, desc.FrameCount, sizeof(double), compareDoubles);
+
+		result.MeanCPUFrameTime = totalFrameTime / (double)desc.FrameCount;
+		result.MedianCPUFrameTime = frameTimes[desc.FrameCount / 2];
+		result.P99CPUFrameTime = frameTimes[(uint32_t)((double)(desc.FrameCount - 1) * 0.99)];
+		result.MaxCPUFrameTime = frameTimes[desc.FrameCount - 1];
+		free(frameTimes);
+	}
+	free(beginTicks);
+
+	if (result.ProfiledFrameCount > 0)
+	{
+		result.MeanCPUWaitTime = cpuWaitTime / (double)result.ProfiledFrameCount;
+		result.MeanGPUFrameTime = gpuFrameTime / (double)result.ProfiledFrameCount;
+	}
+
+	for (uint32_t i = 0; i < result.PassCount; i++)
+	{
+		result.Passes[i].MeanGPUTime /= (double)result.Passes[i].SampleCount;
+	}
+
+	if (desc.OutputTexture != NULL && desc.OutputImagePath != NULL)
+	{
+		vkDeviceWaitIdle(core->LogicalDevice);
+		result.WroteImage = writeBenchmarkImage(core, desc.OutputTexture, desc.OutputTextureLayout, desc.OutputImagePath);
+	}
+
+	if (desc.ResultsPath != NULL)
+	{
+		ibr_writeBenchmarkJSON(&result, desc.ResultsPath);
 	}
-	ib_resetTimersCPU(graph->Core, &graph->TimerManager);
 
-	return graph;
+	return result;
 }
 
-void ibr_endFrame(ibr_RenderGraphPool* pool, ibr_RenderGraph* graph)
+bool ibr_writeBenchmarkJSON(ibr_BenchmarkResult const* result, char const* filePath)
 {
-	ib_potentiallyUnused(pool);
-	ib_potentiallyUnused(graph);
-	ib_assert(graph->ActiveProfilingScopes == NULL);
+	FILE* file = fopen(filePath, "w");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	fprintf(file, "{\n\"device\":");
+	writeJSONString(file, result->DeviceName);
+	fprintf(file, ",\n\"frames\":%u,\n\"profiledFrames\":%u,\n", result->FrameCount, result->ProfiledFrameCount);
+	fprintf(file, "\"cpuFrameMs\":{\"mean\":%.4f,\"median\":%.4f,\"p99\":%.4f,\"max\":%.4f,\"meanWait\":%.4f},\n",
+			result->MeanCPUFrameTime, result->MedianCPUFrameTime, result->P99CPUFrameTime, result->MaxCPUFrameTime, result->MeanCPUWaitTime);
+	fprintf(file, "\"gpuFrameMs\":{\"mean\":%.4f,\"max\":%.4f},\n", result->MeanGPUFrameTime, result->MaxGPUFrameTime);
+	fprintf(file, "\"memory\":{\"reservedBytes\":%llu,\"allocatedBytes\":%llu,\"peakAllocatedBytes\":%llu,\"allocations\":%u,\"roots\":%u,\"pools\":%u},\n",
+			(unsigned long long)result->Memory.ReservedSize, (unsigned long long)result->Memory.AllocatedSize, (unsigned long long)result->PeakAllocatedSize,
+			result->Memory.AllocationCount, result->Memory.RootCount, result->Memory.PoolCount);
+
+	fprintf(file, "\"passes\":[");
+	for (uint32_t i = 0; i < result->PassCount; i++)
+	{
+		ibr_BenchmarkPassTiming const* pass = &result->Passes[i];
+		fprintf(file, "%s\n{\"name\":", i > 0 ? "," : "");
+		writeJSONString(file, pass->Name);
+		fprintf(file, ",\"depth\":%u,\"samples\":%u,\"meanMs\":%.4f,\"minMs\":%.4f,\"maxMs\":%.4f}",
+				pass->Depth, pass->SampleCount, pass->MeanGPUTime, pass->MinGPUTime, pass->MaxGPUTime);
+	}
+	fprintf(file, "\n]\n}\n");
+	return fclose(file) == 0;
 }
 
 void* ibr_allocTransientMemory(ibr_RenderGraph* graph, size_t size)
 {
-	iba_StackAllocation allocation = iba_stackAlloc(&graph->FrameCPUStack, (iba_StackAllocationRequest) { size });
+	return ibr_allocContextTransientMemory(&graph->RecordingContexts[0], size);
+}
+
+ibr_RecordingContext* ibr_getRecordingContext(ibr_RenderGraph* graph, uint32_t threadIndex)
+{
+	ib_assert(threadIndex < graph->RecordingContextCount);
+	return &graph->RecordingContexts[threadIndex];
+}
+
+void* ibr_allocContextTransientMemory(ibr_RecordingContext* context, size_t size)
+{
+	iba_StackAllocation allocation = iba_stackAlloc(&context->FrameCPUStack, (iba_StackAllocationRequest) { size });
 	return stackPageToMemory(allocation.Page, allocation.Offset);
 }
 
@@ -563,19 +1590,19 @@ ib_ShaderInput ibr_allocTransientShaderInput(ibr_RenderGraph* graph, ib_AllocSha
 	return ib_allocShaderInput(graph->Core, desc);
 }
 
-ib_ShaderInput ibr_resourcesToShaderInput(ibr_RenderGraph* graph, ibr_ResourceToShaderInputDesc desc)
+static uint32_t resourcesToShaderInputWrites(ibr_RenderGraph* graph, ib_ShaderInputRange shaderInputs, ibr_Resource* const* resources, uint32_t resourceCount, ib_ShaderInputWrite** outWrites)
 {
-	ib_assert(desc.Resources.Count <= desc.ShaderInputs.Count); // Can't have more resources than inputs
+	ib_assert(resourceCount <= shaderInputs.Count); // Can't have more resources than inputs
 
-	ib_ShaderInputWrite* writes = (ib_ShaderInputWrite*)ibr_allocTransientMemory(graph, desc.Resources.Count * sizeof(ib_ShaderInputWrite));
+	ib_ShaderInputWrite* writes = (ib_ShaderInputWrite*)ibr_allocTransientMemory(graph, resourceCount * sizeof(ib_ShaderInputWrite));
 
 	uint32_t writeCount = 0;
-	for (uint32_t i = 0; i < desc.Resources.Count; i++)
+	for (uint32_t i = 0; i < resourceCount; i++)
 	{
-		ibr_Resource* resource = desc.Resources.Data[i];
+		ibr_Resource* resource = resources[i];
 		if (resource != NULL) // resource array is allowed to be sparse. Just pass in the resources you care about at the right indices.
 		{
-			ib_ShaderInputWrite inputWrite = { .Desc = &desc.ShaderInputs.Data[i] };
+			ib_ShaderInputWrite inputWrite = { .Desc = &shaderInputs.Data[i] };
 			ib_assert(inputWrite.Desc->Index == i); // We're expecting our shader input index to match their in-array location.
 			if (resource->Type == ibr_ResourceType_Texture)
 			{
@@ -590,6 +1617,15 @@ ib_ShaderInput ibr_resourcesToShaderInput(ibr_RenderGraph* graph, ibr_ResourceTo
 		}
 	}
 
+	*outWrites = writes;
+	return writeCount;
+}
+
+ib_ShaderInput ibr_resourcesToShaderInput(ibr_RenderGraph* graph, ibr_ResourceToShaderInputDesc desc)
+{
+	ib_ShaderInputWrite* writes;
+	uint32_t writeCount = resourcesToShaderInputWrites(graph, desc.ShaderInputs, desc.Resources.Data, desc.Resources.Count, &writes);
+
 	return ibr_allocTransientShaderInput(graph, (ib_AllocShaderInputDesc)
 										{
 											.Layout = desc.Layout,
@@ -597,24 +1633,205 @@ ib_ShaderInput ibr_resourcesToShaderInput(ibr_RenderGraph* graph, ibr_ResourceTo
 										});
 }
 
-VkCommandBuffer ibr_allocTransientCommandBuffer(ibr_RenderGraph* graph, ib_Queue queue)
+void ibr_bindTransientShaderInput(ibr_RenderGraph* graph, VkCommandBuffer commandBuffer, ibr_BindTransientShaderInputDesc desc)
+{
+	if (desc.Layout->IsPushDescriptor)
+	{
+		// No set to allocate or update, the driver copies the writes into the command buffer.
+		ib_pushShaderInputs(graph->Core, commandBuffer, (ib_PushShaderInputsDesc)
+							{
+								.BindPoint = desc.BindPoint,
+								.PipelineLayout = desc.PipelineLayout,
+								.SetIndex = desc.SetIndex,
+								.Inputs = { desc.Inputs.Data, desc.Inputs.Count }
+							});
+	}
+	else
+	{
+		ib_ShaderInput input = ibr_allocTransientShaderInput(graph, (ib_AllocShaderInputDesc)
+															{
+																.Layout = desc.Layout,
+																.Inputs = { desc.Inputs.Data, desc.Inputs.Count }
+															});
+		vkCmdBindDescriptorSets(commandBuffer, desc.BindPoint, desc.PipelineLayout, desc.SetIndex, 1, &input.DescriptorSet, 0, NULL);
+	}
+}
+
+void ibr_bindResourcesToShaderInput(ibr_RenderGraph* graph, VkCommandBuffer commandBuffer, ibr_BindResourcesToShaderInputDesc desc)
+{
+	ib_ShaderInputWrite* writes;
+	uint32_t writeCount = resourcesToShaderInputWrites(graph, desc.ShaderInputs, desc.Resources.Data, desc.Resources.Count, &writes);
+
+	ibr_bindTransientShaderInput(graph, commandBuffer, (ibr_BindTransientShaderInputDesc)
+								{
+									.BindPoint = desc.BindPoint,
+									.PipelineLayout = desc.PipelineLayout,
+									.SetIndex = desc.SetIndex,
+									.Layout = desc.Layout,
+									.Inputs = { writes, writeCount }
+								});
+}
+
+static ib_AccelerationStructureUpdateDesc allocAccelerationStructureUpdate(ibr_RenderGraph* graph, VkCommandBuffer cmd, ib_AccelerationStructureData const* data, ibr_UpdateAccelerationStructureDesc update)
+{
+	// Over allocate so the base address can be aligned, buffers are only guaranteed their memory alignment.
+	VkDeviceSize alignment = ib_max(update.Raytracing->AccelerationStructureScratchBufferAlignment, 1);
+	ibr_Resource scratch = ibr_allocPassResource(graph, (ibr_ResourceDesc)
+												{
+													.Type = ibr_ResourceType_Buffer,
+													.Flags = ibr_ResourceFlag_Transient,
+													.BufferDesc =
+													{
+														.Usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+														.Size = (size_t)(ib_accelerationStructureUpdateScratchSize(data) + alignment),
+														.RequiredMemoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+														.DebugName = "Acceleration Structure Update Scratch"
+													}
+												});
+
+	return (ib_AccelerationStructureUpdateDesc)
+	{
+		.CommandBuffer = cmd,
+		.ScratchAddress = (scratch.Buffer->DeviceAddress + alignment - 1) / alignment * alignment,
+		.Policy = update.Policy,
+		.BoundsSurfaceArea = update.BoundsSurfaceArea
+	};
+}
+
+static void recordAccelerationStructureBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess)
 {
-	ibr_TransientCommandBuffer* transientCommandBuffer;
-	list_pushAlloc(transientCommandBuffer, ibr_TransientCommandBuffer, &graph->TransientCommandBuffers[queue]);
-	ib_allocCommandBuffers(graph->Core, (ib_AllocCommandBuffersDesc)
+	VkMemoryBarrier2 barrier =
+	{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = srcStage,
+		.srcAccessMask = srcAccess,
+		.dstStageMask = dstStage,
+		.dstAccessMask = dstAccess
+	};
+	vkCmdPipelineBarrier2(cmd, &(VkDependencyInfo)
 						{
-							.OutCommandBuffers = ib_singlePtrRange(&transientCommandBuffer->CommandBuffer),
-							.Queue = queue,
-							.Pool = graph->TransientCommandPools[queue]
+							.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+							.memoryBarrierCount = 1,
+							.pMemoryBarriers = &barrier
 						});
-	return transientCommandBuffer->CommandBuffer;
+}
+
+#define ibr_AccelerationStructureReadStages (VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT)
+
+// Earlier traces in the frame must be done reading before the structure is rewritten,
+// and later traces and builds must wait for the new one.
+static void beginAccelerationStructureUpdate(VkCommandBuffer cmd)
+{
+	recordAccelerationStructureBarrier(cmd, ibr_AccelerationStructureReadStages, VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR,
+		VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR);
+}
+
+static void endAccelerationStructureUpdate(VkCommandBuffer cmd)
+{
+	recordAccelerationStructureBarrier(cmd, VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+		VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | ibr_AccelerationStructureReadStages, VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR);
+}
+
+bool ibr_updateBLAS(ibr_RenderGraph* graph, VkCommandBuffer cmd, ib_BLAS* blas, ib_BLASDesc const* desc, ibr_UpdateAccelerationStructureDesc update)
+{
+	beginAccelerationStructureUpdate(cmd);
+	bool rebuilt = ib_updateBLAS(update.Raytracing, blas, desc, allocAccelerationStructureUpdate(graph, cmd, &blas->Data, update));
+	endAccelerationStructureUpdate(cmd);
+	return rebuilt;
+}
+
+bool ibr_updateTLAS(ibr_RenderGraph* graph, VkCommandBuffer cmd, ib_TLAS* tlas, ib_TLASDesc const* desc, ibr_UpdateAccelerationStructureDesc update)
+{
+	beginAccelerationStructureUpdate(cmd);
+	bool rebuilt = ib_updateTLAS(update.Raytracing, tlas, desc, allocAccelerationStructureUpdate(graph, cmd, &tlas->Data, update));
+	endAccelerationStructureUpdate(cmd);
+	return rebuilt;
+}
+
+static VkCommandBuffer allocFromCommandBufferList(ibr_RecordingContext* context, ibr_CommandBufferList* list, ib_Queue queue, VkCommandBufferLevel level)
+{
+	if (list->UsedCount == list->AllocatedCount)
+	{
+		// Out of recycled command buffers, grow by a full batch.
+		uint32_t newAllocatedCount = list->AllocatedCount + ibr_CommandBufferAllocationBatchSize;
+		VkCommandBuffer* commandBuffers = (VkCommandBuffer*)realloc(list->CommandBuffers, sizeof(VkCommandBuffer) * newAllocatedCount);
+		ib_assert(commandBuffers != NULL);
+
+		ib_allocCommandBuffers(context->Graph->Core, (ib_AllocCommandBuffersDesc)
+							{
+								.OutCommandBuffers = { commandBuffers + list->AllocatedCount, ibr_CommandBufferAllocationBatchSize },
+								.Queue = queue,
+								.Pool = context->TransientCommandPools[queue],
+								.Level = level
+							});
+
+		list->CommandBuffers = commandBuffers;
+		list->AllocatedCount = newAllocatedCount;
+	}
+
+	return list->CommandBuffers[list->UsedCount++];
+}
+
+VkCommandBuffer ibr_allocTransientCommandBuffer(ibr_RenderGraph* graph, ib_Queue queue)
+{
+	return ibr_allocContextCommandBuffer(&graph->RecordingContexts[0], queue);
+}
+
+VkCommandBuffer ibr_allocContextCommandBuffer(ibr_RecordingContext* context, ib_Queue queue)
+{
+	return allocFromCommandBufferList(context, &context->TransientCommandBuffers[queue], queue, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 }
 
 void ibr_submitCommandBuffers(ibr_RenderGraph* graph, ibr_SubmitCommandBufferDesc desc)
 {
-	uint32_t maxCommandCount = ib_srangeCapacity(desc.CommandBuffers);
+	ibr_RecordingContext* context = &graph->RecordingContexts[0];
+	ib_Queue queue = desc.Queue;
+	ib_assert(queue < ib_Queue_Count);
+
+	VkPipelineStageFlags2 waitStageMask = desc.WaitStageMask != VK_PIPELINE_STAGE_2_NONE ? desc.WaitStageMask : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	VkPipelineStageFlags2 signalStageMask = desc.SignalStageMask != VK_PIPELINE_STAGE_2_NONE ? desc.SignalStageMask : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+	// Bracket the submission with timestamps to measure how long the queue was busy.
+	// Not every queue family supports timestamps.
+	bool timeSubmission = graph->Core->Queues[queue].TimestampValidBits != 0;
+	VkCommandBuffer beginTimerCommands = VK_NULL_HANDLE;
+	VkCommandBuffer endTimerCommands = VK_NULL_HANDLE;
+
+	ibr_TransientSubmission* submission;
+	list_pushAlloc(submission, ibr_TransientSubmission, &graph->Submissions);
+	submission->Queue = queue;
+	submission->IsTimed = timeSubmission;
+	if (timeSubmission)
+	{
+		VkCommandBufferBeginInfo beginBufferInfo =
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+		};
+
+		beginTimerCommands = ibr_allocContextCommandBuffer(context, queue);
+		ib_vkCheck(vkBeginCommandBuffer(beginTimerCommands, &beginBufferInfo));
+		submission->Timer = ib_beginTimer(&context->TimerManager, beginTimerCommands);
+		ib_vkCheck(vkEndCommandBuffer(beginTimerCommands));
+
+		endTimerCommands = ibr_allocContextCommandBuffer(context, queue);
+		ib_vkCheck(vkBeginCommandBuffer(endTimerCommands, &beginBufferInfo));
+		ib_endTimer(&context->TimerManager, endTimerCommands, &submission->Timer);
+		ib_vkCheck(vkEndCommandBuffer(endTimerCommands));
+	}
+
+	uint32_t maxCommandCount = ib_srangeCapacity(desc.CommandBuffers) + 2;
 	VkCommandBufferSubmitInfo* commands = (VkCommandBufferSubmitInfo*)ibr_allocTransientMemory(graph, sizeof(VkCommandBufferSubmitInfo) * maxCommandCount);
 	uint32_t commandCount = 0;
+	if (timeSubmission)
+	{
+		commands[commandCount++] = (VkCommandBufferSubmitInfo)
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+			.commandBuffer = beginTimerCommands,
+		};
+	}
+
 	for (VkCommandBuffer* iter = ib_srangeBegin(desc.CommandBuffers),
 		*end = ib_srangeEnd(desc.CommandBuffers); iter != end; iter++)
 	{
@@ -630,7 +1847,16 @@ void ibr_submitCommandBuffers(ibr_RenderGraph* graph, ibr_SubmitCommandBufferDes
 		};
 	}
 
-	uint32_t maxWaitSemaphores = ib_srangeCapacity(desc.WaitSemaphores);
+	if (timeSubmission)
+	{
+		commands[commandCount++] = (VkCommandBufferSubmitInfo)
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+			.commandBuffer = endTimerCommands,
+		};
+	}
+
+	uint32_t maxWaitSemaphores = ib_srangeCapacity(desc.WaitSemaphores) + ib_srangeCapacity(desc.QueueWaits);
 	VkSemaphoreSubmitInfo* waitSemaphores = (VkSemaphoreSubmitInfo*)ibr_allocTransientMemory(graph, sizeof(VkSemaphoreSubmitInfo) * maxWaitSemaphores);
 	uint32_t waitSemaphoreCount = 0;
 	for (VkSemaphore* iter = ib_srangeBegin(desc.WaitSemaphores),
@@ -645,11 +1871,35 @@ void ibr_submitCommandBuffers(ibr_RenderGraph* graph, ibr_SubmitCommandBufferDes
 		{
 			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
 			.semaphore = *iter,
-			.stageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			.stageMask = waitStageMask,
+		};
+	}
+
+	for (ibr_QueueWait* iter = ib_srangeBegin(desc.QueueWaits),
+		*end = ib_srangeEnd(desc.QueueWaits); iter != end; iter++)
+	{
+		if (iter->StageMask == VK_PIPELINE_STAGE_2_NONE)
+		{
+			break;
+		}
+
+		// Work on the same queue is already ordered by submission.
+		ib_timelineSemaphore* timeline = &graph->QueueTimelines[iter->Queue];
+		if (iter->Queue == queue || timeline->LastSignalValue == 0)
+		{
+			continue;
+		}
+
+		waitSemaphores[waitSemaphoreCount++] = (VkSemaphoreSubmitInfo)
+		{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+			.semaphore = timeline->Semaphore,
+			.value = timeline->LastSignalValue,
+			.stageMask = iter->StageMask,
 		};
 	}
 
-	uint32_t maxSignalSemaphores = ib_srangeCapacity(desc.SignalSemaphores);
+	uint32_t maxSignalSemaphores = ib_srangeCapacity(desc.SignalSemaphores) + 1;
 	VkSemaphoreSubmitInfo* signalSemaphores = (VkSemaphoreSubmitInfo*)ibr_allocTransientMemory(graph, sizeof(VkSemaphoreSubmitInfo) * maxSignalSemaphores);
 	uint32_t signalSemaphoreCount = 0;
 	for (VkSemaphore* iter = ib_srangeBegin(desc.SignalSemaphores),
@@ -664,10 +1914,19 @@ void ibr_submitCommandBuffers(ibr_RenderGraph* graph, ibr_SubmitCommandBufferDes
 		{
 			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
 			.semaphore = *iter,
-			.stageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			.stageMask = signalStageMask,
 		};
 	}
 
+	ib_timelineSemaphore* queueTimeline = &graph->QueueTimelines[queue];
+	signalSemaphores[signalSemaphoreCount++] = (VkSemaphoreSubmitInfo)
+	{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+		.semaphore = queueTimeline->Semaphore,
+		.value = ++queueTimeline->LastSignalValue,
+		.stageMask = signalStageMask,
+	};
+
 	VkSubmitInfo2 submitInfo = (VkSubmitInfo2)
 	{
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
@@ -678,38 +1937,42 @@ void ibr_submitCommandBuffers(ibr_RenderGraph* graph, ibr_SubmitCommandBufferDes
 		.pSignalSemaphoreInfos = signalSemaphores,
 		.signalSemaphoreInfoCount = signalSemaphoreCount
 	};
-	ib_vkCheck(vkQueueSubmit2(graph->Core->Queues[ib_Queue_Graphics].Queue, 1, &submitInfo, desc.SubmitFence));
+	submission->CPUBeginTicks = ib_cpuTicks();
+	if (graph->FirstSubmitCPUTicks == 0)
+	{
+		graph->FirstSubmitCPUTicks = submission->CPUBeginTicks;
+	}
+	ib_vkCheck(vkQueueSubmit2(graph->Core->Queues[queue].Queue, 1, &submitInfo, desc.SubmitFence));
+	submission->CPUEndTicks = ib_cpuTicks();
 }
 
 void ibr_present(ibr_PresentDesc desc)
 {
+	desc.Graph->PresentCPUBeginTicks = ib_cpuTicks();
 	ib_SurfaceState state = ib_presentSurface(desc.Graph->Core, (ib_PresentSurfaceDesc)
 											{
 												.Surface = desc.Surface,
 												.SwapchainTextureIndex = desc.Graph->SwapchainTextureIndex,
 												.WaitSemaphore = desc.Graph->FrameSemaphore
 											});
+	desc.Graph->PresentCPUEndTicks = ib_cpuTicks();
+
 	if (state == ib_SurfaceState_ShouldRebuild)
 	{
 		ib_rebuildSurface(desc.Graph->Core, desc.Surface);
 	}
 }
 
-void ibr_beginGraphicsPass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_BeginGraphicsPassDesc desc)
+ibr_PreparedPass const* ibr_prepareGraphicsPass(ibr_RenderGraph* graph, ibr_BeginGraphicsPassDesc desc)
 {
-	pushProfilingScope(graph, cmd, desc.PassName);
-
-	char const* passDebugLabel = desc.PassName == NULL
-		? "Unnamed Graphic Pass"
-		: desc.PassName;
-
-	VkDebugUtilsLabelEXT passDebugLabelInfo = {
-		.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT,
-		.pLabelName = passDebugLabel,
+	ibr_PreparedPass* pass = (ibr_PreparedPass*)ibr_allocTransientMemory(graph, sizeof(ibr_PreparedPass));
+	*pass = (ibr_PreparedPass)
+	{
+		.Type = ibr_PassType_Graphics,
+		.Flags = desc.Flags,
+		.PassName = desc.PassName
 	};
 
-	vkCmdBeginDebugUtilsLabelEXT(cmd, &passDebugLabelInfo);
-
 	// Barriers
 	uint32_t renderTargetCount = 0;
 	{
@@ -723,8 +1986,8 @@ void ibr_beginGraphicsPass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_Begi
 		VkImageMemoryBarrier2* imageMemoryBarriers = (VkImageMemoryBarrier2*)ibr_allocTransientMemory(graph, sizeof(VkImageMemoryBarrier2) * totalResourceCount);
 		VkBufferMemoryBarrier2* memoryBarriers = (VkBufferMemoryBarrier2*)ibr_allocTransientMemory(graph, sizeof(VkBufferMemoryBarrier2) * totalResourceCount);
 
-		uint32_t imageBarrierCount = totalResourceCount;
-		uint32_t memoryBarrierCount = totalResourceCount;
+		uint32_t imageBarrierCount = 0;
+		uint32_t memoryBarrierCount = 0;
 		createPipelineBarriers(graph, (CreatePipelineBarriersDesc)
 							{
 								desc.OtherResourceStates,
@@ -747,21 +2010,20 @@ void ibr_beginGraphicsPass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_Begi
 			ibr_RenderTargetState state = *iter;
 
 			ib_assert(state.Resource->Type == ibr_ResourceType_Texture);
-			imageMemoryBarriers[imageBarrierCount++] = ib_createTextureBarrier(graph->Core, (ib_TextureBarrierDesc)
-																				{
-																					.Texture = state.Resource->Texture,
-																					.OldLayout = state.Resource->TextureLayout,
-																					.NewLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-																					.SourceStageMask = state.Resource->LastReleaseStageMask,
-																					.DestStageMask = state.AcquireStageMask != VK_PIPELINE_STAGE_NONE ? state.AcquireStageMask : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-																					.SourceAccessMask = state.Resource->LastReleaseAccessMask,
-																					.DestAccessMask = state.AcquireAccessMask != VK_ACCESS_NONE ? state.AcquireAccessMask : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT
-																				});
-
-			// ASSUMPTION: Assume that what where we acquire is where we release for now.
-			state.Resource->LastReleaseAccessMask = state.ReleaseAccessMask != VK_ACCESS_NONE ? state.ReleaseAccessMask : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			state.Resource->LastReleaseStageMask = state.ReleaseStageMask != VK_PIPELINE_STAGE_NONE ? state.ReleaseStageMask : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			state.Resource->TextureLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			ResourceTransition transition =
+			{
+				.Resource = state.Resource,
+				.Layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				.AcquireStageMask = state.AcquireStageMask != VK_PIPELINE_STAGE_NONE ? state.AcquireStageMask : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				.AcquireAccessMask = state.AcquireAccessMask != VK_ACCESS_NONE ? state.AcquireAccessMask : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT,
+				.ReleaseStageMask = state.ReleaseStageMask != VK_PIPELINE_STAGE_NONE ? state.ReleaseStageMask : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				.ReleaseAccessMask = state.ReleaseAccessMask != VK_ACCESS_NONE ? state.ReleaseAccessMask : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+			};
+
+			if (transitionResource(graph, transition, &imageMemoryBarriers[imageBarrierCount], NULL))
+			{
+				imageBarrierCount++;
+			}
 		}
 
 		// Depth Target
@@ -770,31 +2032,30 @@ void ibr_beginGraphicsPass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_Begi
 			ibr_RenderTargetState state = desc.DepthTarget;
 
 			ib_assert(state.Resource->Type == ibr_ResourceType_Texture);
-			imageMemoryBarriers[imageBarrierCount++] = ib_createTextureBarrier(graph->Core, (ib_TextureBarrierDesc)
-																			{
-																				.Texture = state.Resource->Texture,
-																				.OldLayout = state.Resource->TextureLayout,
-																				.NewLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-																				.SourceStageMask = state.Resource->LastReleaseStageMask,
-																				.DestStageMask = state.AcquireStageMask != VK_PIPELINE_STAGE_NONE ? state.AcquireStageMask : VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-																				.SourceAccessMask = state.Resource->LastReleaseAccessMask,
-																				.DestAccessMask = state.AcquireAccessMask != VK_ACCESS_NONE ? state.AcquireAccessMask : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
-																			});
-
-			// ASSUMPTION: Assume that what where we acquire is where we release for now.
-			state.Resource->LastReleaseAccessMask = state.ReleaseAccessMask != VK_ACCESS_NONE ? state.ReleaseAccessMask : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-			state.Resource->LastReleaseStageMask = state.ReleaseStageMask != VK_PIPELINE_STAGE_NONE ? state.ReleaseStageMask : VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-			state.Resource->TextureLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			ResourceTransition transition =
+			{
+				.Resource = state.Resource,
+				.Layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+				.AcquireStageMask = state.AcquireStageMask != VK_PIPELINE_STAGE_NONE ? state.AcquireStageMask : VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+				.AcquireAccessMask = state.AcquireAccessMask != VK_ACCESS_NONE ? state.AcquireAccessMask : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+				.ReleaseStageMask = state.ReleaseStageMask != VK_PIPELINE_STAGE_NONE ? state.ReleaseStageMask : VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				.ReleaseAccessMask = state.ReleaseAccessMask != VK_ACCESS_NONE ? state.ReleaseAccessMask : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+			};
+
+			if (transitionResource(graph, transition, &imageMemoryBarriers[imageBarrierCount], NULL))
+			{
+				imageBarrierCount++;
+			}
 		}
 
-		vkCmdPipelineBarrier2(cmd, &(VkDependencyInfo)
-							{
-								.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-								.imageMemoryBarrierCount = imageBarrierCount,
-								.pImageMemoryBarriers = imageMemoryBarriers,
-								.bufferMemoryBarrierCount = memoryBarrierCount,
-								.pBufferMemoryBarriers = memoryBarriers
-							});
+		pass->Barriers = (VkDependencyInfo)
+		{
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.imageMemoryBarrierCount = imageBarrierCount,
+			.pImageMemoryBarriers = imageMemoryBarriers,
+			.bufferMemoryBarrierCount = memoryBarrierCount,
+			.pBufferMemoryBarriers = memoryBarriers
+		};
 	}
 
 	ibr_RenderTargetState* renderTargetBegin = ib_srangeBegin(desc.RenderTargets);
@@ -812,10 +2073,12 @@ void ibr_beginGraphicsPass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_Begi
 	{
 		uint32_t colorAttachmentWrite = 0;
 		VkRenderingAttachmentInfo* colorAttachments = (VkRenderingAttachmentInfo*)ibr_allocTransientMemory(graph, sizeof(VkRenderingAttachmentInfo) * renderTargetCount);
+		VkFormat* colorFormats = (VkFormat*)ibr_allocTransientMemory(graph, sizeof(VkFormat) * renderTargetCount);
 		for (ibr_RenderTargetState* iter = renderTargetBegin,
 			*end = renderTargetBegin + renderTargetCount; iter != end; iter++)
 		{
 			ibr_RenderTargetState state = *iter;
+			colorFormats[colorAttachmentWrite] = state.Resource->Texture->Format;
 			colorAttachments[colorAttachmentWrite++] = (VkRenderingAttachmentInfo)
 			{
 				.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
@@ -827,10 +2090,11 @@ void ibr_beginGraphicsPass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_Begi
 			};
 		}
 
-		VkRenderingAttachmentInfo depthAttachment = { 0 };
+		VkRenderingAttachmentInfo* depthAttachment = NULL;
 		if (desc.DepthTarget.Resource != NULL)
 		{
-			depthAttachment = (VkRenderingAttachmentInfo)
+			depthAttachment = (VkRenderingAttachmentInfo*)ibr_allocTransientMemory(graph, sizeof(VkRenderingAttachmentInfo));
+			*depthAttachment = (VkRenderingAttachmentInfo)
 			{
 				.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
 				.imageView = desc.DepthTarget.Resource->Texture->View,
@@ -841,17 +2105,26 @@ void ibr_beginGraphicsPass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_Begi
 			};
 		}
 
-		VkRenderingInfo renderInfo =
+		bool useSecondaries = (desc.Flags & ibr_PassFlag_SecondaryCommandBuffers) != 0;
+		pass->RenderingInfo = (VkRenderingInfo)
 		{
 			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+			.flags = useSecondaries ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0,
 			.renderArea = { .extent = extents },
 			.layerCount = 1,
 			.colorAttachmentCount = renderTargetCount,
 			.pColorAttachments = colorAttachments,
-			.pDepthAttachment = (desc.DepthTarget.Resource != NULL) ? &depthAttachment : NULL
+			.pDepthAttachment = depthAttachment
 		};
 
-		vkCmdBeginRendering(cmd, &renderInfo);
+		pass->InheritanceRenderingInfo = (VkCommandBufferInheritanceRenderingInfo)
+		{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+			.colorAttachmentCount = renderTargetCount,
+			.pColorAttachmentFormats = colorFormats,
+			.depthAttachmentFormat = depthAttachment != NULL ? desc.DepthTarget.Resource->Texture->Format : VK_FORMAT_UNDEFINED,
+			.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+		};
 	}
 
 	if (desc.MinDepth == 0.0f && desc.MaxDepth == 0.0f)
@@ -859,20 +2132,25 @@ void ibr_beginGraphicsPass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_Begi
 		desc.MaxDepth = 1.0f;
 	}
 
-	vkCmdSetViewport(cmd, 0, 1, &(VkViewport)
-					{
-						.width = (float)extents.width, .height = (float)extents.height,
-						.minDepth = desc.MinDepth, .maxDepth = desc.MaxDepth,
-					});
+	pass->Viewport = (VkViewport)
+	{
+		.width = (float)extents.width, .height = (float)extents.height,
+		.minDepth = desc.MinDepth, .maxDepth = desc.MaxDepth,
+	};
+	pass->Scissor = (VkRect2D) { .extent = extents };
+
+	return pass;
+}
 
-	vkCmdSetScissor(cmd, 0, 1, &(VkRect2D) { .extent = extents });
+void ibr_beginGraphicsPass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_BeginGraphicsPassDesc desc)
+{
+	ibr_beginPreparedPass(&graph->RecordingContexts[0], cmd, ibr_prepareGraphicsPass(graph, desc));
 }
 
 void ibr_endGraphicsPass(ibr_RenderGraph* graph, VkCommandBuffer cmd)
 {
-	ib_potentiallyUnused(graph);
 	vkCmdEndRendering(cmd);
-	popProfilingScope(graph, cmd);
+	ibr_popProfilingScope(&graph->RecordingContexts[0], cmd);
 	vkCmdEndDebugUtilsLabelEXT(cmd);
 }
 
@@ -893,6 +2171,11 @@ void ibr_barriers(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_BarriersDesc
 							&memoryBarrierCount
 						});
 
+	if (imageBarrierCount == 0 && memoryBarrierCount == 0)
+	{
+		return;
+	}
+
 	vkCmdPipelineBarrier2(cmd, &(VkDependencyInfo)
 						{
 							.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
@@ -903,20 +2186,30 @@ void ibr_barriers(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_BarriersDesc
 						});
 }
 
-void ibr_beginComputePass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_BeginComputePassDesc desc)
+ibr_SplitBarrier const* ibr_signalSplitBarrier(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_BarriersDesc desc)
 {
-	pushProfilingScope(graph, cmd, desc.PassName);
+	ibr_SplitBarrier* barrier = (ibr_SplitBarrier*)ibr_allocTransientMemory(graph, sizeof(ibr_SplitBarrier));
 
-	char const* passDebugLabel = desc.PassName == NULL
-		? "Unnamed Compute Pass"
-		: desc.PassName;
+	ibr_EventList* events = &graph->TransientEvents;
+	if (events->UsedCount == events->AllocatedCount)
+	{
+		// Out of recycled events, grow by a full batch.
+		uint32_t newAllocatedCount = events->AllocatedCount + ibr_CommandBufferAllocationBatchSize;
+		VkEvent* newEvents = (VkEvent*)realloc(events->Events, sizeof(VkEvent) * newAllocatedCount);
+		ib_assert(newEvents != NULL);
 
-	VkDebugUtilsLabelEXT passDebugLabelInfo = {
-		.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT,
-		.pLabelName = passDebugLabel,
-	};
+		for (uint32_t i = events->AllocatedCount; i < newAllocatedCount; i++)
+		{
+			ib_vkCheck(vkCreateEvent(graph->Core->LogicalDevice, &(VkEventCreateInfo)
+									{
+										.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO
+									}, ib_NoVkAllocator, &newEvents[i]));
+		}
 
-	vkCmdBeginDebugUtilsLabelEXT(cmd, &passDebugLabelInfo);
+		events->Events = newEvents;
+		events->AllocatedCount = newAllocatedCount;
+	}
+	barrier->Event = events->Events[events->UsedCount++];
 
 	VkImageMemoryBarrier2* imageMemoryBarriers = NULL;
 	VkBufferMemoryBarrier2* memoryBarriers = NULL;
@@ -930,25 +2223,181 @@ void ibr_beginComputePass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_Begin
 							&imageMemoryBarriers,
 							&imageBarrierCount,
 							&memoryBarriers,
-							&memoryBarrierCount
+							&memoryBarrierCount,
+							.IsSplitBarrier = true
 						});
 
-	vkCmdPipelineBarrier2(cmd, &(VkDependencyInfo)
+	barrier->Barriers = (VkDependencyInfo)
+	{
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.imageMemoryBarrierCount = imageBarrierCount,
+		.pImageMemoryBarriers = imageMemoryBarriers,
+		.bufferMemoryBarrierCount = memoryBarrierCount,
+		.pBufferMemoryBarriers = memoryBarriers
+	};
+
+	// The wait must use the same dependency info as the signal.
+	vkCmdSetEvent2(cmd, barrier->Event, &barrier->Barriers);
+	graph->BarrierStatistics.SplitCount++;
+	return barrier;
+}
+
+void ibr_waitSplitBarrier(VkCommandBuffer cmd, ibr_SplitBarrier const* barrier)
+{
+	vkCmdWaitEvents2(cmd, 1, &barrier->Event, &barrier->Barriers);
+}
+
+ibr_PreparedPass const* ibr_prepareComputePass(ibr_RenderGraph* graph, ibr_BeginComputePassDesc desc)
+{
+	ibr_PreparedPass* pass = (ibr_PreparedPass*)ibr_allocTransientMemory(graph, sizeof(ibr_PreparedPass));
+	*pass = (ibr_PreparedPass)
+	{
+		.Type = ibr_PassType_Compute,
+		.Flags = desc.Flags,
+		.PassName = desc.PassName
+	};
+
+	VkImageMemoryBarrier2* imageMemoryBarriers = NULL;
+	VkBufferMemoryBarrier2* memoryBarriers = NULL;
+
+	uint32_t imageBarrierCount = 0;
+	uint32_t memoryBarrierCount = 0;
+	createPipelineBarriers(graph,
+						(CreatePipelineBarriersDesc)
 						{
-							.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-							.imageMemoryBarrierCount = imageBarrierCount,
-							.pImageMemoryBarriers = imageMemoryBarriers,
-							.bufferMemoryBarrierCount = memoryBarrierCount,
-							.pBufferMemoryBarriers = memoryBarriers
+							desc.ResourceStates,
+							&imageMemoryBarriers,
+							&imageBarrierCount,
+							&memoryBarriers,
+							&memoryBarrierCount
 						});
+
+	pass->Barriers = (VkDependencyInfo)
+	{
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.imageMemoryBarrierCount = imageBarrierCount,
+		.pImageMemoryBarriers = imageMemoryBarriers,
+		.bufferMemoryBarrierCount = memoryBarrierCount,
+		.pBufferMemoryBarriers = memoryBarriers
+	};
+
+	return pass;
+}
+
+void ibr_beginComputePass(ibr_RenderGraph* graph, VkCommandBuffer cmd, ibr_BeginComputePassDesc desc)
+{
+	ibr_beginPreparedPass(&graph->RecordingContexts[0], cmd, ibr_prepareComputePass(graph, desc));
 }
 
 void ibr_endComputePass(ibr_RenderGraph* graph, VkCommandBuffer cmd)
 {
-	popProfilingScope(graph, cmd);
+	ibr_popProfilingScope(&graph->RecordingContexts[0], cmd);
+	vkCmdEndDebugUtilsLabelEXT(cmd);
+}
+
+void ibr_beginPreparedPass(ibr_RecordingContext* context, VkCommandBuffer cmd, ibr_PreparedPass const* pass)
+{
+	bool withPipelineStatistics = (pass->Flags & ibr_PassFlag_PipelineStatistics) != 0
+		&& (pass->Flags & ibr_PassFlag_SecondaryCommandBuffers) == 0;
+	pushProfilingScope(context, cmd, pass->PassName, withPipelineStatistics);
+
+	char const* passDebugLabel = pass->PassName;
+	if (passDebugLabel == NULL)
+	{
+		passDebugLabel = pass->Type == ibr_PassType_Graphics ? "Unnamed Graphic Pass" : "Unnamed Compute Pass";
+	}
+
+	VkDebugUtilsLabelEXT passDebugLabelInfo = {
+		.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT,
+		.pLabelName = passDebugLabel,
+	};
+
+	vkCmdBeginDebugUtilsLabelEXT(cmd, &passDebugLabelInfo);
+
+	// Barriers were resolved when the pass was prepared, we only need to record them.
+	if (pass->Barriers.imageMemoryBarrierCount > 0 || pass->Barriers.bufferMemoryBarrierCount > 0)
+	{
+		vkCmdPipelineBarrier2(cmd, &pass->Barriers);
+	}
+
+	if (pass->Type == ibr_PassType_Graphics)
+	{
+		vkCmdBeginRendering(cmd, &pass->RenderingInfo);
+
+		// Secondaries don't inherit dynamic state, they set their own viewport and scissor.
+		if ((pass->Flags & ibr_PassFlag_SecondaryCommandBuffers) == 0)
+		{
+			vkCmdSetViewport(cmd, 0, 1, &pass->Viewport);
+			vkCmdSetScissor(cmd, 0, 1, &pass->Scissor);
+		}
+	}
+}
+
+void ibr_endPreparedPass(ibr_RecordingContext* context, VkCommandBuffer cmd, ibr_PreparedPass const* pass)
+{
+	if (pass->Type == ibr_PassType_Graphics)
+	{
+		vkCmdEndRendering(cmd);
+	}
+	ibr_popProfilingScope(context, cmd);
 	vkCmdEndDebugUtilsLabelEXT(cmd);
 }
 
+VkCommandBuffer ibr_beginSecondaryCommandBuffer(ibr_RecordingContext* context, ib_Queue queue, ibr_PreparedPass const* pass)
+{
+	bool isGraphics = pass->Type == ibr_PassType_Graphics;
+	ib_assert(!isGraphics || (pass->Flags & ibr_PassFlag_SecondaryCommandBuffers) != 0); // Graphics passes must opt into secondaries.
+
+	VkCommandBuffer cmd = allocFromCommandBufferList(context, &context->TransientSecondaryCommandBuffers[queue], queue, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+	VkCommandBufferInheritanceInfo inheritanceInfo =
+	{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext = isGraphics ? &pass->InheritanceRenderingInfo : NULL
+	};
+
+	ib_vkCheck(vkBeginCommandBuffer(cmd, &(VkCommandBufferBeginInfo)
+									{
+										.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+										.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | (isGraphics ? VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT : 0),
+										.pInheritanceInfo = &inheritanceInfo
+									}));
+
+	if (isGraphics)
+	{
+		vkCmdSetViewport(cmd, 0, 1, &pass->Viewport);
+		vkCmdSetScissor(cmd, 0, 1, &pass->Scissor);
+	}
+
+	return cmd;
+}
+
+void ibr_executeSecondaryCommandBuffers(VkCommandBuffer cmd, ibr_CommandBufferRange commandBuffers)
+{
+	// Compact out the empty slots, order is preserved so recording order matches submission order.
+	VkCommandBuffer executeList[64];
+	uint32_t executeCount = 0;
+	for (uint32_t i = 0; i < commandBuffers.Count; i++)
+	{
+		if (commandBuffers.Data[i] == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		executeList[executeCount++] = commandBuffers.Data[i];
+		if (executeCount == ib_arrayCount(executeList))
+		{
+			vkCmdExecuteCommands(cmd, executeCount, executeList);
+			executeCount = 0;
+		}
+	}
+
+	if (executeCount > 0)
+	{
+		vkCmdExecuteCommands(cmd, executeCount, executeList);
+	}
+}
+
 ibr_ResourceState ibr_textureState(ibr_Resource* resource, ibr_TextureState state, VkPipelineStageFlags stage)
 {
 	ib_assert(resource->Type == ibr_ResourceType_Texture);
@@ -9,8 +9,40 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
 __declspec(dllimport) int __stdcall IsDebuggerPresent(void);
 __declspec(dllimport) void __stdcall DebugBreak(void);
+#else
+#include <signal.h>
+
+// Linux reports the tracing process in /proc, anything other than 0 is a debugger.
+static int IsDebuggerPresent(void)
+{
+	FILE* status = fopen("/proc/self/status", "r");
+	if (status == NULL)
+	{
+		return 0;
+	}
+
+	int tracerPid = 0;
+	char line[256];
+	while (fgets(line, sizeof(line), status) != NULL)
+	{
+		if (sscanf(line, "TracerPid: %d", &tracerPid) == 1)
+		{
+			break;
+		}
+	}
+	fclose(status);
+	return tracerPid != 0;
+}
+
+static void DebugBreak(void)
+{
+	raise(SIGTRAP);
+}
+#endif // _WIN32
+
 void ib_assertHarness(char const* file, uint32_t line, char const* func, bool test, ...)
 {
 	if (!test)
@@ -34,6 +66,9 @@ void ib_assertHarness(char const* file, uint32_t line, char const* func, bool te
 	}
 }
 
+#ifdef _MSC_VER
+#include <intrin.h>
+
 uint32_t ib_firstBitHighU32(uint32_t value)
 {
 	unsigned long index;
@@ -51,4 +86,272 @@ uint32_t ib_firstBitLowU32(uint32_t value)
 uint32_t ib_bitCountU32(uint32_t value)
 {
 	return _mm_popcnt_u32(value);
-}
\ No newline at end of file
+}
+#else
+// Same contract as the MSVC intrinsics, the result is undefined for 0.
+uint32_t ib_firstBitHighU32(uint32_t value)
+{
+	ib_assert(value != 0);
+	return 31 - (uint32_t)__builtin_clz(value);
+}
+
+uint32_t ib_firstBitLowU32(uint32_t value)
+{
+	ib_assert(value != 0);
+	return (uint32_t)__builtin_ctz(value);
+}
+
+uint32_t ib_bitCountU32(uint32_t value)
+{
+	return (uint32_t)__builtin_popcount(value);
+}
+#endif // _MSC_VER
+
+#ifdef _WIN32
+__declspec(dllimport) int __stdcall QueryPerformanceCounter(int64_t* count);
+__declspec(dllimport) int __stdcall QueryPerformanceFrequency(int64_t* frequency);
+__declspec(dllimport) void __stdcall Sleep(unsigned long milliseconds);
+
+static int64_t ticksPerSecond(void)
+{
+	static int64_t frequency = 0;
+	if (frequency == 0)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+	return frequency;
+}
+
+uint64_t ib_cpuTicks(void)
+{
+	int64_t count;
+	QueryPerformanceCounter(&count);
+	return (uint64_t)count;
+}
+
+double ib_cpuTicksToMs(uint64_t ticks)
+{
+	return (double)ticks * 1000.0 / (double)ticksPerSecond();
+}
+
+uint64_t ib_cpuMsToTicks(double ms)
+{
+	return (uint64_t)(ms * (double)ticksPerSecond() / 1000.0);
+}
+
+static void sleepOS(double ms)
+{
+	Sleep((unsigned long)ms);
+}
+#else
+#include <time.h>
+
+uint64_t ib_cpuTicks(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
+
+double ib_cpuTicksToMs(uint64_t ticks)
+{
+	return (double)ticks / 1000000.0;
+}
+
+uint64_t ib_cpuMsToTicks(double ms)
+{
+	return (uint64_t)(ms * 1000000.0);
+}
+
+static void sleepOS(double ms)
+{
+	uint64_t nanoseconds = (uint64_t)(ms * 1000000.0);
+	struct timespec duration = { .tv_sec = (time_t)(nanoseconds / 1000000000ull), .tv_nsec = (long)(nanoseconds % 1000000000ull) };
+	nanosleep(&duration, NULL);
+}
+#endif // _WIN32
+
+void ib_sleepMs(double ms)
+{
+	if (ms <= 0.0)
+	{
+		return;
+	}
+
+	// OS sleeps can overshoot by a scheduler quantum, sleep most of the way and spin for the rest.
+	uint64_t endTicks = ib_cpuTicks() + ib_cpuMsToTicks(ms);
+	double const spinTime = 2.0;
+	if (ms > spinTime)
+	{
+		sleepOS(ms - spinTime);
+	}
+
+	while (ib_cpuTicks() < endTicks)
+	{
+	}
+}
+
+typedef struct
+{
+	ib_ThreadFunc Func;
+	void* UserData;
+} ThreadStart;
+
+static ThreadStart* allocThreadStart(ib_ThreadFunc func, void* userData)
+{
+	ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+	ib_assert(start != NULL);
+	*start = (ThreadStart) { func, userData };
+	return start;
+}
+
+static void runThreadStart(void* startPtr)
+{
+	ThreadStart start = *(ThreadStart*)startPtr;
+	free(startPtr);
+	start.Func(start.UserData);
+}
+
+#ifdef _WIN32
+#include <intrin.h>
+
+__declspec(dllimport) void* __stdcall CreateThread(void* attributes, size_t stackSize, unsigned long (__stdcall* startAddress)(void*), void* parameter, unsigned long flags, unsigned long* threadId);
+__declspec(dllimport) unsigned long __stdcall WaitForSingleObject(void* handle, unsigned long milliseconds);
+__declspec(dllimport) int __stdcall CloseHandle(void* handle);
+__declspec(dllimport) unsigned long __stdcall GetActiveProcessorCount(unsigned short groupNumber);
+#define ib_Infinite 0xFFFFFFFF
+#define ib_AllProcessorGroups 0xFFFF
+
+static unsigned long __stdcall threadProc(void* start)
+{
+	runThreadStart(start);
+	return 0;
+}
+
+ib_Thread ib_startThread(ib_ThreadFunc func, void* userData)
+{
+	ib_Thread thread = { CreateThread(NULL, 0, threadProc, allocThreadStart(func, userData), 0, NULL) };
+	ib_assert(thread.Handle != NULL);
+	return thread;
+}
+
+void ib_joinThread(ib_Thread* thread)
+{
+	WaitForSingleObject(thread->Handle, ib_Infinite);
+	CloseHandle(thread->Handle);
+	thread->Handle = NULL;
+}
+
+uint32_t ib_cpuCoreCount(void)
+{
+	return GetActiveProcessorCount(ib_AllProcessorGroups);
+}
+
+// SRWLOCK is a single pointer that's unlocked when zero, it lives in the handle directly.
+__declspec(dllimport) void __stdcall AcquireSRWLockExclusive(void** lock);
+__declspec(dllimport) void __stdcall ReleaseSRWLockExclusive(void** lock);
+
+void ib_initMutex(ib_Mutex* mutex)
+{
+	mutex->Handle = NULL; // SRWLOCK_INIT
+}
+
+void ib_lockMutex(ib_Mutex* mutex)
+{
+	AcquireSRWLockExclusive(&mutex->Handle);
+}
+
+void ib_unlockMutex(ib_Mutex* mutex)
+{
+	ReleaseSRWLockExclusive(&mutex->Handle);
+}
+
+void ib_killMutex(ib_Mutex* mutex)
+{
+	ib_assert(mutex->Handle == NULL, "Killing a locked mutex.");
+	ib_potentiallyUnused(mutex);
+}
+
+uint32_t ib_atomicAddU32(uint32_t volatile* value, uint32_t add)
+{
+	return (uint32_t)_InterlockedExchangeAdd((long volatile*)value, (long)add) + add;
+}
+
+uint64_t ib_atomicAddU64(uint64_t volatile* value, uint64_t add)
+{
+	return (uint64_t)_InterlockedExchangeAdd64((long long volatile*)value, (long long)add) + add;
+}
+
+uint32_t ib_atomicLoadU32(uint32_t volatile const* value)
+{
+	return (uint32_t)_InterlockedOr((long volatile*)value, 0);
+}
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+static void* threadProc(void* start)
+{
+	runThreadStart(start);
+	return NULL;
+}
+
+ib_Thread ib_startThread(ib_ThreadFunc func, void* userData)
+{
+	pthread_t* handle = (pthread_t*)malloc(sizeof(pthread_t));
+	ib_check(pthread_create(handle, NULL, threadProc, allocThreadStart(func, userData)) == 0);
+	return (ib_Thread) { handle };
+}
+
+void ib_joinThread(ib_Thread* thread)
+{
+	pthread_join(*(pthread_t*)thread->Handle, NULL);
+	free(thread->Handle);
+	thread->Handle = NULL;
+}
+
+uint32_t ib_cpuCoreCount(void)
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (uint32_t)count : 1;
+}
+
+void ib_initMutex(ib_Mutex* mutex)
+{
+	pthread_mutex_t* handle = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
+	ib_check(pthread_mutex_init(handle, NULL) == 0);
+	mutex->Handle = handle;
+}
+
+void ib_lockMutex(ib_Mutex* mutex)
+{
+	pthread_mutex_lock((pthread_mutex_t*)mutex->Handle);
+}
+
+void ib_unlockMutex(ib_Mutex* mutex)
+{
+	pthread_mutex_unlock((pthread_mutex_t*)mutex->Handle);
+}
+
+void ib_killMutex(ib_Mutex* mutex)
+{
+	pthread_mutex_destroy((pthread_mutex_t*)mutex->Handle);
+	free(mutex->Handle);
+	mutex->Handle = NULL;
+}
+
+uint32_t ib_atomicAddU32(uint32_t volatile* value, uint32_t add)
+{
+	return __atomic_add_fetch(value, add, __ATOMIC_SEQ_CST);
+}
+
+uint64_t ib_atomicAddU64(uint64_t volatile* value, uint64_t add)
+{
+	return __atomic_add_fetch(value, add, __ATOMIC_SEQ_CST);
+}
+
+uint32_t ib_atomicLoadU32(uint32_t volatile const* value)
+{
+	return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+#endif // _WIN32
@@ -0,0 +1,608 @@
+// Copyright (c) 2019 Cranberry King; 2025 Snowed In Studios Inc.
+
+// Headless render graph benchmark.
+// Scenarios:
+// - blit: renders a scripted scene without a window and writes the results of ibr_runBenchmark as JSON.
+//   The scene only clears and blits so that it runs on any device, lavapipe included.
+// - pipelines: compiles N compute pipelines serially, then through ib_compilePipelineBatch, and reports both times.
+// - passes: records N compute passes a frame that each bind a transient shader input, once with push descriptors and
+//   once through the transient descriptor pool, and reports the CPU record time of both.
+// - statistics: compiles the compute shader and diffs its driver statistics against a baseline saved by an earlier run,
+//   exits with 1 when a statistic moved past the tolerance. --save-baseline writes the baseline instead.
+//
+// Built by the ib_benchmark project in Experiments/Experiments.sln.
+//
+// ib_benchmark [--scenario blit|pipelines|passes|statistics] [--device name] [--shader compute.spv]
+//              [--frames N] [--warmup N] [--width N] [--height N] [--out results.json] [--image final.ppm]
+//              [--pipelines N] [--threads N] [--passes N]
+//              [--baseline statistics.tsv] [--save-baseline 0|1] [--tolerance 0.05]
+
+#include <iceberg/ib_rendergraph.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Empty compute shader with a specialization constant (constant_id 0) that makes every pipeline distinct.
+// Hand assembled so the tool needs no shader compiler, --shader replaces it with a real shader with a "main" entry point.
+static uint32_t const EmptyComputeSPIRV[] =
+{
+	0x07230203, 0x00010000, 0, 7, 0, // Header, ids below 7
+	0x00020011, 1, // OpCapability Shader
+	0x0003000E, 0, 1, // OpMemoryModel Logical GLSL450
+	0x0005000F, 5, 1, 0x6E69616D, 0, // OpEntryPoint GLCompute %1 "main"
+	0x00060010, 1, 17, 64, 1, 1, // OpExecutionMode %1 LocalSize 64 1 1
+	0x00040047, 5, 1, 0, // OpDecorate %5 SpecId 0
+	0x00020013, 2, // %2 = OpTypeVoid
+	0x00030021, 3, 2, // %3 = OpTypeFunction %2
+	0x00040015, 4, 32, 0, // %4 = OpTypeInt 32 0
+	0x00040032, 4, 5, 0, // %5 = OpSpecConstant %4 0
+	0x00050036, 2, 1, 0, 3, // %1 = OpFunction %2 None %3
+	0x000200F8, 6, // %6 = OpLabel
+	0x000100FD, // OpReturn
+	0x00010038 // OpFunctionEnd
+};
+
+typedef struct
+{
+	void const* Code;
+	size_t CodeSize;
+} ComputeShader;
+
+static bool loadComputeShader(char const* path, ComputeShader* outShader)
+{
+	if (path == NULL)
+	{
+		*outShader = (ComputeShader) { EmptyComputeSPIRV, sizeof(EmptyComputeSPIRV) };
+		return true;
+	}
+
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	void* code = size > 0 && size % 4 == 0 ? malloc((size_t)size) : NULL;
+	if (code != NULL && fread(code, (size_t)size, 1, file) != 1)
+	{
+		free(code);
+		code = NULL;
+	}
+	fclose(file);
+
+	*outShader = (ComputeShader) { code, code != NULL ? (size_t)size : 0 };
+	return code != NULL;
+}
+
+static ib_ComputePipelineDesc computePipelineDesc(ComputeShader shader, ib_SpecializationConstant const* constant)
+{
+	return (ib_ComputePipelineDesc)
+	{
+		.ShaderDesc =
+		{
+			.EntryPoint = "main",
+			.Code = shader.Code,
+			.CodeSize = shader.CodeSize,
+			.Stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.Constants = { constant, constant != NULL ? 1 : 0 }
+		}
+	};
+}
+
+static void runPipelineScenario(ib_Core* core, ComputeShader shader, uint32_t pipelineCount, uint32_t threadCount)
+{
+	// The serial and batched pipelines specialize to different values so the batch can't hit what the serial run cached.
+	ib_SpecializationConstant* constants = (ib_SpecializationConstant*)malloc(sizeof(ib_SpecializationConstant) * pipelineCount * 2);
+	ib_ComputePipelineDesc* descs = (ib_ComputePipelineDesc*)malloc(sizeof(ib_ComputePipelineDesc) * pipelineCount * 2);
+	ib_ComputePipeline* pipelines = (ib_ComputePipeline*)malloc(sizeof(ib_ComputePipeline) * pipelineCount * 2);
+	for (uint32_t i = 0; i < pipelineCount * 2; i++)
+	{
+		constants[i] = (ib_SpecializationConstant) { 0, i };
+		descs[i] = computePipelineDesc(shader, &constants[i]);
+	}
+
+	uint64_t serialBeginTicks = ib_cpuTicks();
+	for (uint32_t i = 0; i < pipelineCount; i++)
+	{
+		pipelines[i] = ib_allocComputePipeline(core, descs[i]);
+	}
+	double serialMs = ib_cpuTicksToMs(ib_cpuTicks() - serialBeginTicks);
+
+	ib_PipelineBatch* batch = ib_compilePipelineBatch(core, (ib_PipelineBatchDesc)
+	{
+		.ComputeDescs = { descs + pipelineCount, pipelineCount },
+		.OutComputePipelines = pipelines + pipelineCount,
+		.ThreadCount = threadCount
+	});
+	ib_PipelineBatchStats stats = ib_waitPipelineBatch(batch);
+	double batchMs = ib_cpuTicksToMs(stats.WallCPUTicks);
+
+	printf("%u compute pipelines: serial %.3fms, batched %.3fms on %u threads, %.2fx\n", pipelineCount, serialMs, batchMs,
+		stats.ThreadCount, batchMs > 0.0 ? serialMs / batchMs : 0.0);
+
+	for (uint32_t i = 0; i < pipelineCount * 2; i++)
+	{
+		ib_freeComputePipeline(core, &pipelines[i]);
+	}
+	free(pipelines);
+	free(descs);
+	free(constants);
+}
+
+// The pool path allocates a set per pass from the render graph's transient pool, which holds this many sets a frame.
+#define MaxPassScenarioPassCount 128
+
+typedef struct
+{
+	uint32_t PassCount;
+	uint32_t WarmupFrameCount;
+	uint32_t FrameCount;
+	ib_ShaderInputDesc const* Input;
+	ib_ShaderInputLayout const* Layout;
+	ib_ComputePipeline const* Pipeline;
+	ib_Buffer const* Buffer;
+	uint64_t RecordTicks; // Summed over the measured frames
+} PassScene;
+
+static void recordPassFrame(ibr_RenderGraph* graph, uint32_t frame, void* userData)
+{
+	PassScene* scene = (PassScene*)userData;
+
+	VkCommandBuffer cmd = ibr_allocTransientCommandBuffer(graph, ib_Queue_Graphics);
+	ib_vkCheck(vkBeginCommandBuffer(cmd, &(VkCommandBufferBeginInfo)
+	{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	}));
+
+	uint64_t beginTicks = ib_cpuTicks();
+	ib_ShaderInputWrite write = { .Desc = scene->Input, .BufferInput = { scene->Buffer, 0, scene->Buffer->Size } };
+	for (uint32_t i = 0; i < scene->PassCount; i++)
+	{
+		ibr_beginComputePass(graph, cmd, (ibr_BeginComputePassDesc) { .PassName = "Pass" });
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, scene->Pipeline->VulkanPipeline);
+		ibr_bindTransientShaderInput(graph, cmd, (ibr_BindTransientShaderInputDesc)
+		{
+			.BindPoint = VK_PIPELINE_BIND_POINT_COMPUTE,
+			.PipelineLayout = scene->Pipeline->Layout,
+			.SetIndex = 0,
+			.Layout = scene->Layout,
+			.Inputs = { &write, 1 }
+		});
+		vkCmdDispatch(cmd, 1, 1, 1);
+		ibr_endComputePass(graph, cmd);
+	}
+
+	if (frame >= scene->WarmupFrameCount && frame < scene->WarmupFrameCount + scene->FrameCount)
+	{
+		scene->RecordTicks += ib_cpuTicks() - beginTicks;
+	}
+
+	ib_vkCheck(vkEndCommandBuffer(cmd));
+	ibr_submitCommandBuffers(graph, (ibr_SubmitCommandBufferDesc)
+	{
+		.Queue = ib_Queue_Graphics,
+		.CommandBuffers = { .Array = { cmd } },
+		.SubmitFence = graph->FrameFence
+	});
+}
+
+// Returns the mean CPU time in milliseconds to record a frame's passes.
+static double runPassScenarioWith(ib_Core* core, ComputeShader shader, uint32_t passCount, uint32_t frameCount, uint32_t warmupFrameCount, bool pushDescriptors)
+{
+	static ib_ShaderInputDesc const input = { .Index = 0, .Shaders = VK_SHADER_STAGE_COMPUTE_BIT, .Type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .ArraySize = 1 };
+	ib_ShaderInputLayout layout = ib_allocShaderInputLayout(core, (ib_ShaderInputLayoutDesc) { .Inputs = { &input, 1 }, .PushDescriptor = pushDescriptors });
+
+	ib_ComputePipelineDesc pipelineDesc = computePipelineDesc(shader, NULL);
+	pipelineDesc.ShaderInputs[0].External = &layout;
+	ib_ComputePipeline pipeline = ib_allocComputePipeline(core, pipelineDesc);
+
+	ib_Buffer buffer = ib_allocBuffer(core, (ib_BufferDesc)
+	{
+		.Usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		.Size = 256,
+		.RequiredMemoryFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		.DebugName = "Benchmark Pass Buffer"
+	});
+
+	PassScene scene =
+	{
+		.PassCount = passCount,
+		.WarmupFrameCount = warmupFrameCount,
+		.FrameCount = frameCount,
+		.Input = &input,
+		.Layout = &layout,
+		.Pipeline = &pipeline,
+		.Buffer = &buffer
+	};
+
+	ibr_RenderGraphPool pool = ibr_allocRenderGraphPool(core, (ibr_RenderGraphPoolDesc) { 0 });
+	ibr_runBenchmark(core, &pool, (ibr_BenchmarkDesc)
+	{
+		.FrameCount = frameCount,
+		.WarmupFrameCount = warmupFrameCount,
+		.RecordFrame = recordPassFrame,
+		.UserData = &scene
+	});
+
+	vkDeviceWaitIdle(core->LogicalDevice);
+	ibr_freeRenderGraphPool(core, &pool);
+	ib_freeBuffer(core, &buffer);
+	ib_freeComputePipeline(core, &pipeline);
+	ib_freeShaderInputLayout(core, &layout);
+	return frameCount > 0 ? ib_cpuTicksToMs(scene.RecordTicks) / (double)frameCount : 0.0;
+}
+
+static void runPassScenario(ib_Core* core, ComputeShader shader, uint32_t passCount, uint32_t frameCount, uint32_t warmupFrameCount)
+{
+	double poolMs = runPassScenarioWith(core, shader, passCount, frameCount, warmupFrameCount, false);
+	printf("%u passes, descriptor pool: %.3fms recording a frame\n", passCount, poolMs);
+
+	if (!core->PushDescriptorsEnabled)
+	{
+		printf("%u passes, push descriptors: not supported by the device\n", passCount);
+		return;
+	}
+
+	double pushMs = runPassScenarioWith(core, shader, passCount, frameCount, warmupFrameCount, true);
+	printf("%u passes, push descriptors: %.3fms recording a frame, %.2fx\n", passCount, pushMs, pushMs > 0.0 ? poolMs / pushMs : 0.0);
+}
+
+#define MaxReportedStatisticChanges 64
+
+// Baselines are per device and driver, keep one for each machine that runs the check.
+static int runStatisticsScenario(ib_Core* core, ComputeShader shader, char const* baselinePath, bool saveBaseline, double tolerance)
+{
+	ib_ComputePipeline pipeline = ib_allocComputePipeline(core, computePipelineDesc(shader, NULL));
+
+	int exitCode = 1;
+	ib_PipelineExecutableReport report;
+	if (!ib_getPipelineExecutableReport(core, pipeline.VulkanPipeline, &report))
+	{
+		fprintf(stderr, "The device doesn't report pipeline executable statistics\n");
+	}
+	else
+	{
+		ib_NamedPipelineExecutableReport const named = { "Compute", &report };
+		ib_PipelineReportRange const reports = { &named, 1 };
+		if (saveBaseline)
+		{
+			if (ib_savePipelineStatisticsBaseline(baselinePath, reports))
+			{
+				printf("Saved pipeline statistics baseline to %s\n", baselinePath);
+				exitCode = 0;
+			}
+			else
+			{
+				fprintf(stderr, "Couldn't write pipeline statistics baseline %s\n", baselinePath);
+			}
+		}
+		else
+		{
+			ib_PipelineStatisticChange changes[MaxReportedStatisticChanges];
+			uint32_t changeCount;
+			if (!ib_diffPipelineStatisticsBaseline((ib_DiffPipelineStatisticsDesc)
+				{
+					.BaselinePath = baselinePath,
+					.Reports = reports,
+					.Tolerance = tolerance,
+					.OutChanges = changes,
+					.MaxChangeCount = MaxReportedStatisticChanges
+				}, &changeCount))
+			{
+				fprintf(stderr, "Couldn't read pipeline statistics baseline %s\n", baselinePath);
+			}
+			else
+			{
+				for (uint32_t i = 0; i < ib_min(changeCount, MaxReportedStatisticChanges); i++)
+				{
+					printf("%s [%s] %s: %g -> %g\n", changes[i].PipelineName, changes[i].ExecutableName, changes[i].Statistic->Name,
+						changes[i].BaselineValue, changes[i].Statistic->Value);
+				}
+				printf("%u statistics moved more than %g%% from %s\n", changeCount, tolerance * 100.0, baselinePath);
+				exitCode = changeCount > 0 ? 1 : 0;
+			}
+		}
+	}
+
+	ib_freeComputePipeline(core, &pipeline);
+	return exitCode;
+}
+
+typedef struct
+{
+	VkExtent2D Extent;
+	ib_Texture Output;
+} Scene;
+
+static ib_TextureDesc sceneTextureDesc(VkExtent2D extent, VkFormat format, VkImageAspectFlags aspect, VkImageUsageFlags usage, char const* name)
+{
+	return (ib_TextureDesc)
+	{
+		.Usage = usage,
+		.Format = format,
+		.Extent = { extent.width, extent.height, 1 },
+		.Aspect = aspect,
+		.MipCount = 1,
+		.LayerCount = 1,
+		.DebugName = name
+	};
+}
+
+static void blit(VkCommandBuffer cmd, ib_Texture const* source, ib_Texture const* dest)
+{
+	VkImageBlit region =
+	{
+		.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.srcOffsets = { { 0, 0, 0 }, { (int32_t)source->Extent.width, (int32_t)source->Extent.height, 1 } },
+		.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+		.dstOffsets = { { 0, 0, 0 }, { (int32_t)dest->Extent.width, (int32_t)dest->Extent.height, 1 } }
+	};
+	vkCmdBlitImage(cmd, source->Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dest->Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_LINEAR);
+}
+
+static void recordSceneFrame(ibr_RenderGraph* graph, uint32_t frame, void* userData)
+{
+	Scene* scene = (Scene*)userData;
+	VkExtent2D halfExtent = { ib_max(scene->Extent.width / 2, 1u), ib_max(scene->Extent.height / 2, 1u) };
+
+	ibr_Resource color, depth, half, output;
+	ibr_allocPassResources(graph, (ibr_AllocPassResourcesDesc)
+	{
+		.ResourceBindings =
+		{
+			.Array =
+			{
+				{ &color, { .Type = ibr_ResourceType_Texture, .Flags = ibr_ResourceFlag_Transient,
+					.TextureDesc = sceneTextureDesc(scene->Extent, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT,
+						VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, "Benchmark Color") } },
+				{ &depth, { .Type = ibr_ResourceType_Texture, .Flags = ibr_ResourceFlag_Transient,
+					.TextureDesc = sceneTextureDesc(scene->Extent, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT,
+						VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, "Benchmark Depth") } },
+				{ &half, { .Type = ibr_ResourceType_Texture, .Flags = ibr_ResourceFlag_Transient,
+					.TextureDesc = sceneTextureDesc(halfExtent, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT,
+						VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, "Benchmark Half") } },
+				{ &output, { .Type = ibr_ResourceType_Texture, .Texture = &scene->Output } }
+			}
+		}
+	});
+
+	VkCommandBuffer cmd = ibr_allocTransientCommandBuffer(graph, ib_Queue_Graphics);
+	ib_vkCheck(vkBeginCommandBuffer(cmd, &(VkCommandBufferBeginInfo)
+	{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	}));
+
+	// Animate the clear so consecutive frames aren't identical.
+	float t = (float)(frame % 256) / 255.0f;
+	ibr_beginGraphicsPass(graph, cmd, (ibr_BeginGraphicsPassDesc)
+	{
+		.RenderTargets = { .Array = { { .Resource = &color, .LoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR, .StoreOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.ClearValue = { .color = { .float32 = { t, 0.25f, 1.0f - t, 1.0f } } } } } },
+		.DepthTarget = { .Resource = &depth, .LoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR, .StoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.ClearValue = { .depthStencil = { 1.0f, 0 } } },
+		.MinDepth = 0.0f,
+		.MaxDepth = 1.0f,
+		.PassName = "Clear"
+	});
+	ibr_endGraphicsPass(graph, cmd);
+
+	ibr_beginComputePass(graph, cmd, (ibr_BeginComputePassDesc)
+	{
+		.ResourceStates = { .Array =
+		{
+			ibr_textureState(&color, ibr_TextureState_TransferSrc, VK_PIPELINE_STAGE_TRANSFER_BIT),
+			ibr_textureState(&half, ibr_TextureState_TransferDst, VK_PIPELINE_STAGE_TRANSFER_BIT)
+		} },
+		.PassName = "Downsample"
+	});
+	blit(cmd, color.Texture, half.Texture);
+	ibr_endComputePass(graph, cmd);
+
+	ibr_beginComputePass(graph, cmd, (ibr_BeginComputePassDesc)
+	{
+		.ResourceStates = { .Array =
+		{
+			ibr_textureState(&half, ibr_TextureState_TransferSrc, VK_PIPELINE_STAGE_TRANSFER_BIT),
+			ibr_textureState(&output, ibr_TextureState_TransferDst, VK_PIPELINE_STAGE_TRANSFER_BIT)
+		} },
+		.PassName = "Upsample"
+	});
+	blit(cmd, half.Texture, output.Texture);
+	ibr_endComputePass(graph, cmd);
+
+	ib_vkCheck(vkEndCommandBuffer(cmd));
+	ibr_submitCommandBuffers(graph, (ibr_SubmitCommandBufferDesc)
+	{
+		.Queue = ib_Queue_Graphics,
+		.CommandBuffers = { .Array = { cmd } },
+		.SubmitFence = graph->FrameFence
+	});
+}
+
+static uint32_t parseU32(char const* value, uint32_t fallback)
+{
+	char* end;
+	unsigned long parsed = strtoul(value, &end, 10);
+	return end != value && *end == '\0' ? (uint32_t)parsed : fallback;
+}
+
+static int runBlitScenario(ib_Core* core, VkExtent2D extent, uint32_t frameCount, uint32_t warmupFrameCount, char const* resultsPath, char const* imagePath)
+{
+	Scene scene = { .Extent = extent };
+	scene.Output = ib_allocTexture(core, sceneTextureDesc(extent, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, "Benchmark Output"));
+
+	ibr_RenderGraphPool pool = ibr_allocRenderGraphPool(core, (ibr_RenderGraphPoolDesc) { 0 });
+	ibr_BenchmarkResult result = ibr_runBenchmark(core, &pool, (ibr_BenchmarkDesc)
+	{
+		.FrameCount = frameCount,
+		.WarmupFrameCount = warmupFrameCount,
+		.RecordFrame = recordSceneFrame,
+		.UserData = &scene,
+		.ResultsPath = resultsPath,
+		.OutputTexture = &scene.Output,
+		.OutputTextureLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.OutputImagePath = imagePath
+	});
+
+	printf("%s: %u frames at %ux%u, CPU %.3fms mean %.3fms p99, GPU %.3fms mean\n", result.DeviceName, result.FrameCount,
+		extent.width, extent.height, result.MeanCPUFrameTime, result.P99CPUFrameTime, result.MeanGPUFrameTime);
+
+	vkDeviceWaitIdle(core->LogicalDevice);
+	ibr_freeRenderGraphPool(core, &pool);
+	ib_freeTexture(core, &scene.Output);
+	return imagePath != NULL && !result.WroteImage ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+	char const* scenario = "blit";
+	char const* deviceName = NULL;
+	char const* shaderPath = NULL;
+	uint32_t frameCount = 500;
+	uint32_t warmupFrameCount = 50;
+	VkExtent2D extent = { 1920, 1080 };
+	char const* resultsPath = "benchmark.json";
+	char const* imagePath = NULL;
+	uint32_t pipelineCount = 256;
+	uint32_t threadCount = 0;
+	uint32_t passCount = MaxPassScenarioPassCount;
+	char const* baselinePath = "statistics.tsv";
+	bool saveBaseline = false;
+	double tolerance = 0.05;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		char const* option = argv[i];
+		char const* value = argv[i + 1];
+		if (strcmp(option, "--scenario") == 0)
+		{
+			scenario = value;
+		}
+		else if (strcmp(option, "--device") == 0)
+		{
+			deviceName = value;
+		}
+		else if (strcmp(option, "--shader") == 0)
+		{
+			shaderPath = value;
+		}
+		else if (strcmp(option, "--frames") == 0)
+		{
+			frameCount = parseU32(value, frameCount);
+		}
+		else if (strcmp(option, "--warmup") == 0)
+		{
+			warmupFrameCount = parseU32(value, warmupFrameCount);
+		}
+		else if (strcmp(option, "--width") == 0)
+		{
+			extent.width = parseU32(value, extent.width);
+		}
+		else if (strcmp(option, "--height") == 0)
+		{
+			extent.height = parseU32(value, extent.height);
+		}
+		else if (strcmp(option, "--out") == 0)
+		{
+			resultsPath = value;
+		}
+		else if (strcmp(option, "--image") == 0)
+		{
+			imagePath = value;
+		}
+		else if (strcmp(option, "--pipelines") == 0)
+		{
+			pipelineCount = parseU32(value, pipelineCount);
+		}
+		else if (strcmp(option, "--threads") == 0)
+		{
+			threadCount = parseU32(value, threadCount);
+		}
+		else if (strcmp(option, "--passes") == 0)
+		{
+			passCount = parseU32(value, passCount);
+		}
+		else if (strcmp(option, "--baseline") == 0)
+		{
+			baselinePath = value;
+		}
+		else if (strcmp(option, "--save-baseline") == 0)
+		{
+			saveBaseline = parseU32(value, 0) != 0;
+		}
+		else if (strcmp(option, "--tolerance") == 0)
+		{
+			tolerance = atof(value);
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", option);
+			return 1;
+		}
+	}
+
+	bool const isBlit = strcmp(scenario, "blit") == 0;
+	bool const isPipelines = strcmp(scenario, "pipelines") == 0;
+	bool const isPasses = strcmp(scenario, "passes") == 0;
+	bool const isStatistics = strcmp(scenario, "statistics") == 0;
+	if (!isBlit && !isPipelines && !isPasses && !isStatistics)
+	{
+		fprintf(stderr, "Unknown scenario %s\n", scenario);
+		return 1;
+	}
+
+	if (extent.width == 0 || extent.height == 0 || pipelineCount == 0)
+	{
+		fprintf(stderr, "Invalid extent %ux%u or pipeline count %u\n", extent.width, extent.height, pipelineCount);
+		return 1;
+	}
+
+	if (passCount == 0 || passCount > MaxPassScenarioPassCount)
+	{
+		fprintf(stderr, "Pass count must be between 1 and %u, the transient descriptor pool holds that many sets\n", MaxPassScenarioPassCount);
+		return 1;
+	}
+
+	ComputeShader shader;
+	if (!loadComputeShader(shaderPath, &shader))
+	{
+		fprintf(stderr, "Couldn't read SPIR-V from %s\n", shaderPath);
+		return 1;
+	}
+
+	// No window, the present queue falls back to the graphics queue.
+	ib_Core core;
+	ib_initCore((ib_CoreDesc) { .DeviceNameFilter = deviceName, .CaptureShaderStatistics = isStatistics }, &core);
+
+	int exitCode = 0;
+	if (isBlit)
+	{
+		exitCode = runBlitScenario(&core, extent, frameCount, warmupFrameCount, resultsPath, imagePath);
+	}
+	else if (isPipelines)
+	{
+		runPipelineScenario(&core, shader, pipelineCount, threadCount);
+	}
+	else if (isPasses)
+	{
+		runPassScenario(&core, shader, passCount, frameCount, warmupFrameCount);
+	}
+	else
+	{
+		exitCode = runStatisticsScenario(&core, shader, baselinePath, saveBaseline, tolerance);
+	}
+
+	ib_killCore(&core);
+	if (shader.Code != EmptyComputeSPIRV)
+	{
+		free((void*)shader.Code);
+	}
+	return exitCode;
+}